@@ -0,0 +1,115 @@
+#include "board.h"
+
+/*
+ * Each BOARD_X_* macro turns one table entry into its contribution to a
+ * register of port P (0 for the pins of other ports); BOARD_REG() ORs the
+ * contributions of the whole table, so every value below is a constant.
+ */
+#define BOARD_ON(P, port)   ((port) == (P))
+#define BOARD_X_USED(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? (1UL << (pin)) : 0UL)
+/* Same bits added instead of ORed: differs from BOARD_X_USED when a pin repeats */
+#define BOARD_X_COUNT(P, port, pin, mode, otype, speed, pull, af, level) \
+    + (BOARD_ON(P, port) ? (1UL << (pin)) : 0UL)
+#define BOARD_X_FIELD2(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? (3UL << ((pin) * 2U)) : 0UL)
+#define BOARD_X_MODER(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? ((uint32_t)GPIO_DRIVER_MODE_##mode << ((pin) * 2U)) : 0UL)
+#define BOARD_X_OTYPER(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? ((uint32_t)GPIO_DRIVER_OUTPUT_##otype << (pin)) : 0UL)
+#define BOARD_X_OSPEEDR(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? ((uint32_t)GPIO_DRIVER_SPEED_##speed << ((pin) * 2U)) : 0UL)
+#define BOARD_X_PUPDR(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (BOARD_ON(P, port) ? ((uint32_t)GPIO_DRIVER_##pull << ((pin) * 2U)) : 0UL)
+#define BOARD_X_AFRL(P, port, pin, mode, otype, speed, pull, af, level) \
+    | ((BOARD_ON(P, port) && (pin) < 8U) ? ((uint32_t)(af) << (((pin) & 7U) * 4U)) : 0UL)
+#define BOARD_X_AFRH(P, port, pin, mode, otype, speed, pull, af, level) \
+    | ((BOARD_ON(P, port) && (pin) >= 8U) ? ((uint32_t)(af) << (((pin) & 7U) * 4U)) : 0UL)
+#define BOARD_X_ODR(P, port, pin, mode, otype, speed, pull, af, level) \
+    | ((BOARD_ON(P, port) && (level)) ? (1UL << (pin)) : 0UL)
+/* Entries out of range: pin over 15, AF over 15 */
+#define BOARD_X_INVALID(P, port, pin, mode, otype, speed, pull, af, level) \
+    | (((pin) > 15U || (af) > 15U) ? 1UL : 0UL)
+
+#define BOARD_REG(x, P)     (0UL BOARD_PINS(x, P))
+
+/* Register value: table bits over the reset value of the pins not in the table */
+#define BOARD_VALUE(x, mask, P, reset)  (((reset) & ~(mask)) | BOARD_REG(x, P))
+
+/* Reset values (RM0368): PA13/PA14/PA15 and PB3/PB4 start as debug pins */
+#define BOARD_MODER_RESET_A     0xA8000000UL
+#define BOARD_MODER_RESET_B     0x00000280UL
+#define BOARD_OSPEEDR_RESET_A   0x0C000000UL
+#define BOARD_OSPEEDR_RESET_B   0x000000C0UL
+#define BOARD_PUPDR_RESET_A     0x64000000UL
+#define BOARD_PUPDR_RESET_B     0x00000100UL
+
+#define BOARD_PORT_ENTRY(P, gpio, moder_reset, ospeedr_reset, pupdr_reset) { \
+    gpio, BOARD_REG(BOARD_X_USED, P), \
+    BOARD_VALUE(BOARD_X_MODER, BOARD_REG(BOARD_X_FIELD2, P), P, moder_reset), \
+    BOARD_REG(BOARD_X_OTYPER, P), \
+    BOARD_VALUE(BOARD_X_OSPEEDR, BOARD_REG(BOARD_X_FIELD2, P), P, ospeedr_reset), \
+    BOARD_VALUE(BOARD_X_PUPDR, BOARD_REG(BOARD_X_FIELD2, P), P, pupdr_reset), \
+    { BOARD_REG(BOARD_X_AFRL, P), BOARD_REG(BOARD_X_AFRH, P) }, \
+    BOARD_REG(BOARD_X_ODR, P) }
+
+/* Build-time checks: conflicts between drivers and pins the board cannot give away */
+#define BOARD_ASSERT_UNIQUE(P, name) \
+    _Static_assert((0UL BOARD_PINS(BOARD_X_COUNT, P)) == BOARD_REG(BOARD_X_USED, P), \
+            "board pin table: a pin of port " name " is claimed twice")
+
+BOARD_ASSERT_UNIQUE(BOARD_PORT_A, "A");
+BOARD_ASSERT_UNIQUE(BOARD_PORT_B, "B");
+BOARD_ASSERT_UNIQUE(BOARD_PORT_C, "C");
+_Static_assert(BOARD_REG(BOARD_X_INVALID, 0U) == 0UL,
+        "board pin table: pin or alternate function number over 15");
+_Static_assert((BOARD_REG(BOARD_X_USED, BOARD_PORT_A) & ((1UL << 13) | (1UL << 14))) == 0UL,
+        "board pin table: PA13/PA14 are the SWD pins");
+
+/* Register values of one port */
+typedef struct {
+    GPIO_TypeDef *gpio;
+    uint32_t     used;      /* Pins of the port in the table */
+    uint32_t     moder;
+    uint32_t     otyper;
+    uint32_t     ospeedr;
+    uint32_t     pupdr;
+    uint32_t     afr[2];
+    uint32_t     odr;
+} board_port_t;
+
+static const board_port_t board_ports[BOARD_PORTS] = {
+    BOARD_PORT_ENTRY(BOARD_PORT_A, GPIOA, BOARD_MODER_RESET_A, BOARD_OSPEEDR_RESET_A, BOARD_PUPDR_RESET_A),
+    BOARD_PORT_ENTRY(BOARD_PORT_B, GPIOB, BOARD_MODER_RESET_B, BOARD_OSPEEDR_RESET_B, BOARD_PUPDR_RESET_B),
+    BOARD_PORT_ENTRY(BOARD_PORT_C, GPIOC, 0UL, 0UL, 0UL),
+};
+
+/**
+ * @brief Enables the GPIO clocks and configures every pin of the table.
+ * One write per register of each port in use; the output level is set
+ * before the mode so outputs start at their declared level.
+ */
+void Board_PinsInit(void) {
+    uint32_t clocks = 0;
+
+    for (uint32_t i = 0; i < BOARD_PORTS; i++) {
+        if (board_ports[i].used) {
+            clocks |= RCC_AHB1ENR_GPIOAEN << i;
+        }
+    }
+    RCC->AHB1ENR |= clocks;
+
+    for (uint32_t i = 0; i < BOARD_PORTS; i++) {
+        const board_port_t *port = &board_ports[i];
+        if (!port->used) {
+            continue;
+        }
+        port->gpio->ODR = port->odr;
+        port->gpio->OTYPER = port->otyper;
+        port->gpio->OSPEEDR = port->ospeedr;
+        port->gpio->PUPDR = port->pupdr;
+        port->gpio->AFR[0] = port->afr[0];
+        port->gpio->AFR[1] = port->afr[1];
+        port->gpio->MODER = port->moder;
+    }
+}
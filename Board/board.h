@@ -0,0 +1,132 @@
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include "stm32f4xx.h"
+#include "gpio.h"
+#include "lcd_config.h"
+#include "74hc595.h"
+#include "rgb.h"
+#include "uart.h"
+#include <rc522.h>
+
+/**
+ * @brief Board pin table.
+ * Every pin of the board is declared here once, with the configuration the
+ * drivers expect before their Init functions run. board.c folds the table
+ * into one value per register and port at compile time, and
+ * Board_PinsInit() writes each register once (unused pins keep their reset
+ * configuration). A pin claimed twice, or a debug pin claimed, is a build
+ * error. The drivers only set up their peripherals.
+ *
+ * Entry: X(P, port, pin, mode, otype, speed, pull, af, level)
+ *   P      passed through (port selected by board.c)
+ *   port   BOARD_PORT_A, BOARD_PORT_B or BOARD_PORT_C
+ *   mode   INPUT, OUTPUT, ALT_FUNCTION or ANALOG
+ *   otype  PUSH_PULL or OPEN_DRAIN
+ *   speed  LOW, MEDIUM, FAST or HIGH
+ *   pull   NO_PULL, PULL_UP or PULL_DOWN
+ *   af     Alternate function number (ALT_FUNCTION pins)
+ *   level  Output level from reset on (OUTPUT pins)
+ */
+
+/* Port indexes (same order as the GPIOx_BASE addresses) */
+#define BOARD_PORT_A    0U
+#define BOARD_PORT_B    1U
+#define BOARD_PORT_C    2U
+#define BOARD_PORTS     3U
+
+/* IR beam sensors (active low outputs) */
+#define ENTRY_IR_PORT         GPIOA
+#define ENTRY_IR_PIN          1
+#define EXIT_IR_PORT          GPIOA
+#define EXIT_IR_PIN           2
+
+#define BOARD_PINS_GATE(X, P) \
+    X(P, BOARD_PORT_A, 0,  ALT_FUNCTION, PUSH_PULL, FAST,   NO_PULL, 1, 0) /* Barrier servo, TIM2_CH1 */ \
+    X(P, BOARD_PORT_A, ENTRY_IR_PIN, INPUT, PUSH_PULL, LOW, PULL_UP, 0, 0) \
+    X(P, BOARD_PORT_A, EXIT_IR_PIN,  INPUT, PUSH_PULL, LOW, PULL_UP, 0, 0)
+
+/* Character LCD: GPIO bus, or I2C2 to a PCF8574 backpack (open drain) */
+#if LCD_BUS == LCD_BUS_PARALLEL
+#define BOARD_LCD_LINE(X, P, port_b, pin) \
+    X(P, (port_b) ? BOARD_PORT_B : BOARD_PORT_A, pin, OUTPUT, PUSH_PULL, MEDIUM, NO_PULL, 0, 0)
+#if LCD_USE_RW
+#define BOARD_PINS_LCD_RW(X, P)     BOARD_LCD_LINE(X, P, 1, RW_Pin)
+#else
+#define BOARD_PINS_LCD_RW(X, P)
+#endif
+#ifdef LCD8Bit
+#define BOARD_PINS_LCD_LOW(X, P) \
+    BOARD_LCD_LINE(X, P, DATA1_PortB, DATA1_Pin) BOARD_LCD_LINE(X, P, DATA2_PortB, DATA2_Pin) \
+    BOARD_LCD_LINE(X, P, DATA3_PortB, DATA3_Pin) BOARD_LCD_LINE(X, P, DATA4_PortB, DATA4_Pin)
+#else
+#define BOARD_PINS_LCD_LOW(X, P)
+#endif
+#define BOARD_PINS_LCD(X, P) \
+    BOARD_LCD_LINE(X, P, 1, RS_Pin) BOARD_LCD_LINE(X, P, 1, E_Pin) BOARD_PINS_LCD_RW(X, P) \
+    BOARD_LCD_LINE(X, P, DATA5_PortB, DATA5_Pin) BOARD_LCD_LINE(X, P, DATA6_PortB, DATA6_Pin) \
+    BOARD_LCD_LINE(X, P, DATA7_PortB, DATA7_Pin) BOARD_LCD_LINE(X, P, DATA8_PortB, DATA8_Pin) \
+    BOARD_PINS_LCD_LOW(X, P)
+#else
+#define BOARD_PINS_LCD(X, P) \
+    X(P, BOARD_PORT_B, LCD_I2C_SCL_Pin, ALT_FUNCTION, OPEN_DRAIN, LOW, PULL_UP, LCD_I2C_SCL_AF, 0) \
+    X(P, BOARD_PORT_B, LCD_I2C_SDA_Pin, ALT_FUNCTION, OPEN_DRAIN, LOW, PULL_UP, LCD_I2C_SDA_AF, 0)
+#endif
+
+/* 74HC595 chain: three bit-banged lines (as built), or SPI1 with a GPIO latch
+   (HC595_USE_SPI); optional OE on TIM3_CH1 (HC595_USE_OE_PWM, pulled up:
+   outputs off until the timer drives it) */
+#if HC595_USE_SPI
+#define BOARD_PINS_HC595_BUS(X, P) \
+    X(P, BOARD_PORT_A, HC595_SCK_PIN,  ALT_FUNCTION, PUSH_PULL, HIGH, NO_PULL, HC595_SPI_AF, 0) \
+    X(P, BOARD_PORT_B, HC595_MOSI_PIN, ALT_FUNCTION, PUSH_PULL, HIGH, NO_PULL, HC595_SPI_AF, 0) \
+    X(P, BOARD_PORT_B, LOAD_PIN,       OUTPUT,       PUSH_PULL, LOW,  NO_PULL, 0, 0)
+#else
+#define BOARD_PINS_HC595_BUS(X, P) \
+    X(P, BOARD_PORT_B, SDI_PIN,  OUTPUT, PUSH_PULL, LOW, NO_PULL, 0, 0) \
+    X(P, BOARD_PORT_B, SCLK_PIN, OUTPUT, PUSH_PULL, LOW, NO_PULL, 0, 0) \
+    X(P, BOARD_PORT_B, LOAD_PIN, OUTPUT, PUSH_PULL, LOW, NO_PULL, 0, 0)
+#endif
+#if HC595_USE_OE_PWM
+#define BOARD_PINS_HC595(X, P) BOARD_PINS_HC595_BUS(X, P) \
+    X(P, BOARD_PORT_B, HC595_OE_PIN, ALT_FUNCTION, PUSH_PULL, LOW, PULL_UP, HC595_OE_AF, 0)
+#else
+#define BOARD_PINS_HC595(X, P) BOARD_PINS_HC595_BUS(X, P)
+#endif
+
+/* Status RGB LED: TIM1_CH1-CH3 */
+#define BOARD_PINS_RGB(X, P) \
+    X(P, BOARD_PORT_A, RED_PIN,   ALT_FUNCTION, PUSH_PULL, FAST, NO_PULL, 1, 0) \
+    X(P, BOARD_PORT_A, GREEN_PIN, ALT_FUNCTION, PUSH_PULL, FAST, NO_PULL, 1, 0) \
+    X(P, BOARD_PORT_A, BLUE_PIN,  ALT_FUNCTION, PUSH_PULL, FAST, NO_PULL, 1, 0)
+
+/* MFRC522 on SPI2 (AF5); CS idles high, RST is held low until MFRC522_Init().
+   Optional IRQ (MFRC522_USE_IRQ=1): module IRQ to PC13, input with pull-up */
+#if MFRC522_USE_IRQ
+#define BOARD_PINS_RC522_IRQ(X, P) \
+    X(P, BOARD_PORT_C, MFRC522_IRQ_PIN, INPUT, PUSH_PULL, LOW, PULL_UP, 0, 0)
+#else
+#define BOARD_PINS_RC522_IRQ(X, P)
+#endif
+#define BOARD_PINS_RC522(X, P) \
+    X(P, BOARD_PORT_B, MFRC522_SCK_PIN,  ALT_FUNCTION, PUSH_PULL, HIGH, NO_PULL, 5, 0) \
+    X(P, BOARD_PORT_B, MFRC522_MISO_PIN, ALT_FUNCTION, PUSH_PULL, HIGH, NO_PULL, 5, 0) \
+    X(P, BOARD_PORT_B, MFRC522_MOSI_PIN, ALT_FUNCTION, PUSH_PULL, HIGH, NO_PULL, 5, 0) \
+    X(P, BOARD_PORT_B, MFRC522_CS_PIN,   OUTPUT,       PUSH_PULL, HIGH, NO_PULL, 0, 1) \
+    X(P, BOARD_PORT_B, MFRC522_RST_PIN,  OUTPUT,       PUSH_PULL, HIGH, NO_PULL, 0, 0) \
+    BOARD_PINS_RC522_IRQ(X, P)
+
+/* Service UART: USART6, pull-up keeps an open RX line idle */
+#define BOARD_PINS_UART(X, P) \
+    X(P, BOARD_PORT_A, UART_TX_PIN, ALT_FUNCTION, PUSH_PULL, LOW, NO_PULL, UART_GPIO_AF, 0) \
+    X(P, BOARD_PORT_A, UART_RX_PIN, ALT_FUNCTION, PUSH_PULL, LOW, PULL_UP, UART_GPIO_AF, 0)
+
+/* The whole board */
+#define BOARD_PINS(X, P) \
+    BOARD_PINS_GATE(X, P) BOARD_PINS_LCD(X, P) BOARD_PINS_HC595(X, P) \
+    BOARD_PINS_RGB(X, P) BOARD_PINS_RC522(X, P) BOARD_PINS_UART(X, P)
+
+/* @brief Enables the GPIO clocks and configures every pin of the table. */
+void Board_PinsInit(void);
+
+#endif /* BOARD_H_ */
@@ -0,0 +1,89 @@
+#include "clock.h"
+#include "delay.h"
+#include "format.h"
+#include "console.h"
+#include "uart.h"
+
+#define CLOCK_SECONDS_PER_DAY   86400U
+
+/* Time of day at clock_base_us */
+static uint32_t clock_base_seconds = CLOCK_DEFAULT_SECONDS;
+static uint64_t clock_base_us = 0;
+
+/**
+ * @brief Parses a number of up to two digits followed by a separator or the end.
+ * @param p Text; advanced past the number and the separator.
+ * @param max Largest accepted value.
+ * @return The value, or -1 if invalid.
+ */
+static int32_t clock_parseField(const char **p, uint32_t max) {
+    uint32_t value = 0;
+    uint8_t digits = 0;
+
+    while (**p >= '0' && **p <= '9' && digits < 2U) {
+        value = value * 10U + (uint32_t)(**p - '0');
+        (*p)++;
+        digits++;
+    }
+    if (digits == 0U || value > max) {
+        return -1;
+    }
+    if (**p == ':') {
+        (*p)++;
+    }
+    return (int32_t)value;
+}
+
+/**
+ * @brief Console command: "time" prints the time of day, "time HH:MM[:SS]" sets it.
+ */
+static void clock_command(const char *args) {
+    char line[16];
+    char *end = line + sizeof line - 1U;
+    char *p;
+
+    if (*args) {
+        int32_t hours = clock_parseField(&args, 23U);
+        int32_t minutes = clock_parseField(&args, 59U);
+        int32_t seconds = *args ? clock_parseField(&args, 59U) : 0;
+        if (hours < 0 || minutes < 0 || seconds < 0 || *args) {
+            UART_Write("usage: time [HH:MM[:SS]]\r\n");
+            return;
+        }
+        Clock_Set((uint32_t)(hours * 3600 + minutes * 60 + seconds));
+    }
+
+    uint32_t now = Clock_SecondsOfDay();
+    p = Format_Uint(line, end, now / 3600U, 2, '0');
+    p = Format_Str(p, end, ":", 0);
+    p = Format_Uint(p, end, (now / 60U) % 60U, 2, '0');
+    p = Format_Str(p, end, ":", 0);
+    p = Format_Uint(p, end, now % 60U, 2, '0');
+    p = Format_Str(p, end, "\r\n", 0);
+    *p = '\0';
+    UART_Write(line);
+}
+
+/**
+ * @brief Registers the "time" console command.
+ */
+void Clock_Init(void) {
+    Console_Register("time", clock_command);
+}
+
+/**
+ * @brief Sets the time of day.
+ * @param seconds Seconds since midnight (taken modulo one day).
+ */
+void Clock_Set(uint32_t seconds) {
+    clock_base_us = monotonic_us();
+    clock_base_seconds = seconds % CLOCK_SECONDS_PER_DAY;
+}
+
+/**
+ * @brief Returns the seconds since midnight (0..86399).
+ */
+uint32_t Clock_SecondsOfDay(void) {
+    uint64_t elapsed = (monotonic_us() - clock_base_us) / 1000000U;
+    return (uint32_t)((clock_base_seconds + elapsed) % CLOCK_SECONDS_PER_DAY);
+}
@@ -0,0 +1,33 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Software time of day.
+ * Counted from the monotonic microsecond clock since the last Clock_Set()
+ * (noon until the time is set). It is lost on reset; the console command
+ * "time HH:MM[:SS]" sets it and "time" prints it.
+ */
+
+/* Time of day reported before the clock is set, in seconds */
+#define CLOCK_DEFAULT_SECONDS   (12U * 3600U)
+
+/* @brief Registers the "time" console command. */
+void Clock_Init(void);
+
+/**
+ * @brief Sets the time of day.
+ * @param seconds Seconds since midnight (taken modulo one day).
+ */
+void Clock_Set(uint32_t seconds);
+
+/* @brief Returns the seconds since midnight (0..86399). */
+uint32_t Clock_SecondsOfDay(void);
+
+/* @brief Returns the minutes since midnight (0..1439). */
+static inline uint16_t Clock_MinuteOfDay(void) {
+    return (uint16_t)(Clock_SecondsOfDay() / 60U);
+}
+
+#endif /* CLOCK_H_ */
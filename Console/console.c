@@ -0,0 +1,80 @@
+#include "console.h"
+#include "uart.h"
+#include "task.h"
+#include <string.h>
+
+/* Registered command */
+typedef struct {
+    const char        *name;
+    Console_Handler_t handler;
+} Console_Command_t;
+
+static Console_Command_t commands[CONSOLE_MAX_COMMANDS];
+static uint8_t command_count = 0;
+
+static Task_t console_task;
+static char console_line[48];
+
+/**
+ * @brief Finds and runs the command of a received line.
+ * @param line Zero-terminated command line.
+ */
+static void console_execute(const char *line) {
+    size_t len = strcspn(line, " ");
+    const char *args = line + len;
+    while (*args == ' ') {
+        args++;
+    }
+
+    for (uint8_t i = 0; i < command_count; i++) {
+        if (strlen(commands[i].name) == len && memcmp(commands[i].name, line, len) == 0) {
+            commands[i].handler(args);
+            return;
+        }
+    }
+
+    UART_Write("unknown command, available:");
+    for (uint8_t i = 0; i < command_count; i++) {
+        UART_Write(" ");
+        UART_Write(commands[i].name);
+    }
+    UART_Write("\r\n");
+}
+
+/**
+ * @brief Polls the service UART for command lines.
+ * @param t The console task.
+ */
+static void Console_Task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        TASK_SLEEP(t, CONSOLE_POLL_INTERVAL);
+        while (UART_ReadLine(console_line, sizeof(console_line))) {
+            console_execute(console_line);
+        }
+    }
+    TASK_END(t);
+}
+
+/**
+ * @brief Starts the console task on the service UART.
+ */
+void Console_Init(void) {
+    Task_Start(&console_task, Console_Task, "console");
+}
+
+/**
+ * @brief Registers a command.
+ * @param name Command name (first word of the line).
+ * @param handler Function called with the rest of the line.
+ * @return true if registered, false if the table is full.
+ */
+bool Console_Register(const char *name, Console_Handler_t handler) {
+    if (command_count >= CONSOLE_MAX_COMMANDS) {
+        return false;
+    }
+    commands[command_count].name = name;
+    commands[command_count].handler = handler;
+    command_count++;
+    return true;
+}
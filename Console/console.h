@@ -0,0 +1,29 @@
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Maximum number of registered commands */
+#define CONSOLE_MAX_COMMANDS        8U
+/* Interval in ms between checks for a received command line */
+#define CONSOLE_POLL_INTERVAL       100U
+
+/* @brief Command handler. args points past the command name (may be empty). */
+typedef void (*Console_Handler_t)(const char *args);
+
+/**
+ * @brief Starts the console task on the service UART.
+ * @note  UART_Init() must have been called.
+ */
+void Console_Init(void);
+
+/**
+ * @brief Registers a command.
+ * @param name Command name (first word of the line).
+ * @param handler Function called with the rest of the line.
+ * @return true if registered, false if the table is full.
+ */
+bool Console_Register(const char *name, Console_Handler_t handler);
+
+#endif /* CONSOLE_H_ */
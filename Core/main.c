@@ -3,12 +3,22 @@
 #include "servo.h"
 #include "delay.h"
 #include "lcd_parallel.h"
+#include "lcd_screen.h"
+#include "lcd_message.h"
 #include <string.h>
-#include <stdio.h>
 #include "lcd_config.h"
 #include "gpio.h"
 #include "74hc595.h"
 #include "rgb.h"
+#include "task.h"
+#include "soft_timer.h"
+#include "uart.h"
+#include "console.h"
+#include "profiler.h"
+#include "trace.h"
+#include "clock.h"
+#include "pwm_timer.h"
+#include "board.h"
 #include <stdbool.h>
 
 /* Private function prototypes */
@@ -16,17 +26,20 @@ void SystemClock_Config(void);
 
 /* Constants for the parking system */
 #define MAX_VEHICLES_INSIDE    4       /* Maximum number of vehicles allowed in the parking lot. */
-#define BARRIER_CLOSED_ANGLE   0.0f    /* Servo angle when the barrier is closed. */
-#define BARRIER_OPEN_ANGLE     75.0f   /* Servo angle when the barrier is open. */
+#define BARRIER_CLOSED_ANGLE   SERVO_DEG(0)    /* Servo angle when the barrier is closed. */
+#define BARRIER_OPEN_ANGLE     SERVO_DEG(75)   /* Servo angle when the barrier is open. */
 #define AUTHORIZED_TIMEOUT     10000   /* Timeout in ms to wait for a vehicle after card authorization. */
 #define PASSAGE_TIMEOUT        15000   /* Timeout in ms for a vehicle to pass through the gate. */
 #define DELAY_BEFORE_CLOSING   2000    /* Delay in ms after a vehicle has passed before closing the barrier. */
+#define SERVO_MOVE_TIMEOUT     2000    /* Longest time in ms a barrier move may take (missed interrupt). */
+#define MESSAGE_HOLD_TIME      1500    /* Time to live in ms of an error message on the LCD. */
+#define READER_POLL_INTERVAL   50      /* Interval in ms between RFID polls while the gate is idle. */
+#define DISPLAY_REFRESH_INTERVAL 50    /* Interval in ms between status display refreshes. */
 
-/* GPIO definitions for IR sensors */
-#define ENTRY_IR_PORT         GPIOA
-#define ENTRY_IR_PIN          1
-#define EXIT_IR_PORT          GPIOA
-#define EXIT_IR_PIN           2
+/* Event bits posted to the gate task */
+#define EVT_CARD_PRESENTED     0x01U   /* The reader task captured a card UID. */
+#define EVT_IR_CHANGE          0x02U   /* One of the IR beams changed state (EXTI). */
+#define EVT_SERVO_DONE         0x04U   /* The barrier servo finished its move (timer interrupt). */
 
 /* Enum for vehicle direction */
 typedef enum {
@@ -65,18 +78,47 @@ volatile VehicleDirection_t current_direction = DIR_NONE;
 volatile BarrierState_t currentState = STATE_CLOSED;
 /* Servo configuration struct */
 Servo_Config_t barrierServo;
+/* Vehicles-inside counter: the three digits of the 74HC595 chain, hundreds first */
+static const HC595_Display_t counter_display = { .first = 0, .count = 3, .type = COMMON_ANODE };
+
+/* Status light when the car park is full (played by DMA, no CPU load) */
+static const RGB_Effect_t status_full = {
+    .type = RGB_EFFECT_BLINK,
+    .color = { 255, 0, 0 },
+    .period_ms = 1000,
+    .duty = 50,
+};
+
+/* Counter brightness by time of day: dimmed at dusk and dawn, low at night */
+static const HC595_BrightnessStep_t counter_brightness[] = {
+    {  6 * 60,  96 },
+    {  7 * 60, 255 },
+    { 19 * 60,  96 },
+    { 22 * 60,  24 },
+};
 /* Stores the UID of the last scanned card */
 uint8_t current_uid[4];
 
-/* Variables for MFRC522 communication (currently unused) */
+/* Buffers for MFRC522 communication (UID + BCC, and ATQA) */
 uint8_t card_uid[5];
 uint8_t card_type[2];
 
-/* Timestamp for state change timeouts */
-uint32_t state_change_timestamp;
 /* Flag to indicate if a vehicle is currently passing through the IR sensors */
 volatile bool vehicle_is_passing = false;
 
+/* Cooperative tasks: barrier sequence, RFID polling and status display */
+static Task_t gate_task;
+static Task_t reader_task;
+static Task_t display_task;
+
+/* Cycle count when the last card was read (tap-to-decision profiling) */
+static uint32_t card_seen_cycles;
+
+/* Gate status text shown on the LCD */
+static const char *gate_status = "Gate Closed";
+/* Tick at which the barrier starts closing (STATE_WAIT_BEFORE_CLOSING) */
+static uint32_t close_at;
+
 /**
  * @brief Checks if a given UID is in the list of authorized UIDs.
  * @param uid Pointer to the UID array to check.
@@ -134,42 +176,14 @@ void remove_vehicle(int index) {
 }
 
 /**
- * @brief Configures GPIO pins for LCD and IR sensors.
+ * @brief Configures every pin of the board (Board/board.h) and the IR sensor interrupts.
  */
 void GPIO_pinsConfig(void) {
-    /* Enable GPIOA and GPIOB clocks */
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN;
-
-    /* Configure LCD Pins as Output Push-Pull */
-    gpio_config_t lcd_pins[] = { { GPIOB, 1, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL }, { GPIOB, 0, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL }, { GPIOA, 7, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL }, { GPIOA, 6, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL }, { GPIOB, 10, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL }, { GPIOB, 2, GPIO_DRIVER_MODE_OUTPUT,
-            GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-            GPIO_DRIVER_NO_PULL } };
-    for (int i = 0; i < sizeof(lcd_pins) / sizeof(gpio_config_t); i++) {
-        GPIO_Init(&lcd_pins[i]);
-    }
-
-    /* Configure Entry IR sensor pin as input with pull-up */
-    gpio_config_t entry_ir_sensor = { ENTRY_IR_PORT, ENTRY_IR_PIN,
-            GPIO_DRIVER_MODE_INPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL,
-            GPIO_DRIVER_SPEED_MEDIUM, GPIO_DRIVER_PULL_UP };
-    GPIO_Init(&entry_ir_sensor);
-
-    /* Configure Exit IR sensor pin as input with pull-up */
-    gpio_config_t exit_ir_sensor = { EXIT_IR_PORT, EXIT_IR_PIN,
-            GPIO_DRIVER_MODE_INPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL,
-            GPIO_DRIVER_SPEED_MEDIUM, GPIO_DRIVER_PULL_UP };
-    GPIO_Init(&exit_ir_sensor);
+    Board_PinsInit();
 
+    /* Wake the gate task (and the core) on every IR beam edge */
+    GPIO_EnableInterrupt(ENTRY_IR_PORT, ENTRY_IR_PIN, GPIO_DRIVER_EDGE_BOTH);
+    GPIO_EnableInterrupt(EXIT_IR_PORT, EXIT_IR_PIN, GPIO_DRIVER_EDGE_BOTH);
 }
 
 /**
@@ -178,7 +192,7 @@ void GPIO_pinsConfig(void) {
  */
 bool Entry_IR_IsBlocked(void) {
     /* The sensor output is active low, so we check for a low level. */
-    return !(ENTRY_IR_PORT->IDR & (1 << ENTRY_IR_PIN));
+    return !Pin_Read(ENTRY_IR_PORT, ENTRY_IR_PIN);
 }
 
 /**
@@ -187,7 +201,321 @@ bool Entry_IR_IsBlocked(void) {
  */
 bool Exit_IR_IsBlocked(void) {
     /* The sensor output is active low, so we check for a low level. */
-    return !(EXIT_IR_PORT->IDR & (1 << EXIT_IR_PIN));
+    return !Pin_Read(EXIT_IR_PORT, EXIT_IR_PIN);
+}
+
+/**
+ * @brief EXTI line 1 interrupt: entry IR sensor edge.
+ */
+void EXTI1_IRQHandler(void) {
+    EXTI->PR = (1U << ENTRY_IR_PIN);
+    TRACE(TRACE_EVT_IR_EDGE, ENTRY_IR_PIN | (Entry_IR_IsBlocked() ? 0x80U : 0U));
+    Task_Post(&gate_task, EVT_IR_CHANGE);
+}
+
+/**
+ * @brief EXTI line 2 interrupt: exit IR sensor edge.
+ */
+void EXTI2_IRQHandler(void) {
+    EXTI->PR = (1U << EXIT_IR_PIN);
+    TRACE(TRACE_EVT_IR_EDGE, EXIT_IR_PIN | (Exit_IR_IsBlocked() ? 0x80U : 0U));
+    Task_Post(&gate_task, EVT_IR_CHANGE);
+}
+
+/**
+ * @brief Checks if the IR sensor on the side the vehicle comes from is blocked.
+ * @return true if the sensor for current_direction is blocked, false otherwise.
+ */
+static bool Direction_IR_IsBlocked(void) {
+    return (current_direction == DIR_ENTRY && Entry_IR_IsBlocked())
+            || (current_direction == DIR_EXIT && Exit_IR_IsBlocked());
+}
+
+/**
+ * @brief Checks that nothing blocks the barrier.
+ * @return true if both IR sensors are clear.
+ */
+static bool Gate_IsClear(void) {
+    return !Entry_IR_IsBlocked() && !Exit_IR_IsBlocked();
+}
+
+/**
+ * @brief Tracks the passage of the vehicle through the gate.
+ * @return true once the vehicle has blocked its sensor and both sensors are clear again.
+ */
+static bool Gate_PassageComplete(void) {
+    /* Stage 1: Wait for the vehicle to start passing. */
+    if (!vehicle_is_passing && Direction_IR_IsBlocked()) {
+        vehicle_is_passing = true;
+    }
+    /* Stage 2: The condition for complete passage is that both sensors are clear. */
+    return vehicle_is_passing && Gate_IsClear();
+}
+
+/* Screen field sources */
+static uint32_t Screen_FreeSlots(void) {
+    return MAX_VEHICLES_INSIDE - vehicle_count;
+}
+
+static const char *Screen_GateStatus(void) {
+    return gate_status;
+}
+
+/* Occupancy in per mille for the bar graph */
+static uint32_t Screen_Occupancy(void) {
+    return (uint32_t)vehicle_count * 1000U / MAX_VEHICLES_INSIDE;
+}
+
+/* Custom characters of the status screen */
+static const LCD_GlyphSet_t status_glyphs = {
+    .slots = {
+        [LCD_BAR_SLOT + 0] = &LCD_GlyphBar[0],
+        [LCD_BAR_SLOT + 1] = &LCD_GlyphBar[1],
+        [LCD_BAR_SLOT + 2] = &LCD_GlyphBar[2],
+        [LCD_BAR_SLOT + 3] = &LCD_GlyphBar[3],
+        [LCD_BAR_SLOT + 4] = &LCD_GlyphBar[4],
+    },
+};
+
+#if LCD_ROWS >= 4
+static uint32_t Screen_VehiclesInside(void) {
+    return vehicle_count;
+}
+
+/* Time until the barrier closes in tenths of a second, blank otherwise */
+static uint32_t Screen_CloseTime(void) {
+    if (currentState != STATE_WAIT_BEFORE_CLOSING) {
+        return LCD_FIELD_NONE;
+    }
+    int32_t remaining = (int32_t)(close_at - Get_Ms_Ticks());
+    return (remaining > 0) ? ((uint32_t)remaining + 99U) / 100U : 0U;
+}
+
+/* 20x4: counts, status, occupancy bar and closing countdown */
+static const LCD_Field_t status_fields[] = {
+    { .col = 14, .row = 0, .width = 2, .format = LCD_FIELD_UINT, .get.number = Screen_FreeSlots },
+    { .col = 14, .row = 1, .width = 2, .format = LCD_FIELD_UINT, .get.number = Screen_VehiclesInside },
+    { .col = 0,  .row = 2, .width = LCD_COLS, .format = LCD_FIELD_TEXT, .get.text = Screen_GateStatus },
+    { .col = 0,  .row = 3, .width = 10, .format = LCD_FIELD_BAR, .get.number = Screen_Occupancy },
+    { .col = 12, .row = 3, .width = 4, .format = LCD_FIELD_FIXED, .decimals = 1,
+      .get.number = Screen_CloseTime },
+};
+static const LCD_Screen_t status_screen = {
+    .rows = { "Free slots:", "Vehicles in:", 0, 0 },
+    .fields = status_fields,
+    .field_count = sizeof(status_fields) / sizeof(status_fields[0]),
+    .glyphs = &status_glyphs,
+};
+#else
+/* 16x2: free slots, occupancy bar and status */
+static const LCD_Field_t status_fields[] = {
+    { .col = 11, .row = 0, .width = 2, .format = LCD_FIELD_UINT, .get.number = Screen_FreeSlots },
+    { .col = 13, .row = 0, .width = 3, .format = LCD_FIELD_BAR, .get.number = Screen_Occupancy },
+    { .col = 0,  .row = 1, .width = LCD_COLS, .format = LCD_FIELD_TEXT, .get.text = Screen_GateStatus },
+};
+static const LCD_Screen_t status_screen = {
+    .rows = { "Free slot:", 0 },
+    .fields = status_fields,
+    .field_count = sizeof(status_fields) / sizeof(status_fields[0]),
+    .glyphs = &status_glyphs,
+};
+#endif
+
+/**
+ * @brief Renders the status screen and any active message into the LCD framebuffer.
+ */
+static void Display_Render(void) {
+    PROF_SCOPE(PROF_ZONE_SCREEN);
+    LCD_RenderScreen(&status_screen);
+    LCD_RenderMessage();
+}
+
+/**
+ * @brief Shows the gate status on the LCD.
+ * @param text Status text.
+ */
+static void Gate_ShowStatus(const char *text) {
+    gate_status = text;
+    Display_Render();
+}
+
+/**
+ * @brief Barrier servo move completion, called from the timer interrupt.
+ * @param servo The barrier servo.
+ */
+static void Barrier_MoveDone(Servo_Config_t *servo) {
+    (void)servo;
+    Task_Post(&gate_task, EVT_SERVO_DONE);
+}
+
+/**
+ * @brief Moves the barrier state machine to a new state and traces the transition.
+ * @param state New state.
+ */
+static void Gate_SetState(BarrierState_t state) {
+    currentState = state;
+    TRACE(TRACE_EVT_STATE, state);
+}
+
+/**
+ * @brief Shows the verdict on an accepted card and profiles the tap-to-decision latency.
+ * @param text Status text.
+ * Drops the alert of a card refused just before, which would cover it.
+ */
+static void Gate_ShowDecision(const char *text) {
+    LCD_CancelMessage(LCD_MSG_ALERT);
+    Gate_ShowStatus(text);
+    PROF_RECORD_SINCE(PROF_ZONE_CARD_TO_DECISION, card_seen_cycles);
+}
+
+/**
+ * @brief Shows why a card was refused as a transient alert; the gate keeps running.
+ * @param text Alert text.
+ */
+static void Gate_Reject(const char *text) {
+    LCD_PostMessage(LCD_MSG_ALERT, text, MESSAGE_HOLD_TIME);
+    PROF_RECORD_SINCE(PROF_ZONE_CARD_TO_DECISION, card_seen_cycles);
+}
+
+/**
+ * @brief Barrier control sequence: card, approach, open, passage, close.
+ * @param t The gate task.
+ */
+static void Gate_Task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        Gate_SetState(STATE_CLOSED);
+        current_direction = DIR_NONE;
+        Gate_ShowStatus("Gate Closed");
+
+        /* Wait for the reader task to capture a card. */
+        TASK_AWAIT_EVENT(t, EVT_CARD_PRESENTED, TASK_FOREVER);
+
+        if (!is_card_authorized(current_uid)) { /* Card not authorized. */
+            Gate_Reject("Access Denied!");
+            continue;
+        }
+        if (find_vehicle_index(current_uid) == -1) { /* Vehicle wants to enter. */
+            if (vehicle_count >= MAX_VEHICLES_INSIDE) { /* Parking is full. */
+                Gate_Reject("Parking is full!");
+                continue;
+            }
+            current_direction = DIR_ENTRY;
+        } else { /* Vehicle wants to exit. */
+            current_direction = DIR_EXIT;
+        }
+
+        /* Wait for the vehicle to trigger the corresponding IR sensor. */
+        Gate_SetState(STATE_AUTHORIZED_WAITING_VEHICLE);
+        Gate_ShowDecision("Gate Opened");
+        TASK_AWAIT_UNTIL(t, Direction_IR_IsBlocked(), EVT_IR_CHANGE, AUTHORIZED_TIMEOUT);
+        if (Task_TimedOut(t)) {
+            continue; /* The vehicle didn't appear, cancel the request. */
+        }
+
+        Gate_SetState(STATE_OPENING);
+        Gate_ShowStatus("Gate Opening...");
+        Servo_MoveTo(&barrierServo, BARRIER_OPEN_ANGLE);
+        TASK_AWAIT_UNTIL(t, !Servo_IsMoving(&barrierServo), EVT_SERVO_DONE, SERVO_MOVE_TIMEOUT);
+
+        Gate_SetState(STATE_OPEN_WAITING_PASSAGE);
+        Gate_ShowStatus("Please pass...");
+        vehicle_is_passing = false;
+        TASK_AWAIT_UNTIL(t, Gate_PassageComplete(), EVT_IR_CHANGE, PASSAGE_TIMEOUT);
+        if (Task_TimedOut(t)) {
+            /* The car takes too long: close as soon as it is safe. */
+            TASK_AWAIT_UNTIL(t, Gate_PassageComplete() || Gate_IsClear(),
+                    EVT_IR_CHANGE, TASK_FOREVER);
+        }
+
+        if (vehicle_is_passing) {
+            /* Update the vehicle database. */
+            if (current_direction == DIR_ENTRY) {
+                add_vehicle(current_uid);
+            } else if (current_direction == DIR_EXIT) {
+                remove_vehicle(find_vehicle_index(current_uid));
+            }
+            Gate_SetState(STATE_WAIT_BEFORE_CLOSING);
+            close_at = Get_Ms_Ticks() + DELAY_BEFORE_CLOSING;
+            Gate_ShowStatus("Vehicle passed!");
+            TASK_SLEEP(t, DELAY_BEFORE_CLOSING);
+        }
+
+        for (;;) {
+            /* Safety check: only close if there are no obstructions. */
+            Gate_SetState(STATE_CLOSING);
+            if (!Gate_IsClear()) {
+                LCD_PostMessage(LCD_MSG_CRITICAL, "Obstruction!", LCD_MSG_UNTIL_CANCELLED);
+                TASK_AWAIT_UNTIL(t, Gate_IsClear(), EVT_IR_CHANGE, TASK_FOREVER);
+                LCD_CancelMessage(LCD_MSG_CRITICAL);
+            }
+            Gate_ShowStatus("Gate Closing...");
+            Servo_MoveTo(&barrierServo, BARRIER_CLOSED_ANGLE);
+            TASK_AWAIT_UNTIL(t, !Servo_IsMoving(&barrierServo) || !Gate_IsClear(),
+                    EVT_SERVO_DONE | EVT_IR_CHANGE, SERVO_MOVE_TIMEOUT);
+            if (!Servo_IsMoving(&barrierServo) || Task_TimedOut(t)) {
+                break; /* Closed. */
+            }
+
+            /* A beam was blocked under the arm: reverse at once, from where it is. */
+            Gate_SetState(STATE_OPENING);
+            Gate_ShowStatus("Gate Opening...");
+            Servo_MoveTo(&barrierServo, BARRIER_OPEN_ANGLE);
+            TASK_AWAIT_UNTIL(t, !Servo_IsMoving(&barrierServo), EVT_SERVO_DONE, SERVO_MOVE_TIMEOUT);
+        }
+    }
+    TASK_END(t);
+}
+
+/**
+ * @brief Polls the RFID reader while the barrier is idle.
+ * @param t The reader task.
+ */
+static void Reader_Task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        TASK_SLEEP(t, READER_POLL_INTERVAL);
+
+        /* Only look for cards while the gate can accept one. */
+        if (currentState != STATE_CLOSED) {
+            continue;
+        }
+
+        /* Check for a present RFID card, then run anti-collision to get its UID. */
+        if (MFRC522_Request(PICC_REQIDL, card_type) == MI_OK
+                && MFRC522_Anticoll(card_uid) == MI_OK) {
+            card_seen_cycles = Prof_Now();
+            memcpy(current_uid, card_uid, 4);
+            Task_Post(&gate_task, EVT_CARD_PRESENTED);
+        }
+    }
+    TASK_END(t);
+}
+
+/**
+ * @brief Refreshes the free slot count, 7-segment counter and RGB status light.
+ * @param t The display task.
+ */
+static void Display_Task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        /* Update the LCD status screen (only changed characters are sent). */
+        Display_Render();
+        /* Display the number of vehicles inside on the 7-segment display. */
+        HC595_PutNumber(&counter_display, vehicle_count);
+        HC595_Flush();
+
+        /* Update RGB LED based on parking availability. */
+        if (vehicle_count == MAX_VEHICLES_INSIDE) {
+            RGB_SetEffect(&status_full); /* Flashing red: Full */
+        } else if (vehicle_count == 0) {
+            RGB_SetColor(0, 255, 0); /* Green: Empty */
+        } else {
+            RGB_SetColor(0, 0, 255); /* Blue: Available slots (changed from yellow for clarity) */
+        }
+        TASK_SLEEP(t, DISPLAY_REFRESH_INTERVAL);
+    }
+    TASK_END(t);
 }
 
 /**
@@ -201,11 +529,11 @@ int main(void) {
     SystemClock_Config();
     Delay_Init();
 
-    /* Configure Servo motor on TIM2 Channel 1, GPIOA Pin 0. */
+    /* Configure Servo motor on TIM2 Channel 1 (PA0 in the board pin table). */
     barrierServo.timer = TIM2;
     barrierServo.channel = 1;
-    barrierServo.gpio_port = GPIOA;
-    barrierServo.gpio_pin = 0;
+    barrierServo.limits.shape = SERVO_PROFILE_SCURVE; /* Default speed, smooth start and stop. */
+    barrierServo.on_done = Barrier_MoveDone;
 
     /* Initialize peripherals. */
     GPIO_pinsConfig();
@@ -214,150 +542,43 @@ int main(void) {
     Servo_SetAngle(&barrierServo, BARRIER_CLOSED_ANGLE); /* Start with barrier closed. */
     LCD_Clear();
     HC595_Init();
+    HC595_AddDisplay(&counter_display);
     RGB_Init();
     delay_ms(100); /* Wait for peripherals to stabilize. */
     MFRC522_Init();
 
-    /* Main application loop. */
-    while (1) {
-        /* Update LCD with the number of free parking slots. */
-        LCD_setCursor(0, 0);
-        char buffer[32];
-        snprintf(buffer, sizeof(buffer), "Free slot: %d",
-                (MAX_VEHICLES_INSIDE - vehicle_count));
-        LCD_Write(buffer);
-        /* Display the number of vehicles inside on the 7-segment display. */
-        HC595_DisplayNumber(vehicle_count);
-
-        /* Update RGB LED based on parking availability. */
-        if (vehicle_count == MAX_VEHICLES_INSIDE) {
-            RGB_SetColor(255, 0, 0); /* Red: Full */
-        } else if (vehicle_count == 0) {
-            RGB_SetColor(0, 255, 0); /* Green: Empty */
-        } else {
-            RGB_SetColor(0, 0, 255); /* Blue: Available slots (changed from yellow for clarity) */
-        }
-
-        /* Barrier control state machine. */
-        switch (currentState) {
-        case STATE_CLOSED:
-            LCD_setCursor(0, 1);
-            LCD_Write("Gate Closed     ");
-            /* Check for a present RFID card. */
-            if (MFRC522_Request(PICC_REQIDL, current_uid) == MI_OK) {
-                /* Perform anti-collision to get the card's UID. */
-                if (MFRC522_Anticoll(current_uid) == MI_OK) {
-                    /* Check if the card is authorized. */
-                    if (is_card_authorized(current_uid)) {
-                        int vehicle_idx = find_vehicle_index(current_uid);
-                        if (vehicle_idx == -1) { /* Vehicle wants to enter. */
-                            if (vehicle_count < MAX_VEHICLES_INSIDE) {
-                                current_direction = DIR_ENTRY;
-                                currentState = STATE_AUTHORIZED_WAITING_VEHICLE;
-                                state_change_timestamp = Get_Ms_Ticks();
-                                LCD_setCursor(0, 1);
-                                LCD_Write("Gate Opened     ");
-                            } else { /* Parking is full. */
-                                LCD_setCursor(0, 1);
-                                LCD_Write("Parking is full!");
-                                delay_ms(1500);
-                            }
-                        } else { /* Vehicle wants to exit. */
-                            current_direction = DIR_EXIT;
-                            currentState = STATE_AUTHORIZED_WAITING_VEHICLE;
-                            state_change_timestamp = Get_Ms_Ticks();
-                            LCD_setCursor(0, 1);
-                            LCD_Write("Gate Opened     ");
-                        }
-                    } else { /* Card not authorized. */
-                        LCD_setCursor(0, 1);
-                        LCD_Write("Access Denied!  ");
-                        delay_ms(1500);
-                    }
-                }
-            }
-            break;
+    /* Service console on USART6: trace dump, profiler with PROFILE_ENABLE=1. */
+    UART_Init(115200);
+    Console_Init();
+    Prof_Init();
+    Trace_Init();
+    Clock_Init();
+    PwmTimer_Init();
 
-        case STATE_AUTHORIZED_WAITING_VEHICLE:
-            /* Wait for the vehicle to trigger the corresponding IR sensor. */
-            if ((current_direction == DIR_ENTRY && Entry_IR_IsBlocked())
-                    || (current_direction == DIR_EXIT && Exit_IR_IsBlocked())) {
-                currentState = STATE_OPENING; /* Vehicle detected, start opening. */
-            }
+    /* Counter brightness follows the time of day ("time HH:MM" on the console). */
+    HC595_AutoBrightness(counter_brightness,
+            sizeof(counter_brightness) / sizeof(counter_brightness[0]));
 
-            /* Timeout if the vehicle doesn't appear. */
-            if (Get_Ms_Ticks() - state_change_timestamp > AUTHORIZED_TIMEOUT) {
-                currentState = STATE_CLOSED; /* Cancel the request. */
-                current_direction = DIR_NONE;
-            }
-            break;
-
-        case STATE_OPENING:
-            LCD_setCursor(0, 1);
-            LCD_Write("Gate Opening... ");
-            Servo_SetAngle(&barrierServo, BARRIER_OPEN_ANGLE);
-            delay_ms(500); /* Give servo time to move. */
-            currentState = STATE_OPEN_WAITING_PASSAGE;
-            state_change_timestamp = Get_Ms_Ticks();
-            vehicle_is_passing = false; /* Reset the passing flag. */
-            break;
-
-        case STATE_OPEN_WAITING_PASSAGE:
-            LCD_setCursor(0, 1);
-            LCD_Write("Please pass...  ");
-
-            /* Stage 1: Wait for the vehicle to start passing. */
-            if (!vehicle_is_passing) {
-                if ((current_direction == DIR_ENTRY && Entry_IR_IsBlocked())
-                        || (current_direction == DIR_EXIT && Exit_IR_IsBlocked())) {
-                    vehicle_is_passing = true; /* Confirm the vehicle has started passing. */
-                }
-            }
+    /* Transient LCD messages redraw the status screen when they change. */
+    LCD_MessageInit(Display_Render);
 
-            /* Stage 2: If the vehicle has started, wait for it to pass completely. */
-            if (vehicle_is_passing) {
-                /* The condition for complete passage is that both sensors are clear. */
-                if (!Entry_IR_IsBlocked() && !Exit_IR_IsBlocked()) {
-                    /* Update the vehicle database. */
-                    if (current_direction == DIR_ENTRY) {
-                        add_vehicle(current_uid);
-                    } else if (current_direction == DIR_EXIT) {
-                        remove_vehicle(find_vehicle_index(current_uid));
-                    }
-                    currentState = STATE_WAIT_BEFORE_CLOSING;
-                    state_change_timestamp = Get_Ms_Ticks();
-                }
-            }
+    /* Start the application tasks. */
+    Task_Start(&display_task, Display_Task, "display");
+    Task_Start(&gate_task, Gate_Task, "gate");
+    Task_Start(&reader_task, Reader_Task, "reader");
 
-            /* Timeout check: if the car takes too long, close if safe. */
-            if (Get_Ms_Ticks() - state_change_timestamp > PASSAGE_TIMEOUT) {
-                if (!Entry_IR_IsBlocked() && !Exit_IR_IsBlocked()) {
-                    currentState = STATE_CLOSING;
-                }
-            }
-            break;
-        case STATE_WAIT_BEFORE_CLOSING:
-            LCD_setCursor(0, 1);
-            LCD_Write("Vehicle passed! ");
-
-            /* Wait for the configured delay before starting to close. */
-            if (Get_Ms_Ticks() - state_change_timestamp > DELAY_BEFORE_CLOSING) {
-                currentState = STATE_CLOSING;
-            }
-            break;
-        case STATE_CLOSING:
-            /* Safety check: only close if there are no obstructions. */
-            if (!Entry_IR_IsBlocked() && !Exit_IR_IsBlocked()) {
-                LCD_setCursor(0, 1);
-                LCD_Write("Gate Closing... ");
-                Servo_SetAngle(&barrierServo, BARRIER_CLOSED_ANGLE);
-                delay_ms(500); /* Give servo time to move. */
-                current_direction = DIR_NONE;
-                currentState = STATE_CLOSED;
-            }
-            break;
+    /* Main application loop. */
+    while (1) {
+        SoftTimer_Process();
+        Task_RunAll();
+        LCD_Flush(); /* Send what the tasks drew in this pass */
+
+        /* Sleep until the next timer or interrupt when every task is blocked. */
+        __disable_irq();
+        if (Task_AllIdle()) {
+            Delay_Idle(SoftTimer_NextExpiry());
         }
-        delay_ms(50); /* Small delay to prevent busy-waiting. */
+        __enable_irq();
     }
 }
 
@@ -2,6 +2,15 @@
 
 /* Tick counter for millisecond delays */
 static volatile uint32_t systick_ms_count = 0;
+/* Upper 32 bits of the millisecond count, bumped when systick_ms_count wraps */
+static volatile uint32_t systick_ms_high = 0;
+/* Core clock cycles per millisecond and per microsecond, from SystemCoreClock
+   at init and after each Delay_ClockChanged() */
+static uint32_t cycles_per_ms = 1;
+static uint32_t cycles_per_us = 1;
+/* monotonic_cycles() at the start of millisecond ms_base (the last clock change) */
+static uint64_t cycles_base = 0;
+static uint64_t ms_base = 0;
 
 /**
  * @brief Initializes the SysTick for millisecond delays and the DWT for microsecond delays.
@@ -10,8 +19,11 @@ static volatile uint32_t systick_ms_count = 0;
  * variable must be up-to-date before calling this function.
  */
 void Delay_Init(void) {
+    cycles_per_ms = SystemCoreClock / 1000;
+    cycles_per_us = SystemCoreClock / 1000000;
+
     /* 1. Configure and enable SysTick for a 1ms interrupt (for Delay_ms) */
-    if (SysTick_Config(SystemCoreClock / 1000) != 0) {
+    if (SysTick_Config(cycles_per_ms) != 0) {
         /* Capture error if SysTick configuration fails */
         while (1);
     }
@@ -28,7 +40,9 @@ void Delay_Init(void) {
  * @note This function is called by the SysTick interrupt handler.
  */
 void SysTick_Handler(void) {
-    systick_ms_count++;
+    if (++systick_ms_count == 0) {
+        systick_ms_high++;
+    }
 }
 
 /**
@@ -39,7 +53,7 @@ void SysTick_Handler(void) {
  */
 void delay_us(uint32_t us) {
     /* Get the number of CPU cycles per microsecond */
-    uint32_t ticks_per_us = SystemCoreClock / 1000000;
+    uint32_t ticks_per_us = cycles_per_us;
 
     /* Get the current value of the cycle counter */
     uint32_t start_ticks = DWT->CYCCNT;
@@ -62,9 +76,11 @@ void delay_ms(uint32_t ms) {
         return;
     }
     uint32_t tickstart = systick_ms_count;
-    /* Wait until the specified number of milliseconds has passed */
-    while ((systick_ms_count - tickstart) < ms)
-        ;
+    /* Wait until the specified number of milliseconds has passed,
+       sleeping until the next interrupt instead of spinning */
+    while ((systick_ms_count - tickstart) < ms) {
+        __WFI();
+    }
 }
 
 /**
@@ -74,3 +90,166 @@ void delay_ms(uint32_t ms) {
 uint32_t Get_Ms_Ticks(void) {
     return systick_ms_count;
 }
+
+/**
+ * @brief  Adds elapsed milliseconds to the tick count (64-bit carry included).
+ * @param  ms: Number of milliseconds to add.
+ */
+static inline void ms_count_add(uint32_t ms) {
+    uint32_t before = systick_ms_count;
+    systick_ms_count = before + ms;
+    if (systick_ms_count < before) {
+        systick_ms_high++;
+    }
+}
+
+/**
+ * @brief  Sleeps with the 1 ms tick suppressed for up to max_ms milliseconds.
+ * @note   Must be called with interrupts disabled (PRIMASK set), after the
+ * caller has checked that there is no pending work; it returns with
+ * interrupts still disabled. SysTick is reprogrammed to fire once at the end
+ * of the idle period, the core waits in WFI, and on wake-up (timeout or any
+ * interrupt such as an EXTI edge) the millisecond count is advanced by the
+ * time actually slept and the 1 ms tick is restored in phase. The sleep is
+ * limited by the 24-bit SysTick reload (~199 ms at 84 MHz); callers simply
+ * go idle again.
+ * @param  max_ms: Longest time to sleep, typically the next timer expiry.
+ */
+void Delay_Idle(uint32_t max_ms) {
+    uint32_t max_idle_ms = (SysTick_LOAD_RELOAD_Msk + 1U) / cycles_per_ms;
+    uint32_t ctrl, elapsed, total, ms;
+
+    if (max_ms == 0) {
+        return;
+    }
+    if (max_ms == 1) {
+        /* The next regular tick comes first anyway */
+        __DSB();
+        __WFI();
+        __ISB();
+        return;
+    }
+    if (max_ms > max_idle_ms) {
+        max_ms = max_idle_ms;
+    }
+
+    /* Stop the tick and see how far into the current millisecond we are */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        /* A tick is already pending: let it be counted first */
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        return;
+    }
+    elapsed = SysTick->LOAD - SysTick->VAL;
+
+    /* Fire once at the end of the idle period, aligned to a tick boundary */
+    uint32_t sleep_cycles = max_ms * cycles_per_ms - elapsed;
+    SysTick->LOAD = sleep_cycles - 1U;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    /* Reading CTRL also clears COUNTFLAG: stop the tick with the value of that one read */
+    ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        /* Slept the whole period; the interrupt it raised is accounted here */
+        total = elapsed + sleep_cycles + (SysTick->LOAD - SysTick->VAL);
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    } else {
+        /* Woken early by another interrupt */
+        total = elapsed + (SysTick->LOAD - SysTick->VAL);
+    }
+
+    ms = total / cycles_per_ms;
+    ms_count_add(ms);
+
+    /* Resume 1 ms ticks in phase with the time already spent in this one */
+    SysTick->LOAD = cycles_per_ms - (total - ms * cycles_per_ms) - 1U;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = cycles_per_ms - 1U;
+}
+
+/**
+ * @brief  Takes the new core clock into account after a clock change.
+ * @note   Call after SystemCoreClock has been updated, next to
+ * PwmTimer_ClockChanged(). The millisecond in progress is closed and
+ * counted whole, so the clocks jump ahead by less than 1 ms, never back,
+ * and the 1 ms tick restarts at the new rate.
+ */
+void Delay_ClockChanged(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        /* A tick the interrupt has not counted yet */
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+        ms_count_add(1);
+    }
+    ms_count_add(1);
+
+    /* Cycles up to here at the old rate, the next ones at the new rate */
+    uint64_t ms = ((uint64_t)systick_ms_high << 32) | systick_ms_count;
+    cycles_base += (ms - ms_base) * cycles_per_ms;
+    ms_base = ms;
+    cycles_per_ms = SystemCoreClock / 1000;
+    cycles_per_us = SystemCoreClock / 1000000;
+
+    SysTick->LOAD = cycles_per_ms - 1U;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Takes a consistent snapshot of the 64-bit millisecond count and
+ * the cycles elapsed in the current millisecond.
+ * @note   The counters are re-read if the SysTick interrupt ran in between.
+ * If the interrupt is pending but cannot run (called with interrupts masked
+ * or from a higher priority handler), the missed tick is added here.
+ * @param  ms: Receives the number of whole milliseconds.
+ * @retval Core clock cycles elapsed since the start of that millisecond.
+ */
+static inline uint32_t monotonic_snapshot(uint64_t *ms) {
+    uint32_t hi, lo, val, pending;
+
+    do {
+        hi = systick_ms_high;
+        lo = systick_ms_count;
+        val = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+        if (pending) {
+            /* Reloaded but not counted yet: VAL now belongs to the next tick */
+            val = SysTick->VAL;
+        }
+    } while (hi != systick_ms_high || lo != systick_ms_count);
+
+    *ms = (((uint64_t)hi << 32) | lo) + (pending ? 1U : 0U);
+    return SysTick->LOAD - val;
+}
+
+/**
+ * @brief  Gets a wrap-safe timestamp in core clock cycles.
+ * @note   Resolution is one core clock (~12 ns at 84 MHz).
+ * @retval Cycles since Delay_Init() was called.
+ */
+uint64_t monotonic_cycles(void) {
+    uint64_t ms;
+    uint32_t cycles = monotonic_snapshot(&ms);
+    return cycles_base + (ms - ms_base) * cycles_per_ms + cycles;
+}
+
+/**
+ * @brief  Gets a wrap-safe timestamp in microseconds.
+ * @retval Microseconds since Delay_Init() was called.
+ */
+uint64_t monotonic_us(void) {
+    uint64_t ms;
+    uint32_t cycles = monotonic_snapshot(&ms);
+    return ms * 1000U + cycles / cycles_per_us;
+}
@@ -27,11 +27,46 @@ void delay_us(uint32_t us);
  */
 void delay_ms(uint32_t ms);
 
+/**
+ * @brief  Sleeps with the 1 ms tick suppressed for up to max_ms milliseconds.
+ * @note   Call with interrupts disabled after checking there is no pending
+ * work; returns with interrupts still disabled. Any enabled interrupt
+ * (EXTI, peripheral) ends the sleep early and the tick count is
+ * resynchronized to the time actually slept.
+ * @param  max_ms: Longest time to sleep, typically the next timer expiry.
+ */
+void Delay_Idle(uint32_t max_ms);
+
+/**
+ * @brief  Takes the new core clock into account after a clock change.
+ * @note   Call after SystemCoreClock has been updated, next to
+ * PwmTimer_ClockChanged(). delay_us(), Delay_Idle() and the monotonic
+ * clocks then use the new rate; the monotonic clocks jump ahead by less
+ * than 1 ms, never back.
+ */
+void Delay_ClockChanged(void);
+
 /**
  * @brief  Gets the current value of the millisecond tick counter.
  * @retval The number of milliseconds since Delay_Init() was called.
  */
 uint32_t Get_Ms_Ticks(void);
 
+/**
+ * @brief  Gets a wrap-safe timestamp in core clock cycles.
+ * @note   Combines the 64-bit SysTick millisecond count with the SysTick
+ * down-counter, so it keeps counting across DWT wraps and sleep. Safe to
+ * call from interrupts and with interrupts disabled.
+ * @retval Cycles since Delay_Init() was called.
+ */
+uint64_t monotonic_cycles(void);
+
+/**
+ * @brief  Gets a wrap-safe timestamp in microseconds.
+ * @note   Same source as monotonic_cycles(), scaled to microseconds.
+ * @retval Microseconds since Delay_Init() was called.
+ */
+uint64_t monotonic_us(void);
+
 
 #endif /* DELAY_H_ */
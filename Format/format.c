@@ -0,0 +1,182 @@
+#include "format.h"
+
+/**
+ * @brief Writes value in decimal, most significant digit first.
+ * @return Position after the digits.
+ */
+static char *put_digits(char *dst, uint32_t value, uint8_t min_digits) {
+    char digits[10];
+    uint8_t n = 0;
+
+    do {
+        digits[n++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value || n < min_digits);
+
+    while (n) {
+        *dst++ = digits[--n];
+    }
+    return dst;
+}
+
+/**
+ * @brief Returns the number of decimal digits of value (at least 1).
+ */
+static uint8_t count_digits(uint32_t value) {
+    uint8_t n = 1;
+    while (value >= 10U) {
+        value /= 10U;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Checks that a field of len characters fits before end; if not,
+ * fills the rest of the buffer with '#'.
+ * @return 1 if the field fits.
+ */
+static uint8_t fits(char *dst, char *end, uint32_t len) {
+    if (dst <= end && len <= (uint32_t)(end - dst)) {
+        return 1;
+    }
+    while (dst < end) {
+        *dst++ = '#';
+    }
+    return 0;
+}
+
+/**
+ * @brief Pads a field that needs len characters up to width.
+ * @return Position where the content starts, or NULL if it does not fit
+ * (the field is then filled with '#').
+ */
+static char *pad_left(char *dst, uint8_t len, uint8_t width, char pad) {
+    if (!width) {
+        return dst;
+    }
+    if (len > width) {
+        for (uint8_t i = 0; i < width; i++) {
+            dst[i] = '#';
+        }
+        return 0;
+    }
+    for (uint8_t i = len; i < width; i++) {
+        *dst++ = pad;
+    }
+    return dst;
+}
+
+/**
+ * @brief Writes an unsigned integer right-aligned.
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param value Value to write.
+ * @param width Field width (0 = natural width).
+ * @param pad Padding character (' ' or '0').
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Uint(char *dst, char *end, uint32_t value, uint8_t width, char pad) {
+    uint8_t len = count_digits(value);
+    if (!fits(dst, end, width ? width : len)) {
+        return end;
+    }
+    char *p = pad_left(dst, len, width, pad);
+    if (!p) {
+        return dst + width;
+    }
+    return put_digits(p, value, 1);
+}
+
+/**
+ * @brief Writes a fixed-point number right-aligned, e.g. 25 with 1 decimal as "2.5".
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param value Value in units of 10^-decimals.
+ * @param decimals Number of digits after the decimal point (0..9).
+ * @param width Field width (0 = natural width).
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Fixed(char *dst, char *end, int32_t value, uint8_t decimals, uint8_t width) {
+    uint32_t scale = 1;
+    uint32_t magnitude = (value < 0) ? 0U - (uint32_t)value : (uint32_t)value;
+
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10U;
+    }
+    uint32_t whole = magnitude / scale;
+    uint32_t fraction = magnitude % scale;
+
+    uint8_t len = (uint8_t)(count_digits(whole) + (decimals ? decimals + 1U : 0U) + (value < 0));
+    if (!fits(dst, end, width ? width : len)) {
+        return end;
+    }
+    char *p = pad_left(dst, len, width, ' ');
+    if (!p) {
+        return dst + width;
+    }
+    if (value < 0) {
+        *p++ = '-';
+    }
+    p = put_digits(p, whole, 1);
+    if (decimals) {
+        *p++ = '.';
+        p = put_digits(p, fraction, decimals);
+    }
+    return p;
+}
+
+/**
+ * @brief Writes a duration as "MM:SS" (or "H:MM:SS" from one hour on).
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param seconds Duration in seconds.
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Time(char *dst, char *end, uint32_t seconds) {
+    uint32_t hours = seconds / 3600U;
+    uint32_t minutes = (seconds / 60U) % 60U;
+
+    if (!fits(dst, end, (hours ? count_digits(hours) + 1U : 0U) + 5U)) {
+        return end;
+    }
+
+    if (hours) {
+        dst = put_digits(dst, hours, 1);
+        *dst++ = ':';
+    }
+    dst = put_digits(dst, minutes, 2);
+    *dst++ = ':';
+    return put_digits(dst, seconds % 60U, 2);
+}
+
+/**
+ * @brief Writes a string left-aligned.
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param str String to write.
+ * @param width Field width (0 = whole string).
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Str(char *dst, char *end, const char *str, uint8_t width) {
+    if (!width) {
+        uint32_t len = 0;
+        while (str[len]) {
+            len++;
+        }
+        if (!fits(dst, end, len)) {
+            return end;
+        }
+        while (*str) {
+            *dst++ = *str++;
+        }
+        return dst;
+    }
+    if (!fits(dst, end, width)) {
+        return end;
+    }
+    for (uint8_t i = 0; i < width; i++) {
+        *dst++ = *str ? *str++ : ' ';
+    }
+    return dst;
+}
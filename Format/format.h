@@ -0,0 +1,63 @@
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Small text formatters for displays and logs.
+ * Replacement for snprintf in fixed-layout output: no allocation, no
+ * varargs, no newlib printf pulled into flash. Each function writes into
+ * dst without a terminating zero and returns the position after the
+ * written text, so calls can be chained. A width of 0 means "as many
+ * characters as needed"; with a non-zero width the text is padded and,
+ * if too long, numbers are replaced by '#' and strings are cut.
+ *
+ * Nothing is written at or past end (the first position that is not the
+ * caller's; keep one for the terminating zero). A field that does not fit
+ * before end fills the rest of the buffer with '#' and returns end, so
+ * the next calls of a chain write nothing and the line shows where it
+ * was cut.
+ */
+
+/**
+ * @brief Writes an unsigned integer right-aligned.
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param value Value to write.
+ * @param width Field width (0 = natural width).
+ * @param pad Padding character (' ' or '0').
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Uint(char *dst, char *end, uint32_t value, uint8_t width, char pad);
+
+/**
+ * @brief Writes a fixed-point number right-aligned, e.g. 25 with 1 decimal as "2.5".
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param value Value in units of 10^-decimals.
+ * @param decimals Number of digits after the decimal point (0..9).
+ * @param width Field width (0 = natural width).
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Fixed(char *dst, char *end, int32_t value, uint8_t decimals, uint8_t width);
+
+/**
+ * @brief Writes a duration as "MM:SS" (or "H:MM:SS" from one hour on).
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param seconds Duration in seconds.
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Time(char *dst, char *end, uint32_t seconds);
+
+/**
+ * @brief Writes a string left-aligned.
+ * @param dst Output position.
+ * @param end End of the buffer: nothing is written at or past it.
+ * @param str String to write.
+ * @param width Field width (0 = whole string).
+ * @return Position after the field (end if it did not fit).
+ */
+char *Format_Str(char *dst, char *end, const char *str, uint8_t width);
+
+#endif /* FORMAT_H_ */
@@ -56,7 +56,7 @@ void GPIO_SetAlternateFunction(GPIO_TypeDef *port, uint8_t pin, gpio_alt_functio
  */
 void GPIO_Write(GPIO_TypeDef *port, uint8_t pin, uint8_t value)
 {
-	port->BSRR = (1 << (pin + (value ? 0 : 16)));
+	Pin_Write(port, pin, value != 0);
 }
 
 /**
@@ -68,7 +68,7 @@ void GPIO_Write(GPIO_TypeDef *port, uint8_t pin, uint8_t value)
  */
 uint8_t GPIO_Read(GPIO_TypeDef *port, uint8_t pin)
 {
-    return (port->IDR >> pin) & 0x01;
+    return Pin_Read(port, pin);
 }
 
 /**
@@ -79,5 +79,38 @@ uint8_t GPIO_Read(GPIO_TypeDef *port, uint8_t pin)
  */
 void GPIO_Toggle(GPIO_TypeDef *port, uint8_t pin)
 {
-    port->ODR ^= (1 << pin);
+    /* Set or reset through BSRR so interrupts driving other pins of the port are not undone */
+    Pin_Toggle(port, pin);
+}
+
+/**
+ * @brief Route a GPIO pin to its EXTI line and enable the interrupt.
+ *
+ * @param port GPIO port.
+ * @param pin  GPIO pin number.
+ * @param edge Trigger edge(s).
+ */
+void GPIO_EnableInterrupt(GPIO_TypeDef *port, uint8_t pin, gpio_edge_t edge)
+{
+    uint32_t port_index = ((uint32_t)port - GPIOA_BASE) / 0x400;
+    IRQn_Type irq;
+
+    /* Select the port as the source of EXTI line "pin" */
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[pin >> 2] = (SYSCFG->EXTICR[pin >> 2] & ~(0xFU << ((pin & 0x3) * 4)))
+            | (port_index << ((pin & 0x3) * 4));
+
+    /* Configure the trigger edges and unmask the line */
+    if (edge & GPIO_DRIVER_EDGE_RISING) EXTI->RTSR |= (1U << pin);
+    else                                EXTI->RTSR &= ~(1U << pin);
+    if (edge & GPIO_DRIVER_EDGE_FALLING) EXTI->FTSR |= (1U << pin);
+    else                                 EXTI->FTSR &= ~(1U << pin);
+    EXTI->PR = (1U << pin);
+    EXTI->IMR |= (1U << pin);
+
+    /* Lines 0-4 have their own vector, 5-9 and 10-15 share one */
+    if (pin <= 4)      irq = (IRQn_Type)(EXTI0_IRQn + pin);
+    else if (pin <= 9) irq = EXTI9_5_IRQn;
+    else               irq = EXTI15_10_IRQn;
+    NVIC_EnableIRQ(irq);
 }
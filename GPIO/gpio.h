@@ -2,6 +2,7 @@
 #define GPIO_H
 
 #include "stm32f4xx.h"
+#include "pin.h"
 
 /**
  * @brief GPIO pin mode options
@@ -50,6 +51,15 @@ typedef enum {
     GPIO_DRIVER_AF12,       GPIO_DRIVER_AF13, GPIO_DRIVER_AF14, GPIO_DRIVER_AF15
 } gpio_alt_function_t;
 
+/**
+ * @brief GPIO external interrupt trigger edge
+ */
+typedef enum {
+    GPIO_DRIVER_EDGE_RISING  = 0x01, /**< Interrupt on rising edge */
+    GPIO_DRIVER_EDGE_FALLING = 0x02, /**< Interrupt on falling edge */
+    GPIO_DRIVER_EDGE_BOTH    = 0x03  /**< Interrupt on both edges */
+} gpio_edge_t;
+
 /**
  * @brief GPIO pin configuration structure
  */
@@ -71,6 +81,8 @@ void GPIO_Init(const gpio_config_t *cfg);
 
 /**
  * @brief Write logic value to GPIO pin
+ * @note  For a pin known at compile time, the inline Pin_Write() (pin.h)
+ *        avoids the call.
  * @param port GPIO port
  * @param pin Pin number
  * @param value 0 = Low, non-zero = High
@@ -100,4 +112,13 @@ void GPIO_Toggle(GPIO_TypeDef *port, uint8_t pin);
  */
 void GPIO_SetAlternateFunction(GPIO_TypeDef *port, uint8_t pin, gpio_alt_function_t af);
 
+/**
+ * @brief Route a GPIO pin to its EXTI line and enable the interrupt
+ * @param port GPIO port
+ * @param pin Pin number
+ * @param edge Trigger edge(s)
+ * @note The application provides the EXTIx_IRQHandler and clears EXTI->PR.
+ */
+void GPIO_EnableInterrupt(GPIO_TypeDef *port, uint8_t pin, gpio_edge_t edge);
+
 #endif  /* GPIO_H */
@@ -0,0 +1,84 @@
+#ifndef PIN_H_
+#define PIN_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Pin access for the drivers.
+ * A pin is a port and a pin number known at compile time (the <NAME>_PORT
+ * and <NAME>_PIN macros of the driver headers). Every accessor is inlined,
+ * so with constant arguments a write is one store of a constant to BSRR and
+ * a read one load of IDR, like the hand-written register accesses: no call,
+ * no branch on the level when it is constant, and no read-modify-write of
+ * ODR that an interrupt writing the same port could undo.
+ *
+ * Build with -DPIN_MOCK=1 on a PC: the port is then a plain structure and
+ * every write goes to Pin_MockBsrr(), provided by the host program, which
+ * applies it to ODR (and IDR of the wires it models) and sees each edge.
+ * Inputs are read from the IDR the host program sets.
+ */
+
+#ifndef PIN_MOCK
+#define PIN_MOCK 0
+#endif
+
+#if PIN_MOCK
+/* @brief Host side of a BSRR write: bits 0-15 set, bits 16-31 reset. */
+void Pin_MockBsrr(GPIO_TypeDef *port, uint32_t bsrr);
+#define PIN_BSRR(port, word)    Pin_MockBsrr((port), (word))
+#else
+#define PIN_BSRR(port, word)    ((void)((port)->BSRR = (word)))
+#endif
+
+/* BSRR word that drives one pin high or low */
+#define PIN_SET_BITS(pin)       (1UL << (pin))
+#define PIN_RESET_BITS(pin)     (1UL << ((pin) + 16U))
+
+/* @brief Drives a pin high. */
+static inline void Pin_High(GPIO_TypeDef *port, uint32_t pin) {
+    PIN_BSRR(port, PIN_SET_BITS(pin));
+}
+
+/* @brief Drives a pin low. */
+static inline void Pin_Low(GPIO_TypeDef *port, uint32_t pin) {
+    PIN_BSRR(port, PIN_RESET_BITS(pin));
+}
+
+/* @brief Drives a pin to a level (one store: the BSRR word is selected, not the register). */
+static inline void Pin_Write(GPIO_TypeDef *port, uint32_t pin, bool level) {
+    PIN_BSRR(port, level ? PIN_SET_BITS(pin) : PIN_RESET_BITS(pin));
+}
+
+/* @brief Returns the input level of a pin. */
+static inline bool Pin_Read(const GPIO_TypeDef *port, uint32_t pin) {
+    return ((port->IDR >> pin) & 1UL) != 0UL;
+}
+
+/* @brief Inverts an output (the write is atomic, the read of ODR is not). */
+static inline void Pin_Toggle(GPIO_TypeDef *port, uint32_t pin) {
+    Pin_Write(port, pin, (port->ODR & PIN_SET_BITS(pin)) == 0UL);
+}
+
+/**
+ * @brief Drives several pins of a port at once.
+ * @param port GPIO port.
+ * @param mask Pins to drive (bit n = pin n).
+ * @param value Levels of the pins in mask.
+ */
+static inline void PinGroup_Write(GPIO_TypeDef *port, uint32_t mask, uint32_t value) {
+    PIN_BSRR(port, (value & mask) | ((~value & mask) << 16));
+}
+
+/* @brief Writes a precomputed BSRR word (set bits 0-15, reset bits 16-31). */
+static inline void PinGroup_Bsrr(GPIO_TypeDef *port, uint32_t bsrr) {
+    PIN_BSRR(port, bsrr);
+}
+
+/* @brief Returns the input levels of several pins of a port (bit n = pin n). */
+static inline uint32_t PinGroup_Read(const GPIO_TypeDef *port, uint32_t mask) {
+    return port->IDR & mask;
+}
+
+#endif /* PIN_H_ */
@@ -3,16 +3,94 @@
 
 #define STM32F4
 
+/* Transport: the GPIO pins below, or a PCF8574 I2C backpack */
+#define LCD_BUS_PARALLEL 0
+#define LCD_BUS_I2C 1
+#ifndef LCD_BUS
+#define LCD_BUS LCD_BUS_PARALLEL
+#endif
+
 #define LCD_DATA_PORT_A GPIOA
 #define LCD_DATA_PORT_B GPIOB
 
-/* Define the data pins for the LCD */
+/* Bus width: define LCD8Bit to drive D0..D7 (one transfer per byte)
+   instead of D4..D7 (two nibbles per byte). */
+/* #define LCD8Bit */
+
+/* Define the data pins for the LCD (DATAn drives D(n-1)) and the port of
+   each one: 0 = LCD_DATA_PORT_A, 1 = LCD_DATA_PORT_B */
+#define DATA1_Pin 3     /* 8-bit mode only */
+#define DATA1_PortB 0
+#define DATA2_Pin 4     /* 8-bit mode only */
+#define DATA2_PortB 0
+#define DATA3_Pin 15    /* 8-bit mode only */
+#define DATA3_PortB 0
+#define DATA4_Pin 7     /* 8-bit mode only */
+#define DATA4_PortB 1
 #define DATA5_Pin 1
+#define DATA5_PortB 1
 #define DATA6_Pin 0
+#define DATA6_PortB 1
 #define DATA7_Pin 7
+#define DATA7_PortB 0
 #define DATA8_Pin 6
+#define DATA8_PortB 0
 
 #define RS_Pin 10
 #define E_Pin 2
 
+/* Optional R/W pin on port B, tied to GND on the board as built. When it
+   is wired to RW_Pin (build with LCD_USE_RW=1) the driver polls the busy
+   flag instead of waiting worst-case times. This only matters with
+   LCD_USE_ASYNC=0: the asynchronous backend reads the flag during
+   LCD_Init() only. The blocking driver gains what the controller is faster
+   than the worst case; at the datasheet timings the polling costs as much
+   as it saves (Sim "make check", boards lcdsync and lcdsync_rw). The data
+   pins are driven by the LCD during reads: they must be 5 V tolerant or the
+   LCD must run from 3.3 V. */
+#ifndef LCD_USE_RW
+#define LCD_USE_RW 0
+#endif
+#define RW_Pin 8
+
+/* Asynchronous backend: bytes are queued and clocked out by a one-pulse
+   timer interrupt instead of blocking the caller. The busy flag is not
+   read in this mode; worst-case execution times are scheduled instead. */
+#ifndef LCD_USE_ASYNC
+#define LCD_USE_ASYNC 1
+#endif
+#define LCD_QUEUE_SIZE 64 /* Power of two */
+#define LCD_SEQ_TIMER TIM10
+#define LCD_SEQ_TIMER_IRQn TIM1_UP_TIM10_IRQn
+
+/* I2C backend (LCD_BUS_I2C): PCF8574 P0 = RS, P1 = RW, P2 = E, P3 = backlight,
+   P4..P7 = D4..D7. SCL on PB10 (the parallel RS pin), SDA on PB3, which is
+   also SWO: "trace swo" is not available with this backend. lcd_i2c.c
+   names the I2C2 interrupt handlers. */
+#define LCD_I2C I2C2
+#define LCD_I2C_RCC_EN RCC_APB1ENR_I2C2EN
+#define LCD_I2C_EV_IRQn I2C2_EV_IRQn
+#define LCD_I2C_ER_IRQn I2C2_ER_IRQn
+#define LCD_I2C_SCL_Pin 10  /* Port B, AF4 */
+#define LCD_I2C_SCL_AF 4
+#define LCD_I2C_SDA_Pin 3   /* Port B, AF9 */
+#define LCD_I2C_SDA_AF 9
+#define LCD_I2C_ADDRESS 0x27        /* 7-bit address (0x3F for the PCF8574A) */
+#define LCD_I2C_SPEED_HZ 100000     /* PCF8574 maximum */
+#define LCD_I2C_BACKLIGHT 1
+/* I2C2_TX: DMA1 stream 7, channel 7 */
+#define LCD_I2C_DMA_STREAM DMA1_Stream7
+#define LCD_I2C_DMA_CHANNEL 7
+#define LCD_I2C_DMA_IFCR DMA1->HIFCR
+#define LCD_I2C_DMA_FLAGS (DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 \
+        | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7)
+/* Bytes per DMA transfer (4 per character, two buffers) */
+#define LCD_I2C_BATCH_SIZE 128
+
+/* Display geometry: 16x2 or 20x4 */
+#ifndef LCD_COLS
+#define LCD_COLS 16
+#define LCD_ROWS 2
+#endif
+
 #endif /* _LCD_CONFIG_H_ */
@@ -0,0 +1,66 @@
+#include "lcd_glyph.h"
+#include "lcd_parallel.h"
+
+/* Bar cells: columns lit from the left, bottom (cursor) row kept clear */
+#define BAR_CELL(bits) { { bits, bits, bits, bits, bits, bits, bits, 0x00 } }
+const LCD_Glyph_t LCD_GlyphBar[LCD_BAR_GLYPHS] = {
+    BAR_CELL(0x10), BAR_CELL(0x18), BAR_CELL(0x1C), BAR_CELL(0x1E), BAR_CELL(0x1F)
+};
+
+/* Glyph currently in each CGRAM slot (NULL = unknown contents) */
+static const LCD_Glyph_t *glyph_resident[LCD_GLYPH_SLOTS];
+
+/**
+ * @brief Makes the glyphs of a set resident, uploading only the slots that differ.
+ * @param set Glyphs needed.
+ * @return Number of glyphs uploaded.
+ */
+uint8_t LCD_UseGlyphSet(const LCD_GlyphSet_t *set) {
+    uint8_t uploaded = 0;
+
+    for (uint8_t slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+        const LCD_Glyph_t *glyph = set->slots[slot];
+        if (glyph && glyph != glyph_resident[slot]) {
+            LCD_LoadGlyph(slot, glyph->rows);
+            glyph_resident[slot] = glyph;
+            uploaded++;
+        }
+    }
+    return uploaded;
+}
+
+/**
+ * @brief Forgets which glyphs are resident (call after the LCD is re-initialized).
+ */
+void LCD_ForgetGlyphs(void) {
+    for (uint8_t slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+        glyph_resident[slot] = 0;
+    }
+}
+
+/**
+ * @brief Formats a horizontal bar graph with 5 steps per character.
+ * @param dst Destination, width characters (not terminated).
+ * @param permille Fill level, 0-1000.
+ * @param width Bar length in characters.
+ */
+void LCD_FormatBar(char *dst, uint32_t permille, uint8_t width) {
+    uint32_t steps = (uint32_t)width * LCD_BAR_GLYPHS;
+    uint32_t lit;
+
+    if (permille > 1000U) {
+        permille = 1000U;
+    }
+    lit = (permille * steps + 500U) / 1000U;
+    for (uint8_t i = 0; i < width; i++) {
+        if (lit >= LCD_BAR_GLYPHS) {
+            dst[i] = LCD_GLYPH_CHAR(LCD_BAR_SLOT + LCD_BAR_GLYPHS - 1);
+            lit -= LCD_BAR_GLYPHS;
+        } else if (lit > 0) {
+            dst[i] = LCD_GLYPH_CHAR(LCD_BAR_SLOT + lit - 1);
+            lit = 0;
+        } else {
+            dst[i] = ' ';
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef _LCD_GLYPH_H_
+#define _LCD_GLYPH_H_
+
+#include <stdint.h>
+
+/**
+ * @brief CGRAM glyph manager.
+ * The controller holds up to 8 custom characters. A screen names the
+ * glyphs it needs in a glyph set; LCD_UseGlyphSet() uploads only the slots
+ * whose resident glyph differs, so switching back and forth between
+ * screens, or rendering the same screen every pass, costs nothing once the
+ * glyphs are loaded.
+ */
+
+#define LCD_GLYPH_SLOTS     8
+
+/* Character code that shows a CGRAM slot. Codes 8-15 mirror 0-7 on the
+   HD44780, which keeps slot 0 usable in NUL-terminated strings. */
+#define LCD_GLYPH_CHAR(slot)    ((char)(0x08 + (slot)))
+
+/* First of the five slots used by bar graphs (1 to 5 lit columns) */
+#ifndef LCD_BAR_SLOT
+#define LCD_BAR_SLOT        0
+#endif
+#define LCD_BAR_GLYPHS      5
+
+/**
+ * @brief A 5x8 custom character: 8 rows, top first, bit 4 is the leftmost pixel.
+ */
+typedef struct {
+    uint8_t rows[8];
+} LCD_Glyph_t;
+
+/**
+ * @brief Glyphs needed by a screen, by CGRAM slot (NULL = slot not used).
+ */
+typedef struct {
+    const LCD_Glyph_t *slots[LCD_GLYPH_SLOTS];
+} LCD_GlyphSet_t;
+
+/* Bar graph cells with 1 to 5 columns lit, for the LCD_BAR_SLOT slots of a set */
+extern const LCD_Glyph_t LCD_GlyphBar[LCD_BAR_GLYPHS];
+
+/**
+ * @brief Makes the glyphs of a set resident, uploading only the slots that differ.
+ * @param set Glyphs needed.
+ * @return Number of glyphs uploaded.
+ */
+uint8_t LCD_UseGlyphSet(const LCD_GlyphSet_t *set);
+
+/**
+ * @brief Forgets which glyphs are resident (call after the LCD is re-initialized).
+ */
+void LCD_ForgetGlyphs(void);
+
+/**
+ * @brief Formats a horizontal bar graph with 5 steps per character.
+ * @param dst Destination, width characters (not terminated).
+ * @param permille Fill level, 0-1000.
+ * @param width Bar length in characters.
+ * @note  The LCD_GlyphBar glyphs must be resident from LCD_BAR_SLOT.
+ */
+void LCD_FormatBar(char *dst, uint32_t permille, uint8_t width);
+
+#endif /* _LCD_GLYPH_H_ */
@@ -0,0 +1,274 @@
+#include "lcd_i2c.h"
+
+#if LCD_BUS == LCD_BUS_I2C
+
+#include "delay.h"
+#include <string.h>
+
+/* PCF8574 outputs */
+#define PCF_RS          0x01U
+#define PCF_RW          0x02U
+#define PCF_E           0x04U
+#define PCF_BACKLIGHT   0x08U
+
+#if LCD_I2C_BACKLIGHT
+#define PCF_IDLE        PCF_BACKLIGHT
+#else
+#define PCF_IDLE        0x00U
+#endif
+
+/* Bus time of the two expander writes that clock one nibble (9 SCL periods each) */
+#define LCD_I2C_NIBBLE_US   ((2U * 9U * 1000000U) / LCD_I2C_SPEED_HZ)
+
+/* Two batch buffers: one is filled while DMA sends the other */
+static uint8_t i2c_batch[2][LCD_I2C_BATCH_SIZE];
+/* Buffer being filled */
+static uint8_t i2c_fill = 0;
+/* Bytes and characters in the buffer being filled */
+static volatile uint16_t i2c_fill_len = 0;
+static volatile uint16_t i2c_fill_chars = 0;
+/* Characters in the transfer in progress */
+static volatile uint16_t i2c_sending_chars = 0;
+/* Set while a transfer runs */
+static volatile uint8_t i2c_busy = 0;
+/* Set when the fill buffer is to be sent as soon as the bus is free */
+static volatile uint8_t i2c_commit_pending = 0;
+/* RS and backlight outputs of the last expander write, 0xFF if unknown */
+static uint8_t i2c_last_ctrl = 0xFF;
+static LCD_QueueStats_t i2c_stats;
+
+/**
+ * @brief Hands the fill buffer to DMA and generates a START.
+ * Called with interrupts disabled or from the I2C interrupt.
+ */
+static void i2c_startBatch(void) {
+    LCD_I2C_DMA_IFCR = LCD_I2C_DMA_FLAGS;
+    LCD_I2C_DMA_STREAM->M0AR = (uint32_t)i2c_batch[i2c_fill];
+    LCD_I2C_DMA_STREAM->NDTR = i2c_fill_len;
+    LCD_I2C_DMA_STREAM->CR |= DMA_SxCR_EN;
+
+    i2c_sending_chars = i2c_fill_chars;
+    i2c_fill ^= 1U;
+    i2c_fill_len = 0;
+    i2c_fill_chars = 0;
+    i2c_commit_pending = 0;
+    i2c_busy = 1;
+    LCD_I2C->CR1 |= I2C_CR1_START;
+}
+
+/**
+ * @brief Ends the transfer: a committed batch follows with a repeated START,
+ * otherwise the bus is released with a STOP.
+ * @param sent 1 if the transfer completed, 0 if it was dropped.
+ * The STOP condition takes about one SCL period and CR1 must not be written
+ * until the hardware clears the bit (RM0368); LCD_I2C_Commit() waits for
+ * that, so the interrupt never does.
+ */
+static void i2c_endBatch(uint8_t sent) {
+    if (sent) {
+        i2c_stats.bytes_sent += i2c_sending_chars;
+    }
+    i2c_sending_chars = 0;
+    i2c_busy = 0;
+
+    if (i2c_commit_pending && i2c_fill_len) {
+        i2c_startBatch();
+    } else {
+        i2c_commit_pending = 0;
+        LCD_I2C->CR1 |= I2C_CR1_STOP;
+    }
+}
+
+/**
+ * @brief I2C event interrupt: address phase, then end of the DMA transfer.
+ */
+void I2C2_EV_IRQHandler(void) {
+    uint32_t sr1 = LCD_I2C->SR1;
+
+    if (sr1 & I2C_SR1_SB) {
+        LCD_I2C->DR = (uint32_t)LCD_I2C_ADDRESS << 1; /* Write */
+    } else if (sr1 & I2C_SR1_ADDR) {
+        (void)LCD_I2C->SR2; /* Clears ADDR; DMA feeds DR from now on */
+    } else if ((sr1 & I2C_SR1_BTF) && LCD_I2C_DMA_STREAM->NDTR == 0) {
+        /* Last byte shifted out */
+        i2c_endBatch(1);
+    }
+}
+
+/**
+ * @brief I2C error interrupt: no acknowledge (no backpack at the address),
+ * bus error or lost arbitration. The batch is dropped.
+ */
+void I2C2_ER_IRQHandler(void) {
+    LCD_I2C->SR1 &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR);
+    LCD_I2C_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+    i2c_endBatch(0);
+}
+
+/**
+ * @brief Appends expander writes to the fill buffer.
+ * @param bytes Expander values.
+ * @param count Number of values.
+ * @param chars Number of LCD bytes they carry.
+ * Waits for the transfer in progress when the fill buffer is full.
+ */
+static void i2c_append(const uint8_t *bytes, uint8_t count, uint8_t chars) {
+    if (i2c_fill_len + count > LCD_I2C_BATCH_SIZE) {
+        i2c_stats.full_waits++;
+        LCD_I2C_Commit();
+        while (i2c_fill_len + count > LCD_I2C_BATCH_SIZE) {
+            __WFI();
+        }
+    }
+
+    /* The interrupt may swap buffers when a commit is pending */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(&i2c_batch[i2c_fill][i2c_fill_len], bytes, count);
+    i2c_fill_len += count;
+    i2c_fill_chars += chars;
+    uint16_t depth = i2c_fill_chars + i2c_sending_chars;
+    __set_PRIMASK(primask);
+
+    if (depth > i2c_stats.max_depth) {
+        i2c_stats.max_depth = depth;
+    }
+}
+
+/**
+ * @brief Encodes one nibble as expander writes: E high, then E low to latch.
+ * @param dst Destination (up to 3 values).
+ * @param nibble Nibble in bits 0..3.
+ * @param ctrl RS and backlight outputs.
+ * @return Number of values written.
+ */
+static uint8_t i2c_encodeNibble(uint8_t *dst, uint8_t nibble, uint8_t ctrl) {
+    uint8_t out = (uint8_t)((nibble & 0x0FU) << 4) | ctrl;
+    uint8_t count = 0;
+
+    if (ctrl != i2c_last_ctrl) {
+        /* RS must be stable before E rises */
+        dst[count++] = out;
+        i2c_last_ctrl = ctrl;
+    }
+    dst[count++] = out | PCF_E;
+    dst[count++] = out;
+    return count;
+}
+
+/**
+ * @brief Sends a single nibble (wake-up sequence) and waits for it.
+ */
+static void i2c_sendNibble(uint8_t nibble) {
+    uint8_t bytes[3];
+    i2c_append(bytes, i2c_encodeNibble(bytes, nibble, PCF_IDLE), 0);
+    LCD_I2C_Drain();
+}
+
+/**
+ * @brief Sets up I2C and DMA and wakes the controller in 4-bit mode.
+ */
+void LCD_I2C_Init(void) {
+    uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+    uint32_t pclk1 = SystemCoreClock >> APBPrescTable[ppre1];
+
+    /* SCL and SDA (open drain, pull-up) come from the board pin table */
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    RCC->APB1ENR |= LCD_I2C_RCC_EN;
+
+    /* Standard mode master, transmit through DMA */
+    LCD_I2C->CR1 = I2C_CR1_SWRST;
+    LCD_I2C->CR1 = 0;
+    LCD_I2C->CR2 = (pclk1 / 1000000U) | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN | I2C_CR2_DMAEN;
+    LCD_I2C->CCR = pclk1 / (2U * LCD_I2C_SPEED_HZ);
+    LCD_I2C->TRISE = pclk1 / 1000000U + 1U; /* 1000 ns maximum rise time */
+    LCD_I2C->CR1 = I2C_CR1_PE;
+
+    /* Memory to peripheral, byte by byte */
+    LCD_I2C_DMA_STREAM->CR = 0;
+    LCD_I2C_DMA_STREAM->CR = ((uint32_t)LCD_I2C_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos)
+            | DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+    LCD_I2C_DMA_STREAM->PAR = (uint32_t)&LCD_I2C->DR;
+
+    NVIC_EnableIRQ(LCD_I2C_EV_IRQn);
+    NVIC_EnableIRQ(LCD_I2C_ER_IRQn);
+
+    /* Power-on, then the 4-bit wake-up sequence */
+    delay_ms(50);
+    i2c_sendNibble(0x03);
+    delay_ms(5);
+    i2c_sendNibble(0x03);
+    delay_us(150);
+    i2c_sendNibble(0x03);
+    i2c_sendNibble(0x02);
+}
+
+/**
+ * @brief Adds one byte to the current batch.
+ * @param rs 0 for an instruction, 1 for DDRAM/CGRAM data.
+ * @param value Byte to send.
+ * @param exec_us Execution time; longer than the gap the bus leaves
+ * between two bytes, it is waited for after sending the batch.
+ */
+void LCD_I2C_Send(uint8_t rs, uint8_t value, uint32_t exec_us) {
+    uint8_t bytes[6];
+    uint8_t ctrl = PCF_IDLE | (rs ? PCF_RS : 0U);
+    uint8_t count = i2c_encodeNibble(bytes, value >> 4, ctrl);
+
+    count += i2c_encodeNibble(bytes + count, value, ctrl);
+    i2c_append(bytes, count, 1);
+
+    if (exec_us > LCD_I2C_NIBBLE_US) {
+        /* Clear/Home: the next strobe would come too early */
+        LCD_I2C_Drain();
+        delay_us(exec_us);
+    }
+}
+
+/**
+ * @brief Starts sending the current batch (after the transfer in progress).
+ * Right after a STOP the bus is not free yet: the START waits for the
+ * hardware to clear the STOP bit, with interrupts enabled.
+ */
+void LCD_I2C_Commit(void) {
+    uint32_t primask = __get_PRIMASK();
+    uint8_t stopping;
+
+    do {
+        __disable_irq();
+        stopping = 0;
+        if (i2c_fill_len) {
+            if (i2c_busy) {
+                i2c_commit_pending = 1;
+            } else if (LCD_I2C->CR1 & I2C_CR1_STOP) {
+                stopping = 1;
+            } else {
+                i2c_startBatch();
+            }
+        }
+        __set_PRIMASK(primask);
+    } while (stopping);
+}
+
+/**
+ * @brief Sends the current batch and waits until the bus is idle.
+ */
+void LCD_I2C_Drain(void) {
+    LCD_I2C_Commit();
+    while (i2c_busy || i2c_fill_len) {
+        __WFI();
+    }
+}
+
+/**
+ * @brief Returns the transfer statistics (depth in characters).
+ */
+void LCD_I2C_GetStats(LCD_QueueStats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = i2c_stats;
+    stats->depth = i2c_fill_chars + i2c_sending_chars;
+    __set_PRIMASK(primask);
+}
+
+#endif /* LCD_BUS == LCD_BUS_I2C */
@@ -0,0 +1,44 @@
+#ifndef _LCD_I2C_H_
+#define _LCD_I2C_H_
+
+#include "lcd_parallel.h"
+#include <stdint.h>
+
+/**
+ * @brief HD44780 transport over a PCF8574 I2C expander (LCD_BUS_I2C).
+ * Used by the LCD driver in place of the GPIO pins. Each character becomes
+ * four expander writes (two nibbles, each with an enable strobe); they are
+ * collected in a batch and sent as one DMA transfer when the driver
+ * commits, while the next batch is filled in the other buffer.
+ */
+
+/**
+ * @brief Sets up the pins, I2C and DMA and wakes the controller in 4-bit mode.
+ */
+void LCD_I2C_Init(void);
+
+/**
+ * @brief Adds one byte to the current batch.
+ * @param rs 0 for an instruction, 1 for DDRAM/CGRAM data.
+ * @param value Byte to send.
+ * @param exec_us Execution time; longer than the gap the bus leaves
+ * between two bytes, it is waited for after sending the batch.
+ */
+void LCD_I2C_Send(uint8_t rs, uint8_t value, uint32_t exec_us);
+
+/**
+ * @brief Starts sending the current batch (after the transfer in progress).
+ */
+void LCD_I2C_Commit(void);
+
+/**
+ * @brief Sends the current batch and waits until the bus is idle.
+ */
+void LCD_I2C_Drain(void);
+
+/**
+ * @brief Returns the transfer statistics (depth in characters).
+ */
+void LCD_I2C_GetStats(LCD_QueueStats_t *stats);
+
+#endif /* _LCD_I2C_H_ */
@@ -0,0 +1,114 @@
+#include "lcd_message.h"
+#include "lcd_parallel.h"
+#include "soft_timer.h"
+#include "format.h"
+
+/* One message per priority */
+typedef struct {
+    const char  *text;      /* NULL when the slot is empty */
+    SoftTimer_t expiry;     /* Ends the message after its TTL */
+} LCD_Message_t;
+
+static LCD_Message_t messages[LCD_MSG_PRIORITY_COUNT];
+static void (*message_redraw)(void);
+
+/**
+ * @brief Calls the redraw hook if the shown message may have changed.
+ * @param priority Slot that changed.
+ */
+static void message_changed(LCD_MsgPriority_t priority) {
+    /* A change below a live higher-priority message is not visible */
+    for (uint8_t p = priority + 1U; p < LCD_MSG_PRIORITY_COUNT; p++) {
+        if (messages[p].text) {
+            return;
+        }
+    }
+    if (message_redraw) {
+        message_redraw();
+    }
+}
+
+/**
+ * @brief Expiry timer callback: the TTL of a message ran out.
+ * @param arg Priority slot (cast to a pointer).
+ */
+static void message_expired(void *arg) {
+    LCD_MsgPriority_t priority = (LCD_MsgPriority_t)(uintptr_t)arg;
+    messages[priority].text = 0;
+    message_changed(priority);
+}
+
+/**
+ * @brief Initializes the message layer.
+ * @param redraw Called when the shown message changes. May be NULL.
+ */
+void LCD_MessageInit(void (*redraw)(void)) {
+    message_redraw = redraw;
+    for (uint8_t p = 0; p < LCD_MSG_PRIORITY_COUNT; p++) {
+        messages[p].text = 0;
+        SoftTimer_Init(&messages[p].expiry, message_expired, (void *)(uintptr_t)p);
+    }
+}
+
+/**
+ * @brief Shows a message for ttl_ms milliseconds.
+ * @param priority Priority slot.
+ * @param text Text (must stay valid while shown, e.g. a string literal).
+ * @param ttl_ms Time to live, LCD_MSG_UNTIL_CANCELLED to keep it.
+ */
+void LCD_PostMessage(LCD_MsgPriority_t priority, const char *text, uint32_t ttl_ms) {
+    LCD_Message_t *message = &messages[priority];
+    uint8_t changed = (message->text != text);
+
+    message->text = text;
+    if (ttl_ms == LCD_MSG_UNTIL_CANCELLED) {
+        SoftTimer_Stop(&message->expiry);
+    } else {
+        SoftTimer_Start(&message->expiry, ttl_ms, 0);
+    }
+    if (changed) {
+        message_changed(priority);
+    }
+}
+
+/**
+ * @brief Removes the message of a priority slot.
+ * @param priority Priority slot.
+ */
+void LCD_CancelMessage(LCD_MsgPriority_t priority) {
+    LCD_Message_t *message = &messages[priority];
+
+    SoftTimer_Stop(&message->expiry);
+    if (message->text) {
+        message->text = 0;
+        message_changed(priority);
+    }
+}
+
+/**
+ * @brief Returns the message currently shown, or NULL if none.
+ */
+const char *LCD_ActiveMessage(void) {
+    for (int8_t p = LCD_MSG_PRIORITY_COUNT - 1; p >= 0; p--) {
+        if (messages[p].text) {
+            return messages[p].text;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Draws the active message over LCD_MESSAGE_ROW of the framebuffer.
+ */
+void LCD_RenderMessage(void) {
+    const char *text = LCD_ActiveMessage();
+    char line[LCD_COLS + 1];
+
+    if (!text) {
+        return;
+    }
+    Format_Str(line, line + LCD_COLS, text, LCD_COLS);
+    line[LCD_COLS] = '\0';
+    LCD_setCursor(0, LCD_MESSAGE_ROW);
+    LCD_Write(line);
+}
@@ -0,0 +1,65 @@
+#ifndef _LCD_MESSAGE_H_
+#define _LCD_MESSAGE_H_
+
+#include "lcd_config.h"
+#include <stdint.h>
+
+/**
+ * @brief Transient LCD messages with priorities and time-to-live.
+ * A message overlays LCD_MESSAGE_ROW of whatever screen is drawn until its
+ * TTL runs out, so callers never have to block to keep text readable.
+ * There is one slot per priority: posting replaces the message of the same
+ * priority, and the highest-priority live message is the one shown. When
+ * it expires or is cancelled, a lower one that is still live shows again.
+ */
+
+/* Row covered by messages */
+#ifndef LCD_MESSAGE_ROW
+#define LCD_MESSAGE_ROW     (LCD_ROWS - 1)
+#endif
+
+/* Message priorities, lowest first */
+typedef enum {
+    LCD_MSG_INFO = 0,
+    LCD_MSG_WARNING,
+    LCD_MSG_ALERT,
+    LCD_MSG_CRITICAL,
+    LCD_MSG_PRIORITY_COUNT
+} LCD_MsgPriority_t;
+
+/* TTL of a message that stays until LCD_CancelMessage() */
+#define LCD_MSG_UNTIL_CANCELLED  0U
+
+/**
+ * @brief Initializes the message layer.
+ * @param redraw Called when the shown message changes (typically renders
+ * the current screen and the message again). May be NULL.
+ */
+void LCD_MessageInit(void (*redraw)(void));
+
+/**
+ * @brief Shows a message for ttl_ms milliseconds.
+ * @param priority Priority slot.
+ * @param text Text (must stay valid while shown, e.g. a string literal).
+ * @param ttl_ms Time to live, LCD_MSG_UNTIL_CANCELLED to keep it.
+ */
+void LCD_PostMessage(LCD_MsgPriority_t priority, const char *text, uint32_t ttl_ms);
+
+/**
+ * @brief Removes the message of a priority slot.
+ * @param priority Priority slot.
+ */
+void LCD_CancelMessage(LCD_MsgPriority_t priority);
+
+/**
+ * @brief Returns the message currently shown, or NULL if none.
+ */
+const char *LCD_ActiveMessage(void);
+
+/**
+ * @brief Draws the active message over LCD_MESSAGE_ROW of the framebuffer.
+ * @note  Call after drawing the screen underneath. Does nothing without a message.
+ */
+void LCD_RenderMessage(void);
+
+#endif /* _LCD_MESSAGE_H_ */
@@ -1,61 +1,416 @@
 #include "lcd_parallel.h"
+#include "lcd_i2c.h"
 #include <stdint.h>
 #include "stm32f4xx.h"
 #include "delay.h"
+#include "profiler.h"
+#include "trace.h"
+#include "pwm_timer.h"
+#include "pin.h"
+#include <string.h>
 
 char display_settings;
 
+/* DDRAM address of the first character of each row (rows 2 and 3 continue
+   rows 0 and 1, e.g. 0x14/0x54 on a 20x4 panel) */
+static const uint8_t lcd_row_offsets[4] = { 0x00, 0x40, LCD_COLS, 0x40 + LCD_COLS };
+
+/* Characters drawn by the application (sent by LCD_Flush) */
+static char lcd_frame[LCD_ROWS][LCD_COLS];
+/* Characters currently shown by the controller */
+static char lcd_shown[LCD_ROWS][LCD_COLS];
+/* Drawing position in the framebuffer */
+static uint8_t frame_col, frame_row;
+/* Set when lcd_frame may differ from lcd_shown */
+static uint8_t frame_dirty;
+/* Controller DDRAM address counter, LCD_ADDRESS_UNKNOWN if not known */
+#define LCD_ADDRESS_UNKNOWN 0xFF
+static uint8_t lcd_address = LCD_ADDRESS_UNKNOWN;
+
+/* Worst-case execution times (HD44780 at 270 kHz) when the busy flag is not used */
+#define LCD_EXEC_TIME_US        45
+#define LCD_CLEAR_TIME_US       1600
+/* Give up polling the busy flag after this time (display not responding) */
+#define LCD_BUSY_TIMEOUT_US     5000
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* Control pin writes (BSRR, so the sequencer interrupt cannot corrupt other port B pins) */
+#define LCD_E_HIGH()    Pin_High(LCD_DATA_PORT_B, E_Pin)
+#define LCD_E_LOW()     Pin_Low(LCD_DATA_PORT_B, E_Pin)
+#define LCD_RS(rs)      Pin_Write(LCD_DATA_PORT_B, RS_Pin, (rs) != 0)
+
+/*
+ * Data pin lookup tables, built at compile time from lcd_config.h. Each
+ * entry is the BSRR word that drives the data lines of one port to a
+ * nibble value (set bits for ones, reset bits for zeros), so a port is
+ * updated with a single atomic write and no read-modify-write.
+ */
+#define LCD_LINE_BSRR(port_b, line_b, set, pin) \
+    (((port_b) == (line_b)) ? ((set) ? (1U << (pin)) : (1U << ((pin) + 16))) : 0U)
+/* D4..D7 (the nibble in 4-bit mode, the upper nibble in 8-bit mode) */
+#define LCD_HIGH_BSRR(port_b, n) \
+    (LCD_LINE_BSRR(port_b, DATA5_PortB, (n) & 0x01, DATA5_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA6_PortB, (n) & 0x02, DATA6_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA7_PortB, (n) & 0x04, DATA7_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA8_PortB, (n) & 0x08, DATA8_Pin))
+/* D0..D3 (the lower nibble in 8-bit mode) */
+#define LCD_LOW_BSRR(port_b, n) \
+    (LCD_LINE_BSRR(port_b, DATA1_PortB, (n) & 0x01, DATA1_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA2_PortB, (n) & 0x02, DATA2_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA3_PortB, (n) & 0x04, DATA3_Pin) \
+    | LCD_LINE_BSRR(port_b, DATA4_PortB, (n) & 0x08, DATA4_Pin))
+#define LCD_LUT16(f, port_b) { \
+    f(port_b, 0), f(port_b, 1), f(port_b, 2), f(port_b, 3), \
+    f(port_b, 4), f(port_b, 5), f(port_b, 6), f(port_b, 7), \
+    f(port_b, 8), f(port_b, 9), f(port_b, 10), f(port_b, 11), \
+    f(port_b, 12), f(port_b, 13), f(port_b, 14), f(port_b, 15) }
+
+static const uint32_t lcd_high_bsrr_a[16] = LCD_LUT16(LCD_HIGH_BSRR, 0);
+static const uint32_t lcd_high_bsrr_b[16] = LCD_LUT16(LCD_HIGH_BSRR, 1);
+#ifdef LCD8Bit
+static const uint32_t lcd_low_bsrr_a[16] = LCD_LUT16(LCD_LOW_BSRR, 0);
+static const uint32_t lcd_low_bsrr_b[16] = LCD_LUT16(LCD_LOW_BSRR, 1);
+#endif
+
+/* MODER bits of the data pins of each port (for busy flag reads) */
+#define LCD_LINE_MODER(port_b, line_b, pin) (((port_b) == (line_b)) ? (3U << ((pin) * 2)) : 0U)
+#define LCD_HIGH_MODER(port_b) \
+    (LCD_LINE_MODER(port_b, DATA5_PortB, DATA5_Pin) | LCD_LINE_MODER(port_b, DATA6_PortB, DATA6_Pin) \
+    | LCD_LINE_MODER(port_b, DATA7_PortB, DATA7_Pin) | LCD_LINE_MODER(port_b, DATA8_PortB, DATA8_Pin))
+#ifdef LCD8Bit
+#define LCD_DATA_MODER(port_b) (LCD_HIGH_MODER(port_b) \
+    | LCD_LINE_MODER(port_b, DATA1_PortB, DATA1_Pin) | LCD_LINE_MODER(port_b, DATA2_PortB, DATA2_Pin) \
+    | LCD_LINE_MODER(port_b, DATA3_PortB, DATA3_Pin) | LCD_LINE_MODER(port_b, DATA4_PortB, DATA4_Pin))
+#else
+#define LCD_DATA_MODER(port_b) LCD_HIGH_MODER(port_b)
+#endif
+
+/* Port holding D7, where the busy flag is read */
+#define LCD_BF_PORT     (DATA8_PortB ? LCD_DATA_PORT_B : LCD_DATA_PORT_A)
+
+#if LCD_USE_ASYNC
+/* Queue entry: byte in bits 0..7 plus these flags */
+#define LCD_QUEUE_RS            0x100U  /* Character (RS high) */
+#define LCD_QUEUE_SLOW          0x200U  /* Clear/Home: long execution time */
+
+/* Bytes waiting for the sequencer */
+static uint16_t lcd_queue[LCD_QUEUE_SIZE];
+static volatile uint16_t lcd_queue_head = 0;
+static volatile uint16_t lcd_queue_tail = 0;
+/* Set once LCD_Init() has handed the bus to the sequencer */
+static uint8_t lcd_async_running = 0;
+/* Set while the sequencer timer is running */
+static volatile uint8_t lcd_seq_busy = 0;
+/* Next step of the sequencer */
+static volatile uint8_t lcd_seq_step;
+static LCD_QueueStats_t lcd_stats;
+
+/* Sequencer steps, one timer interrupt each (8-bit mode uses the first two) */
+enum {
+    LCD_SEQ_HIGH_NIBBLE,    /* RS and upper nibble (8-bit: whole byte) out, E high */
+    LCD_SEQ_HIGH_FALL,      /* E low: controller latches the upper nibble (8-bit: byte done) */
+    LCD_SEQ_LOW_NIBBLE,     /* Lower nibble out, E high */
+    LCD_SEQ_LOW_FALL,       /* E low: byte complete, wait its execution time */
+};
+#endif
+
 /**
  * @brief  Send a falling edge to the LCD
  * This function generates a falling edge on the Enable pin of the LCD.
  */
 static void fallingEdge(void) {
     /* Set Enable pin low */
-    LCD_DATA_PORT_B->ODR &= ~(1 << E_Pin);
-    /* Set Enable pin high */
-    LCD_DATA_PORT_B->ODR |= (1 << E_Pin);
-    delay_us(2);
-    /* Set Enable pin low */
-    LCD_DATA_PORT_B->ODR &= ~(1 << E_Pin);
+    LCD_E_LOW();
+    /* Set Enable pin high (PWeh >= 450 ns) */
+    LCD_E_HIGH();
+    delay_us(1);
+    /* Set Enable pin low (tcycE >= 1000 ns) */
+    LCD_E_LOW();
     delay_us(1);
 }
 
+#if LCD_USE_RW
+/**
+ * @brief  Switch the data pins between input and output
+ * @param  input: 1 to release the bus to the LCD, 0 to drive it
+ */
+static void lcd_dataDirection(uint8_t input) {
+    const uint32_t mask_b = LCD_DATA_MODER(1);
+    const uint32_t mask_a = LCD_DATA_MODER(0);
+    if (input) {
+        LCD_DATA_PORT_B->MODER &= ~mask_b;
+        LCD_DATA_PORT_A->MODER &= ~mask_a;
+    } else {
+        LCD_DATA_PORT_B->MODER |= (mask_b & 0x55555555U);
+        LCD_DATA_PORT_A->MODER |= (mask_a & 0x55555555U);
+    }
+}
+
+/**
+ * @brief  Wait until the LCD has finished the previous instruction
+ * Reads the busy flag (D7) until it clears. In 4-bit mode both nibbles of
+ * the status byte are clocked so the interface stays in step.
+ */
+static void lcd_waitReady(void) {
+    uint64_t deadline = monotonic_us() + LCD_BUSY_TIMEOUT_US;
+    uint8_t busy;
+
+    lcd_dataDirection(1);
+    PinGroup_Bsrr(LCD_DATA_PORT_B, PIN_RESET_BITS(RS_Pin) | PIN_SET_BITS(RW_Pin));
+    do {
+        /* Upper nibble: busy flag on D7, valid tDDR (360 ns) after E rises */
+        LCD_E_HIGH();
+        delay_us(1);
+        busy = Pin_Read(LCD_BF_PORT, DATA8_Pin);
+        LCD_E_LOW();
+        delay_us(1);
 #ifndef LCD8Bit
+        /* Lower nibble (address counter bits, not needed) */
+        LCD_E_HIGH();
+        delay_us(1);
+        LCD_E_LOW();
+        delay_us(1);
+#endif
+    } while (busy && monotonic_us() < deadline);
+    Pin_Low(LCD_DATA_PORT_B, RW_Pin);
+    lcd_dataDirection(0);
+}
+#endif
+
+#ifndef LCD8Bit
+/**
+ * @brief  Put a nibble on D4..D7 without strobing E
+ * @param  data: Nibble in bits 0..3
+ */
+static inline void lcd_putNibble(char data) {
+    PinGroup_Bsrr(LCD_DATA_PORT_B, lcd_high_bsrr_b[data & 0x0F]);
+    PinGroup_Bsrr(LCD_DATA_PORT_A, lcd_high_bsrr_a[data & 0x0F]);
+}
+
 static void LCD_sendData4Bit(char data) {
-    LCD_DATA_PORT_B->ODR &= ~((1 << DATA5_Pin) | (1 << DATA6_Pin));
-    LCD_DATA_PORT_A->ODR &= ~((1 << DATA7_Pin) | (1 << DATA8_Pin));
-
-    /* Set data pin 5 */
-    if (data & 0x01)
-        LCD_DATA_PORT_B->ODR |= (1 << DATA5_Pin);
-    /* Set data pin 6 */
-    if (data & 0x02)
-        LCD_DATA_PORT_B->ODR |= (1 << DATA6_Pin);
-    /* Set data pin 7 */
-    if (data & 0x04)
-        LCD_DATA_PORT_A->ODR |= (1 << DATA7_Pin);
-    /* Set data pin 8 */
-    if (data & 0x08)
-        LCD_DATA_PORT_A->ODR |= (1 << DATA8_Pin);
+    lcd_putNibble(data);
+    fallingEdge();
+}
+#else
+/**
+ * @brief  Put a byte on D0..D7 without strobing E
+ * @param  data: Byte to output
+ */
+static inline void lcd_putByte(uint8_t data) {
+    PinGroup_Bsrr(LCD_DATA_PORT_B, lcd_low_bsrr_b[data & 0x0F] | lcd_high_bsrr_b[data >> 4]);
+    PinGroup_Bsrr(LCD_DATA_PORT_A, lcd_low_bsrr_a[data & 0x0F] | lcd_high_bsrr_a[data >> 4]);
+}
 
+static void LCD_sendData8Bit(uint8_t data) {
+    lcd_putByte(data);
     fallingEdge();
-    delay_us(45);
 }
 #endif
 
+/**
+ * @brief  Send one byte as two nibbles, blocking
+ * @param  rs: 0 for an instruction, 1 for DDRAM/CGRAM data
+ * @param  value: Byte to send
+ * @param  exec_us: Worst-case execution time, waited when there is no R/W pin
+ * With the R/W pin the busy flag is polled before the transfer, so the
+ * caller can do other work while the controller executes.
+ */
+static void lcd_sendByteBlocking(uint8_t rs, char value, uint32_t exec_us) {
+#if LCD_USE_RW
+    (void)exec_us;
+    lcd_waitReady();
+#endif
+    LCD_RS(rs);
+#ifdef LCD8Bit
+    LCD_sendData8Bit((uint8_t)value);
+#else
+    LCD_sendData4Bit(value >> 4); /* Send upper nibble */
+    LCD_sendData4Bit(value);      /* Send lower nibble */
+#endif
+#if !LCD_USE_RW
+    delay_us(exec_us);
+#endif
+}
+
+#if LCD_USE_ASYNC
+/**
+ * @brief  Returns the number of queued bytes
+ */
+static inline uint16_t lcd_queueDepth(void) {
+    return (uint16_t)(lcd_queue_head - lcd_queue_tail);
+}
+
+/**
+ * @brief  Arm the one-pulse sequencer timer
+ * @param  us: Time until the next step (1..65535 us)
+ */
+static inline void lcd_seqSchedule(uint32_t us) {
+    LCD_SEQ_TIMER->ARR = us - 1U;
+    LCD_SEQ_TIMER->CNT = 0;
+    LCD_SEQ_TIMER->CR1 |= TIM_CR1_CEN;
+}
+
+/**
+ * @brief  Run one step of the transmit sequencer
+ * @retval Microseconds until the next step, 0 when the queue is empty
+ * Clocks the byte at the queue tail out in four steps (two in 8-bit mode):
+ * each nibble is placed with E high and latched on the falling edge one
+ * step later. After the last falling edge the byte is dequeued and the
+ * next one starts once its execution time has passed.
+ */
+static uint32_t lcd_seqStep(void) {
+    uint16_t entry = lcd_queue[lcd_queue_tail & (LCD_QUEUE_SIZE - 1U)];
+
+    switch (lcd_seq_step) {
+    case LCD_SEQ_HIGH_NIBBLE:
+        if (lcd_queueDepth() == 0) {
+            return 0;
+        }
+        LCD_RS(entry & LCD_QUEUE_RS);
+#ifdef LCD8Bit
+        lcd_putByte((uint8_t)entry);
+#else
+        lcd_putNibble((char)(entry >> 4));
+#endif
+        LCD_E_HIGH();
+        lcd_seq_step = LCD_SEQ_HIGH_FALL;
+        return 1;
+#ifndef LCD8Bit
+    case LCD_SEQ_HIGH_FALL:
+        LCD_E_LOW();
+        lcd_seq_step = LCD_SEQ_LOW_NIBBLE;
+        return 1;
+    case LCD_SEQ_LOW_NIBBLE:
+        lcd_putNibble((char)entry);
+        LCD_E_HIGH();
+        lcd_seq_step = LCD_SEQ_LOW_FALL;
+        return 1;
+#endif
+    default:
+        LCD_E_LOW();
+        lcd_queue_tail++;
+        lcd_stats.bytes_sent++;
+        lcd_seq_step = LCD_SEQ_HIGH_NIBBLE;
+        return (entry & LCD_QUEUE_SLOW) ? LCD_CLEAR_TIME_US : LCD_EXEC_TIME_US;
+    }
+}
+
+/**
+ * @brief  Sequencer timer interrupt (TIM10 shares its vector with TIM1 update)
+ */
+void TIM1_UP_TIM10_IRQHandler(void) {
+    if (LCD_SEQ_TIMER->SR & TIM_SR_UIF) {
+        LCD_SEQ_TIMER->SR = ~TIM_SR_UIF;
+        uint32_t next = lcd_seqStep();
+        if (next) {
+            lcd_seqSchedule(next);
+        } else {
+            lcd_seq_busy = 0;
+        }
+    }
+}
+
+/**
+ * @brief  Set the sequencer prescaler for a 1 us tick (also after a clock change)
+ */
+static void lcd_seqReclock(void) {
+    LCD_SEQ_TIMER->PSC = PwmTimer_Clock(LCD_SEQ_TIMER) / 1000000U - 1U;
+}
+
+/**
+ * @brief  Set up the sequencer timer with a 1 us tick in one-pulse mode
+ */
+static void lcd_seqInit(void) {
+    PwmTimer_Reserve(LCD_SEQ_TIMER, "lcd", lcd_seqReclock);
+    LCD_SEQ_TIMER->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+    lcd_seqReclock();
+    LCD_SEQ_TIMER->EGR = TIM_EGR_UG; /* Load the prescaler */
+    LCD_SEQ_TIMER->SR = 0;
+    LCD_SEQ_TIMER->DIER = TIM_DIER_UIE;
+    NVIC_EnableIRQ(LCD_SEQ_TIMER_IRQn);
+
+    lcd_seq_step = LCD_SEQ_HIGH_NIBBLE;
+    lcd_async_running = 1;
+}
+
+/**
+ * @brief  Queue one byte for the sequencer
+ * Waits for room when the queue is full.
+ */
+static void lcd_enqueue(uint16_t entry) {
+    if (lcd_queueDepth() >= LCD_QUEUE_SIZE) {
+        lcd_stats.full_waits++;
+        while (lcd_queueDepth() >= LCD_QUEUE_SIZE) {
+            __WFI();
+        }
+    }
+    lcd_queue[lcd_queue_head & (LCD_QUEUE_SIZE - 1U)] = entry;
+    lcd_queue_head++;
+
+    uint16_t depth = lcd_queueDepth();
+    if (depth > lcd_stats.max_depth) {
+        lcd_stats.max_depth = depth;
+    }
+
+    /* Start the sequencer if it stopped on an empty queue */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!lcd_seq_busy) {
+        lcd_seq_busy = 1;
+        lcd_seqSchedule(1);
+    }
+    __set_PRIMASK(primask);
+}
+#endif
+
+/**
+ * @brief  Send one byte to the LCD
+ * Queued for the sequencer once LCD_Init() has finished, blocking before.
+ */
+static void lcd_sendByte(uint8_t rs, char value, uint32_t exec_us) {
+    PROF_SCOPE(PROF_ZONE_LCD_BYTE);
+#if LCD_USE_ASYNC
+    if (lcd_async_running) {
+        lcd_enqueue((uint8_t)value | (rs ? LCD_QUEUE_RS : 0U)
+                | (exec_us > LCD_EXEC_TIME_US ? LCD_QUEUE_SLOW : 0U));
+        return;
+    }
+#endif
+    lcd_sendByteBlocking(rs, value, exec_us);
+}
+#else /* LCD_BUS_I2C */
+/**
+ * @brief  Send one byte to the LCD
+ * Added to the current I2C batch, which lcd_commit() hands to DMA.
+ */
+static void lcd_sendByte(uint8_t rs, char value, uint32_t exec_us) {
+    PROF_SCOPE(PROF_ZONE_LCD_BYTE);
+    LCD_I2C_Send(rs, (uint8_t)value, exec_us);
+}
+#endif
+
+/**
+ * @brief  Start sending the bytes produced so far
+ * The I2C backend sends everything since the last commit as one DMA
+ * transfer; the parallel backend has already sent or queued each byte.
+ */
+static inline void lcd_commit(void) {
+#if LCD_BUS == LCD_BUS_I2C
+    LCD_I2C_Commit();
+#endif
+}
+
 /**
  * @brief  Send a command to the LCD
  * @param  command: Command to send
  * Sends a control instruction (e.g., clear, set cursor, shift)
- to the LCD by splitting it into two 4-bit transmissions.
+ to the LCD (two 4-bit transmissions, or one in 8-bit mode).
  */
 static void LCD_sendCommand(char command) {
-    /* Clear RS pin for command */
-    LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
-    /* Send upper nibble*/
-    LCD_sendData4Bit(command >> 4);
-    /* Send lower nibble */
-    LCD_sendData4Bit(command); // Send lower nibble
+    /* Clear and Return Home take 1.52 ms, every other instruction 37 us */
+    uint8_t slow = ((uint8_t)command == LCD_CMD_CLEAR_DISPLAY
+            || ((uint8_t)command & 0xFE) == LCD_CMD_RETURN_HOME);
+    lcd_sendByte(0, command, slow ? LCD_CLEAR_TIME_US : LCD_EXEC_TIME_US);
 }
 
 /**
@@ -65,54 +420,151 @@ static void LCD_sendCommand(char command) {
  * Sends a character to be displayed on the LCD.
  */
 static void LCD_sendData(char data) {
-    LCD_DATA_PORT_B->ODR |= (1 << RS_Pin); // Set RS pin for data
-    LCD_sendData4Bit(data >> 4); // Send upper nibble
-    LCD_sendData4Bit(data); // Send lower nibble
+    lcd_sendByte(1, data, LCD_EXEC_TIME_US);
 }
 
 /**
- * @brief  Turn off display without clearing data
- * Sends command to disable display (Display OFF).
+ * @brief  Clear the framebuffer
+ * Fills the screen with spaces and moves the drawing position home.
+ * The controller is updated by the next LCD_Flush().
  */
 void LCD_Clear(void) {
-    LCD_sendCommand(LCD_CMD_CLEAR_DISPLAY);
-    delay_ms(2); // Wait for the command to complete
+    memset(lcd_frame, ' ', sizeof(lcd_frame));
+    frame_col = 0;
+    frame_row = 0;
+    frame_dirty = 1;
 }
 
 /**
- * @brief  Put a character on the LCD
+ * @brief  Put a character into the framebuffer
  * @param  c: Character to display
  * @retval None
- * This function sends a character to the LCD.
+ * Draws at the current position and advances it. Characters past the end
+ * of the row are dropped.
  */
 void LCD_Put(char c) {
-    LCD_sendData(c);
+    if (frame_row < LCD_ROWS && frame_col < LCD_COLS) {
+        if (lcd_frame[frame_row][frame_col] != c) {
+            lcd_frame[frame_row][frame_col] = c;
+            frame_dirty = 1;
+        }
+        frame_col++;
+    }
 }
 
 /**
- * @brief  Write a string to the LCD
+ * @brief  Write a string into the framebuffer
  * @param  str: Pointer to the string to display
  * @retval None
- * This function sends a string to the LCD.
+ * Draws the string from the current position, clipped at the end of the row.
  */
 void LCD_Write(char *str) {
     while (*str) {
-        LCD_sendData(*str++);
+        LCD_Put(*str++);
+    }
+}
+
+/**
+ * @brief  Send the changed characters to the LCD
+ * @retval Number of bus transfers (commands and characters) sent
+ * Compares the framebuffer with what the controller shows and writes only
+ * the differing characters. Runs of changed characters are sent back to
+ * back using the controller's address auto-increment; a DDRAM address
+ * command is only issued where the next change is not at the current
+ * address.
+ */
+uint32_t LCD_Flush(void) {
+    uint32_t transfers = 0;
+
+    if (!frame_dirty) {
+        return 0;
+    }
+    PROF_SCOPE(PROF_ZONE_LCD_FLUSH);
+    TRACE(TRACE_EVT_LCD_FLUSH_BEGIN, 0);
+
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        for (uint8_t col = 0; col < LCD_COLS; col++) {
+            char c = lcd_frame[row][col];
+            if (c == lcd_shown[row][col]) {
+                continue;
+            }
+            uint8_t address = lcd_row_offsets[row] + col;
+            if (address != lcd_address) {
+                LCD_sendCommand(LCD_CMD_SET_DDRAM_ADDR | address);
+                transfers++;
+            }
+            LCD_sendData(c);
+            lcd_shown[row][col] = c;
+            lcd_address = address + 1;
+            transfers++;
+        }
+    }
+    frame_dirty = 0;
+    lcd_commit();
+
+    TRACE(TRACE_EVT_LCD_FLUSH_END, transfers > 0xFF ? 0xFF : transfers);
+    return transfers;
+}
+
+/**
+ * @brief  Force a full redraw on the next flush
+ * Use when the controller contents may have been corrupted (e.g. after a
+ * brown-out of the display).
+ */
+void LCD_Invalidate(void) {
+    memset(lcd_shown, 0, sizeof(lcd_shown));
+    lcd_address = LCD_ADDRESS_UNKNOWN;
+    frame_dirty = 1;
+}
+
+/**
+ * @brief  Upload a custom character into CGRAM
+ * @param  slot: CGRAM slot (0-7), shown by character codes slot and slot + 8
+ * @param  bitmap: 8 rows, top first, bit 4 is the leftmost pixel
+ * @retval None
+ * Sent immediately (queued with LCD_USE_ASYNC), not through the
+ * framebuffer. Characters already on the screen that use the slot change
+ * as soon as the upload completes.
+ */
+void LCD_LoadGlyph(uint8_t slot, const uint8_t *bitmap) {
+    LCD_sendCommand(LCD_CMD_SET_CGRAM_ADDR | ((slot & 0x07) << 3));
+    for (uint8_t row = 0; row < 8; row++) {
+        LCD_sendData(bitmap[row] & 0x1F);
     }
+    lcd_commit();
+    /* The address counter now points into CGRAM */
+    lcd_address = LCD_ADDRESS_UNKNOWN;
 }
 
 /**
- * @brief  Initialize the LCD in 4-bit mode
+ * @brief  Initialize the LCD in 4-bit (or 8-bit, with LCD8Bit) mode
  * Sends the required startup sequence and configuration commands to prepare the LCD for operation.
  */
 void LCD_Init(void) {
-    /* Clear RS pin for command */
-    LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
-    /* Clear Enable pin */
-    LCD_DATA_PORT_B->ODR &= ~(1 << E_Pin);
+#if LCD_BUS == LCD_BUS_I2C
+    /* Power-on delay and wake-up sequence over the expander */
+    LCD_I2C_Init();
+    display_settings =
+    LCD_CMD_4BIT_MODE | LCD_CMD_2LINE_MODE | LCD_CMD_5x8_DOTS;
+#else
+    /* RS low for a command, Enable low (and R/W low: write mode) */
+#if LCD_USE_RW
+    PinGroup_Write(LCD_DATA_PORT_B, (1U << RS_Pin) | (1U << E_Pin) | (1U << RW_Pin), 0U);
+#else
+    PinGroup_Write(LCD_DATA_PORT_B, (1U << RS_Pin) | (1U << E_Pin), 0U);
+#endif
     delay_ms(50);
 
-#if 1
+#ifdef LCD8Bit
+    display_settings =
+    LCD_CMD_8BIT_MODE | LCD_CMD_2LINE_MODE | LCD_CMD_5x8_DOTS;
+    LCD_sendData8Bit(0x30);
+    delay_ms(5);
+    LCD_sendData8Bit(0x30);
+    delay_us(150);
+    LCD_sendData8Bit(0x30);
+    delay_us(50);
+#else
     display_settings =
     LCD_CMD_4BIT_MODE | LCD_CMD_2LINE_MODE | LCD_CMD_5x8_DOTS;
     LCD_sendData4Bit(0x03);
@@ -124,36 +576,72 @@ void LCD_Init(void) {
     LCD_sendData4Bit(0x02);
     delay_us(50);
 #endif
+#endif /* LCD_BUS */
+    /* From here on the controller is in its final bus mode and reports busy */
     LCD_sendCommand(LCD_CMD_FUNCTION_SET | display_settings);
-    delay_ms(1);
     display_settings |= LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF;
     LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | display_settings);
-    delay_us(50);
 
-    LCD_Clear();
+    LCD_sendCommand(LCD_CMD_CLEAR_DISPLAY);
     display_settings |= LCD_CMD_SET_ENTRY_LEFT | LCD_CMD_SET_ENTRY_NO_SHIFT;
     LCD_sendCommand(LCD_CMD_ENTRY_MODE_SET | display_settings);
-    delay_us(50);
+
+    /* The controller now shows blanks with the address counter at 0 */
+    memset(lcd_shown, ' ', sizeof(lcd_shown));
+    lcd_address = 0;
+    LCD_Clear();
+    lcd_commit();
+
+#if LCD_BUS == LCD_BUS_PARALLEL && LCD_USE_ASYNC
+#if LCD_USE_RW
+    /* The busy flag was polled before each byte, not after: let the last
+       instruction finish, the sequencer starts on an idle controller */
+    lcd_waitReady();
+#endif
+    /* From now on bytes are clocked out in the background */
+    lcd_seqInit();
+#endif
 }
 
 /**
- * @brief  Set cursor to specified column and row
- * @param  x: Column position (0–15)
- * @param  y: Row position (0: top row, 1: bottom row)
+ * @brief  Wait until every queued byte has been sent
+ * Returns at once when the asynchronous backend is disabled.
+ */
+void LCD_Drain(void) {
+#if LCD_BUS == LCD_BUS_I2C
+    LCD_I2C_Drain();
+#elif LCD_USE_ASYNC
+    while (lcd_seq_busy) {
+        __WFI();
+    }
+#endif
+}
+
+/**
+ * @brief  Get the transmit queue statistics
+ * @param  stats: Filled with the current depth and the counters
+ */
+void LCD_GetQueueStats(LCD_QueueStats_t *stats) {
+#if LCD_BUS == LCD_BUS_I2C
+    LCD_I2C_GetStats(stats);
+#elif LCD_USE_ASYNC
+    *stats = lcd_stats;
+    stats->depth = lcd_queueDepth();
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+/**
+ * @brief  Set the drawing position to specified column and row
+ * @param  x: Column position (0 to LCD_COLS - 1)
+ * @param  y: Row position (0 to LCD_ROWS - 1, 0 is the top row)
  * @retval None
- * Moves the LCD cursor to the given (x, y) position.
+ * Moves the framebuffer drawing position to the given (x, y) position.
  */
 void LCD_setCursor(char x, char y) {
-    uint8_t address;
-    if (y == 0) {
-        /* First line */
-        address = 0x00 + x;
-    } else {
-        /* Second line */
-        address = 0x40 + x;
-    }
-    /* Set DDRAM address */
-    LCD_sendCommand(LCD_CMD_SET_DDRAM_ADDR | address);
+    frame_col = (uint8_t)x;
+    frame_row = (uint8_t)y;
 }
 
 /**
@@ -162,6 +650,7 @@ void LCD_setCursor(char x, char y) {
  */
 void LCD_cursorOn(void) {
     LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | 0x04 | 0x02);
+    lcd_commit();
 }
 
 /**
@@ -170,6 +659,7 @@ void LCD_cursorOn(void) {
  */
 void LCD_blinkOn(void) {
     LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | 0x04 | 0x01);
+    lcd_commit();
 }
 
 /**
@@ -177,6 +667,7 @@ void LCD_blinkOn(void) {
  */
 void LCD_clearDisplay(void) {
     LCD_sendCommand(0x08 | 0x04 | 0x00);
+    lcd_commit();
 }
 
 /**
@@ -187,5 +678,6 @@ void LCD_clearDisplay(void) {
  */
 void LCD_setDisplaySettings(LCD_Display_Settings settings) {
     LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | (settings & 0x07));
+    lcd_commit();
 }
 
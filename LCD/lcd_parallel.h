@@ -7,6 +7,24 @@ extern "C" {
 
 #include "lcd_config.h"
 #include "stm32f4xx.h"
+#include <stdint.h>
+
+/*
+ * Drawing functions (LCD_Clear, LCD_Put, LCD_Write, LCD_setCursor) only
+ * update a framebuffer in RAM. LCD_Flush() sends the characters that
+ * changed since the last flush. With LCD_USE_ASYNC the flush only queues
+ * the bytes; a timer interrupt sends them in the background. With
+ * LCD_BUS_I2C the same API drives a PCF8574 backpack and each flush goes
+ * out as one DMA transfer.
+ */
+
+/* Transmit queue statistics */
+typedef struct {
+    uint16_t depth;         /*!< Bytes currently queued. */
+    uint16_t max_depth;     /*!< Highest depth seen. */
+    uint32_t bytes_sent;    /*!< Bytes clocked out by the sequencer. */
+    uint32_t full_waits;    /*!< Times a writer had to wait for room. */
+} LCD_QueueStats_t;
 
 #define LCD_CMD_CLEAR_DISPLAY       0x01
 #define LCD_CMD_RETURN_HOME         0x02
@@ -48,31 +66,58 @@ typedef enum {
 } LCD_Display_Settings;
 
 /**
- * @brief Initializes the LCD in 4-bit mode.
+ * @brief Initializes the LCD in 4-bit (or 8-bit, with LCD8Bit) mode.
  */
 void LCD_Init(void);
 
 /**
- * @brief Sends a command to the LCD.
- * @param cmd Command to send.
+ * @brief Clears the framebuffer.
  */
 void LCD_Clear(void);
 
 /**
- * @brief Sends a command to the LCD.
+ * @brief Draws a character at the current position.
  */
 void LCD_Put(char c);
 
 /**
- * @brief Writes a string to the LCD.
+ * @brief Draws a string at the current position.
  */
 void LCD_Write(char *str);
 
 /**
- * @brief Sets the cursor position on the LCD.
+ * @brief Sets the drawing position.
  */
 void LCD_setCursor(char x, char y);
 
+/**
+ * @brief Sends the changed characters to the LCD.
+ * @return Number of bus transfers sent (0 if nothing changed).
+ */
+uint32_t LCD_Flush(void);
+
+/**
+ * @brief Forces a full redraw on the next flush.
+ */
+void LCD_Invalidate(void);
+
+/**
+ * @brief Uploads a 5x8 custom character into a CGRAM slot.
+ * @param slot CGRAM slot (0-7).
+ * @param bitmap 8 rows, top first, bit 4 is the leftmost pixel.
+ */
+void LCD_LoadGlyph(uint8_t slot, const uint8_t *bitmap);
+
+/**
+ * @brief Waits until every queued byte has been sent.
+ */
+void LCD_Drain(void);
+
+/**
+ * @brief Returns the transmit queue statistics.
+ */
+void LCD_GetQueueStats(LCD_QueueStats_t *stats);
+
 /**
  * @brief Turns the LCD cursor display on.
  */
@@ -0,0 +1,79 @@
+#include "lcd_screen.h"
+#include "lcd_parallel.h"
+#include "format.h"
+
+/**
+ * @brief Formats one field into a row buffer.
+ * @param line Row buffer of LCD_COLS characters.
+ * @param field Field to format.
+ */
+static void render_field(char *line, const LCD_Field_t *field) {
+    char *dst = line + field->col;
+    char *end = line + LCD_COLS;
+    uint8_t width = field->width;
+
+    /* Clip to the row */
+    if (field->col >= LCD_COLS) {
+        return;
+    }
+    if (width > LCD_COLS - field->col) {
+        width = LCD_COLS - field->col;
+    }
+
+    if (field->format == LCD_FIELD_TEXT) {
+        const char *text = field->get.text();
+        Format_Str(dst, end, text ? text : "", width);
+        return;
+    }
+
+    uint32_t value = field->get.number();
+    if (value == LCD_FIELD_NONE) {
+        Format_Str(dst, end, "", width);
+        return;
+    }
+    switch (field->format) {
+    case LCD_FIELD_FIXED:
+        Format_Fixed(dst, end, (int32_t)value, field->decimals, width);
+        break;
+    case LCD_FIELD_BAR:
+        LCD_FormatBar(dst, value, width);
+        break;
+    case LCD_FIELD_TIME: {
+        /* Up to 1193046:28:15 */
+        char time[13];
+        char *time_end = Format_Time(time, time + sizeof time, value);
+        uint8_t len = (uint8_t)(time_end - time);
+        /* Right-align, keep the seconds if the field is too short */
+        for (uint8_t i = 0; i < width; i++) {
+            dst[width - 1U - i] = (i < len) ? time_end[-1 - (int)i] : ' ';
+        }
+        break;
+    }
+    default:
+        Format_Uint(dst, end, value, width, ' ');
+        break;
+    }
+}
+
+/**
+ * @brief Draws a screen into the LCD framebuffer.
+ * @param screen Template to render.
+ */
+void LCD_RenderScreen(const LCD_Screen_t *screen) {
+    char line[LCD_COLS + 1];
+
+    if (screen->glyphs) {
+        LCD_UseGlyphSet(screen->glyphs);
+    }
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        Format_Str(line, line + LCD_COLS, screen->rows[row] ? screen->rows[row] : "", LCD_COLS);
+        for (uint8_t i = 0; i < screen->field_count; i++) {
+            if (screen->fields[i].row == row) {
+                render_field(line, &screen->fields[i]);
+            }
+        }
+        line[LCD_COLS] = '\0';
+        LCD_setCursor(0, row);
+        LCD_Write(line);
+    }
+}
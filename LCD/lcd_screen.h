@@ -0,0 +1,58 @@
+#ifndef _LCD_SCREEN_H_
+#define _LCD_SCREEN_H_
+
+#include "lcd_config.h"
+#include "lcd_glyph.h"
+#include <stdint.h>
+
+/**
+ * @brief Declarative screen templates.
+ * A screen is a fixed text per row plus a list of fields. Rendering fills
+ * each row with its text, formats the fields into place and draws the rows
+ * into the LCD framebuffer; LCD_Flush() then sends only what changed, so a
+ * screen can be re-rendered as often as its values may change. Custom
+ * characters the screen uses are made resident in CGRAM before drawing.
+ */
+
+/* Field formats */
+#define LCD_FIELD_TEXT      0U  /* get.text(), left-aligned */
+#define LCD_FIELD_UINT      1U  /* get.number(), right-aligned */
+#define LCD_FIELD_FIXED     2U  /* get.number() in 10^-decimals units, right-aligned */
+#define LCD_FIELD_TIME      3U  /* get.number() in seconds as MM:SS */
+#define LCD_FIELD_BAR       4U  /* get.number() in per mille as a bar graph (needs LCD_GlyphBar) */
+
+/* Returned by a number getter to leave the field blank */
+#define LCD_FIELD_NONE      0xFFFFFFFFU
+
+/**
+ * @brief A value placed on the screen.
+ */
+typedef struct {
+    uint8_t col;        /*!< First column. */
+    uint8_t row;        /*!< Row. */
+    uint8_t width;      /*!< Field width in characters. */
+    uint8_t format;     /*!< LCD_FIELD_* format. */
+    uint8_t decimals;   /*!< Digits after the point (LCD_FIELD_FIXED). */
+    union {
+        uint32_t (*number)(void);       /*!< Numeric value source. */
+        const char *(*text)(void);      /*!< Text source (NULL result = blank). */
+    } get;
+} LCD_Field_t;
+
+/**
+ * @brief Screen template.
+ */
+typedef struct {
+    const char        *rows[LCD_ROWS];  /*!< Fixed text of each row (NULL = blank). */
+    const LCD_Field_t *fields;          /*!< Fields drawn over the text. */
+    uint8_t           field_count;      /*!< Number of fields. */
+    const LCD_GlyphSet_t *glyphs;       /*!< Custom characters used (NULL = none). */
+} LCD_Screen_t;
+
+/**
+ * @brief Draws a screen into the LCD framebuffer.
+ * @param screen Template to render.
+ */
+void LCD_RenderScreen(const LCD_Screen_t *screen);
+
+#endif /* _LCD_SCREEN_H_ */
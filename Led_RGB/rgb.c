@@ -1,113 +1,152 @@
 #include "rgb.h"
-
-/* Pin and GPIO definitions for the RGB LED */
-#define RED_PIN     8       /* PA8  - TIM1_CH1 */
-#define GREEN_PIN   9       /* PA9  - TIM1_CH2 */
-#define BLUE_PIN    10      /* PA10 - TIM1_CH3 */
-#define RGB_GPIO    GPIOA
+#include "rgb_gamma.h"
+#include "profiler.h"
+#include "pwm_timer.h"
 
 /* PWM configuration constants */
-#define PWM_TARGET_HZ   1000U     /* Target PWM frequency: ~1 kHz */
-#define PWM_ARR         999U      /* Auto-reload register value for 1 kHz at a specific timer clock */
+#define PWM_TARGET_HZ   1000U     /* PWM frequency: 1 kHz */
+#define PWM_ARR         RGB_GAMMA_ARR /* 10-bit duty: 1024 steps, set by the gamma table */
+
+/* TIM1_UP request: DMA2 stream 5, channel 6 */
+#define RGB_DMA_STREAM  DMA2_Stream5
+#define RGB_DMA_CHANNEL 6
+#define RGB_DMA_IFCR    DMA2->HIFCR
+#define RGB_DMA_FLAGS   (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 \
+        | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+/* DMA burst: 3 transfers from CCR1 (register offset 0x34 = word 13) */
+#define RGB_BURST_BASE  13U
+#define RGB_BURST_LEN   3U
+
+/* Compare values of CCR1-CCR3 for each frame; one table plays while the other is rendered */
+static uint16_t rgb_frames[2][RGB_MAX_FRAMES][RGB_BURST_LEN];
+static uint8_t rgb_idle = 0;
+/* Effect shown, for skipping redundant updates */
+static RGB_Effect_t rgb_current;
+static uint8_t rgb_started = 0;
+/* Set once TIM1 and the DMA are set up: effects are ignored until then */
+static uint8_t rgb_ready = 0;
+
+/**
+ * @brief Converts a color to the compare values of CCR1-CCR3.
+ * @param frame Destination (3 values).
+ * @param c The 8-bit color.
+ */
+static inline void rgb_toFrame(uint16_t *frame, RGB_Color_t c) {
+    frame[0] = rgb_gamma[c.r];
+    frame[1] = rgb_gamma[c.g];
+    frame[2] = rgb_gamma[c.b];
+}
+
+/**
+ * @brief Interpolates between two colors in perceptual (pre-gamma) space.
+ * @param pos 0 = a, 255 = b.
+ */
+static RGB_Color_t rgb_mix(RGB_Color_t a, RGB_Color_t b, uint8_t pos) {
+    RGB_Color_t c;
+    c.r = (uint8_t)(a.r + ((int32_t)(b.r - a.r) * pos) / 255);
+    c.g = (uint8_t)(a.g + ((int32_t)(b.g - a.g) * pos) / 255);
+    c.b = (uint8_t)(a.b + ((int32_t)(b.b - a.b) * pos) / 255);
+    return c;
+}
 
 /**
- * @brief Simple software delay function.
- * @param ms The number of milliseconds to delay.
- * @note This is a blocking delay and its accuracy depends on the system clock.
+ * @brief Stops the frame DMA at a frame boundary; CCR1-CCR3 keep the last frame.
  */
-static inline void delay_ms(volatile uint32_t ms) {
-    while (ms--) for (volatile uint32_t i=0; i<14000; ++i) __NOP(); /* Loop calibrated for ~1ms at 84MHz */
+static void rgb_stop(void) {
+    if (RGB_DMA_STREAM->CR & DMA_SxCR_EN) {
+        /* A burst takes a few bus cycles after the update event */
+        while (RGB_DMA_STREAM->NDTR % RGB_BURST_LEN) {
+        }
+    }
+    TIM1->DIER &= ~TIM_DIER_UDE;
+    RGB_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+    while (RGB_DMA_STREAM->CR & DMA_SxCR_EN) {
+    }
 }
 
 /**
- * @brief Computes the timer prescaler value.
- * @param timclk_hz The timer's input clock frequency in Hz.
- * @param fpwm_hz The desired PWM frequency in Hz.
- * @param arr The auto-reload register value.
- * @return The calculated prescaler value (PSC register value).
+ * @brief Plays frames from the update event DMA.
+ * @param frames Frame table.
+ * @param count Number of frames.
+ * @param repeat PWM periods per frame (1..256).
+ * @param loop 1 to restart at the first frame, 0 to stop on the last one.
  */
-static uint16_t compute_psc(uint32_t timclk_hz, uint32_t fpwm_hz, uint32_t arr) {
-    /* Formula: PSC = (timclk_hz / (fpwm_hz * (arr + 1))) - 1 */
-    uint32_t denom = fpwm_hz * (arr + 1U);
-    if (!denom) denom = 1U; /* Avoid division by zero */
-    uint32_t psc = (timclk_hz + denom - 1U) / denom; /* Calculate with ceiling division */
-    if (psc == 0) psc = 1;
-    return (uint16_t)(psc - 1U);
+static void rgb_play(uint16_t (*frames)[RGB_BURST_LEN], uint16_t count, uint16_t repeat, uint8_t loop) {
+    rgb_stop();
+    TIM1->RCR = repeat - 1U; /* Loaded at the next update event */
+    TIM1->DCR = (RGB_BURST_BASE << TIM_DCR_DBA_Pos) | ((RGB_BURST_LEN - 1U) << TIM_DCR_DBL_Pos);
+
+    /* Memory to peripheral, half-words, one burst per request */
+    RGB_DMA_IFCR = RGB_DMA_FLAGS;
+    RGB_DMA_STREAM->M0AR = (uint32_t)frames;
+    RGB_DMA_STREAM->NDTR = (uint32_t)count * RGB_BURST_LEN;
+    RGB_DMA_STREAM->CR = ((uint32_t)RGB_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos)
+            | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_DIR_0
+            | (loop ? DMA_SxCR_CIRC : 0U);
+    RGB_DMA_STREAM->CR |= DMA_SxCR_EN;
+    TIM1->DIER |= TIM_DIER_UDE;
 }
 
 /**
- * @brief Scales an 8-bit color value (0-255) to the timer's ARR range (0-PWM_ARR).
- * @param v The 8-bit color value.
- * @return The scaled value for the CCR register.
+ * @brief Renders an animated effect into a frame table.
+ * @param effect Blink, pulse or fade.
+ * @param frames Destination, RGB_MAX_FRAMES frames.
+ * @param repeat Receives the PWM periods per frame.
+ * @return Number of frames.
  */
-static inline uint16_t scale8_to_arr(uint8_t v) {
-    /* Maps 0..255 -> 0..PWM_ARR with rounding */
-    uint32_t x = (uint32_t)v * (uint32_t)PWM_ARR + 127U;
-    return (uint16_t)(x / 255U);
+static uint16_t rgb_render(const RGB_Effect_t *effect, uint16_t (*frames)[RGB_BURST_LEN], uint16_t *repeat) {
+    uint32_t periods = (uint32_t)effect->period_ms * PWM_TARGET_HZ / 1000U;
+    uint32_t per_frame = (periods + RGB_MAX_FRAMES - 1U) / RGB_MAX_FRAMES;
+    if (per_frame == 0) per_frame = 1;
+    if (per_frame > 256U) per_frame = 256U; /* 8-bit repetition counter */
+    uint32_t count = periods / per_frame;
+    if (count < 2U) count = 2U;
+    if (count > RGB_MAX_FRAMES) count = RGB_MAX_FRAMES;
+    uint32_t half = count / 2U;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t pos;
+        switch (effect->type) {
+        case RGB_EFFECT_BLINK:
+            pos = (i * 100U < (uint32_t)effect->duty * count) ? 255U : 0U;
+            break;
+        case RGB_EFFECT_PULSE:
+            pos = (i < half) ? (uint8_t)(i * 255U / half) : (uint8_t)((count - i) * 255U / (count - half));
+            break;
+        default: /* RGB_EFFECT_FADE */
+            pos = (uint8_t)(i * 255U / (count - 1U));
+            break;
+        }
+        rgb_toFrame(frames[i], rgb_mix(effect->color2, effect->color, pos));
+    }
+    *repeat = (uint16_t)per_frame;
+    return (uint16_t)count;
 }
 
 /**
- * @brief Initializes GPIO and TIM1 for RGB LED PWM control.
+ * @brief Initializes TIM1 and its update DMA for RGB LED PWM control.
  */
 void RGB_Init(void) {
-    /* Enable clocks for GPIOA and TIM1 */
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
-    RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
-
-    /* Configure pins PA8, PA9, PA10 as Alternate Function */
-    RGB_GPIO->MODER &= ~((3U << (RED_PIN * 2)) | (3U << (GREEN_PIN * 2))
-            | (3U << (BLUE_PIN * 2))); /* Clear mode bits */
-    RGB_GPIO->MODER |= ((2U << (RED_PIN * 2)) | (2U << (GREEN_PIN * 2))
-            | (2U << (BLUE_PIN * 2))); /* Set to Alternate Function mode */
-    /* Select AF1 (TIM1) for the pins */
-    RGB_GPIO->AFR[1] &= ~((0xFU << ((RED_PIN - 8) * 4))
-            | (0xFU << ((GREEN_PIN - 8) * 4)) | (0xFU << ((BLUE_PIN - 8) * 4)));
-    RGB_GPIO->AFR[1] |= ((1U << ((RED_PIN - 8) * 4))
-            | (1U << ((GREEN_PIN - 8) * 4)) | (1U << ((BLUE_PIN - 8) * 4)));
-
-    /* Configure pin output speed to medium */
-    RGB_GPIO->OSPEEDR &= ~((3U << (RED_PIN * 2)) | (3U << (GREEN_PIN * 2))
-            | (3U << (BLUE_PIN * 2)));
-    RGB_GPIO->OSPEEDR |= ((2U << (RED_PIN * 2)) | (2U << (GREEN_PIN * 2))
-            | (2U << (BLUE_PIN * 2)));
-
-    /* Configure TIM1 for PWM generation */
-    uint32_t timclk_hz = 168000000U; /* APB2 Timer Clock is 168 MHz for F411 */
-    TIM1->PSC = compute_psc(timclk_hz, PWM_TARGET_HZ, PWM_ARR);
-    TIM1->ARR = PWM_ARR;
-
-    /* Reset duty cycles (Capture/Compare Registers) */
-    TIM1->CCR1 = 0; /* Red channel */
-    TIM1->CCR2 = 0; /* Green channel */
-    TIM1->CCR3 = 0; /* Blue channel */
-
-    /* Configure PWM mode 1 and enable preload for all channels */
-    /* CH1/CH2 are in CCMR1, CH3/CH4 are in CCMR2 */
-
-    /* Channel 1 (Red) */
-    TIM1->CCMR1 &= ~TIM_CCMR1_OC1M;
-    TIM1->CCMR1 |= (6U << TIM_CCMR1_OC1M_Pos); /* 110: PWM mode 1 */
-    TIM1->CCMR1 |= TIM_CCMR1_OC1PE; /* Enable preload */
-    /* Channel 2 (Green) */
-    TIM1->CCMR1 &= ~TIM_CCMR1_OC2M;
-    TIM1->CCMR1 |= (6U << TIM_CCMR1_OC2M_Pos);
-    TIM1->CCMR1 |= TIM_CCMR1_OC2PE;
-    /* Channel 3 (Blue) */
-    TIM1->CCMR2 &= ~TIM_CCMR2_OC3M;
-    TIM1->CCMR2 |= (6U << TIM_CCMR2_OC3M_Pos);
-    TIM1->CCMR2 |= TIM_CCMR2_OC3PE;
-
-    /* Set output polarity to active high and enable channels */
-    TIM1->CCER &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P | TIM_CCER_CC3P); /* Active high */
-    TIM1->CCER |= (TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC3E); /* Enable outputs */
-
-    /* Advanced timers like TIM1 require the Main Output Enable (MOE) bit to be set. */
-    TIM1->BDTR |= TIM_BDTR_MOE;
-
-    /* Enable Auto-Reload Preload, generate an update event to load registers, and enable the counter. */
-    TIM1->CR1 |= TIM_CR1_ARPE;
-    TIM1->EGR |= TIM_EGR_UG;
-    TIM1->CR1 |= TIM_CR1_CEN;
+    static const char *const owners[RGB_BURST_LEN] = { "rgb red", "rgb green", "rgb blue" };
+
+    /* The pins come from the board pin table, the TIM1 clock from the timer service */
+
+    /* PWM mode 1, active high, duty 0; the prescaler follows the real APB2 timer clock */
+    for (uint8_t ch = 1; ch <= RGB_BURST_LEN; ch++) {
+        if (PwmTimer_Open(TIM1, ch, PWM_TARGET_HZ, PWM_ARR + 1U, owners[ch - 1U]) != PWM_TIMER_OK) {
+            /* TIM1 is not ours: release what was opened and leave the DMA alone */
+            while (--ch >= 1U) {
+                PwmTimer_Close(TIM1, ch);
+            }
+            return;
+        }
+    }
+
+    /* Update event DMA writes into TIM1->DMAR (the burst) */
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+    RGB_DMA_STREAM->CR = 0;
+    RGB_DMA_STREAM->PAR = (uint32_t)&TIM1->DMAR;
+    rgb_ready = 1;
 }
 
 /**
@@ -117,7 +156,52 @@ void RGB_Init(void) {
  * @param b Blue component (0-255).
  */
 void RGB_SetColor(uint8_t r, uint8_t g, uint8_t b) {
-    TIM1->CCR1 = scale8_to_arr(r); /* Set Red duty cycle */
-    TIM1->CCR2 = scale8_to_arr(g); /* Set Green duty cycle */
-    TIM1->CCR3 = scale8_to_arr(b); /* Set Blue duty cycle */
+    RGB_Effect_t effect = { .type = RGB_EFFECT_SOLID, .color = { r, g, b } };
+    RGB_SetEffect(&effect);
+}
+
+/**
+ * @brief Returns 1 if two effects look the same (unused fields ignored).
+ */
+static uint8_t rgb_sameEffect(const RGB_Effect_t *a, const RGB_Effect_t *b) {
+    if (a->type != b->type || a->color.r != b->color.r || a->color.g != b->color.g
+            || a->color.b != b->color.b) {
+        return 0;
+    }
+    if (a->type == RGB_EFFECT_SOLID) {
+        return 1;
+    }
+    return a->color2.r == b->color2.r && a->color2.g == b->color2.g && a->color2.b == b->color2.b
+            && a->period_ms == b->period_ms && (a->type != RGB_EFFECT_BLINK || a->duty == b->duty);
+}
+
+/**
+ * @brief Starts an effect. A solid color is written to CCR1-CCR3 directly
+ * (preloaded, so it changes at the next PWM period); the other effects are
+ * rendered into the idle frame table and played by DMA.
+ * @param effect Effect to show; does nothing if it is already running, or
+ * if RGB_Init() could not open TIM1.
+ */
+void RGB_SetEffect(const RGB_Effect_t *effect) {
+    if (!rgb_ready || (rgb_started && rgb_sameEffect(effect, &rgb_current))) {
+        return;
+    }
+    PROF_SCOPE(PROF_ZONE_RGB_SET);
+    rgb_current = *effect;
+    rgb_started = 1;
+
+    if (effect->type == RGB_EFFECT_SOLID) {
+        uint16_t frame[RGB_BURST_LEN];
+        rgb_toFrame(frame, effect->color);
+        rgb_stop();
+        TIM1->CCR1 = frame[0]; /* Set Red duty cycle */
+        TIM1->CCR2 = frame[1]; /* Set Green duty cycle */
+        TIM1->CCR3 = frame[2]; /* Set Blue duty cycle */
+        return;
+    }
+
+    uint16_t repeat;
+    uint16_t count = rgb_render(effect, rgb_frames[rgb_idle], &repeat);
+    rgb_play(rgb_frames[rgb_idle], count, repeat, effect->type != RGB_EFFECT_FADE);
+    rgb_idle ^= 1U;
 }
@@ -3,7 +3,49 @@
 
 #include "stm32f4xx.h"
 
-/* @brief Initializes GPIO pins and Timer for RGB LED PWM control. */
+/*
+ * Status light on TIM1 CH1-CH3. Levels are 8-bit perceptual values mapped
+ * through a gamma table (rgb_gamma.h) to 10-bit compare values. Animated
+ * effects are rendered once into a frame table; DMA then writes one frame
+ * into CCR1-CCR3 on each TIM1 update event (a DMA burst through DMAR), so
+ * they play without the CPU. The repetition counter sets how many PWM
+ * periods each frame lasts.
+ */
+
+/* Pins on port A (the board pin table sets them up) */
+#define RED_PIN     8       /* PA8  - TIM1_CH1 */
+#define GREEN_PIN   9       /* PA9  - TIM1_CH2 */
+#define BLUE_PIN    10      /* PA10 - TIM1_CH3 */
+
+/* Most frames in an effect; longer effects hold each frame for more periods */
+#ifndef RGB_MAX_FRAMES
+#define RGB_MAX_FRAMES  128U
+#endif
+
+/* 8-bit color */
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} RGB_Color_t;
+
+typedef enum {
+    RGB_EFFECT_SOLID = 0,   /* color */
+    RGB_EFFECT_BLINK,       /* color for duty % of the period, then color2 */
+    RGB_EFFECT_PULSE,       /* color2 to color and back over the period */
+    RGB_EFFECT_FADE,        /* color2 to color once over the period, then color */
+} RGB_EffectType_t;
+
+typedef struct {
+    RGB_EffectType_t type;
+    RGB_Color_t color;      /*!< Main color. */
+    RGB_Color_t color2;     /*!< Off color of a blink, low color of a pulse, start of a fade. */
+    uint16_t period_ms;     /*!< Blink or pulse period, fade duration. */
+    uint8_t duty;           /*!< Blink on time in % of the period. */
+} RGB_Effect_t;
+
+/* @brief Initializes the Timer for RGB LED PWM control (pins: Board_PinsInit).
+ * If a TIM1 channel cannot be opened the LED stays off and effects are ignored. */
 void RGB_Init(void);
 
 /* @brief Sets the color of the RGB LED.
@@ -13,4 +55,7 @@ void RGB_Init(void);
  */
 void RGB_SetColor(uint8_t r, uint8_t g, uint8_t b);
 
+/* @brief Starts an effect; does nothing if it is the one already running or TIM1 is not set up. */
+void RGB_SetEffect(const RGB_Effect_t *effect);
+
 #endif /* INC_RGB_H_ */
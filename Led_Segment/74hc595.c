@@ -1,12 +1,235 @@
 #include "74hc595.h"
+#include "profiler.h"
+#include "format.h"
+#include "soft_timer.h"
+#include "clock.h"
+#include "pwm_timer.h"
+#include "console.h"
+#include "uart.h"
+#include "pin.h"
+#include <string.h>
 
-/* Segment patterns for digits 0-9 for a common cathode 7-segment display. */
-/* (Segments are mapped as: g, f, e, d, c, b, a) */
-static const uint8_t seg_cc[10] = {
-    0x3F, /* 0 */ 0x06, /* 1 */ 0x5B, /* 2 */ 0x4F, /* 3 */ 0x66, /* 4 */
-    0x6D, /* 5 */ 0x7D, /* 6 */ 0x07, /* 7 */ 0x7F, /* 8 */ 0x6F  /* 9 */
+/* Segment font for ASCII 0x20-0x5F (lowercase letters use the uppercase
+   glyph). Bits: a = 0x01, b = 0x02 ... g = 0x40, dp = 0x80. */
+static const uint8_t hc595_font[64] = {
+    /* ' '   '!'   '"'   '#'   '$'   '%'   '&'   '\'' */
+    0x00, 0x86, 0x22, 0x00, 0x6D, 0x00, 0x00, 0x20,
+    /* '('   ')'   '*'   '+'   ','   '-'   '.'   '/'  (* = degree sign) */
+    0x39, 0x0F, 0x63, 0x00, 0x80, 0x40, 0x80, 0x52,
+    /* '0'   '1'   '2'   '3'   '4'   '5'   '6'   '7' */
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,
+    /* '8'   '9'   ':'   ';'   '<'   '='   '>'   '?' */
+    0x7F, 0x6F, 0x00, 0x00, 0x58, 0x48, 0x4C, 0x53,
+    /* '@'   'A'   'B'   'C'   'D'   'E'   'F'   'G' */
+    0x7B, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71, 0x3D,
+    /* 'H'   'I'   'J'   'K'   'L'   'M'   'N'   'O' */
+    0x76, 0x30, 0x1E, 0x75, 0x38, 0x15, 0x54, 0x3F,
+    /* 'P'   'Q'   'R'   'S'   'T'   'U'   'V'   'W' */
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x1C, 0x2A,
+    /* 'X'   'Y'   'Z'   '['   '\\'  ']'   '^'   '_' */
+    0x76, 0x6E, 0x5B, 0x39, 0x64, 0x0F, 0x23, 0x08,
 };
 
+/* Segments lit in each register or multiplexed digit (bit set = on) */
+static uint8_t hc595_frame[HC595_FRAME_SIZE];
+/* 0xFF for registers driving common-anode displays (outputs active low) */
+static uint8_t hc595_invert[HC595_FRAME_SIZE];
+/* Set when the frame changed since the last flush */
+static uint8_t hc595_dirty = 0;
+/* Current brightness, 0..255 */
+static uint8_t hc595_brightness = 255;
+
+/* Brightness schedule followed by HC595_AutoBrightness() */
+static const HC595_BrightnessStep_t *hc595_schedule = NULL;
+static uint8_t hc595_schedule_len = 0;
+static SoftTimer_t hc595_schedule_timer;
+
+#if HC595_MUX_DIGITS
+/* Select and segment bytes of each digit in shift order. Flush fills the
+   idle copy, the refresh interrupt reads the active one. */
+static uint8_t hc595_scan[2][HC595_MUX_DIGITS][2];
+static volatile uint8_t hc595_scan_active = 0;
+/* Digit shifted in and waiting for the next latch */
+static uint8_t hc595_mux_digit = 0;
+static HC595_MuxStats_t hc595_mux_stats;
+#else
+/* Shift-order bytes of the burst being sent (padded up to the benchmark length) */
+#if PROFILE_ENABLE && HC595_BENCH_MAX > HC595_CHAIN_LENGTH
+#define HC595_TX_SIZE   HC595_BENCH_MAX
+#else
+#define HC595_TX_SIZE   HC595_CHAIN_LENGTH
+#endif
+static uint8_t hc595_tx[HC595_TX_SIZE];
+#endif
+
+#if HC595_USE_SPI
+#if !HC595_MUX_DIGITS
+/* Set from the start of a transfer until the frame is latched */
+static volatile uint8_t hc595_busy = 0;
+#endif
+
+/**
+ * @brief STCP pulse (>= 20 ns high): copies the shift registers to the outputs.
+ */
+static inline void hc595_latchPulse(void) {
+    Pin_High(GPIOB, LOAD_PIN);
+    __NOP();
+    __NOP();
+    __NOP();
+    __NOP();
+    Pin_Low(GPIOB, LOAD_PIN);
+}
+
+/**
+ * @brief Initializes SPI1 and its TX DMA stream.
+ * SCK, MOSI and LOAD (output, low) come from the board pin table.
+ */
+static void hc595_busInit(void) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+    RCC->APB2ENR |= RCC_APB2ENR_SPI1EN;
+
+    /* Transmit-only master, mode 0 (the 74HC595 shifts on SCK rising), MSB first */
+    HC595_SPI->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | (HC595_SPI_BR << SPI_CR1_BR_Pos);
+    HC595_SPI->CR2 = SPI_CR2_TXDMAEN;
+    HC595_SPI->CR1 |= SPI_CR1_SPE;
+
+#if HC595_MUX_DIGITS
+    /* Memory to peripheral, byte by byte; the refresh interrupt latches
+       each digit one period later, so no completion interrupt */
+    HC595_DMA_STREAM->CR = 0;
+    HC595_DMA_STREAM->CR = ((uint32_t)HC595_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos)
+            | DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+    HC595_DMA_STREAM->PAR = (uint32_t)&HC595_SPI->DR;
+#else
+    /* Memory to peripheral, byte by byte, interrupt when the last byte is in the SPI */
+    HC595_DMA_STREAM->CR = 0;
+    HC595_DMA_STREAM->CR = ((uint32_t)HC595_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos)
+            | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+    HC595_DMA_STREAM->PAR = (uint32_t)&HC595_SPI->DR;
+    NVIC_EnableIRQ(HC595_DMA_IRQn);
+#endif
+}
+
+#if HC595_MUX_DIGITS
+/**
+ * @brief Sets the refresh timer prescaler for 1 us ticks (also after a clock change).
+ */
+static void hc595_muxReclock(void) {
+    HC595_MUX_TIMER->PSC = PwmTimer_Clock(HC595_MUX_TIMER) / 1000000U - 1U;
+}
+
+/**
+ * @brief Starts the refresh timer: one interrupt per digit,
+ * HC595_MUX_DIGITS * HC595_MUX_REFRESH_HZ per second.
+ */
+static void hc595_muxInit(void) {
+    PwmTimer_Reserve(HC595_MUX_TIMER, "hc595 mux", hc595_muxReclock);
+    HC595_MUX_TIMER->CR1 = 0;
+    hc595_muxReclock();
+    HC595_MUX_TIMER->ARR = 1000000U / (HC595_MUX_DIGITS * HC595_MUX_REFRESH_HZ) - 1U;
+    HC595_MUX_TIMER->EGR = TIM_EGR_UG;
+    HC595_MUX_TIMER->SR = 0;
+    HC595_MUX_TIMER->DIER = TIM_DIER_UIE;
+    NVIC_EnableIRQ(HC595_MUX_TIMER_IRQn);
+    HC595_MUX_TIMER->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Refresh interrupt: latches the digit shifted in during the previous
+ * period, then starts shifting the next one. Segments and select lines
+ * change in the same latch, so there is no ghosting and no busy-wait; the
+ * run time is a fixed handful of register writes, checked against
+ * HC595_MUX_BUDGET_CYCLES.
+ */
+void TIM1_BRK_TIM9_IRQHandler(void) {
+    uint32_t start = DWT->CYCCNT;
+
+    HC595_MUX_TIMER->SR = ~TIM_SR_UIF;
+    hc595_latchPulse();
+
+    hc595_mux_digit = (hc595_mux_digit + 1U < HC595_MUX_DIGITS) ? hc595_mux_digit + 1U : 0U;
+    HC595_DMA_IFCR = HC595_DMA_FLAGS;
+    HC595_DMA_STREAM->M0AR = (uint32_t)hc595_scan[hc595_scan_active][hc595_mux_digit];
+    HC595_DMA_STREAM->NDTR = 2;
+    HC595_DMA_STREAM->CR |= DMA_SxCR_EN;
+
+    uint32_t cycles = DWT->CYCCNT - start;
+    hc595_mux_stats.ticks++;
+    if (cycles > hc595_mux_stats.max_cycles) {
+        hc595_mux_stats.max_cycles = cycles;
+    }
+    if (cycles > HC595_MUX_BUDGET_CYCLES) {
+        hc595_mux_stats.overruns++;
+    }
+    PROF_RECORD_SINCE(PROF_ZONE_HC595_MUX, start);
+}
+#else
+/**
+ * @brief Sets the latch timer to count PCLK2 cycles, the SPI clock source
+ * (also after a clock change).
+ */
+static void hc595_latchReclock(void) {
+    uint32_t ppre2 = (RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos;
+    uint32_t pclk2 = SystemCoreClock >> APBPrescTable[ppre2];
+
+    HC595_LATCH_TIMER->PSC = PwmTimer_Clock(HC595_LATCH_TIMER) / pclk2 - 1U;
+}
+
+/**
+ * @brief Sets up the latch timer: one pulse, started by the DMA interrupt,
+ * as long as the two bytes the SPI may still hold (16 SCK periods).
+ */
+static void hc595_latchInit(void) {
+    PwmTimer_Reserve(HC595_LATCH_TIMER, "hc595 latch", hc595_latchReclock);
+    HC595_LATCH_TIMER->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+    hc595_latchReclock();
+    HC595_LATCH_TIMER->ARR = (16U << (HC595_SPI_BR + 1U)) - 1U;
+    HC595_LATCH_TIMER->EGR = TIM_EGR_UG;
+    HC595_LATCH_TIMER->SR = 0;
+    HC595_LATCH_TIMER->DIER = TIM_DIER_UIE;
+    NVIC_EnableIRQ(HC595_LATCH_TIMER_IRQn);
+}
+
+/**
+ * @brief DMA transfer complete: the last bytes are still shifting, so the
+ * latch timer is started rather than waiting for the SPI here.
+ */
+void DMA2_Stream3_IRQHandler(void) {
+    HC595_DMA_IFCR = HC595_DMA_FLAGS;
+    HC595_LATCH_TIMER->CR1 |= TIM_CR1_CEN;
+}
+
+/**
+ * @brief Latch timer pulse over: the burst has left the SPI, latch the frame.
+ */
+void TIM1_BRK_TIM9_IRQHandler(void) {
+    HC595_LATCH_TIMER->SR = ~TIM_SR_UIF;
+    hc595_latchPulse();
+    hc595_busy = 0;
+}
+
+/**
+ * @brief Waits until the previous burst is latched (a few microseconds at most).
+ */
+static void hc595_wait(void) {
+    while (hc595_busy) {
+        __WFI();
+    }
+}
+
+/**
+ * @brief Starts the DMA transfer of hc595_tx; the interrupt latches it.
+ * @param length Number of bytes.
+ */
+static void hc595_start(uint8_t length) {
+    hc595_busy = 1;
+    HC595_DMA_IFCR = HC595_DMA_FLAGS;
+    HC595_DMA_STREAM->M0AR = (uint32_t)hc595_tx;
+    HC595_DMA_STREAM->NDTR = length;
+    HC595_DMA_STREAM->CR |= DMA_SxCR_EN;
+}
+#endif /* HC595_MUX_DIGITS */
+#else
 /**
  * @brief A short, blocking delay.
  * @param t The number of iterations to loop.
@@ -14,16 +237,9 @@ static const uint8_t seg_cc[10] = {
 static inline void delay_short(volatile uint32_t t) { while(t--) __NOP(); }
 
 /**
- * @brief Initializes the GPIO pins used to control the 74HC595 shift register.
+ * @brief Nothing to set up: SDI, SCLK and LOAD are outputs, low, from the board pin table.
  */
-void HC595_Init(void) {
-    /* Enable GPIOB clock */
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
-    /* Configure SDI, SCLK, and LOAD pins as general purpose output */
-    GPIOB->MODER &= ~((3U<<(SDI_PIN*2))|(3U<<(SCLK_PIN*2))|(3U<<(LOAD_PIN*2)));
-    GPIOB->MODER |=  ((1U<<(SDI_PIN*2))|(1U<<(SCLK_PIN*2))|(1U<<(LOAD_PIN*2)));
-    /* Initialize pin states to low */
-    GPIOB->ODR &= ~((1U<<SDI_PIN)|(1U<<SCLK_PIN)|(1U<<LOAD_PIN));
+static void hc595_busInit(void) {
 }
 
 /**
@@ -31,13 +247,12 @@ void HC595_Init(void) {
  * @param b The bit to send (1 or 0).
  */
 static void sendBit(uint8_t b) {
-    /* Set SDI pin high or low based on the bit value */
-    if (b) GPIOB->ODR |=  (1U << SDI_PIN);
-    else   GPIOB->ODR &= ~(1U << SDI_PIN);
+    /* Set SDI pin high or low based on the bit value (BSRR: port B is shared with the LCD interrupt) */
+    Pin_Write(GPIOB, SDI_PIN, b != 0);
     /* Pulse the clock (SCLK) to shift the bit in */
-    GPIOB->ODR |=  (1U << SCLK_PIN);
+    Pin_High(GPIOB, SCLK_PIN);
     delay_short(20);
-    GPIOB->ODR &= ~(1U << SCLK_PIN);
+    Pin_Low(GPIOB, SCLK_PIN);
 }
 
 /**
@@ -57,59 +272,372 @@ void HC595_SendByte(uint8_t data) {
  */
 void HC595_Latch(void) {
     /* Pulse the load/latch pin (LOAD) to make the sent data appear on the outputs */
-    GPIOB->ODR |=  (1U << LOAD_PIN);
+    Pin_High(GPIOB, LOAD_PIN);
     delay_short(40);
-    GPIOB->ODR &= ~(1U << LOAD_PIN);
+    Pin_Low(GPIOB, LOAD_PIN);
 }
 
 /**
- * @brief Encodes a single digit (0-9) into its 7-segment pattern.
- * @param d The digit to encode.
- * @return The corresponding 7-segment code.
+ * @brief Bit-banged bursts are complete when hc595_start() returns.
  */
-static uint8_t encodeDigit(uint8_t d) {
-    uint8_t code = seg_cc[d % 10];
-#if LED_TYPE == COMMON_ANODE
-    /* Invert the code for common anode displays */
-    code = ~code;
+static void hc595_wait(void) {
+}
+
+/**
+ * @brief Shifts hc595_tx out bit by bit and latches it.
+ * @param length Number of bytes.
+ */
+static void hc595_start(uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        HC595_SendByte(hc595_tx[i]);
+    }
+    HC595_Latch();
+}
 #endif
-    return code;
+
+#if HC595_USE_OE_PWM
+/**
+ * @brief Sets up the brightness PWM on OE: 256 steps at HC595_OE_PWM_HZ.
+ * OE is active low, so the output polarity is inverted and the compare
+ * value is the on time.
+ */
+static void hc595_oeInit(void) {
+    /* OE is an alternate function pin with a pull-up (board pin table): the
+       outputs stay off until the timer runs */
+    /* 255 steps: a compare value of 255 keeps OE low for the whole period */
+    if (PwmTimer_Open(HC595_OE_TIMER, HC595_OE_CHANNEL, HC595_OE_PWM_HZ, 255U, "hc595 oe")
+            == PWM_TIMER_OK) {
+        HC595_OE_TIMER->CCER |= TIM_CCER_CC1P << ((HC595_OE_CHANNEL - 1U) * 4U);
+        PwmTimer_Write(HC595_OE_TIMER, HC595_OE_CHANNEL, hc595_brightness);
+    }
 }
+#endif
 
 /**
- * @brief Displays a number up to 3 digits on the 7-segment displays.
- * @param num The number to display (0-999).
+ * @brief Sets the brightness of all outputs.
+ * @param level 0 = off, 255 = full (PWM duty on OE, applied at the next period).
  */
-void HC595_DisplayNumber(uint16_t num) {
-    if (num > 999) num = 999;
-    /* Extract hundreds, tens, and ones digits */
-    uint8_t h = (num/100)%10;
-    uint8_t t = (num/10)%10;
-    uint8_t o = num%10;
+void HC595_SetBrightness(uint8_t level) {
+    hc595_brightness = level;
+#if HC595_USE_OE_PWM
+    PwmTimer_Write(HC595_OE_TIMER, HC595_OE_CHANNEL, level);
+#endif
+}
+
+/**
+ * @brief Applies the schedule step in effect at the current time of day.
+ * Before the first step of the day the last one (from the evening before) applies.
+ */
+static void hc595_applySchedule(void *arg) {
+    uint16_t minute = Clock_MinuteOfDay();
+    uint8_t level = hc595_schedule[hc595_schedule_len - 1U].level;
 
-    /* Define the blank pattern based on the LED type */
-#if LED_TYPE == COMMON_CATHODE
-    uint8_t blank = 0x00; /* All segments off */
+    for (uint8_t i = 0; i < hc595_schedule_len; i++) {
+        if (hc595_schedule[i].minute <= minute) {
+            level = hc595_schedule[i].level;
+        }
+    }
+    if (level != hc595_brightness) {
+        HC595_SetBrightness(level);
+    }
+}
+
+/**
+ * @brief Follows a brightness schedule by time of day, checked every minute.
+ * @param steps Steps sorted by minute; must stay valid (typically a static const table).
+ * @param count Number of steps, 0 to stop following the schedule.
+ */
+void HC595_AutoBrightness(const HC595_BrightnessStep_t *steps, uint8_t count) {
+    SoftTimer_Stop(&hc595_schedule_timer);
+    hc595_schedule = steps;
+    hc595_schedule_len = count;
+    if (count) {
+        hc595_applySchedule(NULL);
+        SoftTimer_Start(&hc595_schedule_timer, 60000U, 60000U);
+    }
+}
+
+/**
+ * @brief Returns the refresh interrupt measurements.
+ */
+void HC595_GetMuxStats(HC595_MuxStats_t *stats) {
+#if HC595_MUX_DIGITS
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = hc595_mux_stats;
+    __set_PRIMASK(primask);
 #else
-    uint8_t blank = 0xFF; /* All segments off (inverted) */
+    memset(stats, 0, sizeof(*stats));
 #endif
+}
 
-    /* Encode digits, blanking leading zeros */
-    uint8_t bH = (num>=100) ? encodeDigit(h) : blank;
-    uint8_t bT = (num>=10) ? encodeDigit(t) : blank;
-    uint8_t bO = encodeDigit(o);
+#if HC595_MUX_DIGITS
+/**
+ * @brief Encodes the frame into the idle scan table and makes it the active one.
+ * Each entry is the select byte (shifted first, it ends up in register 1)
+ * then the segment byte.
+ */
+static void hc595_encode(void) {
+    uint8_t idle = hc595_scan_active ^ 1U;
 
-    /* Send the encoded bytes to the shift registers in the correct order */
-#if ORDER_321 /* Order for digits: Hundreds, Tens, Ones */
-    HC595_SendByte(bO);
-    HC595_SendByte(bT);
-    HC595_SendByte(bH);
-#else /* Order for digits: Ones, Tens, Hundreds */
-    HC595_SendByte(bH);
-    HC595_SendByte(bT);
-    HC595_SendByte(bO);
+    for (uint8_t d = 0; d < HC595_MUX_DIGITS; d++) {
+        uint8_t select = (uint8_t)(1U << d);
+        hc595_scan[idle][d][0] = HC595_MUX_SELECT_ACTIVE_LOW ? (uint8_t)~select : select;
+        hc595_scan[idle][d][1] = hc595_frame[d] ^ hc595_invert[d];
+    }
+    hc595_scan_active = idle;
+}
+#else
+/**
+ * @brief Encodes the frame into wire polarity and shift order (last register first).
+ * @param dst HC595_CHAIN_LENGTH bytes.
+ */
+static void hc595_encode(uint8_t *dst) {
+    for (uint8_t i = 0; i < HC595_CHAIN_LENGTH; i++) {
+        uint8_t reg = HC595_CHAIN_LENGTH - 1U - i;
+        dst[i] = hc595_frame[reg] ^ hc595_invert[reg];
+    }
+}
 #endif
 
-    /* Latch the data to display it */
-    HC595_Latch();
+#if PROFILE_ENABLE && !HC595_MUX_DIGITS
+/**
+ * @brief Times a flush of the frame as if the chain had length registers.
+ * Longer chains than the real one are emulated by shifting padding ahead
+ * of the frame: it falls off the end of the chain, so the display is not
+ * disturbed.
+ * @param length Registers, HC595_CHAIN_LENGTH to HC595_BENCH_MAX.
+ * @param cpu Cycles until the CPU is free again.
+ * @param total Cycles until the frame is latched.
+ * @return 1 if timed, 0 if length is out of range.
+ */
+uint8_t HC595_Bench(uint8_t length, uint32_t *cpu, uint32_t *total) {
+    if (length < HC595_CHAIN_LENGTH || length > HC595_BENCH_MAX) {
+        return 0;
+    }
+    hc595_wait();
+
+    uint32_t start = Prof_Now();
+    memset(hc595_tx, 0, length - HC595_CHAIN_LENGTH);
+    hc595_encode(hc595_tx + length - HC595_CHAIN_LENGTH);
+    hc595_start(length);
+    *cpu = Prof_Now() - start;
+#if HC595_USE_SPI
+    /* Spin rather than sleep: the cycle counter stops in WFI */
+    do {
+        *total = Prof_Now() - start;
+    } while (hc595_busy);
+#else
+    *total = *cpu;
+#endif
+    return 1;
+}
+
+/**
+ * @brief Console command: "hc595 bench" times a flush for chains of 3, 8
+ * and HC595_BENCH_MAX registers (those not shorter than the real one).
+ */
+static void hc595_bench(void) {
+    static const uint8_t lengths[] = { 3, 8, HC595_BENCH_MAX };
+    char line[48];
+    char *end = line + sizeof line - 1U;
+    char *p;
+    uint32_t cpu, total;
+
+    UART_Write("regs      cpu    total  (cycles)\r\n");
+    for (uint8_t k = 0; k < sizeof(lengths); k++) {
+        if (!HC595_Bench(lengths[k], &cpu, &total)) {
+            continue;
+        }
+        p = Format_Uint(line, end, lengths[k], 4, ' ');
+        p = Format_Uint(p, end, cpu, 9, ' ');
+        p = Format_Uint(p, end, total, 9, ' ');
+        p = Format_Str(p, end, "\r\n", 0);
+        *p = '\0';
+        UART_Write(line);
+    }
+}
+#endif
+
+/**
+ * @brief Console command: "hc595" prints the brightness and the refresh
+ * interrupt measurements; "hc595 bench" (PROFILE_ENABLE, static chain) times flushes.
+ */
+static void hc595_command(const char *args) {
+    /* Longest line: the refresh stats, 54 + 3 + 4 x 10 digits + NUL; a longer one ends in '#' */
+    char line[112];
+    char *end = line + sizeof line - 1U;
+    char *p;
+
+#if PROFILE_ENABLE && !HC595_MUX_DIGITS
+    if (strcmp(args, "bench") == 0) {
+        hc595_bench();
+        return;
+    }
+#endif
+    if (*args) {
+        UART_Write("usage: hc595\r\n");
+        return;
+    }
+    p = Format_Str(line, end, "brightness ", 0);
+    p = Format_Uint(p, end, hc595_brightness, 0, ' ');
+#if HC595_MUX_DIGITS
+    HC595_MuxStats_t stats;
+    HC595_GetMuxStats(&stats);
+    p = Format_Str(p, end, ", refresh ", 0);
+    p = Format_Uint(p, end, stats.ticks, 0, ' ');
+    p = Format_Str(p, end, " ticks, max ", 0);
+    p = Format_Uint(p, end, stats.max_cycles, 0, ' ');
+    p = Format_Str(p, end, "/", 0);
+    p = Format_Uint(p, end, HC595_MUX_BUDGET_CYCLES, 0, ' ');
+    p = Format_Str(p, end, " cycles, overruns ", 0);
+    p = Format_Uint(p, end, stats.overruns, 0, ' ');
+#endif
+    p = Format_Str(p, end, "\r\n", 0);
+    *p = '\0';
+    UART_Write(line);
+}
+
+/**
+ * @brief Initializes the chain: pins (and SPI/DMA, refresh or latch timer,
+ * brightness PWM), then a blank frame sent on the first flush.
+ */
+void HC595_Init(void) {
+    memset(hc595_frame, 0, sizeof(hc595_frame));
+    memset(hc595_invert, (LED_TYPE == COMMON_ANODE) ? 0xFF : 0x00, sizeof(hc595_invert));
+    hc595_dirty = 1;
+    hc595_busInit();
+#if HC595_MUX_DIGITS
+    hc595_encode();
+    hc595_muxInit();
+#elif HC595_USE_SPI
+    hc595_latchInit();
+#endif
+#if HC595_USE_OE_PWM
+    hc595_oeInit();
+#endif
+    SoftTimer_Init(&hc595_schedule_timer, hc595_applySchedule, NULL);
+    Console_Register("hc595", hc595_command);
+}
+
+/**
+ * @brief Sets the bits of one register.
+ * @param reg Register (0 = the one wired to the MCU), or digit when multiplexed.
+ * @param bits Segments/LEDs to light.
+ */
+void HC595_SetRaw(uint8_t reg, uint8_t bits) {
+    if (reg < HC595_FRAME_SIZE && hc595_frame[reg] != bits) {
+        hc595_frame[reg] = bits;
+        hc595_dirty = 1;
+    }
+}
+
+/**
+ * @brief Returns the register holding a digit of a display.
+ * @param display Display.
+ * @param digit Digit position, 0 = leftmost.
+ */
+static uint8_t hc595_digitReg(const HC595_Display_t *display, uint8_t digit) {
+    return display->reversed ? (uint8_t)(display->first + display->count - 1U - digit)
+                             : (uint8_t)(display->first + digit);
+}
+
+/**
+ * @brief Sets the polarity of the registers of a display and blanks it.
+ * @param display Display to claim the registers for.
+ */
+void HC595_AddDisplay(const HC595_Display_t *display) {
+    for (uint8_t i = 0; i < display->count; i++) {
+        uint8_t reg = display->first + i;
+        if (reg < HC595_FRAME_SIZE) {
+            hc595_invert[reg] = (display->type == COMMON_ANODE) ? 0xFF : 0x00;
+            hc595_frame[reg] = 0;
+        }
+    }
+    hc595_dirty = 1;
+}
+
+/**
+ * @brief Returns the segments of a character.
+ * @param c Character.
+ * @return Segment bits, 0 for characters without a glyph.
+ */
+uint8_t HC595_Font(char c) {
+    uint8_t code = (uint8_t)c;
+    if (code >= 0x60U && code < 0x80U) {
+        code -= 0x20U; /* Lowercase */
+    }
+    return (code >= 0x20U && code < 0x60U) ? hc595_font[code - 0x20U] : 0x00;
+}
+
+/**
+ * @brief Draws text left-aligned on a display, blanking the remaining digits.
+ * @param display Display.
+ * @param text Text; a '.' lights the point of the digit before it.
+ */
+void HC595_PutText(const HC595_Display_t *display, const char *text) {
+    uint8_t digit = 0;
+    uint8_t dotted = 1; /* A leading '.' takes a digit of its own */
+
+    for (; *text; text++) {
+        if (*text == '.' && !dotted) {
+            uint8_t reg = hc595_digitReg(display, digit - 1U);
+            HC595_SetRaw(reg, hc595_frame[reg] | HC595_SEG_DP);
+            dotted = 1;
+            continue;
+        }
+        if (digit >= display->count) {
+            break;
+        }
+        HC595_SetRaw(hc595_digitReg(display, digit++), HC595_Font(*text));
+        dotted = (*text == '.');
+    }
+    while (digit < display->count) {
+        HC595_SetRaw(hc595_digitReg(display, digit++), 0);
+    }
+}
+
+/**
+ * @brief Draws a number right-aligned on a display with leading zeros blanked.
+ * @param display Display.
+ * @param num Value, clamped to the largest number the digits can show.
+ */
+void HC595_PutNumber(const HC595_Display_t *display, uint32_t num) {
+    char text[HC595_FRAME_SIZE + 1];
+    uint8_t width = (display->count < HC595_FRAME_SIZE) ? display->count : HC595_FRAME_SIZE;
+    uint32_t max = 0;
+
+    for (uint8_t i = 0; i < width; i++) {
+        if (max > 429496728U) {
+            max = 0xFFFFFFFFU;
+            break;
+        }
+        max = max * 10U + 9U;
+    }
+    if (num > max) {
+        num = max;
+    }
+    *Format_Uint(text, text + sizeof text - 1U, num, width, ' ') = '\0';
+    HC595_PutText(display, text);
+}
+
+/**
+ * @brief Shifts the whole chain out in one burst and latches it, if the frame
+ * changed. With multiplexing, hands the frame to the refresh interrupt instead.
+ * @return 1 if the frame was sent, 0 if it was unchanged.
+ */
+uint8_t HC595_Flush(void) {
+    if (!hc595_dirty) {
+        return 0;
+    }
+    PROF_SCOPE(PROF_ZONE_HC595_DISPLAY);
+    hc595_dirty = 0;
+#if HC595_MUX_DIGITS
+    hc595_encode();
+#else
+    hc595_wait();
+    hc595_encode(hc595_tx);
+    hc595_start(HC595_CHAIN_LENGTH);
+#endif
+    return 1;
 }
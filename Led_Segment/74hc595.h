@@ -3,29 +3,179 @@
 
 #include "stm32f4xx.h"
 
-/* Pin definitions for 74HC595 connection on GPIOB */
-#define SDI_PIN   4  /* Serial Data In (DS) */
-#define SCLK_PIN  5  /* Shift Register Clock (SHCP) */
+/*
+ * The chain is modelled as a framebuffer of one byte per register.
+ * Register 0 is the one whose DS input is wired to the MCU; the first
+ * byte shifted out ends up in the last register. Drawing functions only
+ * update the framebuffer (bit set = segment/LED on); HC595_Flush() shifts
+ * the whole chain out in one burst and latches it, and does nothing when
+ * the frame has not changed.
+ *
+ * With HC595_MUX_DIGITS set, the chain is two registers instead: register
+ * 0 drives the segments shared by all digits and register 1 the digit
+ * select lines. The framebuffer then holds one byte per digit and a timer
+ * interrupt scans them; HC595_Flush() only hands the new frame to it.
+ */
+
+/* Transport: 0 = bit-banged GPIO on the pins below (the board as built),
+   1 = SPI1 with DMA (a whole frame in one transfer, latched by a TIM9 pulse
+   started from the DMA interrupt). SPI needs the chain rewired: DS to PB5 (SPI1_MOSI, the
+   bit-banged SCLK pin) and SHCP to PA5 (SPI1_SCK); LOAD stays on PB6. */
+#ifndef HC595_USE_SPI
+#define HC595_USE_SPI 0
+#endif
+
+/* Number of registers in the chain */
+#ifndef HC595_CHAIN_LENGTH
+#define HC595_CHAIN_LENGTH 3
+#endif
+
+/* Multiplexed digits (2..8), 0 = one register per digit */
+#ifndef HC595_MUX_DIGITS
+#define HC595_MUX_DIGITS 0
+#endif
+
+/* Brightness: 0 = OE tied low (the board as built), 1 = PWM on the OE pin.
+   Needs HC595_USE_SPI and a rewired chain: OE from TIM3_CH1 on PB4, which
+   is then no longer the bit-banged data pin. */
+#ifndef HC595_USE_OE_PWM
+#define HC595_USE_OE_PWM 0
+#endif
+
+/* Bytes in the framebuffer: one per register, or one per multiplexed digit */
+#if HC595_MUX_DIGITS
+#define HC595_FRAME_SIZE    HC595_MUX_DIGITS
+#else
+#define HC595_FRAME_SIZE    HC595_CHAIN_LENGTH
+#endif
+
+#if HC595_MUX_DIGITS && !HC595_USE_SPI
+#error "HC595_MUX_DIGITS needs HC595_USE_SPI: the refresh interrupt cannot bit-bang a digit"
+#endif
+#if HC595_MUX_DIGITS > 8
+#error "HC595_MUX_DIGITS: the select register has 8 outputs"
+#endif
+#if HC595_USE_OE_PWM && !HC595_USE_SPI
+#error "HC595_USE_OE_PWM needs HC595_USE_SPI: PB4 is the bit-banged data pin"
+#endif
+
+/* Pin definitions for 74HC595 connection on GPIOB (configured by the board pin table) */
+#define SDI_PIN   4  /* Serial Data In (DS), bit-banged only */
+#define SCLK_PIN  5  /* Shift Register Clock (SHCP), bit-banged only */
 #define LOAD_PIN  6  /* Storage Register Clock / Latch (STCP) */
 
+/* SPI wiring: DS on SPI1_MOSI (PB5), SHCP on SPI1_SCK (PA5), STCP on LOAD_PIN */
+#define HC595_SPI           SPI1
+#define HC595_SPI_AF        5
+#define HC595_MOSI_PIN      5   /* Port B */
+#define HC595_SCK_PIN       5   /* Port A */
+#define HC595_SPI_BR        3U  /* fPCLK2 / 16 = 5.25 MHz */
+/* SPI1_TX: DMA2 stream 3, channel 3 (74hc595.c names the handler) */
+#define HC595_DMA_STREAM    DMA2_Stream3
+#define HC595_DMA_CHANNEL   3
+#define HC595_DMA_IRQn      DMA2_Stream3_IRQn
+#define HC595_DMA_IFCR      DMA2->LIFCR
+#define HC595_DMA_FLAGS     (DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 \
+        | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+
+/* Multiplexed refresh: TIM9 update interrupt, one digit per period */
+#define HC595_MUX_REFRESH_HZ        125U    /* Full frames per second */
+#define HC595_MUX_TIMER             TIM9
+#define HC595_MUX_TIMER_IRQn        TIM1_BRK_TIM9_IRQn  /* Handler named in 74hc595.c */
+#define HC595_MUX_SELECT_ACTIVE_LOW 0       /* 1 if a low select output turns a digit on */
+/* Cycles the refresh interrupt may take; longer runs count as overruns */
+#define HC595_MUX_BUDGET_CYCLES     200U
+
+/* Static chain over SPI: TIM9 in one-pulse mode latches the burst once its
+   last bytes have left the SPI (the multiplexed refresh has TIM9 otherwise) */
+#define HC595_LATCH_TIMER           TIM9
+#define HC595_LATCH_TIMER_IRQn      TIM1_BRK_TIM9_IRQn  /* Handler named in 74hc595.c */
+
+/* Brightness PWM on OE (active low, so the duty is inverted in the timer) */
+#define HC595_OE_TIMER              TIM3
+#define HC595_OE_CHANNEL            1U
+#define HC595_OE_PIN                4U      /* Port B */
+#define HC595_OE_AF                 2U
+#define HC595_OE_PWM_HZ             20000U  /* Above audible and camera flicker */
+
+/* Longest chain HC595_Bench() and the "hc595 bench" console command time (PROFILE_ENABLE) */
+#define HC595_BENCH_MAX     32
+
 /* 7-segment display type configuration */
 #define COMMON_CATHODE  0
 #define COMMON_ANODE    1
-#define LED_TYPE COMMON_ANODE /* Set the type of 7-segment display used */
+#define LED_TYPE COMMON_ANODE /* Polarity of registers not claimed by a display */
 
-/* Order in which digits are shifted out. Set to 1 if the first byte sent corresponds to the 'ones' digit. */
-#define ORDER_321 1
+/* Segment bits of a register */
+#define HC595_SEG_A     0x01U
+#define HC595_SEG_B     0x02U
+#define HC595_SEG_C     0x04U
+#define HC595_SEG_D     0x08U
+#define HC595_SEG_E     0x10U
+#define HC595_SEG_F     0x20U
+#define HC595_SEG_G     0x40U
+#define HC595_SEG_DP    0x80U
 
-/* @brief Initializes GPIO pins for controlling the 74HC595. */
+/* A group of registers showing one value: a multi-digit counter, a lane or floor indicator... */
+typedef struct {
+    uint8_t first;      /*!< First register of the display. */
+    uint8_t count;      /*!< Number of registers (digits). */
+    uint8_t type;       /*!< COMMON_CATHODE or COMMON_ANODE. */
+    uint8_t reversed;   /*!< 1 if the leftmost digit is the last register instead of the first. */
+} HC595_Display_t;
+
+/* Brightness from a time of day on, until the next step */
+typedef struct {
+    uint16_t minute;    /*!< Minutes since midnight. */
+    uint8_t  level;     /*!< Brightness, 0 = off, 255 = full. */
+} HC595_BrightnessStep_t;
+
+/* Refresh interrupt measurements (cycles exclude interrupt entry and exit) */
+typedef struct {
+    uint32_t ticks;         /*!< Interrupts handled. */
+    uint32_t max_cycles;    /*!< Longest run. */
+    uint32_t overruns;      /*!< Runs over HC595_MUX_BUDGET_CYCLES. */
+} HC595_MuxStats_t;
+
+/* @brief Initializes the pins (and SPI/DMA) used to control the 74HC595 chain. */
 void HC595_Init(void);
 
+#if !HC595_USE_SPI
 /* @brief Sends one byte of data to the shift register. */
 void HC595_SendByte(uint8_t data);
 
 /* @brief Latches the data from the shift register to the output pins. */
 void HC595_Latch(void);
+#endif
+
+/* @brief Sets the polarity of the registers of a display and blanks it. */
+void HC595_AddDisplay(const HC595_Display_t *display);
+
+/* @brief Returns the segments of a character (digits, letters, a few symbols; 0 if none). */
+uint8_t HC595_Font(char c);
+
+/* @brief Sets the bits of one register (bit set = on). */
+void HC595_SetRaw(uint8_t reg, uint8_t bits);
+
+/* @brief Draws text left-aligned on a display; '.' lights the point of the previous digit. */
+void HC595_PutText(const HC595_Display_t *display, const char *text);
+
+/* @brief Draws a number right-aligned on a display, clamped to the digits available. */
+void HC595_PutNumber(const HC595_Display_t *display, uint32_t num);
+
+/* @brief Shifts the frame out and latches it if it changed. Returns 1 if it was sent. */
+uint8_t HC595_Flush(void);
+
+/* @brief Sets the brightness of all outputs (0 = off, 255 = full). */
+void HC595_SetBrightness(uint8_t level);
+
+/* @brief Follows a brightness schedule by time of day (steps sorted by minute). */
+void HC595_AutoBrightness(const HC595_BrightnessStep_t *steps, uint8_t count);
+
+/* @brief Returns the refresh interrupt measurements (all zero without multiplexing). */
+void HC595_GetMuxStats(HC595_MuxStats_t *stats);
 
-/* @brief Displays a number (0-999) on the 7-segment displays. */
-void HC595_DisplayNumber(uint16_t num);
+/* @brief Times a flush as if the chain had length registers (PROFILE_ENABLE, static chain). */
+uint8_t HC595_Bench(uint8_t length, uint32_t *cpu, uint32_t *total);
 
 #endif /* INC_74HC595_H_ */
@@ -0,0 +1,166 @@
+#include "profiler.h"
+
+#if PROFILE_ENABLE
+
+#include "console.h"
+#include "uart.h"
+#include "format.h"
+#include <string.h>
+
+/* Statistics of one zone */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint16_t buckets[PROF_BUCKETS]; /* Saturating counts */
+} Prof_Stats_t;
+
+static Prof_Stats_t zones[PROF_ZONE_COUNT];
+
+static const char *const zone_names[PROF_ZONE_COUNT] = {
+    "rc522_request",
+    "lcd_flush",
+    "lcd_byte",
+    "hc595_display",
+    "hc595_mux",
+    "screen",
+    "rgb_set",
+    "card_to_decision",
+};
+
+/**
+ * @brief Maps a cycle count to its histogram bucket.
+ */
+static uint32_t bucket_index(uint32_t cycles) {
+    if (cycles < PROF_EXACT_BUCKETS) {
+        return cycles;
+    }
+    uint32_t msb = 31U - (uint32_t)__builtin_clz(cycles);
+    uint32_t sub = (cycles >> (msb - PROF_SUB_BITS)) & ((1U << PROF_SUB_BITS) - 1U);
+    return PROF_EXACT_BUCKETS + ((msb - 3U) << PROF_SUB_BITS) + sub;
+}
+
+/**
+ * @brief Returns the largest cycle count that falls into a bucket.
+ */
+static uint32_t bucket_upper(uint32_t index) {
+    if (index < PROF_EXACT_BUCKETS) {
+        return index;
+    }
+    uint32_t msb = 3U + ((index - PROF_EXACT_BUCKETS) >> PROF_SUB_BITS);
+    uint32_t sub = (index - PROF_EXACT_BUCKETS) & ((1U << PROF_SUB_BITS) - 1U);
+    uint32_t width = 1UL << (msb - PROF_SUB_BITS);
+    return ((1UL << msb) + sub * width) + (width - 1U);
+}
+
+/**
+ * @brief Returns the value below which a share of the samples fall.
+ * @param stats Zone statistics.
+ * @param permille Percentile in 1/1000 (500 = median).
+ */
+static uint32_t percentile(const Prof_Stats_t *stats, uint32_t permille) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+        total += stats->buckets[i];
+    }
+    /* Rank of the wanted sample, rounded up */
+    uint32_t rank = (uint32_t)(((uint64_t)total * permille + 999U) / 1000U);
+    uint32_t seen = 0;
+
+    for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= rank && seen) {
+            uint32_t upper = bucket_upper(i);
+            return (upper < stats->max) ? upper : stats->max;
+        }
+    }
+    return stats->max;
+}
+
+/**
+ * @brief Console command: "prof" prints the zones, "prof reset" clears them.
+ */
+static void prof_command(const char *args) {
+    if (strcmp(args, "reset") == 0) {
+        Prof_Reset();
+        UART_Write("prof: reset\r\n");
+    } else {
+        Prof_Dump();
+    }
+}
+
+/**
+ * @brief Starts the cycle counter and registers the "prof" console command.
+ */
+void Prof_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    Prof_Reset();
+    Console_Register("prof", prof_command);
+}
+
+/**
+ * @brief Adds one measurement to a zone.
+ * @param zone Zone to record into.
+ * @param cycles Duration in CPU cycles.
+ */
+void Prof_Record(Prof_Zone_t zone, uint32_t cycles) {
+    Prof_Stats_t *stats = &zones[zone];
+    uint16_t *bucket = &stats->buckets[bucket_index(cycles)];
+
+    if (cycles < stats->min) stats->min = cycles;
+    if (cycles > stats->max) stats->max = cycles;
+    if (*bucket != 0xFFFFU) (*bucket)++;
+    stats->count++;
+}
+
+/**
+ * @brief Clears all zones.
+ */
+void Prof_Reset(void) {
+    memset(zones, 0, sizeof(zones));
+    for (uint32_t i = 0; i < PROF_ZONE_COUNT; i++) {
+        zones[i].min = 0xFFFFFFFFU;
+    }
+}
+
+/**
+ * @brief Prints min/p50/p99/max of every zone on the service UART.
+ * @note  Values are CPU cycles; percentiles are bucket upper bounds.
+ */
+void Prof_Dump(void) {
+    /* Longest line: the header, 71 + 10 digits + 7 + NUL; a longer one ends in '#' */
+    char line[96];
+    char *end = line + sizeof line - 1U;
+    char *p;
+
+    p = Format_Str(line, end, "zone              count      min      p50      p99      max  (cycles @ ", 0);
+    p = Format_Uint(p, end, SystemCoreClock / 1000000U, 0, ' ');
+    p = Format_Str(p, end, " MHz)\r\n", 0);
+    *p = '\0';
+    UART_Write(line);
+
+    for (uint32_t i = 0; i < PROF_ZONE_COUNT; i++) {
+        const Prof_Stats_t *stats = &zones[i];
+        p = Format_Str(line, end, zone_names[i], 16);
+        p = Format_Str(p, end, " ", 0);
+        p = Format_Uint(p, end, stats->count, 6, ' ');
+        if (!stats->count) {
+            p = Format_Str(p, end, "        -        -        -        -", 0);
+        } else {
+            uint32_t values[4] = { stats->min, percentile(stats, 500U),
+                                   percentile(stats, 990U), stats->max };
+            for (uint32_t v = 0; v < 4; v++) {
+                p = Format_Str(p, end, " ", 0);
+                p = Format_Uint(p, end, values[v], 8, ' ');
+            }
+        }
+        p = Format_Str(p, end, "\r\n", 0);
+        *p = '\0';
+        UART_Write(line);
+    }
+}
+
+#endif /* PROFILE_ENABLE */
@@ -0,0 +1,92 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/**
+ * @brief Cycle-accurate hot-path profiler.
+ * Scoped zones read the DWT cycle counter on entry and exit and add the
+ * duration to a per-zone log-linear histogram (4 sub-buckets per power of
+ * two, so every percentile is within 25% of the true value). The console
+ * command "prof" prints min/p50/p99/max per zone, "prof reset" clears them.
+ * Build with -DPROFILE_ENABLE=1 to enable; otherwise every macro compiles
+ * to nothing and the DWT is left untouched.
+ */
+
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE  0
+#endif
+
+/* Profiled zones */
+typedef enum {
+    PROF_ZONE_RC522_REQUEST = 0,    /* MFRC522_Request() */
+    PROF_ZONE_LCD_FLUSH,            /* LCD_Flush() */
+    PROF_ZONE_LCD_BYTE,             /* One LCD instruction or character, including the wait */
+    PROF_ZONE_HC595_DISPLAY,        /* HC595_Flush() when the frame changed */
+    PROF_ZONE_HC595_MUX,            /* 7-segment refresh interrupt (HC595_MUX_DIGITS) */
+    PROF_ZONE_SCREEN,               /* Status screen render (formatting into the framebuffer) */
+    PROF_ZONE_RGB_SET,              /* RGB_SetColor() */
+    PROF_ZONE_CARD_TO_DECISION,     /* Card read until the gate decision is shown */
+    PROF_ZONE_COUNT
+} Prof_Zone_t;
+
+/* Histogram geometry: 8 exact buckets, then 4 per power of two up to 2^32 */
+#define PROF_EXACT_BUCKETS      8U
+#define PROF_SUB_BITS           2U
+#define PROF_BUCKETS            (PROF_EXACT_BUCKETS + (32U - 3U) * (1U << PROF_SUB_BITS))
+
+#if PROFILE_ENABLE
+
+/* Scope guard placed by PROF_SCOPE */
+typedef struct {
+    Prof_Zone_t zone;
+    uint32_t    start;
+} Prof_Scope_t;
+
+/**
+ * @brief Starts the cycle counter and registers the "prof" console command.
+ */
+void Prof_Init(void);
+
+/**
+ * @brief Adds one measurement to a zone.
+ * @param zone Zone to record into.
+ * @param cycles Duration in CPU cycles.
+ */
+void Prof_Record(Prof_Zone_t zone, uint32_t cycles);
+
+/* @brief Clears all zones. */
+void Prof_Reset(void);
+
+/* @brief Prints min/p50/p99/max of every zone on the service UART. */
+void Prof_Dump(void);
+
+/* @brief Returns the current cycle count (start of a manual measurement). */
+static inline uint32_t Prof_Now(void) {
+    return DWT->CYCCNT;
+}
+
+static inline void prof_scope_end(Prof_Scope_t *scope) {
+    Prof_Record(scope->zone, DWT->CYCCNT - scope->start);
+}
+
+/* @brief Measures from this point to the end of the enclosing block. */
+#define PROF_SCOPE(zone) \
+    Prof_Scope_t prof_scope_ __attribute__((cleanup(prof_scope_end))) = { (zone), DWT->CYCCNT }
+
+/* @brief Records the time elapsed since a Prof_Now() reading. */
+#define PROF_RECORD_SINCE(zone, start)  Prof_Record((zone), DWT->CYCCNT - (start))
+
+#else
+
+#define Prof_Init()                     ((void)0)
+#define Prof_Reset()                    ((void)0)
+#define Prof_Dump()                     ((void)0)
+#define Prof_Now()                      (0U)
+#define PROF_SCOPE(zone)                do { } while (0)
+#define PROF_RECORD_SINCE(zone, start)  ((void)(start))
+
+#endif /* PROFILE_ENABLE */
+
+#endif /* PROFILER_H_ */
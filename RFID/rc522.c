@@ -1,4 +1,8 @@
 #include <rc522.h>
+#include "delay.h"
+#include "gpio.h"
+#include "profiler.h"
+#include "trace.h"
 
 /*---------- PRIVATE FUNCTION PROTOTYPES ----------*/
 static void MFRC522_GPIO_Init(void);
@@ -9,60 +13,44 @@ static uint8_t Read_MFRC522(uint8_t addr);
 static void SetBitMask(uint8_t reg, uint8_t mask);
 static void ClearBitMask(uint8_t reg, uint8_t mask);
 static void AntennaOn(void);
-static void AntennaOff(void);
 static void CalulateCRC(uint8_t *pIndata, uint8_t len, uint8_t *pOutData);
 static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLen, uint8_t *backData, uint16_t *backLen);
 
 
 /*---------- GPIO CONTROL MACROS ----------*/
 /* Macro to pull the Chip Select (CS) pin low. */
-#define CS_LOW()      (MFRC522_CS_PORT->BSRR = (1U << (MFRC522_CS_PIN + 16)))
+#define CS_LOW()      Pin_Low(MFRC522_CS_PORT, MFRC522_CS_PIN)
 /* Macro to pull the Chip Select (CS) pin high. */
-#define CS_HIGH()     (MFRC522_CS_PORT->BSRR = (1U << MFRC522_CS_PIN))
+#define CS_HIGH()     Pin_High(MFRC522_CS_PORT, MFRC522_CS_PIN)
 /* Macro to pull the Reset (RST) pin low. */
-#define RST_LOW()     (MFRC522_RST_PORT->BSRR = (1U << (MFRC522_RST_PIN + 16)))
+#define RST_LOW()     Pin_Low(MFRC522_RST_PORT, MFRC522_RST_PIN)
 /* Macro to pull the Reset (RST) pin high. */
-#define RST_HIGH()    (MFRC522_RST_PORT->BSRR = (1U << MFRC522_RST_PIN))
+#define RST_HIGH()    Pin_High(MFRC522_RST_PORT, MFRC522_RST_PIN)
 
+#if MFRC522_USE_IRQ
+/* Set by the EXTI handler when the MFRC522 pulls its IRQ pin low */
+static volatile uint8_t mfrc522_irq_flag = 0;
 
 /**
- * @brief Initializes GPIO pins for MFRC522 SPI communication.
+ * @brief EXTI lines 10-15 interrupt: MFRC522 IRQ pin.
+ */
+void EXTI15_10_IRQHandler(void) {
+    if (EXTI->PR & (1U << MFRC522_IRQ_PIN)) {
+        EXTI->PR = (1U << MFRC522_IRQ_PIN);
+        mfrc522_irq_flag = 1;
+    }
+}
+#endif
+
+/**
+ * @brief Routes the IRQ pin to its EXTI line.
+ * The pins themselves are configured by the board pin table (Board_PinsInit).
  */
 static void MFRC522_GPIO_Init(void) {
-    /* 1. Enable GPIO clocks for ports A and B. */
-    MFRC522_GPIO_RCC_REG |= (MFRC522_GPIOA_RCC_EN | MFRC522_GPIOB_RCC_EN);
-
-    /* 2. Configure SPI pins (SCK, MISO, MOSI) as Alternate Function AF5 for SPI2. */
-
-    /* SCK Pin (PB13) configuration */
-    MFRC522_SCK_PORT->MODER &= ~(0x03 << (MFRC522_SCK_PIN * 2)); /* Clear mode bits */
-    MFRC522_SCK_PORT->MODER |= (0x02 << (MFRC522_SCK_PIN * 2));  /* Set to Alternate Function mode */
-    MFRC522_SCK_PORT->AFR[1] |= (5U << ((MFRC522_SCK_PIN - 8) * 4)); /* Select AF5 */
-
-    /* MISO Pin (PB14) configuration */
-    MFRC522_MISO_PORT->MODER &= ~(0x03 << (MFRC522_MISO_PIN * 2));
-    MFRC522_MISO_PORT->MODER |= (0x02 << (MFRC522_MISO_PIN * 2));
-    MFRC522_MISO_PORT->AFR[1] |= (5U << ((MFRC522_MISO_PIN - 8) * 4));
-
-    /* MOSI Pin (PB15) configuration */
-    MFRC522_MOSI_PORT->MODER &= ~(0x03 << (MFRC522_MOSI_PIN * 2));
-    MFRC522_MOSI_PORT->MODER |= (0x02 << (MFRC522_MOSI_PIN * 2));
-    MFRC522_MOSI_PORT->AFR[1] |= (5U << ((MFRC522_MOSI_PIN - 8) * 4));
-
-    /* Set high speed for all SPI pins */
-    MFRC522_SCK_PORT->OSPEEDR |= (0x03 << (MFRC522_SCK_PIN * 2));
-    MFRC522_MISO_PORT->OSPEEDR |= (0x03 << (MFRC522_MISO_PIN * 2));
-    MFRC522_MOSI_PORT->OSPEEDR |= (0x03 << (MFRC522_MOSI_PIN * 2));
-
-    /* 3. Configure CS pin (PB12) as General Purpose Output. */
-    MFRC522_CS_PORT->MODER &= ~(0x03 << (MFRC522_CS_PIN * 2));
-    MFRC522_CS_PORT->MODER |= (0x01 << (MFRC522_CS_PIN * 2));
-    MFRC522_CS_PORT->OSPEEDR |= (0x03 << (MFRC522_CS_PIN * 2));
-
-    /* 4. Configure RST pin (PB9) as General Purpose Output. */
-    MFRC522_RST_PORT->MODER &= ~(0x03 << (MFRC522_RST_PIN * 2));
-    MFRC522_RST_PORT->MODER |= (0x01 << (MFRC522_RST_PIN * 2));
-    MFRC522_RST_PORT->OSPEEDR |= (0x03 << (MFRC522_RST_PIN * 2));
+#if MFRC522_USE_IRQ
+    /* IRQ pin: input with pull-up, interrupt on falling edge. */
+    GPIO_EnableInterrupt(MFRC522_IRQ_PORT, MFRC522_IRQ_PIN, GPIO_DRIVER_EDGE_FALLING);
+#endif
 }
 
 /**
@@ -164,13 +152,6 @@ static void AntennaOn(void) {
     }
 }
 
-/**
- * @brief Turns the antenna off.
- */
-static void AntennaOff(void) {
-    ClearBitMask(TxControlReg, 0x03);
-}
-
 /**
  * @brief Performs a soft reset of the MFRC522 module.
  */
@@ -220,6 +201,10 @@ static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLe
     uint8_t lastBits;
     uint8_t n;
     uint16_t i;
+    uint64_t deadline;
+    uint8_t timed_out = 0;
+
+    TRACE(TRACE_EVT_RC522_BEGIN, command);
 
     /* Set interrupt enable and wait flags based on the command. */
     switch (command) {
@@ -236,7 +221,13 @@ static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLe
     }
 
     /* Configure communication registers. */
+#if MFRC522_USE_IRQ
+    /* Only the completion, error and timer sources drive the IRQ pin */
+    Write_MFRC522(CommIEnReg, (irqEn & (waitIRq | 0x03)) | 0x80); /* IRqInv: active low */
+    mfrc522_irq_flag = 0;
+#else
     Write_MFRC522(CommIEnReg, irqEn | 0x80); /* Enable IRQ pin */
+#endif
     ClearBitMask(CommIrqReg, 0x80);        /* Clear all interrupt request bits */
     SetBitMask(FIFOLevelReg, 0x80);        /* Flush the FIFO buffer */
     Write_MFRC522(CommandReg, PCD_IDLE);   /* Cancel current command */
@@ -253,16 +244,28 @@ static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLe
     }
 
     /* Wait for the command to complete or timeout. */
-    i = 2000; /* Set timeout */
-    do {
+    deadline = monotonic_us() + MFRC522_COMMAND_TIMEOUT_US;
+#if MFRC522_USE_IRQ
+    /* Sleep until the IRQ pin (or the deadline) ends the command */
+    while (!mfrc522_irq_flag && monotonic_us() < deadline) {
+        __WFI();
+    }
+#endif
+    for (;;) {
         n = Read_MFRC522(CommIrqReg);
-        i--;
-    } while ((i != 0) && !(n & 0x01) && !(n & waitIRq));
+        if ((n & 0x01) || (n & waitIRq)) {
+            break;
+        }
+        if (monotonic_us() >= deadline) {
+            timed_out = 1;
+            break;
+        }
+    }
 
     ClearBitMask(BitFramingReg, 0x80); /* Stop the transmission */
 
     /* Check the result. */
-    if (i != 0) {
+    if (!timed_out) {
         if (!(Read_MFRC522(ErrorReg) & 0x1B)) { /* Check for errors */
             status = MI_OK;
             if (n & irqEn & 0x01) {
@@ -290,6 +293,7 @@ static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLe
             status = MI_ERR;
         }
     }
+    TRACE(TRACE_EVT_RC522_END, status | (timed_out ? 0x80U : 0U));
     return status;
 }
 
@@ -300,6 +304,7 @@ static uint8_t MFRC522_ToCard(uint8_t command, uint8_t *sendData, uint8_t sendLe
  * @return Status of the operation (MI_OK or MI_ERR).
  */
 uint8_t MFRC522_Request(uint8_t reqMode, uint8_t *TagType) {
+    PROF_SCOPE(PROF_ZONE_RC522_REQUEST);
     uint8_t status;
     uint16_t backBits; /* The length of the received data in bits */
     Write_MFRC522(BitFramingReg, 0x07); /* TxLastBists = 7 */
@@ -347,6 +352,7 @@ uint8_t MFRC522_Anticoll(uint8_t *serNum) {
  */
 static void CalulateCRC(uint8_t *pIndata, uint8_t len, uint8_t *pOutData) {
     uint8_t i, n;
+    uint64_t deadline;
     ClearBitMask(DivIrqReg, 0x04); /* Clear CRCIRq interrupt request bit */
     SetBitMask(FIFOLevelReg, 0x80); /* Flush FIFO buffer */
 
@@ -357,11 +363,10 @@ static void CalulateCRC(uint8_t *pIndata, uint8_t len, uint8_t *pOutData) {
     Write_MFRC522(CommandReg, PCD_CALCCRC); /* Start CRC calculation */
 
     /* Wait for CRC calculation to complete. */
-    i = 0xFF;
+    deadline = monotonic_us() + MFRC522_CRC_TIMEOUT_US;
     do {
         n = Read_MFRC522(DivIrqReg);
-        i--;
-    } while ((i != 0) && !(n & 0x04));
+    } while (!(n & 0x04) && monotonic_us() < deadline);
 
     /* Read CRC result. */
     pOutData[0] = Read_MFRC522(CRCResultRegL);
@@ -5,7 +5,8 @@
 #include <stdint.h>
 
 /*------------- PIN DEFINITIONS -------------*/
-/* Change these definitions to match your circuit schematic. */
+/* Change these definitions to match your circuit schematic; the pins are
+   configured by the board pin table (Board/board.h). */
 #define MFRC522_SPI_INSTANCE        SPI2
 #define MFRC522_SPI_RCC_REG         RCC->APB1ENR
 #define MFRC522_SPI_RCC_EN          RCC_APB1ENR_SPI2EN
@@ -24,15 +25,25 @@
 #define MFRC522_RST_PORT            GPIOB
 #define MFRC522_RST_PIN             9
 
-/* GPIO Clock Enable */
-#define MFRC522_GPIO_RCC_REG        RCC->AHB1ENR
-#define MFRC522_GPIOA_RCC_EN        0 /* GPIOA not used in this configuration */
-#define MFRC522_GPIOB_RCC_EN        RCC_AHB1ENR_GPIOBEN
+/* Optional IRQ pin (open drain, active low), not connected on the board as
+   built. Wire the module's IRQ to PC13 and build with MFRC522_USE_IRQ=1 to
+   sleep in WFI while a command runs instead of polling CommIrqReg over SPI
+   (with the option on and the line open, every command waits out
+   MFRC522_COMMAND_TIMEOUT_US). */
+#ifndef MFRC522_USE_IRQ
+#define MFRC522_USE_IRQ             0
+#endif
+#define MFRC522_IRQ_PORT            GPIOC
+#define MFRC522_IRQ_PIN             13
 
 /*------------- CONSTANTS -------------*/
 /* Maximum length of the array for data transfer */
 #define MAX_LEN 16
 
+/* Time limits for the MFRC522 to finish a command (the card timer is set to ~15 ms) */
+#define MFRC522_COMMAND_TIMEOUT_US  25000
+#define MFRC522_CRC_TIMEOUT_US      5000
+
 /* MFRC522 commands (datasheet chapter 10) */
 #define PCD_IDLE              0x00
 #define PCD_AUTHENT           0x0E
@@ -1,179 +1,414 @@
 #include "servo.h"
+#include "trace.h"
+#include "pwm_timer.h"
+#include <math.h>
+#include <stddef.h>
+
+/* Timers the manager drives, with their update interrupt */
+typedef struct {
+    TIM_TypeDef *timer;
+    IRQn_Type   irq;
+} servo_timer_t;
+
+static const servo_timer_t servo_timers[] = {
+    { TIM2, TIM2_IRQn },
+    { TIM3, TIM3_IRQn },
+    { TIM4, TIM4_IRQn },
+    { TIM5, TIM5_IRQn },
+};
+
+#define SERVO_TIMER_COUNT   (sizeof(servo_timers) / sizeof(servo_timers[0]))
+
+/* Servo on each channel of each timer, NULL if none */
+static Servo_Config_t *servo_bank[SERVO_TIMER_COUNT][4];
 
 /**
- * @brief  Gets the alternate function mapping for a given timer.
- * @param  timer Pointer to the TIM_TypeDef peripheral.
- * @return The alternate function value (0-15). Returns 0xFF if timer is not supported.
- * @note   This is specific to STM32F401xx. Check the datasheet for other MCUs.
+ * @brief Returns the index of a timer in servo_timers, -1 if the manager does not drive it.
  */
-static uint8_t _servo_get_gpio_af(TIM_TypeDef *timer) {
-    if (timer == TIM1 || timer == TIM2) {
-        return 1; /* AF1 */
-    } else if (timer == TIM3 || timer == TIM4 || timer == TIM5) {
-        return 2; /* AF2 */
-    } else if (timer == TIM9 || timer == TIM10 || timer == TIM11) {
-        return 3; /* AF3 */
+static int32_t servo_findTimer(const TIM_TypeDef *timer) {
+    for (uint32_t i = 0; i < SERVO_TIMER_COUNT; i++) {
+        if (servo_timers[i].timer == timer) {
+            return (int32_t)i;
+        }
     }
-    return 0xFF; /* Unsupported timer */
+    return -1;
 }
 
 /**
- * @brief Initializes the GPIO and Timer for a specific servo motor.
- * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @brief Returns the compare register of the servo's channel.
  */
-void Servo_Init(Servo_Config_t *config) {
-    if (!config || !config->timer || !config->gpio_port) {
-        return;
-    }
+static inline volatile uint32_t *servo_ccr(const Servo_Config_t *config) {
+    return &config->timer->CCR1 + (config->channel - 1U);
+}
 
-    /* 1. Enable GPIO and Timer Clocks */
-    /* Enable GPIO Port Clock */
-    if (config->gpio_port == GPIOA) {
-        RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
-    } else if (config->gpio_port == GPIOB) {
-        RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
-    } else if (config->gpio_port == GPIOC) {
-        RCC->AHB1ENR |= RCC_AHB1ENR_GPIOCEN;
-    } /* Add other ports if needed (GPIOD, etc.) */
+/**
+ * @brief Lets the update interrupt of the servo's timer run (it stops itself when idle).
+ * Called with interrupts disabled.
+ */
+static inline void servo_wake(const Servo_Config_t *config) {
+    config->timer->DIER |= TIM_DIER_UIE;
+}
 
-    /* Enable Timer Clock */
-    if (config->timer == TIM2 || config->timer == TIM3 || config->timer == TIM4 || config->timer == TIM5) {
-        RCC->APB1ENR |= (1 << ((uint32_t)config->timer - (uint32_t)TIM2) / 0x400);
-    } else if (config->timer == TIM1 || config->timer == TIM9 || config->timer == TIM10 || config->timer == TIM11) {
-        /* A bit more complex for APB2 timers due to their register layout */
-        if(config->timer == TIM1)  RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
-        if(config->timer == TIM9)  RCC->APB2ENR |= RCC_APB2ENR_TIM9EN;
-        if(config->timer == TIM10) RCC->APB2ENR |= RCC_APB2ENR_TIM10EN;
-        if(config->timer == TIM11) RCC->APB2ENR |= RCC_APB2ENR_TIM11EN;
+/**
+ * @brief Ends a move: traces the angle reached and calls on_done.
+ */
+static void servo_finish(Servo_Config_t *config) {
+    config->moving = 0;
+    TRACE(TRACE_EVT_SERVO_DONE, (uint8_t)(config->target / 10U));
+    if (config->on_done) {
+        config->on_done(config);
     }
+}
 
-    /* 2. Configure GPIO Pin as Alternate Function */
-    /* Set mode to Alternate Function (10) */
-    config->gpio_port->MODER &= ~(0x03UL << (config->gpio_pin * 2));
-    config->gpio_port->MODER |= (0x02UL << (config->gpio_pin * 2));
-
-    /* Set speed to high speed (10) */
-    config->gpio_port->OSPEEDR &= ~(0x03UL << (config->gpio_pin * 2));
-    config->gpio_port->OSPEEDR |= (0x02UL << (config->gpio_pin * 2));
-
-    /* Configure Alternate Function register */
-    uint8_t af_value = _servo_get_gpio_af(config->timer);
-    if (af_value == 0xFF) return; /* Stop if timer not supported */
+/**
+ * @brief Update interrupt of a timer: writes the next pulse width of every
+ * channel that has one. The compare registers are preloaded, so the values
+ * written here are output together from the next update on.
+ * @param index Entry of servo_timers.
+ */
+static void servo_update(uint32_t index) {
+    TIM_TypeDef *timer = servo_timers[index].timer;
+    uint8_t busy = 0;
 
-    if (config->gpio_pin < 8) {
-        config->gpio_port->AFR[0] &= ~(0x0FUL << (config->gpio_pin * 4));
-        config->gpio_port->AFR[0] |= ((uint32_t)af_value << (config->gpio_pin * 4));
-    } else {
-        config->gpio_port->AFR[1] &= ~(0x0FUL << ((config->gpio_pin - 8) * 4));
-        config->gpio_port->AFR[1] |= ((uint32_t)af_value << ((config->gpio_pin - 8) * 4));
+    timer->SR = ~TIM_SR_UIF;
+    for (uint32_t ch = 0; ch < 4U; ch++) {
+        Servo_Config_t *config = servo_bank[index][ch];
+        if (!config) {
+            continue;
+        }
+        if (config->moving) {
+            if (config->move_pos < config->move_len) {
+                (&timer->CCR1)[ch] = config->profile[config->move_pos++];
+            } else {
+                /* The last frame is being output */
+                servo_finish(config);
+            }
+        } else if (config->pending_us) {
+            (&timer->CCR1)[ch] = config->pending_us;
+            config->pending_us = 0;
+        }
+        /* on_done may have started another move */
+        if (config->moving || config->pending_us) {
+            busy = 1;
+        }
+    }
+    if (!busy) {
+        timer->DIER &= ~TIM_DIER_UIE;
     }
+}
 
-    /* 3. Configure Timer for 50Hz PWM */
-    /**
-     * --- Calculation for 50Hz PWM ---
-     * Target Frequency = 50 Hz (20ms period)
-     * Assuming Timer Clock (from APB1) is 42 MHz for TIM2-5.
-     * Timer_Tick_Frequency = Timer_Clock / (Prescaler + 1)
-     * We want a 1MHz tick frequency (1us resolution) for easy pulse width control.
-     * Prescaler = (Timer_Clock / 1,000,000) - 1
-     * Prescaler = (42,000,000 / 1,000,000) - 1 = 41
-     * PWM_Frequency = Timer_Tick_Frequency / (AutoReloadRegister + 1)
-     * 50 Hz = 1,000,000 / (ARR + 1)
-     * ARR = (1,000,000 / 50) - 1 = 20,000 - 1 = 19999
-     */
+void TIM2_IRQHandler(void) { servo_update(0); }
+void TIM3_IRQHandler(void) { servo_update(1); }
+void TIM4_IRQHandler(void) { servo_update(2); }
+void TIM5_IRQHandler(void) { servo_update(3); }
 
-    config->timer->PSC = 83;
-    config->timer->ARR = 19999;
+/**
+ * @brief Fraction of the ramp distance covered at a point of an acceleration phase.
+ * @param u Time into the phase over its length (0..1).
+ * @param shape Ramp shape.
+ * @return Distance over (peak speed x phase length): 0 at u = 0, 1/2 at u = 1.
+ */
+static float servo_ramp(float u, Servo_Shape_t shape) {
+    if (shape == SERVO_PROFILE_SCURVE) {
+        /* Integral of the smoothstep 3u^2 - 2u^3 */
+        return u * u * u - 0.5f * u * u * u * u;
+    }
+    return 0.5f * u * u;
+}
 
-    /* 4. Configure PWM Channel */
-    volatile uint32_t *ccmr = (config->channel <= 2) ? &config->timer->CCMR1 : &config->timer->CCMR2;
-    uint8_t channel_offset = (config->channel % 2 == 1) ? 0 : 8;
+/**
+ * @brief Initializes the Timer channel for a specific servo motor and adds
+ * it to the manager.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ */
+void Servo_Init(Servo_Config_t *config) {
+    if (!config || !config->timer || config->channel < 1U || config->channel > 4U) {
+        return;
+    }
+    int32_t index = servo_findTimer(config->timer);
+    if (index < 0 || servo_bank[index][config->channel - 1U]) {
+        return;
+    }
 
-    /* Clear previous settings for the channel */
-    *ccmr &= ~(0xFFUL << channel_offset);
+    /* Open the channel: 50 Hz with 20000 steps, i.e. a 1 us tick, so a
+       compare value is a pulse width in microseconds. The prescaler is
+       computed from the timer clock read from RCC. The pin is set up by
+       the board pin table. */
+    if (PwmTimer_Open(config->timer, config->channel, SERVO_PWM_HZ, SERVO_PERIOD_US, "servo")
+            != PWM_TIMER_OK) {
+        return;
+    }
 
-    /* Set PWM Mode 1 (OCxM = 110) and enable Preload (OCxPE = 1) */
-    *ccmr |= (0x68UL << channel_offset);
+    /* Calibration table from the end points (defaults if not set) */
+    Servo_Calibrate(config,
+            config->min_us ? config->min_us : SERVO_MIN_PULSE_WIDTH_US,
+            config->max_us ? config->max_us : SERVO_MAX_PULSE_WIDTH_US);
+    config->moving = 0;
+    config->pending_us = 0;
+    servo_bank[index][config->channel - 1U] = config;
+    NVIC_EnableIRQ(servo_timers[index].irq);
 
-    /* Enable the channel output */
-    config->timer->CCER |= (1UL << ((config->channel - 1) * 4));
+    /* Set initial position to 90 degrees */
+    Servo_SetAngle(config, SERVO_DEG(90));
+}
 
-    /* 5. Enable Timer */
-    /* Enable Auto-Reload Preload (ARPE) */
-    config->timer->CR1 |= TIM_CR1_ARPE;
+/**
+ * @brief Initializes several servos.
+ * @param servos Servos to initialize.
+ * @param count Number of servos.
+ */
+void Servo_InitAll(Servo_Config_t *const servos[], uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        Servo_Init(servos[i]);
+    }
+}
 
-    /* For advanced timers (TIM1), enable main output */
-    if(config->timer == TIM1) {
-        config->timer->BDTR |= TIM_BDTR_MOE;
+/**
+ * @brief Releases the channel of a servo.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ */
+void Servo_DeInit(Servo_Config_t *config) {
+    if (!config || !config->timer || config->channel < 1U || config->channel > 4U) {
+        return;
+    }
+    int32_t index = servo_findTimer(config->timer);
+    if (index < 0 || servo_bank[index][config->channel - 1U] != config) {
+        return;
     }
 
-    /* Generate an update event to load the prescaler and ARR */
-    config->timer->EGR |= TIM_EGR_UG;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    config->moving = 0;
+    config->pending_us = 0;
+    servo_bank[index][config->channel - 1U] = NULL;
+    __set_PRIMASK(primask);
 
-    /* Clear the update flag */
-    config->timer->SR &= ~TIM_SR_UIF;
+    /* Release the channel; the timer stops once no other channel uses it */
+    PwmTimer_Close(config->timer, config->channel);
+}
 
-    /* Enable the counter */
-    config->timer->CR1 |= TIM_CR1_CEN;
+/**
+ * @brief Calibrates the end points of a servo.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param min_us Pulse width at 0 degrees.
+ * @param max_us Pulse width at 180 degrees.
+ */
+void Servo_Calibrate(Servo_Config_t *config, uint16_t min_us, uint16_t max_us) {
+    int32_t span = (int32_t)max_us - (int32_t)min_us;
 
-    /* Set initial position to 90 degrees (1.5ms pulse) */
-    Servo_SetAngle(config, 90.0f);
+    config->min_us = min_us;
+    config->max_us = max_us;
+    for (uint32_t i = 0; i < SERVO_LUT_POINTS; i++) {
+        config->lut[i] = (uint16_t)((int32_t)min_us + span * (int32_t)i / (int32_t)(SERVO_LUT_POINTS - 1U));
+    }
 }
 
 /**
- * @brief De-initializes the timer associated with a servo.
+ * @brief Corrects one point of the calibration table.
  * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle Angle of the point, a multiple of SERVO_LUT_STEP.
+ * @param pulse_us Pulse width measured for that angle.
  */
-void Servo_DeInit(Servo_Config_t *config) {
-    if (!config || !config->timer) {
+void Servo_CalibratePoint(Servo_Config_t *config, Servo_Angle_t angle, uint16_t pulse_us) {
+    if (angle > SERVO_ANGLE_MAX || angle % SERVO_LUT_STEP) {
         return;
     }
-    /* Disable the timer counter */
-    config->timer->CR1 &= ~TIM_CR1_CEN;
-    /* Note: Disabling clocks is omitted for simplicity, as other servos might */
+    config->lut[angle / SERVO_LUT_STEP] = pulse_us;
+    if (angle == 0U) {
+        config->min_us = pulse_us;
+    } else if (angle == SERVO_ANGLE_MAX) {
+        config->max_us = pulse_us;
+    }
 }
 
 /**
- * @brief Sets the angle of the servo motor.
+ * @brief Returns the calibrated pulse width of an angle (interpolated in the table).
  * @param config Pointer to the Servo_Config_t structure for the servo.
- * @param angle The desired angle, from 0.0 to 180.0 degrees.
+ * @param angle Angle in tenths of a degree, clamped to SERVO_ANGLE_MAX.
  */
-void Servo_SetAngle(Servo_Config_t *config, float angle) {
-    /* Clamp the angle to the valid range [0, 180] */
-    if (angle < 0.0f) angle = 0.0f;
-    if (angle > 180.0f) angle = 180.0f;
+uint16_t Servo_PulseForAngle(const Servo_Config_t *config, Servo_Angle_t angle) {
+    if (angle >= SERVO_ANGLE_MAX) {
+        return config->lut[SERVO_LUT_POINTS - 1U];
+    }
+    uint32_t i = angle / SERVO_LUT_STEP;
+    int32_t frac = (int32_t)(angle - i * SERVO_LUT_STEP);
+    int32_t delta = (int32_t)config->lut[i + 1U] - (int32_t)config->lut[i];
+    return (uint16_t)((int32_t)config->lut[i] + delta * frac / (int32_t)SERVO_LUT_STEP);
+}
 
-    /* Linearly map the angle (0-180) to the pulse width (MIN-MAX) */
-    uint16_t pulse_width = SERVO_MIN_PULSE_WIDTH_US +
-        (uint16_t)(angle / 180.0f * (SERVO_MAX_PULSE_WIDTH_US - SERVO_MIN_PULSE_WIDTH_US));
+/**
+ * @brief Sets the angle of the servo motor on the next frame.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle The desired angle in tenths of a degree.
+ */
+void Servo_SetAngle(Servo_Config_t *config, Servo_Angle_t angle) {
+    if (!config || !config->timer) {
+        return;
+    }
+    if (angle > SERVO_ANGLE_MAX) angle = SERVO_ANGLE_MAX;
+    TRACE(TRACE_EVT_SERVO, (uint8_t)(angle / 10U));
 
-    Servo_SetPulseWidth_us(config, pulse_width);
+    config->target = angle;
+    Servo_SetPulseWidth_us(config, Servo_PulseForAngle(config, angle));
 }
 
 /**
- * @brief Sets the raw pulse width for the servo motor.
+ * @brief Sets the raw pulse width for the servo motor on the next frame.
  * @param config Pointer to the Servo_Config_t structure for the servo.
  * @param pulse_width_us The desired pulse width in microseconds.
  */
 void Servo_SetPulseWidth_us(Servo_Config_t *config, uint16_t pulse_width_us) {
-    if (!config || !config->timer) {
+    if (!config || !config->timer || pulse_width_us == 0U) {
         return;
     }
 
-    /* The CCRx value directly corresponds to the pulse width in microseconds */
-    /* due to the 1MHz timer tick frequency setup in Servo_Init. */
-    switch (config->channel) {
-        case 1:
-            config->timer->CCR1 = pulse_width_us;
-            break;
-        case 2:
-            config->timer->CCR2 = pulse_width_us;
-            break;
-        case 3:
-            config->timer->CCR3 = pulse_width_us;
-            break;
-        case 4:
-            config->timer->CCR4 = pulse_width_us;
-            break;
+    /* The CCRx value directly corresponds to the pulse width in microseconds
+       due to the 1MHz timer tick; the update interrupt writes it */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    config->moving = 0;
+    config->pending_us = pulse_width_us;
+    servo_wake(config);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Plans a move as one pulse width per PWM frame.
+ * The move accelerates, cruises at the top speed if the distance allows,
+ * and decelerates symmetrically; with the S-curve shape the ramps have the
+ * same length but a smooth velocity (peak acceleration 1.5x the limit).
+ * @param from_us Start pulse width.
+ * @param to_us Target pulse width.
+ * @param span_us Pulse width change over 180 degrees.
+ * @param limits Speed, acceleration and shape (zero fields use the defaults).
+ * @param out Receives the pulse widths; the last one is to_us.
+ * @param max Capacity of out.
+ * @return Number of frames, 0 if already at the target.
+ */
+uint16_t Servo_Profile(uint16_t from_us, uint16_t to_us, uint16_t span_us,
+        const Servo_Limits_t *limits, uint16_t *out, uint16_t max) {
+    const float us_per_deg = (float)span_us / 180.0f;
+    const float frame_s = 1.0f / (float)SERVO_PWM_HZ;
+    float dist = (to_us > from_us) ? (float)(to_us - from_us) : (float)(from_us - to_us);
+    float dir = (to_us > from_us) ? 1.0f : -1.0f;
+
+    if (dist == 0.0f || max == 0U) {
+        return 0;
+    }
+    float speed = (float)(limits->speed_dps ? limits->speed_dps : SERVO_DEFAULT_SPEED_DPS) * us_per_deg;
+    float accel = (float)(limits->accel_dps2 ? limits->accel_dps2 : SERVO_DEFAULT_ACCEL_DPS2) * us_per_deg;
+
+    /* Ramp time to top speed; a short move never reaches it (triangle) */
+    float ramp_s = speed / accel;
+    if (speed * ramp_s > dist) {
+        ramp_s = sqrtf(dist / accel);
+        speed = accel * ramp_s;
+    }
+    float ramp_dist = speed * ramp_s;   /* Both ramps together */
+    float cruise_s = (dist - ramp_dist) / speed;
+    float total_s = 2.0f * ramp_s + cruise_s;
+
+    uint32_t frames = (uint32_t)(total_s / frame_s + 0.999f);
+    if (frames == 0U) frames = 1U;
+    if (frames > max) frames = max;
+
+    for (uint32_t k = 1; k <= frames; k++) {
+        float t = (float)k * frame_s;
+        float pos;
+        if (k == frames) {
+            pos = dist;
+        } else if (t < ramp_s) {
+            pos = servo_ramp(t / ramp_s, limits->shape) * ramp_dist;
+        } else if (t < ramp_s + cruise_s) {
+            pos = 0.5f * ramp_dist + speed * (t - ramp_s);
+        } else {
+            pos = dist - servo_ramp((total_s - t) / ramp_s, limits->shape) * ramp_dist;
+        }
+        out[k - 1U] = (uint16_t)((float)from_us + dir * pos + 0.5f);
+    }
+    return (uint16_t)frames;
+}
+
+
+/**
+ * @brief Stops the servo and plans a move from the pulse width it outputs.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle The target angle in tenths of a degree (clamped).
+ * @note  move_len is left at 0 when already there (on_done is called then).
+ */
+static void servo_plan(Servo_Config_t *config, Servo_Angle_t angle) {
+    if (angle > SERVO_ANGLE_MAX) angle = SERVO_ANGLE_MAX;
+    TRACE(TRACE_EVT_SERVO, (uint8_t)(angle / 10U));
+
+    /* The interrupt leaves the servo alone while it is planned */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    config->moving = 0;
+    config->pending_us = 0;
+    __set_PRIMASK(primask);
+
+    /* The compare register holds the last pulse width written (mid-move for a reversal) */
+    int32_t span = (int32_t)config->lut[SERVO_LUT_POINTS - 1U] - (int32_t)config->lut[0];
+    config->target = angle;
+    config->move_pos = 0;
+    config->move_len = Servo_Profile((uint16_t)*servo_ccr(config), Servo_PulseForAngle(config, angle),
+            (uint16_t)((span < 0) ? -span : span), &config->limits, config->profile, SERVO_PROFILE_MAX);
+    if (config->move_len == 0U) {
+        servo_finish(config);
+    }
+}
+
+/**
+ * @brief Moves the servo to an angle along a profile played by the timer interrupt.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle The target angle in tenths of a degree (clamped).
+ */
+void Servo_MoveTo(Servo_Config_t *config, Servo_Angle_t angle) {
+    Servo_MoveAll(&config, &angle, 1);
+}
+
+/**
+ * @brief Starts several moves on the same frame.
+ * @param servos Servos to move.
+ * @param angles Target angle of each servo.
+ * @param count Number of servos.
+ */
+void Servo_MoveAll(Servo_Config_t *const servos[], const Servo_Angle_t angles[], uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (servos[i] && servos[i]->timer) {
+            servo_plan(servos[i], angles[i]);
+        }
+    }
+
+    /* One critical section: no update interrupt can fall between two servos */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < count; i++) {
+        if (servos[i] && servos[i]->timer && servos[i]->move_len) {
+            servos[i]->moving = 1;
+            servo_wake(servos[i]);
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stops a move where it is (on_done is not called).
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ */
+void Servo_Stop(Servo_Config_t *config) {
+    config->moving = 0;
+}
+
+/**
+ * @brief Returns how far the current move has got.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @return 0..1000 per mille of the frames sent, 1000 when idle.
+ */
+uint16_t Servo_GetProgress(const Servo_Config_t *config) {
+    uint16_t len = config->move_len;
+    if (!config->moving || len == 0U) {
+        return 1000;
     }
+    return (uint16_t)((uint32_t)config->move_pos * 1000U / len);
 }
@@ -7,53 +7,148 @@ extern "C" {
 
 #include "stm32f4xx.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 /**
- * @brief Defines the minimum and maximum pulse width for the servo in microseconds.
+ * @brief Defines the default minimum and maximum pulse width for the servo in microseconds.
  * These values typically correspond to 0 and 180 degrees, respectively.
  * Standard values are 1000us (1ms) for 0 degrees and 2000us (2ms) for 180 degrees.
- * You might need to tune these for your specific servo.
+ * A servo whose min_us/max_us fields are left at 0 uses them; others are
+ * calibrated one by one (Servo_Calibrate, Servo_CalibratePoint).
  */
 #define SERVO_MIN_PULSE_WIDTH_US 414
 #define SERVO_MAX_PULSE_WIDTH_US 2571
 
+/* PWM frame: 50 Hz, counted in 1 us steps */
+#define SERVO_PWM_HZ             50U
+#define SERVO_PERIOD_US          20000U
+
 /**
- * @brief Structure to hold the configuration for a single servo motor.
- * @note  The user must initialize this structure with the correct GPIO and Timer
- * peripherals for the servo connection.
+ * @brief Servo manager. Up to four servos share a timer, one per channel
+ * (TIM2-TIM5, e.g. four barriers on TIM2 CH1-CH4). Each timer has a single
+ * update interrupt that writes the next pulse width of every channel with
+ * something to do: a pending Servo_SetPulseWidth_us() value or the next
+ * frame of a move. The compare registers are preloaded, so all the values
+ * written in one interrupt reach the pins together on the next frame.
+ * The interrupt is only enabled while a channel of the timer has work.
+ *
+ * Angles are integers in tenths of a degree. Each servo converts them
+ * through its own table of pulse widths every SERVO_LUT_STEP, filled from
+ * its calibration, with linear interpolation in between: no float math.
  */
+/* Angle in tenths of a degree, 0..1800 */
+typedef uint16_t Servo_Angle_t;
+#define SERVO_DEG(deg)          ((Servo_Angle_t)((deg) * 10U))
+#define SERVO_ANGLE_MAX         SERVO_DEG(180)
+/* Calibration table: one pulse width every 10 degrees */
+#define SERVO_LUT_STEP          SERVO_DEG(10)
+#define SERVO_LUT_POINTS        (SERVO_ANGLE_MAX / SERVO_LUT_STEP + 1U)
+
+/* Frames in a profile (20 ms each); longer moves end with a step */
+#define SERVO_PROFILE_MAX        128U
+/* Default limits, within what a hobby servo does unloaded (~0.1 s/60 deg) */
+#define SERVO_DEFAULT_SPEED_DPS  400U   /* deg/s */
+#define SERVO_DEFAULT_ACCEL_DPS2 3000U  /* deg/s^2 */
+
+/* Velocity shape of the acceleration and deceleration phases */
+typedef enum {
+    SERVO_PROFILE_TRAPEZOID = 0,    /* Constant acceleration */
+    SERVO_PROFILE_SCURVE,           /* Smoothstep velocity: no step in acceleration, 1.5x peak */
+} Servo_Shape_t;
+
+/* Motion limits; a zero field selects the default */
 typedef struct {
-    TIM_TypeDef  *timer;       /*!< Pointer to the Timer peripheral (e.g., TIM2, TIM3). */
+    uint16_t speed_dps;     /*!< Top speed in degrees per second. */
+    uint16_t accel_dps2;    /*!< Acceleration in degrees per second squared. */
+    Servo_Shape_t shape;    /*!< Ramp shape. */
+} Servo_Limits_t;
+
+typedef struct Servo_Config Servo_Config_t;
+
+/* @brief Called from the timer interrupt when a move has ended. */
+typedef void (*Servo_Callback_t)(Servo_Config_t *servo);
+
+/**
+ * @brief Structure to hold the configuration for a single servo motor.
+ * @note  The user must initialize this structure with the Timer and channel
+ * of the servo; its pin is declared in the board pin table (Board/board.h).
+ */
+struct Servo_Config {
+    TIM_TypeDef  *timer;       /*!< Pointer to the Timer peripheral (TIM2-TIM5). */
     uint8_t      channel;      /*!< Timer channel (1-4) connected to the servo. */
-    GPIO_TypeDef *gpio_port;   /*!< Pointer to the GPIO port of the servo pin (e.g., GPIOA, GPIOB). */
-    uint8_t      gpio_pin;     /*!< GPIO pin number (0-15) connected to the servo. */
-} Servo_Config_t;
+    uint16_t     min_us;       /*!< Pulse width at 0 degrees (0 = SERVO_MIN_PULSE_WIDTH_US). */
+    uint16_t     max_us;       /*!< Pulse width at 180 degrees (0 = SERVO_MAX_PULSE_WIDTH_US);
+                                    below min_us for a servo mounted mirrored. */
+    Servo_Limits_t   limits;   /*!< Motion limits for Servo_MoveTo(). */
+    Servo_Callback_t on_done;  /*!< Called when a move ends (may be NULL). */
+
+    /* State, managed by the driver */
+    uint16_t          lut[SERVO_LUT_POINTS];    /*!< Pulse width every SERVO_LUT_STEP. */
+    Servo_Angle_t     target;       /*!< Angle of the last command. */
+    volatile uint16_t pending_us;   /*!< Pulse width for the next frame, 0 if none. */
+    volatile uint8_t  moving;       /*!< 1 while a profile is playing. */
+    volatile uint16_t move_pos;     /*!< Frames of the profile written so far. */
+    uint16_t          move_len;     /*!< Frames in the current profile. */
+    uint16_t          profile[SERVO_PROFILE_MAX]; /*!< Pulse widths, one per frame. */
+};
 
 /**
- * @brief Initializes the GPIO and Timer for a specific servo motor.
+ * @brief Initializes the Timer channel for a specific servo motor and adds
+ * it to the manager.
  * @param config Pointer to the Servo_Config_t structure for the servo.
- * @note  This function configures the timer to produce a 50Hz PWM signal,
- * which is standard for servo control. It assumes the APB1 clock for the
- * timer is 42MHz (standard on STM32F401 when HCLK is 84MHz).
+ * @note  This function opens the channel through the timer service for a
+ * 50Hz PWM signal with a 1us tick, which is standard for servo control.
+ * It fails (and leaves the pin unused) if the timer already runs at
+ * another rate for a different driver.
  */
 void Servo_Init(Servo_Config_t *config);
 
 /**
- * @brief De-initializes the timer associated with a servo to save power.
+ * @brief Initializes several servos (e.g. every barrier of the car park).
+ * @param servos Servos to initialize.
+ * @param count Number of servos.
+ */
+void Servo_InitAll(Servo_Config_t *const servos[], uint8_t count);
+
+/**
+ * @brief Releases the channel of a servo; the timer stops with its last channel.
  * @param config Pointer to the Servo_Config_t structure for the servo.
  */
 void Servo_DeInit(Servo_Config_t *config);
 
 /**
- * @brief Sets the angle of the servo motor.
+ * @brief Calibrates the end points of a servo (straight line in between).
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param min_us Pulse width at 0 degrees.
+ * @param max_us Pulse width at 180 degrees.
+ */
+void Servo_Calibrate(Servo_Config_t *config, uint16_t min_us, uint16_t max_us);
+
+/**
+ * @brief Corrects one point of the calibration table (non-linear servos).
  * @param config Pointer to the Servo_Config_t structure for the servo.
- * @param angle The desired angle, from 0.0 to 180.0 degrees. Values outside
- * this range will be clamped.
+ * @param angle Angle of the point, a multiple of SERVO_LUT_STEP.
+ * @param pulse_us Pulse width measured for that angle.
  */
-void Servo_SetAngle(Servo_Config_t *config, float angle);
+void Servo_CalibratePoint(Servo_Config_t *config, Servo_Angle_t angle, uint16_t pulse_us);
 
 /**
- * @brief Sets the raw pulse width for the servo motor.
+ * @brief Returns the calibrated pulse width of an angle.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle Angle in tenths of a degree, clamped to SERVO_ANGLE_MAX.
+ */
+uint16_t Servo_PulseForAngle(const Servo_Config_t *config, Servo_Angle_t angle);
+
+/**
+ * @brief Sets the angle of the servo motor on the next frame.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle The desired angle in tenths of a degree (SERVO_DEG(90) for
+ * 90 degrees). Values above SERVO_ANGLE_MAX will be clamped.
+ */
+void Servo_SetAngle(Servo_Config_t *config, Servo_Angle_t angle);
+
+/**
+ * @brief Sets the raw pulse width for the servo motor on the next frame.
  * @param config Pointer to the Servo_Config_t structure for the servo.
  * @param pulse_width_us The desired pulse width in microseconds. This function
  * is useful for fine-tuning and calibration. It is recommended
@@ -61,6 +156,59 @@ void Servo_SetAngle(Servo_Config_t *config, float angle);
  */
 void Servo_SetPulseWidth_us(Servo_Config_t *config, uint16_t pulse_width_us);
 
+/**
+ * @brief Moves the servo to an angle along a trapezoidal or S-curve profile.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @param angle The target angle in tenths of a degree (clamped).
+ * @note  Returns at once; the move is played by the timer interrupt and
+ * config->on_done is called at the end. Calling it during a move retargets
+ * it from the current position (e.g. to reverse the barrier), without a jump.
+ */
+void Servo_MoveTo(Servo_Config_t *config, Servo_Angle_t angle);
+
+/**
+ * @brief Starts several moves on the same frame (servos of one timer start
+ * exactly together).
+ * @param servos Servos to move.
+ * @param angles Target angle of each servo.
+ * @param count Number of servos.
+ */
+void Servo_MoveAll(Servo_Config_t *const servos[], const Servo_Angle_t angles[], uint8_t count);
+
+/**
+ * @brief Stops a move where it is.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ */
+void Servo_Stop(Servo_Config_t *config);
+
+/**
+ * @brief Returns true while a move is running.
+ */
+static inline bool Servo_IsMoving(const Servo_Config_t *config) {
+    return config->moving != 0;
+}
+
+/**
+ * @brief Returns how far the current move has got.
+ * @param config Pointer to the Servo_Config_t structure for the servo.
+ * @return 0..1000 per mille of the frames sent, 1000 when idle.
+ */
+uint16_t Servo_GetProgress(const Servo_Config_t *config);
+
+/**
+ * @brief Plans a move as one pulse width per PWM frame.
+ * @param from_us Start pulse width.
+ * @param to_us Target pulse width.
+ * @param span_us Pulse width change over 180 degrees (speed and acceleration scale).
+ * @param limits Speed, acceleration and shape (zero fields use the defaults).
+ * @param out Receives the pulse widths; the last one is to_us.
+ * @param max Capacity of out.
+ * @return Number of frames, 0 if already at the target.
+ * @note  No hardware access: the generator can be run on a PC.
+ */
+uint16_t Servo_Profile(uint16_t from_us, uint16_t to_us, uint16_t span_us,
+        const Servo_Limits_t *limits, uint16_t *out, uint16_t max);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,470 @@
+#ifndef SIM_STM32F4XX_H_
+#define SIM_STM32F4XX_H_
+
+/**
+ * @brief Host build of the device header: the register layout, bit names
+ * and core functions the drivers use, backed by the peripheral models of
+ * Sim/ instead of the STM32F401.
+ *
+ * GPIO, TIM, RCC and SYSCFG are plain memory (their addresses appear in
+ * static tables of the drivers); the models pick up what the firmware
+ * wrote at the next synchronisation point. Every access to the other
+ * peripherals goes through Sim_Sync() first: virtual time advances by one
+ * bus access, due events and interrupts run, and the registers are brought
+ * up to date, so polling loops see the hardware make progress.
+ *
+ * Only what the drivers of this repository use is declared.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO    volatile
+#define __I     volatile const
+#define __O     volatile
+
+#define __NVIC_PRIO_BITS    4U
+
+typedef enum {
+    NonMaskableInt_IRQn     = -14,
+    SysTick_IRQn            = -1,
+    EXTI0_IRQn              = 6,
+    EXTI1_IRQn              = 7,
+    EXTI2_IRQn              = 8,
+    EXTI3_IRQn              = 9,
+    EXTI4_IRQn              = 10,
+    DMA1_Stream0_IRQn       = 11,
+    DMA1_Stream1_IRQn       = 12,
+    DMA1_Stream2_IRQn       = 13,
+    DMA1_Stream3_IRQn       = 14,
+    DMA1_Stream4_IRQn       = 15,
+    DMA1_Stream5_IRQn       = 16,
+    DMA1_Stream6_IRQn       = 17,
+    EXTI9_5_IRQn            = 23,
+    TIM1_BRK_TIM9_IRQn      = 24,
+    TIM1_UP_TIM10_IRQn      = 25,
+    TIM1_TRG_COM_TIM11_IRQn = 26,
+    TIM1_CC_IRQn            = 27,
+    TIM2_IRQn               = 28,
+    TIM3_IRQn               = 29,
+    TIM4_IRQn               = 30,
+    I2C1_EV_IRQn            = 31,
+    I2C1_ER_IRQn            = 32,
+    I2C2_EV_IRQn            = 33,
+    I2C2_ER_IRQn            = 34,
+    SPI1_IRQn               = 35,
+    SPI2_IRQn               = 36,
+    USART1_IRQn             = 37,
+    USART2_IRQn             = 38,
+    EXTI15_10_IRQn          = 40,
+    DMA1_Stream7_IRQn       = 47,
+    TIM5_IRQn               = 50,
+    DMA2_Stream0_IRQn       = 56,
+    DMA2_Stream1_IRQn       = 57,
+    DMA2_Stream2_IRQn       = 58,
+    DMA2_Stream3_IRQn       = 59,
+    DMA2_Stream4_IRQn       = 60,
+    DMA2_Stream5_IRQn       = 68,
+    DMA2_Stream6_IRQn       = 69,
+    DMA2_Stream7_IRQn       = 70,
+    USART6_IRQn             = 71,
+} IRQn_Type;
+
+#define SIM_IRQ_COUNT   72  /* External interrupt vectors */
+
+/* Register blocks (RM0368 layout) */
+typedef struct {
+    __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, PLLCFGR, CFGR, CIR, AHB1RSTR, AHB2RSTR, RESERVED0[2], APB1RSTR, APB2RSTR,
+            RESERVED1[2], AHB1ENR, AHB2ENR, RESERVED2[2], APB1ENR, APB2ENR;
+} RCC_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR,
+            CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR;
+} TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, SR, DR, CRCPR, RXCRCR, TXCRCR, I2SCFGR, I2SPR;
+} SPI_TypeDef;
+
+typedef struct {
+    __IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, OAR1, OAR2, DR, SR1, SR2, CCR, TRISE, FLTR;
+} I2C_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct {
+    __IO uint32_t MEMRMP, PMC, EXTICR[4];
+} SYSCFG_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, CSR;
+} PWR_TypeDef;
+
+typedef struct {
+    __IO uint32_t CPUID, ICSR, VTOR, AIRCR, SCR, CCR;
+} SCB_Type;
+
+typedef struct {
+    __IO uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+
+typedef struct {
+    __IO uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+    __IO uint32_t PORT[32];
+    __IO uint32_t TER, TPR, TCR, LAR;
+} ITM_Type;
+
+/* GPIO ports 0x400 apart, like the AHB1 map (GPIO_EnableInterrupt() derives the port index) */
+#define SIM_GPIO_PORTS  3
+typedef union {
+    GPIO_TypeDef regs;
+    uint8_t      space[0x400];
+} Sim_GpioSlot_t;
+
+/* Timer instances in the order of the models */
+enum { SIM_TIM1, SIM_TIM2, SIM_TIM3, SIM_TIM4, SIM_TIM5, SIM_TIM9, SIM_TIM10, SIM_TIM11, SIM_TIMERS };
+
+/* The timers fill a page of their own, kept read-only between accesses:
+   the first write of the firmware faults and marks them for reconciling */
+#define SIM_PAGE_SIZE   4096U
+typedef union {
+    TIM_TypeDef tim[SIM_TIMERS];
+    uint8_t     page[SIM_PAGE_SIZE];
+} __attribute__((aligned(SIM_PAGE_SIZE))) Sim_TimerPage_t;
+
+extern Sim_GpioSlot_t     sim_gpio[SIM_GPIO_PORTS];
+extern Sim_TimerPage_t    sim_timer_page;
+#define sim_tim           (sim_timer_page.tim)
+extern RCC_TypeDef        sim_rcc;
+extern SYSCFG_TypeDef     sim_syscfg;
+extern PWR_TypeDef        sim_pwr;
+extern CoreDebug_Type     sim_coredebug;
+extern ITM_Type           sim_itm;
+extern SPI_TypeDef        sim_spi[3];
+extern USART_TypeDef      sim_usart[3];
+extern I2C_TypeDef        sim_i2c[3];
+extern DMA_TypeDef        sim_dma[2];
+extern DMA_Stream_TypeDef sim_dma_stream[16];
+extern EXTI_TypeDef       sim_exti;
+extern SCB_Type           sim_scb;
+extern DWT_Type           sim_dwt;
+
+/* @brief Synchronisation point of a peripheral access; returns the register block. */
+void *Sim_Sync(void *regs);
+/* @brief SysTick access (COUNTFLAG is cleared by the access after the one that returned it). */
+SysTick_Type *Sim_SysTickAccess(void);
+/* @brief SPI access: waits (in virtual time) for the byte in progress. */
+SPI_TypeDef *Sim_SpiAccess(uint32_t index);
+/* @brief USART access: waits (in virtual time) for the byte in progress. */
+USART_TypeDef *Sim_UsartAccess(uint32_t index);
+
+#define SIM_SYNCED(type, regs)  ((type *)Sim_Sync(&(regs)))
+
+#define GPIOA_BASE      ((uint32_t)(uintptr_t)&sim_gpio[0])
+#define GPIOA           (&sim_gpio[0].regs)
+#define GPIOB           (&sim_gpio[1].regs)
+#define GPIOC           (&sim_gpio[2].regs)
+#define RCC             (&sim_rcc)
+#define SYSCFG          (&sim_syscfg)
+#define PWR             (&sim_pwr)
+#define CoreDebug       (&sim_coredebug)
+#define ITM             (&sim_itm)
+#define TIM1            (&sim_tim[SIM_TIM1])
+#define TIM2            (&sim_tim[SIM_TIM2])
+#define TIM3            (&sim_tim[SIM_TIM3])
+#define TIM4            (&sim_tim[SIM_TIM4])
+#define TIM5            (&sim_tim[SIM_TIM5])
+#define TIM9            (&sim_tim[SIM_TIM9])
+#define TIM10           (&sim_tim[SIM_TIM10])
+#define TIM11           (&sim_tim[SIM_TIM11])
+
+#define SysTick         (Sim_SysTickAccess())
+#define DWT             SIM_SYNCED(DWT_Type, sim_dwt)
+#define SCB             SIM_SYNCED(SCB_Type, sim_scb)
+#define EXTI            SIM_SYNCED(EXTI_TypeDef, sim_exti)
+#define SPI1            (Sim_SpiAccess(0))
+#define SPI2            (Sim_SpiAccess(1))
+#define SPI3            (Sim_SpiAccess(2))
+#define USART1          (Sim_UsartAccess(0))
+#define USART2          (Sim_UsartAccess(1))
+#define USART6          (Sim_UsartAccess(2))
+#define I2C1            SIM_SYNCED(I2C_TypeDef, sim_i2c[0])
+#define I2C2            SIM_SYNCED(I2C_TypeDef, sim_i2c[1])
+#define I2C3            SIM_SYNCED(I2C_TypeDef, sim_i2c[2])
+#define DMA1            SIM_SYNCED(DMA_TypeDef, sim_dma[0])
+#define DMA2            SIM_SYNCED(DMA_TypeDef, sim_dma[1])
+#define DMA1_Stream0    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[0])
+#define DMA1_Stream1    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[1])
+#define DMA1_Stream2    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[2])
+#define DMA1_Stream3    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[3])
+#define DMA1_Stream4    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[4])
+#define DMA1_Stream5    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[5])
+#define DMA1_Stream6    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[6])
+#define DMA1_Stream7    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[7])
+#define DMA2_Stream0    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[8])
+#define DMA2_Stream1    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[9])
+#define DMA2_Stream2    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[10])
+#define DMA2_Stream3    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[11])
+#define DMA2_Stream4    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[12])
+#define DMA2_Stream5    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[13])
+#define DMA2_Stream6    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[14])
+#define DMA2_Stream7    SIM_SYNCED(DMA_Stream_TypeDef, sim_dma_stream[15])
+
+/* Clock tree (system_stm32f4xx.c) */
+extern uint32_t SystemCoreClock;
+extern const uint8_t AHBPrescTable[16];
+extern const uint8_t APBPrescTable[8];
+
+/* Core: interrupt mask, sleep and NVIC, run by the simulator */
+extern volatile uint32_t sim_primask;
+void Sim_Wfi(void);
+void Sim_EnableIrq(void);
+void Sim_NvicEnable(IRQn_Type irq, int enable);
+void Sim_NvicSetPriority(IRQn_Type irq, uint32_t priority);
+void Sim_ItmPut(uint32_t c);
+
+static inline void __NOP(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+static inline void __DMB(void) {}
+static inline void __WFI(void) { Sim_Wfi(); }
+static inline void __WFE(void) { Sim_Wfi(); }
+static inline void __SEV(void) {}
+static inline void __disable_irq(void) { sim_primask = 1U; }
+static inline void __enable_irq(void) { Sim_EnableIrq(); }
+static inline uint32_t __get_PRIMASK(void) { return sim_primask; }
+static inline void __set_PRIMASK(uint32_t primask) {
+    if (primask & 1U) {
+        sim_primask = 1U;
+    } else {
+        Sim_EnableIrq();
+    }
+}
+static inline uint32_t __CLZ(uint32_t value) { return value ? (uint32_t)__builtin_clz(value) : 32U; }
+
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { Sim_NvicEnable(irq, 1); }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { Sim_NvicEnable(irq, 0); }
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) { Sim_NvicSetPriority(irq, priority); }
+
+static inline uint32_t ITM_SendChar(uint32_t c) {
+    Sim_ItmPut(c);
+    return c;
+}
+
+/* RCC */
+#define RCC_AHB1ENR_GPIOAEN_Pos     0
+#define RCC_AHB1ENR_GPIOAEN         (1U << RCC_AHB1ENR_GPIOAEN_Pos)
+#define RCC_AHB1ENR_GPIOBEN         (1U << 1)
+#define RCC_AHB1ENR_GPIOCEN         (1U << 2)
+#define RCC_AHB1ENR_DMA1EN          (1U << 21)
+#define RCC_AHB1ENR_DMA2EN          (1U << 22)
+#define RCC_APB1ENR_TIM2EN          (1U << 0)
+#define RCC_APB1ENR_TIM3EN          (1U << 1)
+#define RCC_APB1ENR_TIM4EN          (1U << 2)
+#define RCC_APB1ENR_TIM5EN          (1U << 3)
+#define RCC_APB1ENR_SPI2EN          (1U << 14)
+#define RCC_APB1ENR_SPI3EN          (1U << 15)
+#define RCC_APB1ENR_USART2EN        (1U << 17)
+#define RCC_APB1ENR_I2C1EN          (1U << 21)
+#define RCC_APB1ENR_I2C2EN          (1U << 22)
+#define RCC_APB1ENR_I2C3EN          (1U << 23)
+#define RCC_APB1ENR_PWREN           (1U << 28)
+#define RCC_APB2ENR_TIM1EN          (1U << 0)
+#define RCC_APB2ENR_USART1EN        (1U << 4)
+#define RCC_APB2ENR_USART6EN        (1U << 5)
+#define RCC_APB2ENR_SPI1EN          (1U << 12)
+#define RCC_APB2ENR_SYSCFGEN        (1U << 14)
+#define RCC_APB2ENR_TIM9EN          (1U << 16)
+#define RCC_APB2ENR_TIM10EN         (1U << 17)
+#define RCC_APB2ENR_TIM11EN         (1U << 18)
+#define RCC_CFGR_HPRE_Pos           4
+#define RCC_CFGR_HPRE               (0xFU << RCC_CFGR_HPRE_Pos)
+#define RCC_CFGR_PPRE1_Pos          10
+#define RCC_CFGR_PPRE1              (0x7U << RCC_CFGR_PPRE1_Pos)
+#define RCC_CFGR_PPRE2_Pos          13
+#define RCC_CFGR_PPRE2              (0x7U << RCC_CFGR_PPRE2_Pos)
+
+/* TIM */
+#define TIM_CR1_CEN                 (1U << 0)
+#define TIM_CR1_UDIS                (1U << 1)
+#define TIM_CR1_URS                 (1U << 2)
+#define TIM_CR1_OPM                 (1U << 3)
+#define TIM_CR1_ARPE                (1U << 7)
+#define TIM_DIER_UIE                (1U << 0)
+#define TIM_DIER_CC1IE              (1U << 1)
+#define TIM_DIER_UDE                (1U << 8)
+#define TIM_SR_UIF                  (1U << 0)
+#define TIM_SR_CC1IF                (1U << 1)
+#define TIM_EGR_UG                  (1U << 0)
+#define TIM_CCMR1_OC1PE             (1U << 3)
+#define TIM_CCMR1_OC1M_Pos          4
+#define TIM_CCMR1_OC1M              (7U << TIM_CCMR1_OC1M_Pos)
+#define TIM_CCMR1_OC2PE             (1U << 11)
+#define TIM_CCMR1_OC2M_Pos          12
+#define TIM_CCMR1_OC2M              (7U << TIM_CCMR1_OC2M_Pos)
+#define TIM_CCMR2_OC3PE             (1U << 3)
+#define TIM_CCMR2_OC3M_Pos          4
+#define TIM_CCMR2_OC3M              (7U << TIM_CCMR2_OC3M_Pos)
+#define TIM_CCMR2_OC4PE             (1U << 11)
+#define TIM_CCMR2_OC4M_Pos          12
+#define TIM_CCMR2_OC4M              (7U << TIM_CCMR2_OC4M_Pos)
+#define TIM_CCER_CC1E               (1U << 0)
+#define TIM_CCER_CC1P               (1U << 1)
+#define TIM_CCER_CC2E               (1U << 4)
+#define TIM_CCER_CC2P               (1U << 5)
+#define TIM_CCER_CC3E               (1U << 8)
+#define TIM_CCER_CC3P               (1U << 9)
+#define TIM_CCER_CC4E               (1U << 12)
+#define TIM_CCER_CC4P               (1U << 13)
+#define TIM_BDTR_MOE                (1U << 15)
+#define TIM_DCR_DBA_Pos             0
+#define TIM_DCR_DBA                 (0x1FU << TIM_DCR_DBA_Pos)
+#define TIM_DCR_DBL_Pos             8
+#define TIM_DCR_DBL                 (0x1FU << TIM_DCR_DBL_Pos)
+
+/* SPI */
+#define SPI_CR1_CPHA                (1U << 0)
+#define SPI_CR1_CPOL                (1U << 1)
+#define SPI_CR1_MSTR                (1U << 2)
+#define SPI_CR1_BR_Pos              3
+#define SPI_CR1_BR                  (7U << SPI_CR1_BR_Pos)
+#define SPI_CR1_SPE                 (1U << 6)
+#define SPI_CR1_LSBFIRST            (1U << 7)
+#define SPI_CR1_SSI                 (1U << 8)
+#define SPI_CR1_SSM                 (1U << 9)
+#define SPI_CR2_TXDMAEN             (1U << 1)
+#define SPI_SR_RXNE                 (1U << 0)
+#define SPI_SR_TXE                  (1U << 1)
+#define SPI_SR_BSY                  (1U << 7)
+
+/* USART */
+#define USART_SR_RXNE               (1U << 5)
+#define USART_SR_TC                 (1U << 6)
+#define USART_SR_TXE                (1U << 7)
+#define USART_CR1_RE                (1U << 2)
+#define USART_CR1_TE                (1U << 3)
+#define USART_CR1_RXNEIE            (1U << 5)
+#define USART_CR1_TCIE              (1U << 6)
+#define USART_CR1_TXEIE             (1U << 7)
+#define USART_CR1_UE                (1U << 13)
+
+/* I2C (master transmitter with DMA, as the LCD backpack backend uses it) */
+#define I2C_CR1_PE                  (1U << 0)
+#define I2C_CR1_START               (1U << 8)
+#define I2C_CR1_STOP                (1U << 9)
+#define I2C_CR1_ACK                 (1U << 10)
+#define I2C_CR1_SWRST               (1U << 15)
+#define I2C_CR2_FREQ_Pos            0
+#define I2C_CR2_ITERREN             (1U << 8)
+#define I2C_CR2_ITEVTEN             (1U << 9)
+#define I2C_CR2_DMAEN               (1U << 11)
+#define I2C_CR2_LAST                (1U << 12)
+#define I2C_SR1_SB                  (1U << 0)
+#define I2C_SR1_ADDR                (1U << 1)
+#define I2C_SR1_BTF                 (1U << 2)
+#define I2C_SR1_TXE                 (1U << 7)
+#define I2C_SR1_BERR                (1U << 8)
+#define I2C_SR1_ARLO                (1U << 9)
+#define I2C_SR1_AF                  (1U << 10)
+#define I2C_SR1_OVR                 (1U << 11)
+#define I2C_SR2_MSL                 (1U << 0)
+#define I2C_SR2_BUSY                (1U << 1)
+#define I2C_CCR_FS                  (1U << 15)
+
+/* DMA */
+#define DMA_SxCR_EN                 (1U << 0)
+#define DMA_SxCR_TEIE               (1U << 2)
+#define DMA_SxCR_HTIE               (1U << 3)
+#define DMA_SxCR_TCIE               (1U << 4)
+#define DMA_SxCR_DIR_Pos            6
+#define DMA_SxCR_DIR_0              (1U << 6)
+#define DMA_SxCR_CIRC               (1U << 8)
+#define DMA_SxCR_PINC               (1U << 9)
+#define DMA_SxCR_MINC               (1U << 10)
+#define DMA_SxCR_PSIZE_Pos          11
+#define DMA_SxCR_PSIZE_0            (1U << 11)
+#define DMA_SxCR_PSIZE_1            (1U << 12)
+#define DMA_SxCR_MSIZE_Pos          13
+#define DMA_SxCR_MSIZE_0            (1U << 13)
+#define DMA_SxCR_MSIZE_1            (1U << 14)
+#define DMA_SxCR_PL_Pos             16
+#define DMA_SxCR_CHSEL_Pos          25
+/* Flags of stream n: bit offset 0, 6, 16, 22 in LISR (streams 0-3) or HISR (4-7) */
+#define SIM_DMA_FLAG_SHIFT(n)       ((((n) & 2U) ? 16U : 0U) + (((n) & 1U) ? 6U : 0U))
+#define DMA_LISR_TCIF1              (1U << 11)
+#define DMA_LISR_TCIF3              (1U << 27)
+#define DMA_LIFCR_CTCIF1            (1U << 11)
+#define DMA_LIFCR_CFEIF3            (1U << 22)
+#define DMA_LIFCR_CDMEIF3           (1U << 24)
+#define DMA_LIFCR_CTEIF3            (1U << 25)
+#define DMA_LIFCR_CHTIF3            (1U << 26)
+#define DMA_LIFCR_CTCIF3            (1U << 27)
+#define DMA_HISR_TCIF5              (1U << 11)
+#define DMA_HISR_TEIF7              (1U << 25)
+#define DMA_HISR_TCIF7              (1U << 27)
+#define DMA_HIFCR_CFEIF5            (1U << 6)
+#define DMA_HIFCR_CDMEIF5           (1U << 8)
+#define DMA_HIFCR_CTEIF5            (1U << 9)
+#define DMA_HIFCR_CHTIF5            (1U << 10)
+#define DMA_HIFCR_CTCIF5            (1U << 11)
+#define DMA_HIFCR_CFEIF7            (1U << 22)
+#define DMA_HIFCR_CDMEIF7           (1U << 24)
+#define DMA_HIFCR_CTEIF7            (1U << 25)
+#define DMA_HIFCR_CHTIF7            (1U << 26)
+#define DMA_HIFCR_CTCIF7            (1U << 27)
+
+/* Core peripherals */
+#define SCB_ICSR_PENDSTCLR_Msk      (1U << 25)
+#define SCB_ICSR_PENDSTSET_Msk      (1U << 26)
+#define SCB_SCR_SLEEPDEEP_Msk       (1U << 2)
+#define SCB_SCR_SEVONPEND_Msk       (1U << 4)
+#define SysTick_CTRL_ENABLE_Msk     (1U << 0)
+#define SysTick_CTRL_TICKINT_Msk    (1U << 1)
+#define SysTick_CTRL_CLKSOURCE_Msk  (1U << 2)
+#define SysTick_CTRL_COUNTFLAG_Msk  (1U << 16)
+#define SysTick_LOAD_RELOAD_Msk     (0xFFFFFFU)
+#define DWT_CTRL_CYCCNTENA_Msk      (1U << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1U << 24)
+#define PWR_CR_LPDS                 (1U << 0)
+#define PWR_CR_PDDS                 (1U << 1)
+#define PWR_CR_FPDS                 (1U << 9)
+
+/* @brief Starts the SysTick interrupt every ticks core clocks (CMSIS core_cm4.h). */
+static inline uint32_t SysTick_Config(uint32_t ticks) {
+    if ((ticks - 1U) > SysTick_LOAD_RELOAD_Msk) {
+        return 1U;
+    }
+    SysTick->LOAD = ticks - 1U;
+    NVIC_SetPriority(SysTick_IRQn, (1U << __NVIC_PRIO_BITS) - 1U);
+    SysTick->VAL = 0U;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+    return 0U;
+}
+
+#endif /* SIM_STM32F4XX_H_ */
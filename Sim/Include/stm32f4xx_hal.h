@@ -0,0 +1,59 @@
+#ifndef SIM_STM32F4XX_HAL_H_
+#define SIM_STM32F4XX_HAL_H_
+
+/**
+ * @brief The part of the HAL main.c calls (clock setup), for the host build.
+ * HAL_RCC_ClockConfig() derives SystemCoreClock from the PLL settings and
+ * writes the bus prescalers into RCC->CFGR, which the timer and UART
+ * drivers read back.
+ */
+
+#include "stm32f4xx.h"
+
+#define HSE_VALUE   25000000U   /* Crystal of the board */
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+} HAL_StatusTypeDef;
+
+typedef struct {
+    uint32_t PLLState, PLLSource, PLLM, PLLN, PLLP, PLLQ;
+} RCC_PLLInitTypeDef;
+
+typedef struct {
+    uint32_t OscillatorType, HSEState, HSIState, HSICalibrationValue;
+    RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct {
+    uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+#define RCC_OSCILLATORTYPE_HSE      0x00000001U
+#define RCC_HSE_ON                  0x00010000U
+#define RCC_PLL_ON                  0x00000002U
+#define RCC_PLLSOURCE_HSE           0x00400000U
+#define RCC_PLLP_DIV2               0x00000002U
+#define RCC_PLLP_DIV4               0x00000004U
+#define RCC_CLOCKTYPE_SYSCLK        0x00000001U
+#define RCC_CLOCKTYPE_HCLK          0x00000002U
+#define RCC_CLOCKTYPE_PCLK1         0x00000004U
+#define RCC_CLOCKTYPE_PCLK2         0x00000008U
+#define RCC_SYSCLKSOURCE_PLLCLK     0x00000002U
+#define RCC_SYSCLK_DIV1             0x00000000U
+/* APB dividers are the PPRE1 field values */
+#define RCC_HCLK_DIV1               0x00000000U
+#define RCC_HCLK_DIV2               0x00001000U
+#define RCC_HCLK_DIV4               0x00001400U
+#define FLASH_LATENCY_2             0x00000002U
+#define PWR_REGULATOR_VOLTAGE_SCALE2 0x00008000U
+
+#define __HAL_RCC_PWR_CLK_ENABLE()          (RCC->APB1ENR |= RCC_APB1ENR_PWREN)
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(x)  (PWR->CR = (PWR->CR & ~0x0000C000U) | (x))
+
+HAL_StatusTypeDef HAL_Init(void);
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *init);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *init, uint32_t latency);
+
+#endif /* SIM_STM32F4XX_HAL_H_ */
@@ -0,0 +1,39 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+/**
+ * @brief Host unit tests of firmware modules (Sim/Tests/test_*.c).
+ *
+ * Each test is a program linked against the firmware objects it uses and,
+ * where it needs registers or time, the simulator core (sim.h). A failed
+ * check prints its location and the test goes on; Test_Done() prints the
+ * summary in the format of the scenarios and gives the exit status.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern uint32_t test_checks;
+extern uint32_t test_failures;
+
+/* Checks a condition; on failure prints it with a formatted explanation */
+#define CHECK(cond, ...) do { \
+        test_checks++; \
+        if (!(cond)) { \
+            test_failures++; \
+            printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } while (0)
+
+/* Definitions of the counters, once per test program */
+#define TEST_COUNTERS   uint32_t test_checks = 0; uint32_t test_failures = 0
+
+/* @brief Prints "<name>: N checks, M failed" and returns the exit status. */
+static inline int Test_Done(const char *name) {
+    printf("%s: %u checks, %u failed\n", name, (unsigned)test_checks, (unsigned)test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif /* TEST_H_ */
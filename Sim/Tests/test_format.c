@@ -0,0 +1,179 @@
+#include <string.h>
+#include "test.h"
+#include "format.h"
+
+/**
+ * @brief Format_*: padding, '#' for a field too narrow, negative and
+ * exact (unrounded) fixed-point numbers, durations and the end of the
+ * buffer, which no call may write at or past.
+ */
+
+TEST_COUNTERS;
+
+#define GUARD       '~'
+#define BUF_SIZE    32U
+
+static char buf[BUF_SIZE + 8U];
+
+/* Fills the buffer and the guard bytes after it */
+static void clear(void) {
+    memset(buf, GUARD, sizeof buf);
+}
+
+/* Terminates the text written up to end and compares it */
+static void check_text(const char *end, const char *expected, const char *what) {
+    char text[sizeof buf + 1U];
+    size_t len = (size_t)(end - buf);
+
+    memcpy(text, buf, len);
+    text[len] = '\0';
+    CHECK(strcmp(text, expected) == 0, "%s: \"%s\", expected \"%s\"", what, text, expected);
+}
+
+/* Checks that nothing was written from limit on */
+static void check_guard(size_t limit, const char *what) {
+    for (size_t i = limit; i < sizeof buf; i++) {
+        if (buf[i] != GUARD) {
+            CHECK(buf[i] == GUARD, "%s: byte %u written past the end", what, (unsigned)i);
+            return;
+        }
+    }
+}
+
+static void check_uint(uint32_t value, uint8_t width, char pad, const char *expected) {
+    clear();
+    check_text(Format_Uint(buf, buf + BUF_SIZE, value, width, pad), expected, "uint");
+    check_guard(strlen(expected), "uint");
+}
+
+static void check_fixed(int32_t value, uint8_t decimals, uint8_t width, const char *expected) {
+    clear();
+    check_text(Format_Fixed(buf, buf + BUF_SIZE, value, decimals, width), expected, "fixed");
+    check_guard(strlen(expected), "fixed");
+}
+
+static void check_time(uint32_t seconds, const char *expected) {
+    clear();
+    check_text(Format_Time(buf, buf + BUF_SIZE, seconds), expected, "time");
+    check_guard(strlen(expected), "time");
+}
+
+static void check_str(const char *str, uint8_t width, const char *expected) {
+    clear();
+    check_text(Format_Str(buf, buf + BUF_SIZE, str, width), expected, "str");
+    check_guard(strlen(expected), "str");
+}
+
+static void test_padding(void) {
+    check_uint(0, 0, ' ', "0");
+    check_uint(42, 0, ' ', "42");
+    check_uint(42, 5, ' ', "   42");
+    check_uint(42, 5, '0', "00042");
+    check_uint(4294967295U, 0, ' ', "4294967295");
+    check_uint(4294967295U, 10, ' ', "4294967295");
+    check_str("abc", 0, "abc");
+    check_str("abc", 5, "abc  ");
+    check_str("", 3, "   ");
+    check_str("", 0, "");
+}
+
+static void test_width(void) {
+    /* Numbers too wide for their field are replaced, strings are cut */
+    check_uint(12345, 4, ' ', "####");
+    check_uint(10, 1, '0', "#");
+    check_fixed(-100, 1, 4, "####");
+    check_str("abcdef", 3, "abc");
+}
+
+static void test_fixed(void) {
+    check_fixed(25, 1, 0, "2.5");
+    check_fixed(5, 2, 0, "0.05");
+    check_fixed(0, 3, 0, "0.000");
+    check_fixed(123, 0, 0, "123");
+    check_fixed(25, 1, 6, "   2.5");
+    /* Negative numbers, also between -1 and 0 */
+    check_fixed(-25, 1, 0, "-2.5");
+    check_fixed(-5, 2, 0, "-0.05");
+    check_fixed(-25, 1, 6, "  -2.5");
+    check_fixed(-2147483647 - 1, 0, 0, "-2147483648");
+    check_fixed(-2147483647 - 1, 9, 0, "-2.147483648");
+    /* The value is exact: no rounding at a carry, the fraction keeps its zeros */
+    check_fixed(999, 3, 0, "0.999");
+    check_fixed(1000, 3, 0, "1.000");
+    check_fixed(1001, 3, 0, "1.001");
+    check_fixed(99999, 2, 5, "#####");
+    check_fixed(99999, 2, 6, "999.99");
+}
+
+static void test_time(void) {
+    check_time(0, "00:00");
+    check_time(59, "00:59");
+    check_time(61, "01:01");
+    check_time(3599, "59:59");
+    check_time(3600, "1:00:00");
+    check_time(36000U + 62U, "10:01:02");
+    check_time(0xFFFFFFFEU, "1193046:28:14");
+}
+
+static void test_end(void) {
+    char *end = buf + 8;
+    char *p;
+
+    /* A chain that fits stops exactly at end */
+    clear();
+    p = Format_Str(buf, end, "ab", 0);
+    p = Format_Uint(p, end, 123, 6, ' ');
+    check_text(p, "ab   123", "chain to end");
+    check_guard(8, "chain to end");
+
+    /* A field that does not fit fills the rest with '#', later calls write nothing */
+    clear();
+    p = Format_Str(buf, end, "abc", 0);
+    p = Format_Uint(p, end, 1234567U, 0, ' ');
+    CHECK(p == end, "uint past end returns %d, expected end", (int)(p - buf));
+    p = Format_Str(p, end, "\r\n", 0);
+    CHECK(p == end, "str after end returns %d", (int)(p - buf));
+    check_text(p, "abc#####", "uint past end");
+    check_guard(8, "uint past end");
+
+    clear();
+    p = Format_Str(buf, end, "too long for it", 0);
+    check_text(p, "########", "str past end");
+    check_guard(8, "str past end");
+
+    clear();
+    p = Format_Str(buf, end, "abcdef", 0);
+    p = Format_Str(p, end, "xyz", 3);
+    check_text(p, "abcdef##", "str field past end");
+    check_guard(8, "str field past end");
+
+    clear();
+    p = Format_Fixed(buf, end, -12345, 2, 0);
+    check_text(p, "-123.45", "fixed fits");
+    p = Format_Fixed(p, end, -1, 1, 0);
+    check_text(p, "-123.45#", "fixed past end");
+    check_guard(8, "fixed past end");
+
+    clear();
+    p = Format_Str(buf, end, "t ", 0);
+    p = Format_Time(p, end, 36000U);
+    check_text(p, "t ######", "time past end");
+    check_guard(8, "time past end");
+
+    /* An empty buffer takes nothing */
+    clear();
+    p = Format_Uint(buf, buf, 7, 0, ' ');
+    CHECK(p == buf, "empty buffer returns %d", (int)(p - buf));
+    p = Format_Str(buf, buf, "", 0);
+    CHECK(p == buf, "empty string in empty buffer returns %d", (int)(p - buf));
+    check_guard(0, "empty buffer");
+}
+
+int main(void) {
+    test_padding();
+    test_width();
+    test_fixed();
+    test_time();
+    test_end();
+    return Test_Done("test_format");
+}
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "test.h"
+#include "sim.h"
+#include "sim_devices.h"
+#include "board.h"
+#include "delay.h"
+#include "74hc595.h"
+
+/**
+ * @brief 74HC595 driver on the simulated chain (sim_hc595.c), in the
+ * transport of the build: bit-banged, SPI with DMA (HC595_USE_SPI) or
+ * multiplexed digits (HC595_MUX_DIGITS). Numbers and text drawn on the
+ * counter are what the chain shows once the flush is latched (multiplexed:
+ * once the scan has selected every digit), and a flush of an unchanged
+ * frame sends nothing.
+ *
+ * Multiplexed, the refresh interrupt keeps every digit lit at
+ * HC595_MUX_REFRESH_HZ and stays within HC595_MUX_BUDGET_CYCLES (the
+ * simulator charges its register accesses); its longest run is printed.
+ */
+
+TEST_COUNTERS;
+
+/* Time for a flush to show: the burst and its latch, or two scan frames */
+#if HC595_MUX_DIGITS
+#define SHOW_US     (2U * 1000000U / HC595_MUX_REFRESH_HZ)
+#else
+#define SHOW_US     100U
+#endif
+
+static const HC595_Display_t counter = { .first = 0, .count = SIM_HC595_DIGITS, .type = COMMON_ANODE };
+
+static void setup(void) {
+    Sim_Reset();
+    SimHc595_Init();
+    SystemCoreClock = (uint32_t)SIM_CORE_HZ;
+    Delay_Init();
+    Board_PinsInit();
+    HC595_Init();
+    HC595_AddDisplay(&counter);
+}
+
+/* Flushes, waits for the chain to show the frame and checks the digits */
+static void check_shown(const char *expected) {
+    char text[SIM_HC595_DIGITS + 1U];
+
+    HC595_Flush();
+    delay_us(SHOW_US);
+    SimHc595_Text(text);
+    CHECK(strcmp(text, expected) == 0, "counter shows \"%s\", expected \"%s\"", text, expected);
+}
+
+static void test_digits(void) {
+    static const struct {
+        uint32_t number;
+        const char *shown;
+    } numbers[] = {
+        { 0, "  0" }, { 7, "  7" }, { 42, " 42" }, { 100, "100" }, { 999, "999" },
+        { 1000, "999" },    /* Clamped to the digits */
+    };
+
+    check_shown("   ");
+    for (uint32_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        HC595_PutNumber(&counter, numbers[i].number);
+        check_shown(numbers[i].shown);
+    }
+    HC595_PutText(&counter, "-A-");
+    check_shown("-A-");
+    HC595_PutText(&counter, "E");
+    check_shown("E  ");
+
+    /* Nothing changed: nothing sent */
+    CHECK(HC595_Flush() == 0U, "unchanged frame flushed");
+    HC595_PutText(&counter, "E");
+    CHECK(HC595_Flush() == 0U, "redrawn frame flushed");
+}
+
+#if HC595_MUX_DIGITS
+static void test_refresh(void) {
+    HC595_MuxStats_t before, after;
+    uint32_t ms = 1000U;
+
+    HC595_PutNumber(&counter, 123);
+    HC595_Flush();
+    HC595_GetMuxStats(&before);
+    delay_ms(ms);
+    HC595_GetMuxStats(&after);
+    check_shown("123");
+
+    uint32_t ticks = after.ticks - before.ticks;
+    uint32_t expected = HC595_MUX_DIGITS * HC595_MUX_REFRESH_HZ * ms / 1000U;
+    CHECK(ticks + 1U >= expected && ticks <= expected + 1U, "%u refresh interrupts in %u ms, expected %u",
+            ticks, ms, expected);
+    CHECK(after.overruns == 0U, "%u refresh interrupts over %u cycles (longest %u)",
+            after.overruns, HC595_MUX_BUDGET_CYCLES, after.max_cycles);
+
+    printf("hc595 refresh: %u digits at %u Hz, %u interrupts; longest %u cycles "
+            "(%u register accesses) of the %u-cycle budget\n",
+            HC595_MUX_DIGITS, HC595_MUX_REFRESH_HZ, after.ticks, after.max_cycles,
+            after.max_cycles / SIM_ACCESS_CYCLES, HC595_MUX_BUDGET_CYCLES);
+}
+#endif
+
+int main(void) {
+    setup();
+    test_digits();
+#if HC595_MUX_DIGITS
+    test_refresh();
+#endif
+    return Test_Done("test_hc595");
+}
@@ -0,0 +1,279 @@
+#include "test.h"
+#include "sim.h"
+#include "delay.h"
+#include "soft_timer.h"
+#include "task.h"
+
+/**
+ * @brief Tickless idle under random EXTI wake-ups: tasks sleeping and
+ * waiting for an event with a timeout, periodic and one-shot soft timers,
+ * all driven by the loop of main() (SoftTimer_Process, Task_RunAll, then
+ * Delay_Idle(SoftTimer_NextExpiry()) when every task is idle), while edges
+ * on PA0 (EXTI line 0) arrive at random and cut the idle periods short.
+ *
+ * Every wake-up is checked on the tick it is due and, in virtual time,
+ * against its deadline: never before it, and no later than WAKE_LATE_MAX
+ * plus what the idle periods in between left uncounted (IDLE_LOSS_MAX
+ * each, see test_monotonic). A wait ended by an edge must resume within
+ * EDGE_LATE_MAX of it. The worst lateness is printed.
+ */
+
+TEST_COUNTERS;
+
+#define CYCLES_PER_MS   (SIM_CORE_HZ / 1000U)
+/* Most cycles one Delay_Idle() may leave uncounted */
+#define IDLE_LOSS_MAX   (32U * SIM_ACCESS_CYCLES)
+/* Longest time from a deadline to the wake-up, idle losses apart */
+#define WAKE_LATE_MAX   SIM_US(10)
+/* Longest time from an edge to the resumption of the task waiting for it */
+#define EDGE_LATE_MAX   SIM_US(10)
+/* Virtual time the loop runs */
+#define RUN_TIME        SIM_S(20)
+
+#define EDGE_PIN        0U
+#define EDGE_WIDTH      SIM_US(10)
+#define EV_EDGE         0x1U
+
+#define SLEEPERS        3U
+
+/* Random numbers, seeded for a reproducible run (splitmix64) */
+static uint64_t rng = 1;
+
+static uint32_t random_range(uint32_t lo, uint32_t hi) {
+    uint64_t z = (rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return lo + (uint32_t)(z % (uint64_t)(hi - lo + 1U));
+}
+
+/* Idle periods entered so far */
+static uint32_t idles;
+
+/* A wake-up to come: due on a tick and at a point of virtual time */
+typedef struct {
+    uint32_t tick;
+    Sim_Time_t when;
+    uint32_t idles;
+} deadline_t;
+
+/* Worst lateness seen, and the number of wake-ups checked */
+static struct {
+    Sim_Time_t late_max;
+    Sim_Time_t edge_max;
+    uint32_t sleeps;
+    uint32_t timeouts;
+    uint32_t expiries;
+    uint32_t edge_wakes;
+} stats;
+
+/* Sets a deadline ms milliseconds from now, in ticks and in virtual time */
+static void deadline_set(deadline_t *d, uint32_t tick) {
+    /* The firmware's clock may be behind sim_now: the tick falls due when it gets there */
+    Sim_Time_t now = sim_now;
+    uint64_t cycles = monotonic_cycles();
+
+    d->tick = tick;
+    d->when = now + (uint64_t)tick * CYCLES_PER_MS - cycles;
+    d->idles = idles;
+}
+
+/* Checks a wake-up against its deadline */
+static void deadline_check(const deadline_t *d, const char *what) {
+    Sim_Time_t now = sim_now;
+    uint32_t ticks = Get_Ms_Ticks();
+    Sim_Time_t allowed = WAKE_LATE_MAX + (Sim_Time_t)(idles - d->idles) * IDLE_LOSS_MAX;
+
+    CHECK(ticks == d->tick, "%s: woke on tick %u, due %u", what, (unsigned)ticks, (unsigned)d->tick);
+    CHECK(now >= d->when, "%s: woke %llu cycles early (tick %u)", what,
+            (unsigned long long)(d->when - now), (unsigned)d->tick);
+    if (now >= d->when) {
+        Sim_Time_t late = now - d->when;
+        CHECK(late <= allowed, "%s: woke %llu cycles late, %llu allowed (tick %u)", what,
+                (unsigned long long)late, (unsigned long long)allowed, (unsigned)d->tick);
+        stats.late_max = (late > stats.late_max) ? late : stats.late_max;
+    }
+}
+
+/*---------- Edges on PA0 ----------*/
+
+static Sim_Event_t edge_event;
+static uint32_t edges_sent;
+static uint32_t edges_taken;
+/* Virtual time of the last rising edge, and of the first one not yet seen by the listener */
+static Sim_Time_t edge_raised;
+static Sim_Time_t edge_at;
+static bool edge_pending;
+
+/* Raises PA0 for EDGE_WIDTH, then lowers it until the next random edge */
+static void edge_fire(void *arg) {
+    if (!SimGpio_Level(0, EDGE_PIN)) {
+        SimGpio_Drive(0, EDGE_PIN, 1);
+        edge_raised = sim_now;
+        edges_sent++;
+        Sim_Schedule(&edge_event, sim_now + EDGE_WIDTH);
+    } else {
+        SimGpio_Drive(0, EDGE_PIN, 0);
+        Sim_Schedule(&edge_event, sim_now + SIM_US(random_range(100U, 30000U)));
+    }
+}
+
+/*---------- Tasks ----------*/
+
+typedef struct {
+    Task_t task;
+    uint32_t ms;
+    deadline_t due;
+} sleeper_t;
+
+static sleeper_t sleepers[SLEEPERS];
+
+/* Sleeps for random times, each checked against its deadline */
+static void sleeper_task(Task_t *t) {
+    sleeper_t *s = (sleeper_t *)t;
+
+    TASK_BEGIN(t);
+    for (;;) {
+        s->ms = random_range(1U, 150U);
+        deadline_set(&s->due, Get_Ms_Ticks() + s->ms);
+        TASK_SLEEP(t, s->ms);
+        deadline_check(&s->due, "sleep");
+        stats.sleeps++;
+    }
+    TASK_END(t);
+}
+
+static sleeper_t listener;
+
+/* Waits for the edges with a random timeout */
+static void listener_task(Task_t *t) {
+    sleeper_t *s = (sleeper_t *)t;
+
+    TASK_BEGIN(t);
+    for (;;) {
+        s->ms = random_range(1U, 40U);
+        deadline_set(&s->due, Get_Ms_Ticks() + s->ms);
+        TASK_AWAIT_EVENT(t, EV_EDGE, s->ms);
+
+        __disable_irq();
+        if (edge_pending) {
+            /* Woken by an edge (perhaps also timed out at the same time) */
+            Sim_Time_t latency = sim_now - edge_at;
+            CHECK(latency <= EDGE_LATE_MAX, "edge: resumed %llu cycles after it", (unsigned long long)latency);
+            stats.edge_max = (latency > stats.edge_max) ? latency : stats.edge_max;
+            edge_pending = false;
+            stats.edge_wakes++;
+        } else {
+            CHECK(Task_TimedOut(t), "event wait ended without an edge or a timeout");
+            deadline_check(&s->due, "event timeout");
+            stats.timeouts++;
+        }
+        __enable_irq();
+    }
+    TASK_END(t);
+}
+
+void EXTI0_IRQHandler(void) {
+    EXTI->PR = (1U << EDGE_PIN);
+    edges_taken++;
+    if (!edge_pending) {
+        edge_pending = true;
+        edge_at = edge_raised;
+    }
+    Task_Post(&listener.task, EV_EDGE);
+}
+
+/*---------- Soft timers ----------*/
+
+typedef struct {
+    SoftTimer_t timer;
+    deadline_t due;
+    uint32_t period;
+} probe_t;
+
+static probe_t periodic[2];
+static probe_t oneshot;
+
+static void periodic_fire(void *arg) {
+    probe_t *p = arg;
+
+    deadline_check(&p->due, "periodic timer");
+    stats.expiries++;
+    deadline_set(&p->due, p->due.tick + p->period);
+}
+
+/* Restarts itself from its callback with a random delay */
+static void oneshot_fire(void *arg) {
+    probe_t *p = arg;
+    uint32_t ms = random_range(1U, 70U);
+
+    deadline_check(&p->due, "one-shot timer");
+    stats.expiries++;
+    deadline_set(&p->due, Get_Ms_Ticks() + ms);
+    SoftTimer_Start(&p->timer, ms, 0);
+}
+
+static void probe_start(probe_t *p, SoftTimer_Callback_t fire, uint32_t delay, uint32_t period) {
+    SoftTimer_Init(&p->timer, fire, p);
+    p->period = period;
+    deadline_set(&p->due, Get_Ms_Ticks() + delay);
+    SoftTimer_Start(&p->timer, delay, period);
+}
+
+/*---------- Run ----------*/
+
+static void setup(void) {
+    Sim_Reset();
+    SystemCoreClock = (uint32_t)SIM_CORE_HZ;
+    Delay_Init();
+
+    /* PA0 input, rising edges on EXTI line 0 */
+    SimGpio_Drive(0, EDGE_PIN, 0);
+    SYSCFG->EXTICR[0] &= ~0xFU;
+    EXTI->IMR |= (1U << EDGE_PIN);
+    EXTI->RTSR |= (1U << EDGE_PIN);
+    NVIC_EnableIRQ(EXTI0_IRQn);
+    Sim_EventInit(&edge_event, edge_fire, NULL);
+    Sim_Schedule(&edge_event, sim_now + SIM_MS(3));
+
+    for (uint32_t i = 0; i < SLEEPERS; i++) {
+        Task_Start(&sleepers[i].task, sleeper_task, "sleeper");
+    }
+    Task_Start(&listener.task, listener_task, "listener");
+    probe_start(&periodic[0], periodic_fire, 7U, 7U);
+    probe_start(&periodic[1], periodic_fire, 100U, 33U);
+    probe_start(&oneshot, oneshot_fire, 5U, 0U);
+}
+
+/* The loop of main() */
+static void run(Sim_Time_t end) {
+    while (sim_now < end) {
+        SoftTimer_Process();
+        Task_RunAll();
+
+        __disable_irq();
+        if (Task_AllIdle()) {
+            idles++;
+            Delay_Idle(SoftTimer_NextExpiry());
+        }
+        __enable_irq();
+    }
+}
+
+int main(void) {
+    setup();
+    run(sim_now + RUN_TIME);
+
+    CHECK(edges_taken == edges_sent, "%u edges taken of %u", (unsigned)edges_taken, (unsigned)edges_sent);
+    CHECK(stats.sleeps > 0U && stats.timeouts > 0U && stats.edge_wakes > 0U && stats.expiries > 0U,
+            "sleeps %u, timeouts %u, edge wakes %u, expiries %u", (unsigned)stats.sleeps,
+            (unsigned)stats.timeouts, (unsigned)stats.edge_wakes, (unsigned)stats.expiries);
+
+    printf("idle wake-ups: %u sleeps, %u event timeouts, %u timer expiries, %u edges in %u idle periods; "
+            "latest %.2f us after the deadline, %.2f us after an edge\n",
+            (unsigned)stats.sleeps, (unsigned)stats.timeouts, (unsigned)stats.expiries,
+            (unsigned)edges_sent, (unsigned)idles,
+            (double)stats.late_max * 1e6 / (double)SIM_CORE_HZ,
+            (double)stats.edge_max * 1e6 / (double)SIM_CORE_HZ);
+    return Test_Done("test_idle_wake");
+}
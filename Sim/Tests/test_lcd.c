@@ -0,0 +1,596 @@
+#include "test.h"
+#include "sim.h"
+#include "sim_devices.h"
+#include "board.h"
+#include "delay.h"
+#include "lcd_parallel.h"
+#include <string.h>
+
+/**
+ * @brief LCD driver on the simulated HD44780 (sim_lcd.c), in the bus mode
+ * and geometry of the build: 4-bit or 8-bit (LCD8Bit), 16x2 or 20x4,
+ * queued (LCD_USE_ASYNC) or blocking, busy flag (LCD_USE_RW) or fixed
+ * delays. LCD_Flush() sends only the characters that changed, with a DDRAM
+ * address command only where a run of changes does not continue at the
+ * address counter, and the controller ends up showing the framebuffer.
+ * Prints the transfers of a full redraw against typical partial updates.
+ *
+ * The TIM10 sequencer (LCD_USE_ASYNC): nothing is written while the
+ * controller is busy, the E pulses meet the HD44780 timing with RS and the
+ * data lines stable while E is high, a writer waiting on a full queue loses
+ * no byte. Prints the register accesses of a queued redraw (what the
+ * simulator charges time for) against the bus time the blocking path spins
+ * through. The blocking path (LCD_USE_ASYNC=0) meets the same timing;
+ * prints the time a full redraw keeps the caller, waiting on the busy flag
+ * or the fixed delays.
+ *
+ * The data line lookup tables: every byte value, decoded from the pins at
+ * each falling edge of E, arrives as sent, and each nibble (8-bit: byte)
+ * reaches the data lines of a port in a single update. Prints the BSRR
+ * writes this takes against the ODR writes of the per-pin code the tables
+ * replaced.
+ *
+ * The PCF8574 backpack (LCD_BUS_I2C, the I2C2 and DMA model of
+ * sim_periph.c): RS is set before E rises and E falls on its own, batches
+ * larger than a buffer follow each other without a byte lost, and the
+ * interrupt never writes CR1 while a STOP is generated. Without a device at
+ * the address the batches are dropped and nothing waits forever. Prints the
+ * CPU cycles of a redraw against its time on the bus.
+ */
+
+TEST_COUNTERS;
+
+#ifdef LCD8Bit
+#define XFERS           1U      /* Bus transfers (E pulses) per byte */
+#define FIRST_LINE      0U      /* D0 */
+#else
+#define XFERS           2U
+#define FIRST_LINE      4U      /* D4 */
+#endif
+#if LCD_BUS == LCD_BUS_I2C
+/* Bus time of one byte: 4 expander writes of 9 SCL periods (5 where RS changes) */
+#define BYTE_BUS_US     (4U * 9U * 1000000U / LCD_I2C_SPEED_HZ)
+#else
+/* Bus time of one byte queued with the default execution time (1 us sequencer steps + 45 us) */
+#define BYTE_BUS_US     (2U * XFERS - 1U + 45U)
+#endif
+/* LCD_Flush() queues the bytes, something else sends them */
+#define QUEUED          (LCD_BUS == LCD_BUS_I2C || LCD_USE_ASYNC)
+/* Characters on the screen */
+#define CELLS           (LCD_ROWS * LCD_COLS)
+/* HD44780 write timing: E pulse width (PWeh) and E cycle (tcycE) */
+#define NS_CYCLES(ns)   ((Sim_Time_t)(ns) * SIM_CORE_HZ / 1000000000ULL)
+#define E_HIGH_MIN      NS_CYCLES(450)
+#define E_CYCLE_MIN     NS_CYCLES(1000)
+
+/* Data lines of each port, as lcd_config.h wires them */
+#define LINE(port_b, line_b, pin)   (((port_b) == (line_b)) ? (1U << (pin)) : 0U)
+#ifdef LCD8Bit
+#define LOW_MASK(port_b) (LINE(port_b, DATA1_PortB, DATA1_Pin) | LINE(port_b, DATA2_PortB, DATA2_Pin) \
+        | LINE(port_b, DATA3_PortB, DATA3_Pin) | LINE(port_b, DATA4_PortB, DATA4_Pin))
+#else
+#define LOW_MASK(port_b) 0U
+#endif
+#define DATA_MASK(port_b) (LOW_MASK(port_b) \
+        | LINE(port_b, DATA5_PortB, DATA5_Pin) | LINE(port_b, DATA6_PortB, DATA6_Pin) \
+        | LINE(port_b, DATA7_PortB, DATA7_Pin) | LINE(port_b, DATA8_PortB, DATA8_Pin))
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* DDRAM address of the first character of each row */
+static const uint8_t row_base[4] = { 0x00, 0x40, LCD_COLS, 0x40 + LCD_COLS };
+#endif
+
+/* E pulses seen on the bus */
+static struct {
+    bool e;
+    bool read;          /* R/W high: the controller drives the data lines */
+    Sim_Time_t rise;
+    Sim_Time_t min_high;
+    Sim_Time_t min_cycle;
+    uint32_t pulses;
+    uint32_t writes;    /* Transfers latched by the controller */
+    uint32_t unstable;  /* RS or data changed while E was high in a write */
+    uint32_t odr[2];        /* Data bits of ODR of port A, B last seen */
+    uint32_t updates[2];    /* Data line writes of port A, B since the last transfer */
+    uint32_t transfers;     /* Transfers captured */
+    uint32_t split;         /* Of those, reached a port in more than one update */
+    uint32_t data_updates;  /* Data line writes for them */
+} bus = { .min_high = ~0ULL, .min_cycle = ~0ULL };
+
+/* Writes latched while capturing: RS and value, decoded from the pins */
+#define CAPTURE_MAX     2048U
+static struct {
+    bool on;
+    uint32_t count;
+    uint8_t rs[CAPTURE_MAX];
+    uint8_t value[CAPTURE_MAX];
+} capture;
+
+/* What the controller should show: the text drawn, clipped at the row end */
+static char model[LCD_ROWS][LCD_COLS + 1];
+
+/* Value on the data lines: the nibble on D4..D7, or (8-bit) the byte on D0..D7 */
+static uint8_t bus_value(void) {
+    static const struct {
+        uint32_t port;
+        uint32_t pin;
+    } lines[8] = {
+        { DATA1_PortB, DATA1_Pin }, { DATA2_PortB, DATA2_Pin },
+        { DATA3_PortB, DATA3_Pin }, { DATA4_PortB, DATA4_Pin },
+        { DATA5_PortB, DATA5_Pin }, { DATA6_PortB, DATA6_Pin },
+        { DATA7_PortB, DATA7_Pin }, { DATA8_PortB, DATA8_Pin },
+    };
+    uint8_t value = 0;
+
+    for (uint32_t i = FIRST_LINE; i < 8U; i++) {
+        if (SimGpio_Level(lines[i].port ? SIM_PORT_B : SIM_PORT_A, lines[i].pin)) {
+            value |= (uint8_t)(1U << i);
+        }
+    }
+    return (uint8_t)(value >> FIRST_LINE);
+}
+
+/* A write latched on the falling edge of E */
+static void bus_latch(uint32_t levels_b) {
+    bus.writes++;
+    if (capture.on && capture.count < CAPTURE_MAX) {
+        if (bus.updates[0] > 1U || bus.updates[1] > 1U) {
+            bus.split++;
+        }
+        bus.data_updates += bus.updates[0] + bus.updates[1];
+        bus.transfers++;
+        capture.rs[capture.count] = (levels_b >> RS_Pin) & 1U;
+        capture.value[capture.count] = bus_value();
+        capture.count++;
+    }
+    bus.updates[0] = 0;
+    bus.updates[1] = 0;
+}
+
+/* Counts the writes of the data lines of a port: changes of ODR (the levels
+   also change when the lines switch direction, around a busy flag read) */
+static void bus_odr(uint32_t port_b, const GPIO_TypeDef *gpio) {
+    uint32_t odr = gpio->ODR & DATA_MASK(port_b);
+
+    if (odr != bus.odr[port_b]) {
+        bus.odr[port_b] = odr;
+        bus.updates[port_b]++;
+    }
+}
+
+static void bus_watch(uint32_t port, uint32_t before, uint32_t after) {
+    uint32_t changed = before ^ after;
+
+    if (port == SIM_PORT_A) {
+        if (bus.e && !bus.read && (changed & DATA_MASK(0))) {
+            bus.unstable++;
+        }
+        bus_odr(0, GPIOA);
+        return;
+    }
+    if (port != SIM_PORT_B) {
+        return;
+    }
+    bus.read = (after >> RW_Pin) & 1U;
+    bus_odr(1, GPIOB);
+    if (bus.e && !bus.read && (changed & (DATA_MASK(1) | (1U << RS_Pin)))) {
+        bus.unstable++;
+    }
+    if (!(changed & (1U << E_Pin))) {
+        return;
+    }
+    bool was_high = bus.e;
+    bus.e = (after >> E_Pin) & 1U;
+    if (!was_high && !bus.e) {
+        return;     /* Floating high until Board_PinsInit(), then driven low: no pulse */
+    }
+    if (bus.e) {
+        if (bus.pulses && sim_now - bus.rise < bus.min_cycle) {
+            bus.min_cycle = sim_now - bus.rise;
+        }
+        bus.rise = sim_now;
+    } else {
+        if (sim_now - bus.rise < bus.min_high) {
+            bus.min_high = sim_now - bus.rise;
+        }
+        bus.pulses++;
+        if (!bus.read) {
+            bus_latch(after);
+        }
+    }
+}
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* BSRR writes of the data lines: the driver sets or resets every data line
+   of a port in each write, so one line per port counts them */
+static uint32_t data_writes(void) {
+    uint32_t writes = 0;
+
+    for (uint32_t port_b = 0; port_b < 2U; port_b++) {
+        if (DATA_MASK(port_b)) {
+            writes += SimGpio_Writes(port_b ? SIM_PORT_B : SIM_PORT_A,
+                    (uint32_t)__builtin_ctz(DATA_MASK(port_b)));
+        }
+    }
+    return writes;
+}
+#endif
+
+static void model_clear(void) {
+    for (uint32_t row = 0; row < LCD_ROWS; row++) {
+        memset(model[row], ' ', LCD_COLS);
+        model[row][LCD_COLS] = '\0';
+    }
+}
+
+static void setup(void) {
+    Sim_Reset();
+    SimLcd_Init();
+    SimGpio_Watch(bus_watch);
+    SystemCoreClock = (uint32_t)SIM_CORE_HZ;
+    Delay_Init();
+    Board_PinsInit();
+    LCD_Init();
+    LCD_Drain();
+    model_clear();
+}
+
+/* Bytes the controller has executed so far */
+static uint32_t bytes_sent(void) {
+    return SimLcd_Writes();
+}
+
+#if QUEUED
+/* Bytes the sequencer (I2C: the DMA transfers) has clocked out so far */
+static uint32_t bytes_queued(void) {
+    LCD_QueueStats_t stats;
+    LCD_GetQueueStats(&stats);
+    return stats.bytes_sent;
+}
+#endif
+
+/* Draws text at (col, row) into the framebuffer and the model, without flushing */
+static void put(uint8_t col, uint8_t row, const char *text) {
+    LCD_setCursor((char)col, (char)row);
+    LCD_Write((char *)text);
+    for (; *text && col < LCD_COLS; text++, col++) {
+        model[row][col] = *text;
+    }
+}
+
+/* Flushes and waits; checks the transfers against the bytes the controller latched */
+static uint32_t flush(const char *what) {
+    uint32_t before = bytes_sent();
+#if QUEUED
+    uint32_t queued = bytes_queued();
+#endif
+
+    uint32_t transfers = LCD_Flush();
+    LCD_Drain();
+    CHECK(bytes_sent() - before == transfers, "%s: %u transfers, %u bytes latched",
+            what, transfers, bytes_sent() - before);
+#if QUEUED
+    CHECK(bytes_queued() - queued == transfers, "%s: %u transfers, %u bytes sent by the sequencer",
+            what, transfers, bytes_queued() - queued);
+#endif
+    return transfers;
+}
+
+/* Draws text at (col, row) and flushes */
+static uint32_t draw(uint8_t col, uint8_t row, const char *text) {
+    put(col, row, text);
+    return flush(text);
+}
+
+/* Checks what the controller shows against the model, every row */
+static void check_shown(void) {
+    char text[SIM_LCD_COLS + 1U];
+
+    for (uint32_t row = 0; row < SIM_LCD_ROWS; row++) {
+        SimLcd_Row(row, text);
+        CHECK(strcmp(text, model[row]) == 0, "row %u shows \"%s\", expected \"%s\"",
+                row, text, model[row]);
+    }
+}
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* Checks the bus timing seen so far */
+static void check_timing(void) {
+    CHECK(SimLcd_Violations() == 0U, "%u writes while the controller was busy", SimLcd_Violations());
+    CHECK(bus.min_high >= E_HIGH_MIN, "E high for %llu cycles, at least %llu",
+            (unsigned long long)bus.min_high, (unsigned long long)E_HIGH_MIN);
+    CHECK(bus.min_cycle >= E_CYCLE_MIN, "E cycle of %llu cycles, at least %llu",
+            (unsigned long long)bus.min_cycle, (unsigned long long)E_CYCLE_MIN);
+    CHECK(bus.unstable == 0U, "RS or data changed %u times while E was high", bus.unstable);
+}
+#endif
+
+static void test_diff_flush(void) {
+    /* Over the blank screen: the spaces are skipped, an address after each gap
+       (none for the first run: LCD_Init() leaves the address counter at 0) */
+    uint32_t first = draw(0, 0, "Gate closed  000");
+    CHECK(first == 4U + 1U + 6U + 1U + 3U, "row 0 over blanks: %u transfers", first);
+    first = draw(0, 1, "Ready   12:34:56");
+    CHECK(first == 1U + 5U + 1U + 8U, "row 1 over blanks: %u transfers", first);
+    check_shown();
+
+    /* Nothing changed: nothing sent, also when a character is redrawn as it is */
+    CHECK(LCD_Flush() == 0U, "clean flush sent something");
+    CHECK(draw(0, 0, "Gate") == 0U, "unchanged text sent");
+
+    /* One character: address and character */
+    uint32_t one = draw(15, 1, "7");
+    CHECK(one == 2U, "one character: %u transfers", one);
+
+    /* A run: one address, then auto-increment */
+    uint32_t run = draw(13, 0, "123");
+    CHECK(run == 4U, "3-character run: %u transfers", run);
+
+    /* Unchanged characters inside the text are skipped: two runs, two addresses */
+    uint32_t clock = draw(8, 1, "12:35:08");
+    CHECK(clock == 5U, "clock 12:34:57 -> 12:35:08: %u transfers", clock);
+
+    /* Changes on both rows: a new address for the second row */
+    put(5, 0, "open  ");
+    put(0, 1, "Wait ");
+    uint32_t both = flush("two rows");
+    CHECK(both == 1U + 6U + 1U + 5U, "two rows: %u transfers", both);
+    check_shown();
+
+    /* Last column of row 0, then first of row 1: not contiguous in DDRAM */
+    uint32_t wrap = draw(LCD_COLS - 1U, 0, "4");
+    put(0, 1, "w");
+    uint32_t next = flush("row 1 start");
+    CHECK(wrap == 2U && next == 2U, "row end, row start: %u + %u transfers", wrap, next);
+#if LCD_ROWS >= 4
+    /* Row 2 continues row 0 in DDRAM: no address between them */
+    put(LCD_COLS - 2U, 0, "xy");
+    put(0, 2, "z");
+    uint32_t continued = flush("row 0 end, row 2 start");
+    CHECK(continued == 1U + 3U, "row 0 end, row 2 start: %u transfers", continued);
+#endif
+
+    /* After a CGRAM upload the address counter is unknown: the address is sent again */
+    static const uint8_t glyph[8] = { 0x04, 0x0E, 0x1F, 0, 0, 0, 0, 0 };
+    LCD_LoadGlyph(0, glyph);
+    LCD_Drain();
+    uint32_t after_glyph = draw(1, 1, "A");
+    CHECK(after_glyph == 2U, "after a glyph upload: %u transfers", after_glyph);
+
+    /* LCD_Invalidate: everything again, though nothing changed, one address per row */
+    LCD_Invalidate();
+    uint32_t full = flush("full redraw");
+    CHECK(full == LCD_ROWS + CELLS, "full redraw: %u transfers", full);
+    check_shown();
+
+    /* LCD_Clear: spaces over every drawn character, and the clipping at the row end */
+    LCD_Clear();
+    model_clear();
+    put(0, 0, "0123456789abcdefghijXYZ");
+    flush("clear");
+    check_shown();
+
+    /* The status screen clock ticking over */
+    draw(8, 1, "12:35:08");
+    uint32_t second = draw(15, 1, "9");
+    uint32_t minute = draw(12, 1, "6:00");
+    printf("LCD_Flush: full redraw %u transfers (%u us on the bus), one character %u, "
+            "clock second %u, clock minute %u\n", full, full * BYTE_BUS_US, one, second, minute);
+}
+
+/* Solid glyphs in every CGRAM slot, shown on row 0 */
+static void draw_glyphs(void) {
+    static const uint8_t solid[8] = { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F };
+
+    for (uint8_t slot = 0; slot < 8U; slot++) {
+        LCD_LoadGlyph(slot, solid);
+    }
+    LCD_Drain();
+    LCD_Clear();
+    model_clear();
+    for (char slot = 0; slot < 8; slot++) {
+        LCD_Put(slot);
+    }
+    memset(model[0], '#', 8);
+    flush("glyphs");
+    check_shown();
+}
+
+#if LCD_BUS == LCD_BUS_I2C
+/* Shows every printable character, a screenful at a time */
+static void draw_charset(void) {
+    char c = ' ';
+
+    do {
+        for (uint8_t row = 0; row < LCD_ROWS; row++) {
+            for (uint8_t col = 0; col < LCD_COLS; col++) {
+                char text[2] = { c, '\0' };
+                put(col, row, text);
+                c = (c < 0x7E) ? (char)(c + 1) : ' ';
+            }
+        }
+        flush("charset");
+        check_shown();
+    } while (c != ' ');
+}
+
+static void test_i2c(void) {
+    LCD_QueueStats_t stats;
+
+    /* A full redraw: more than one batch, the interrupt and DMA send it */
+    LCD_Invalidate();
+    Sim_Time_t active = Sim_ActiveCycles();
+    Sim_Time_t start = sim_now;
+    uint32_t bytes = flush("i2c redraw");
+    Sim_Time_t cpu_cycles = Sim_ActiveCycles() - active;
+    Sim_Time_t bus_cycles = sim_now - start;
+    check_shown();
+    CHECK(bus_cycles >= SIM_US(bytes * BYTE_BUS_US), "%u bytes in %llu us", bytes,
+            (unsigned long long)(bus_cycles / SIM_US(1)));
+    CHECK(cpu_cycles < bus_cycles / 100U, "%llu CPU cycles for %llu on the bus",
+            (unsigned long long)cpu_cycles, (unsigned long long)bus_cycles);
+
+    /* Glyph uploads fill both buffers: the writer waits, the batches follow each other */
+    LCD_GetQueueStats(&stats);
+    uint32_t waits = stats.full_waits;
+    draw_glyphs();
+    LCD_GetQueueStats(&stats);
+    CHECK(stats.full_waits > waits, "72 bytes queued without waiting");
+
+    draw_charset();
+    CHECK(SimLcd_Violations() == 0U, "%u expander writes out of order or while the controller was busy",
+            SimLcd_Violations());
+
+    /* No backpack at the address: every batch is dropped, nothing hangs */
+    LCD_GetQueueStats(&stats);
+    uint32_t sent = stats.bytes_sent;
+    uint32_t executed = bytes_sent();
+    SimI2c_Attach(1, LCD_I2C_ADDRESS, NULL);
+    LCD_Invalidate();
+    LCD_Flush();
+    LCD_Drain();
+    LCD_GetQueueStats(&stats);
+    CHECK(stats.bytes_sent == sent && bytes_sent() == executed, "%u bytes sent, %u executed without a device",
+            stats.bytes_sent - sent, bytes_sent() - executed);
+
+    printf("LCD I2C: %u-byte redraw in %llu us on the bus for %llu CPU cycles (%.1f register accesses "
+            "per byte)\n", bytes, (unsigned long long)(bus_cycles / SIM_US(1)),
+            (unsigned long long)cpu_cycles, (double)cpu_cycles / SIM_ACCESS_CYCLES / bytes);
+}
+#elif LCD_USE_ASYNC
+static void test_sequencer(void) {
+    LCD_QueueStats_t stats;
+
+    /* A full redraw is queued, not sent: the caller gets the CPU back at once
+       (the simulator charges the register accesses, not the code in between) */
+    LCD_Invalidate();
+    Sim_Time_t active = Sim_ActiveCycles();
+    Sim_Time_t start = sim_now;
+    uint32_t bytes = LCD_Flush();
+    Sim_Time_t flush_cycles = Sim_ActiveCycles() - active;
+    LCD_GetQueueStats(&stats);
+    CHECK(stats.depth > 0U, "full redraw sent before LCD_Flush() returned");
+
+    /* The rest is the sequencer interrupt, 2 per transfer; LCD_Drain() sleeps in between */
+    active = Sim_ActiveCycles();
+    LCD_Drain();
+    Sim_Time_t isr_cycles = Sim_ActiveCycles() - active;
+    Sim_Time_t bus_cycles = sim_now - start;
+    CHECK(bus_cycles >= SIM_US(bytes * BYTE_BUS_US), "%u bytes in %llu us", bytes,
+            (unsigned long long)(bus_cycles / SIM_US(1)));
+    CHECK(flush_cycles + isr_cycles < bus_cycles / 10U, "%llu CPU cycles for %llu on the bus",
+            (unsigned long long)(flush_cycles + isr_cycles), (unsigned long long)bus_cycles);
+
+    /* More than the queue holds: the writer waits for room, every byte arrives */
+    LCD_GetQueueStats(&stats);
+    uint32_t waits = stats.full_waits;
+    draw_glyphs();
+    LCD_GetQueueStats(&stats);
+    CHECK(stats.full_waits > waits, "72 bytes queued without waiting");
+    CHECK(stats.max_depth == LCD_QUEUE_SIZE, "queue filled to %u of %u", stats.max_depth, LCD_QUEUE_SIZE);
+
+    check_timing();
+    printf("LCD sequencer: %u-byte redraw queued with %llu register accesses, then %.1f per byte "
+            "in the interrupt, against %u us spun per byte by the blocking path\n",
+            bytes, (unsigned long long)(flush_cycles / SIM_ACCESS_CYCLES),
+            (double)isr_cycles / SIM_ACCESS_CYCLES / bytes, BYTE_BUS_US);
+}
+#else
+static void test_blocking(void) {
+    /* Glyph uploads and redraws go straight to the bus */
+    draw_glyphs();
+
+    /* A full redraw keeps the caller until the last byte is on the bus */
+    LCD_Invalidate();
+    Sim_Time_t start = sim_now;
+    uint32_t bytes = flush("blocking redraw");
+    Sim_Time_t cycles = sim_now - start;
+    check_shown();
+
+    check_timing();
+    printf("LCD blocking flush (%s): %u-byte redraw in %llu us, %.1f us per byte\n",
+            LCD_USE_RW ? "busy flag" : "fixed delays", bytes,
+            (unsigned long long)(cycles / SIM_US(1)), (double)cycles / SIM_US(1) / bytes);
+}
+#endif
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* Every byte value through the framebuffer, a screenful per flush */
+static void test_lookup_tables(void) {
+    uint32_t errors = 0;
+    uint32_t perpin = 0;
+    uint32_t writes = 0;
+
+    /* Values XOR 0x80: the first cell (0x80) differs from the zeros LCD_Invalidate() leaves */
+    LCD_Invalidate();
+    for (uint32_t group = 0; group * CELLS < 256U; group++) {
+        for (uint32_t i = 0; i < CELLS; i++) {
+            LCD_setCursor((char)(i % LCD_COLS), (char)(i / LCD_COLS));
+            LCD_Put((char)((group * CELLS + i) ^ 0x80U));
+        }
+        capture.on = true;
+        capture.count = 0;
+        bus.updates[0] = 0;
+        bus.updates[1] = 0;
+        uint32_t before = data_writes();
+        uint32_t transfers = LCD_Flush();
+        LCD_Drain();
+        writes += data_writes() - before;
+        capture.on = false;
+
+        /* Each row: its DDRAM address, then its characters */
+        CHECK(transfers == LCD_ROWS + CELLS && capture.count == XFERS * transfers,
+                "group %u: %u transfers, %u captured", group, transfers, capture.count);
+        if (capture.count != XFERS * (LCD_ROWS + CELLS)) {
+            continue;
+        }
+        for (uint32_t k = 0; k < LCD_ROWS + CELLS; k++) {
+            uint32_t row = k / (LCD_COLS + 1U);
+            uint32_t col = k % (LCD_COLS + 1U);
+            uint8_t rs = (col != 0U);
+            uint8_t expected = rs ? (uint8_t)((group * CELLS + row * LCD_COLS + col - 1U) ^ 0x80U)
+                    : (uint8_t)(LCD_CMD_SET_DDRAM_ADDR | row_base[row]);
+            const uint8_t *value = &capture.value[XFERS * k];
+            uint8_t got = (XFERS == 2U) ? (uint8_t)((value[0] << 4) | value[XFERS - 1U]) : value[0];
+            bool rs_ok = true;
+
+            for (uint32_t x = 0; x < XFERS; x++) {
+                rs_ok = rs_ok && capture.rs[XFERS * k + x] == rs;
+                /* The per-pin code: clear both ports, then one OR per line set */
+                perpin += 2U + (uint32_t)__builtin_popcount(value[x]);
+            }
+            if (got != expected || !rs_ok) {
+                if (!errors) {
+                    printf("  group %u, transfer %u: %#04x (RS %u), expected %#04x (RS %u)\n",
+                            group, k, got, capture.rs[XFERS * k], expected, rs);
+                }
+                errors++;
+            }
+        }
+    }
+    CHECK(errors == 0U, "%u bytes wrong on the pins", errors);
+    CHECK(bus.split == 0U, "%u transfers reached a port in several updates", bus.split);
+    CHECK(SimLcd_Violations() == 0U, "%u writes while the controller was busy", SimLcd_Violations());
+
+    printf("LCD data lines: 256 byte values decoded from the pins, %u transfers in %u port updates "
+            "(at most one per port and transfer); %u BSRR writes (%.2f per transfer) where the "
+            "per-pin ODR code makes %u read-modify-writes (%.2f)\n",
+            bus.transfers, bus.data_updates, writes, (double)writes / bus.transfers,
+            perpin, (double)perpin / bus.transfers);
+}
+#endif
+
+int main(void) {
+    setup();
+    test_diff_flush();
+#if LCD_BUS == LCD_BUS_I2C
+    test_i2c();
+#elif LCD_USE_ASYNC
+    test_sequencer();
+    test_lookup_tables();
+#else
+    test_blocking();
+    test_lookup_tables();
+#endif
+    return Test_Done("test_lcd");
+}
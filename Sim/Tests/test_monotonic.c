@@ -0,0 +1,210 @@
+#include "test.h"
+#include "sim.h"
+#include "delay.h"
+
+/**
+ * @brief monotonic_cycles() on the simulator's SysTick: every read lands
+ * between the virtual times before and after the call, so time never goes
+ * backwards, with the reads aligned to every cycle around the reload, with
+ * the tick interrupt taken in the middle of a read, pending behind PRIMASK
+ * (PENDSTSET) or accounted by the tickless idle (COUNTFLAG). Prints the cost
+ * of a read in register accesses.
+ *
+ * Delay_Idle() stops SysTick while it reprograms it and the cycles of that
+ * window are not counted: after each idle period the clock may be behind
+ * the virtual time by up to IDLE_LOSS_MAX more. The loss is printed.
+ *
+ * Delay_ClockChanged(): the core clock halved and restored at every phase
+ * of a millisecond; the clocks never go back, the tick, delay_us() and
+ * monotonic_us() follow the new rate.
+ */
+
+TEST_COUNTERS;
+
+#define CYCLES_PER_MS   (SIM_CORE_HZ / 1000U)
+/* Most cycles one Delay_Idle() may leave uncounted */
+#define IDLE_LOSS_MAX   (32U * SIM_ACCESS_CYCLES)
+
+/* Virtual time of monotonic_cycles() == 0 */
+static Sim_Time_t base;
+static uint64_t last;
+/* Cycles the clock may be behind the virtual time (idle periods so far) */
+static Sim_Time_t slack;
+
+/* Cost of the reads, in simulated cycles */
+static struct {
+    uint64_t reads;
+    uint64_t cycles;
+    Sim_Time_t min;
+    Sim_Time_t max;
+} cost = { 0, 0, ~0ULL, 0 };
+
+/* Reads the clock once and checks it against the virtual time */
+static uint64_t check_read(const char *what) {
+    Sim_Time_t before = sim_now;
+    uint64_t now = monotonic_cycles();
+    Sim_Time_t after = sim_now;
+    Sim_Time_t spent = after - before;
+
+    CHECK(now > last, "%s: %llu after %llu", what, (unsigned long long)now, (unsigned long long)last);
+    CHECK(base + now + slack >= before && base + now <= after,
+            "%s: read %llu, virtual time %llu..%llu", what, (unsigned long long)now,
+            (unsigned long long)(before - base), (unsigned long long)(after - base));
+    last = now;
+    cost.reads++;
+    cost.cycles += spent;
+    cost.min = (spent < cost.min) ? spent : cost.min;
+    cost.max = (spent > cost.max) ? spent : cost.max;
+    return now;
+}
+
+/* Virtual time of the next SysTick reload after now */
+static Sim_Time_t next_tick(void) {
+    return base + ((sim_now - base) / CYCLES_PER_MS + 1U) * CYCLES_PER_MS;
+}
+
+static void setup(void) {
+    Sim_Reset();
+    SystemCoreClock = (uint32_t)SIM_CORE_HZ;
+    Delay_Init();
+    Sim_AdvanceTo(sim_now + 1000U);
+
+    /* The first read sets the origin: VAL is the first register the read touches */
+    Sim_Time_t before = sim_now;
+    uint64_t now = monotonic_cycles();
+    base = before + SIM_ACCESS_CYCLES - now;
+    last = now;
+}
+
+/* Back-to-back reads with the tick interrupt running in between */
+static void test_free_running(void) {
+    Sim_Time_t end = sim_now + 20U * CYCLES_PER_MS;
+    while (sim_now < end) {
+        check_read("free running");
+    }
+}
+
+/* A read started at every cycle around the reload, taken or held pending */
+static void test_reload_phases(void) {
+    for (int32_t phase = -24; phase <= 24; phase++) {
+        Sim_AdvanceTo((Sim_Time_t)((int64_t)next_tick() + phase));
+        check_read("tick taken");
+    }
+    for (int32_t phase = -24; phase <= 24; phase++) {
+        Sim_AdvanceTo((Sim_Time_t)((int64_t)next_tick() + phase));
+        __disable_irq();
+        check_read("tick pending");
+        check_read("tick pending, again");
+        __enable_irq();
+        check_read("tick counted");
+    }
+}
+
+/* Interrupts masked for most of a millisecond across a reload */
+static void test_masked(void) {
+    for (uint32_t i = 0; i < 8U; i++) {
+        Sim_AdvanceTo(next_tick() - CYCLES_PER_MS / 2U + i * 997U);
+        __disable_irq();
+        Sim_Time_t end = sim_now + CYCLES_PER_MS * 9U / 10U;
+        while (sim_now < end) {
+            check_read("masked");
+        }
+        __enable_irq();
+        check_read("unmasked");
+    }
+}
+
+/* Tickless idle: the tick stopped, reprogrammed and its flag read in Delay_Idle */
+static void test_idle(void) {
+    Sim_Time_t lost = 0, lost_max = 0;
+
+    for (uint32_t ms = 2; ms < 12U; ms++) {
+        Sim_AdvanceTo(sim_now + ms * 7919U);
+        __disable_irq();
+        Sim_Time_t behind = sim_now + SIM_ACCESS_CYCLES - (base + check_read("before idle"));
+        slack += IDLE_LOSS_MAX;
+        Delay_Idle(ms);
+        Sim_Time_t before = sim_now;
+        Sim_Time_t loss = before + SIM_ACCESS_CYCLES - (base + check_read("after idle")) - behind;
+        lost += loss;
+        lost_max = (loss > lost_max) ? loss : lost_max;
+        __enable_irq();
+        for (uint32_t i = 0; i < 100U; i++) {
+            check_read("resumed");
+        }
+    }
+    Sim_AdvanceTo(sim_now + 3U * CYCLES_PER_MS);
+    check_read("a tick after idle");
+    printf("Delay_Idle: %llu cycles uncounted per idle period on average, %llu at most\n",
+            (unsigned long long)(lost / 10U), (unsigned long long)lost_max);
+}
+
+/* Checks the rates the delay module uses after a change to clock_hz */
+static void check_rates(uint32_t clock_hz) {
+    uint32_t per_ms = clock_hz / 1000U;
+
+    /* The tick: 10 ms of the new clock */
+    uint32_t ticks = Get_Ms_Ticks();
+    Sim_AdvanceTo(sim_now + 10U * per_ms);
+    uint32_t counted = Get_Ms_Ticks() - ticks;
+    CHECK(counted >= 9U && counted <= 11U, "%u Hz: %u ticks in 10 ms", clock_hz, counted);
+
+    /* delay_us: the wait itself, plus the few accesses of the loop */
+    Sim_Time_t start = sim_now;
+    delay_us(100U);
+    Sim_Time_t spent = sim_now - start;
+    CHECK(spent >= 100U * (clock_hz / 1000000U) && spent <= 100U * (clock_hz / 1000000U) + 8U * SIM_ACCESS_CYCLES,
+            "%u Hz: delay_us(100) took %llu cycles", clock_hz, (unsigned long long)spent);
+
+    /* monotonic_us over 5 ms of the new clock */
+    uint64_t us = monotonic_us();
+    Sim_AdvanceTo(sim_now + 5U * per_ms);
+    uint64_t elapsed = monotonic_us() - us;
+    CHECK(elapsed >= 4990U && elapsed <= 5010U, "%u Hz: monotonic_us advanced %llu over 5 ms",
+            clock_hz, (unsigned long long)elapsed);
+}
+
+/* The core clock halved and restored, at phases across a millisecond */
+static void test_clock_change(void) {
+    const uint32_t clocks[2] = { (uint32_t)SIM_CORE_HZ / 2U, (uint32_t)SIM_CORE_HZ };
+    uint64_t prev_cycles = monotonic_cycles();
+    uint64_t prev_us = monotonic_us();
+    uint32_t backwards = 0;
+
+    for (uint32_t i = 0; i < 40U; i++) {
+        Sim_AdvanceTo(sim_now + 2011U * (i + 1U));
+        SystemCoreClock = clocks[i & 1U];
+        Delay_ClockChanged();
+        for (uint32_t k = 0; k < 200U; k++) {
+            uint64_t cycles = monotonic_cycles();
+            uint64_t us = monotonic_us();
+            backwards += (cycles <= prev_cycles) + (us < prev_us);
+            prev_cycles = cycles;
+            prev_us = us;
+        }
+    }
+    CHECK(backwards == 0U, "%u reads went back across clock changes", backwards);
+
+    SystemCoreClock = clocks[0];
+    Delay_ClockChanged();
+    check_rates(clocks[0]);
+    SystemCoreClock = clocks[1];
+    Delay_ClockChanged();
+    check_rates(clocks[1]);
+}
+
+int main(void) {
+    setup();
+    test_free_running();
+    test_reload_phases();
+    test_masked();
+    test_idle();
+    test_clock_change();
+
+    printf("monotonic_cycles: %llu reads, %.1f register accesses each on average (%llu..%llu)\n",
+            (unsigned long long)cost.reads,
+            (double)cost.cycles / (double)cost.reads / SIM_ACCESS_CYCLES,
+            (unsigned long long)(cost.min / SIM_ACCESS_CYCLES),
+            (unsigned long long)(cost.max / SIM_ACCESS_CYCLES));
+    return Test_Done("test_monotonic");
+}
@@ -0,0 +1,115 @@
+#include "test.h"
+#include "sim.h"
+#include "pwm_timer.h"
+
+/**
+ * @brief PwmTimer_ClockFrom and PwmTimer_Compute: timer clock of each APB
+ * prescaler, prescaler rounding, ARR limits and the settings refused.
+ */
+
+TEST_COUNTERS;
+
+#define HCLK        84000000U
+#define ARR_16      0xFFFFU
+#define ARR_32      0xFFFFFFFFU
+
+/* Computes and checks the register values and the resulting frequency */
+static void check_timing(uint32_t clk, uint32_t freq_hz, uint32_t steps, uint32_t max_arr,
+        uint32_t psc, uint32_t freq_out) {
+    PwmTimer_Timing_t timing = { 0 };
+    bool ok = PwmTimer_Compute(clk, freq_hz, steps, max_arr, &timing);
+
+    CHECK(ok, "%u Hz x %u from %u Hz refused", freq_hz, steps, clk);
+    CHECK(timing.psc == psc, "%u Hz x %u from %u Hz: psc %u, expected %u",
+            freq_hz, steps, clk, timing.psc, psc);
+    CHECK(timing.arr == steps - 1U, "arr %u for %u steps", timing.arr, steps);
+    CHECK(timing.freq_hz == freq_out, "%u Hz x %u from %u Hz: %u Hz, expected %u",
+            freq_hz, steps, clk, timing.freq_hz, freq_out);
+}
+
+static void check_refused(uint32_t clk, uint32_t freq_hz, uint32_t steps, uint32_t max_arr) {
+    PwmTimer_Timing_t timing = { 0 };
+    CHECK(!PwmTimer_Compute(clk, freq_hz, steps, max_arr, &timing),
+            "%u Hz x %u from %u Hz (max ARR %#x) accepted, psc %u",
+            freq_hz, steps, clk, max_arr, timing.psc);
+}
+
+static void test_clock(void) {
+    /* PPRE 0xx: APB not divided, the timers run at HCLK */
+    for (uint32_t ppre = 0; ppre < 4U; ppre++) {
+        CHECK(PwmTimer_ClockFrom(HCLK, ppre) == HCLK, "ppre %u", ppre);
+    }
+    /* Divided: twice the APB clock */
+    CHECK(PwmTimer_ClockFrom(HCLK, 4U) == HCLK, "APB /2");
+    CHECK(PwmTimer_ClockFrom(HCLK, 5U) == HCLK / 2U, "APB /4");
+    CHECK(PwmTimer_ClockFrom(HCLK, 6U) == HCLK / 4U, "APB /8");
+    CHECK(PwmTimer_ClockFrom(HCLK, 7U) == HCLK / 8U, "APB /16");
+    /* The APB clock is rounded down before doubling, as the RCC divides */
+    CHECK(PwmTimer_ClockFrom(25000001U, 5U) == 12500000U, "odd HCLK, APB /4");
+
+    /* Read from RCC: TIM3 on APB1, TIM1 on APB2 */
+    Sim_Reset();
+    SystemCoreClock = HCLK;
+    RCC->CFGR = (5U << RCC_CFGR_PPRE1_Pos) | (0U << RCC_CFGR_PPRE2_Pos);
+    CHECK(PwmTimer_Clock(TIM3) == HCLK / 2U, "TIM3, APB1 /4: %u", PwmTimer_Clock(TIM3));
+    CHECK(PwmTimer_Clock(TIM1) == HCLK, "TIM1, APB2 /1: %u", PwmTimer_Clock(TIM1));
+    RCC->CFGR = (4U << RCC_CFGR_PPRE1_Pos) | (4U << RCC_CFGR_PPRE2_Pos);
+    CHECK(PwmTimer_Clock(TIM3) == HCLK, "TIM3, APB1 /2: %u", PwmTimer_Clock(TIM3));
+    CHECK(PwmTimer_Clock(TIM1) == HCLK, "TIM1, APB2 /2: %u", PwmTimer_Clock(TIM1));
+    CHECK(PwmTimer_Clock((TIM_TypeDef *)0) == 0U, "not a timer");
+}
+
+static void test_compute(void) {
+    /* Servo: 50 Hz x 20000 steps, a 1 us tick at each APB setting */
+    check_timing(PwmTimer_ClockFrom(HCLK, 0U), 50U, 20000U, ARR_16, 83U, 50U);
+    check_timing(PwmTimer_ClockFrom(HCLK, 4U), 50U, 20000U, ARR_16, 83U, 50U);
+    check_timing(PwmTimer_ClockFrom(HCLK, 5U), 50U, 20000U, ARR_16, 41U, 50U);
+    /* RGB: 1 kHz x 1024 steps, divider 82.03 -> 82, 1000.4 Hz reported as 1000 */
+    check_timing(HCLK, 1000U, 1024U, ARR_16, 81U, 1000U);
+    /* 74HC595 OE: 20 kHz x 255 steps, divider 16.47 -> 16, 20588 Hz */
+    check_timing(HCLK, 20000U, 255U, ARR_16, 15U, 20588U);
+}
+
+static void test_rounding(void) {
+    /* The prescaler is the nearest divider; halves round up */
+    check_timing(9U, 1U, 4U, ARR_16, 1U, 1U);      /* 2.25 -> 2 */
+    check_timing(10U, 1U, 4U, ARR_16, 2U, 0U);     /* 2.5  -> 3 */
+    check_timing(11U, 1U, 4U, ARR_16, 2U, 0U);     /* 2.75 -> 3 */
+    check_timing(7U, 1U, 2U, ARR_16, 3U, 0U);      /* 3.5  -> 4 */
+    /* A divider just under 1 rounds up to 1 */
+    check_timing(HCLK, 50000000U, 2U, ARR_16, 0U, HCLK / 2U);   /* 0.84 -> 1 */
+}
+
+static void test_arr_limits(void) {
+    /* 16-bit timers: up to 65536 steps (ARR 0xFFFF) */
+    check_timing(HCLK, 100U, 0x10000U, ARR_16, 12U, 98U);
+    check_refused(HCLK, 100U, 0x10001U, ARR_16);
+    /* 32-bit timers (TIM2/TIM5): past 16 bits */
+    check_timing(HCLK, 100U, 0x10001U, ARR_32, 12U, 98U);
+    check_timing(HCLK, 1U, HCLK, ARR_32, 0U, 1U);
+    /* At least two steps */
+    check_timing(HCLK, 1000U, 2U, ARR_16, 41999U, 1000U);
+    check_refused(HCLK, 1000U, 1U, ARR_16);
+    check_refused(HCLK, 1000U, 0U, ARR_32);
+}
+
+static void test_out_of_range(void) {
+    check_refused(HCLK, 0U, 1000U, ARR_16);             /* No frequency */
+    check_refused(0U, 1000U, 1024U, ARR_16);            /* Timer not clocked */
+    check_refused(HCLK, 100000000U, 2U, ARR_16);        /* Divider 0.42 -> 0 */
+    check_refused(HCLK, 1U, 2U, ARR_16);                /* Divider 42000000 */
+    /* The 16-bit prescaler bounds the divider at 65536 */
+    check_timing(131072U, 1U, 2U, ARR_16, 0xFFFFU, 1U); /* 65536 */
+    check_refused(131073U, 1U, 2U, ARR_16);             /* 65536.5 -> 65537 */
+    /* Frequency x steps = 2^32 must not wrap to 0 in the divider */
+    check_refused(HCLK, 0x10000U, 0x10000U, ARR_32);
+}
+
+int main(void) {
+    test_clock();
+    test_compute();
+    test_rounding();
+    test_arr_limits();
+    test_out_of_range();
+    return Test_Done("test_pwm_timer");
+}
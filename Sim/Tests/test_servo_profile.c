@@ -0,0 +1,126 @@
+#include "test.h"
+#include "servo.h"
+#include <stdlib.h>
+
+/**
+ * @brief Servo_Profile: every planned move is monotonic, stays within the
+ * speed and acceleration limits, ends on the target, and is cut to the
+ * capacity of the output (ending with a step).
+ */
+
+TEST_COUNTERS;
+
+/* Pulse widths over 180 degrees with the default calibration */
+#define SPAN_US     (SERVO_MAX_PULSE_WIDTH_US - SERVO_MIN_PULSE_WIDTH_US)
+/* Written past the end of a profile to catch an overrun */
+#define GUARD       0xBEEFU
+/* Rounding of each frame to a whole microsecond */
+#define ROUND_US    1.0
+
+static uint16_t profile[SERVO_PROFILE_MAX + 8U];
+
+/* Plans a move into profile[] with guard values after max frames */
+static uint16_t plan(uint16_t from_us, uint16_t to_us, const Servo_Limits_t *limits, uint16_t max) {
+    for (uint32_t i = 0; i < sizeof(profile) / sizeof(profile[0]); i++) {
+        profile[i] = GUARD;
+    }
+    return Servo_Profile(from_us, to_us, SPAN_US, limits, profile, max);
+}
+
+/* Checks a move that fits in the profile against every property */
+static void check_move(uint16_t from_us, uint16_t to_us, const Servo_Limits_t *limits) {
+    uint32_t speed_dps = limits->speed_dps ? limits->speed_dps : SERVO_DEFAULT_SPEED_DPS;
+    uint32_t accel_dps2 = limits->accel_dps2 ? limits->accel_dps2 : SERVO_DEFAULT_ACCEL_DPS2;
+    double frame_s = 1.0 / SERVO_PWM_HZ;
+    double us_per_deg = (double)SPAN_US / 180.0;
+    double max_step = speed_dps * us_per_deg * frame_s;
+    double max_accel = accel_dps2 * us_per_deg * frame_s * frame_s
+            * ((limits->shape == SERVO_PROFILE_SCURVE) ? 1.5 : 1.0);
+    int32_t dir = (to_us > from_us) ? 1 : -1;
+    uint16_t n = plan(from_us, to_us, limits, SERVO_PROFILE_MAX);
+
+    CHECK(n > 0U && n < SERVO_PROFILE_MAX, "%u -> %u: %u frames", from_us, to_us, n);
+    if (n == 0U || n >= SERVO_PROFILE_MAX) {
+        return;
+    }
+    CHECK(profile[n - 1U] == to_us, "%u -> %u ends on %u", from_us, to_us, profile[n - 1U]);
+    CHECK(profile[n] == GUARD, "%u -> %u: frame %u written past the end", from_us, to_us, n);
+
+    int32_t prev = from_us;
+    int32_t prev_step = 0;
+    for (uint16_t k = 0; k < n; k++) {
+        int32_t step = ((int32_t)profile[k] - prev) * dir;
+        CHECK(step >= 0, "%u -> %u: frame %u goes back by %d us", from_us, to_us, k, -step);
+        CHECK(step <= max_step + ROUND_US, "%u -> %u: frame %u moves %d us, limit %.1f",
+                from_us, to_us, k, step, max_step);
+        CHECK(abs(step - prev_step) <= max_accel + 2.0 * ROUND_US,
+                "%u -> %u: frame %u changes speed by %d us/frame, limit %.1f",
+                from_us, to_us, k, step - prev_step, max_accel);
+        CHECK(profile[k] >= ((dir > 0) ? from_us : to_us) && profile[k] <= ((dir > 0) ? to_us : from_us),
+                "%u -> %u: frame %u at %u, outside the move", from_us, to_us, k, profile[k]);
+        prev = profile[k];
+        prev_step = step;
+    }
+    /* The last frame lands from at most a ramp-end speed, not a jump */
+    CHECK(prev_step <= max_accel + 2.0 * ROUND_US, "%u -> %u: arrives at %d us/frame",
+            from_us, to_us, prev_step);
+}
+
+static void test_moves(void) {
+    static const Servo_Limits_t cases[] = {
+        { 0, 0, SERVO_PROFILE_TRAPEZOID },      /* Defaults */
+        { 0, 0, SERVO_PROFILE_SCURVE },
+        { 120U, 600U, SERVO_PROFILE_TRAPEZOID },
+        { 120U, 600U, SERVO_PROFILE_SCURVE },
+        { 900U, 20000U, SERVO_PROFILE_TRAPEZOID },
+    };
+    static const uint16_t moves[][2] = {
+        { SERVO_MIN_PULSE_WIDTH_US, SERVO_MAX_PULSE_WIDTH_US },    /* Full travel, cruises */
+        { SERVO_MAX_PULSE_WIDTH_US, SERVO_MIN_PULSE_WIDTH_US },    /* Downwards */
+        { 1500U, 1600U },                                          /* Short: triangle */
+        { 1500U, 1499U },                                          /* 1 us */
+        { 1500U, 1502U },
+    };
+
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (uint32_t m = 0; m < sizeof(moves) / sizeof(moves[0]); m++) {
+            check_move(moves[m][0], moves[m][1], &cases[c]);
+        }
+    }
+}
+
+static void test_no_move(void) {
+    const Servo_Limits_t limits = { 0 };
+
+    CHECK(plan(1500U, 1500U, &limits, SERVO_PROFILE_MAX) == 0U, "already at the target");
+    CHECK(profile[0] == GUARD, "nothing written for a 0-frame move");
+    CHECK(plan(1000U, 2000U, &limits, 0U) == 0U, "no room");
+    CHECK(profile[0] == GUARD, "nothing written without room");
+}
+
+static void test_clipping(void) {
+    /* 1 deg/s over the full travel: 180 s, far more than SERVO_PROFILE_MAX frames */
+    const Servo_Limits_t slow = { 1U, 0, SERVO_PROFILE_TRAPEZOID };
+    uint16_t n = plan(SERVO_MIN_PULSE_WIDTH_US, SERVO_MAX_PULSE_WIDTH_US, &slow, SERVO_PROFILE_MAX);
+
+    CHECK(n == SERVO_PROFILE_MAX, "clipped to %u frames", n);
+    CHECK(profile[SERVO_PROFILE_MAX - 1U] == SERVO_MAX_PULSE_WIDTH_US, "clipped move ends on %u",
+            profile[SERVO_PROFILE_MAX - 1U]);
+    CHECK(profile[SERVO_PROFILE_MAX] == GUARD, "clipped move written past the end");
+    for (uint16_t k = 1; k < n; k++) {
+        CHECK(profile[k] >= profile[k - 1U], "clipped move goes back at frame %u", k);
+    }
+
+    /* A smaller capacity clips the same way */
+    n = plan(SERVO_MIN_PULSE_WIDTH_US, SERVO_MAX_PULSE_WIDTH_US, &slow, 4U);
+    CHECK(n == 4U, "clipped to %u frames of 4", n);
+    CHECK(profile[3] == SERVO_MAX_PULSE_WIDTH_US && profile[4] == GUARD,
+            "4-frame clip: last %u, next %#x", profile[3], profile[4]);
+}
+
+int main(void) {
+    test_moves();
+    test_no_move();
+    test_clipping();
+    return Test_Done("test_servo_profile");
+}
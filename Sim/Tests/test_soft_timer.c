@@ -0,0 +1,172 @@
+#include "test.h"
+#include "soft_timer.h"
+
+/**
+ * @brief Soft timer wheel: expiries on the exact tick across the 2^32 ms
+ * wraparound and through the cascades of every level, with the wheel
+ * driven the way the idle loop does it (sleep SoftTimer_NextExpiry(), then
+ * process).
+ */
+
+TEST_COUNTERS;
+
+/* Millisecond clock of the test, in place of the SysTick count of Delay/ */
+static uint32_t test_ms;
+
+uint32_t Get_Ms_Ticks(void) {
+    return test_ms;
+}
+
+typedef struct {
+    SoftTimer_t timer;
+    uint32_t due;       /* Tick of the next expiry */
+    uint32_t period;
+    uint32_t fired;     /* Number of expiries */
+    uint32_t late;      /* Expiries off their tick */
+} probe_t;
+
+static void probe_fire(void *arg) {
+    probe_t *probe = arg;
+
+    if (test_ms != probe->due) {
+        if (!probe->late) {
+            printf("  expiry at %#x, due %#x\n", (unsigned)test_ms, (unsigned)probe->due);
+        }
+        probe->late++;
+    }
+    probe->fired++;
+    probe->due += probe->period;
+}
+
+/* Starts or restarts a probe (zero-initialized before its first start) */
+static void probe_start(probe_t *probe, uint32_t delay, uint32_t period) {
+    SoftTimer_Stop(&probe->timer);
+    SoftTimer_Init(&probe->timer, probe_fire, probe);
+    probe->due = test_ms + delay;
+    probe->period = period;
+    probe->fired = 0;
+    probe->late = 0;
+    SoftTimer_Start(&probe->timer, delay, period);
+}
+
+/* Runs the wheel as the idle loop does, up to the tick until (at most 2^31 - 1 ahead) */
+static void run_until(uint32_t until) {
+    for (uint32_t steps = 0; (int32_t)(until - test_ms) > 0; steps++) {
+        uint32_t next = SoftTimer_NextExpiry();
+        if (next > until - test_ms) {
+            next = until - test_ms;
+        }
+        test_ms += next;
+        SoftTimer_Process();
+        if (steps > 1000000U) {
+            CHECK(0, "wheel does not settle at %#x", (unsigned)test_ms);
+            return;
+        }
+    }
+}
+
+static void test_wraparound(void) {
+    static probe_t once, periodic, across;
+
+    /* One-shot and periodic timers running through 0xFFFFFFFF -> 0 */
+    test_ms = 0xFFFFFF00U;
+    probe_start(&once, 0x180U, 0U);             /* Due at 0x80 after the wrap */
+    probe_start(&periodic, 7U, 7U);
+    probe_start(&across, 0x1000U, 0x10000U);    /* Level 1, then level 2 */
+    run_until(0x00030000U);
+
+    CHECK(once.fired == 1U && once.late == 0U, "one-shot: %u expiries, %u late", once.fired, once.late);
+    CHECK(!SoftTimer_IsActive(&once.timer), "one-shot still running");
+    CHECK(periodic.fired == (0x30000U + 0x100U) / 7U && periodic.late == 0U,
+            "7 ms period: %u expiries, %u late", periodic.fired, periodic.late);
+    CHECK(across.fired == 3U && across.late == 0U, "64 s period: %u expiries, %u late",
+            across.fired, across.late);
+    SoftTimer_Stop(&periodic.timer);
+    SoftTimer_Stop(&across.timer);
+
+    /* Started on the last tick before the wrap */
+    test_ms = 0xFFFFFFFFU;
+    probe_start(&once, 1U, 0U);
+    run_until(10U);
+    CHECK(once.fired == 1U && once.late == 0U, "1 ms over the wrap: %u expiries, %u late",
+            once.fired, once.late);
+
+    /* Processed in one late call: caught up, due in the past */
+    test_ms = 0xFFFFFFF0U;
+    probe_start(&once, 0x20U, 0U);
+    test_ms = 0x40U;
+    once.due = test_ms;
+    SoftTimer_Process();
+    CHECK(once.fired == 1U && once.late == 0U, "late process over the wrap: %u expiries", once.fired);
+}
+
+static void test_cascade(uint32_t start) {
+    /* Both sides of every level boundary, and parked beyond the wheel */
+    static const uint32_t delays[] = {
+        0U, 1U, 63U, 64U, 65U, 127U, 128U,
+        4095U, 4096U, 4097U, 4096U * 3U + 17U,
+        262143U, 262144U, 262145U, 262144U * 5U + 4099U,
+        16777215U, 16777216U, 16777217U, 16777216U * 3U + 262147U,
+        SOFT_TIMER_MAX_DELAY / 64U, SOFT_TIMER_MAX_DELAY,
+    };
+    static probe_t probes[sizeof(delays) / sizeof(delays[0])];
+    const uint32_t count = sizeof(delays) / sizeof(delays[0]);
+
+    test_ms = start;
+    for (uint32_t i = 0; i < count; i++) {
+        probe_start(&probes[i], delays[i], 0U);
+    }
+    run_until(start + SOFT_TIMER_MAX_DELAY);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(probes[i].fired == 1U && probes[i].late == 0U,
+                "from %#x, %u ms: %u expiries, %u late",
+                (unsigned)start, (unsigned)delays[i], probes[i].fired, probes[i].late);
+    }
+    CHECK(SoftTimer_NextExpiry() == SOFT_TIMER_MAX_DELAY, "timers left");
+}
+
+/* Random starts, restarts and stops against the expected expiry ticks */
+static void test_random(void) {
+    static probe_t probes[64];
+    uint32_t seed = 12345U;
+
+    test_ms = 0xFFF00000U;
+    for (uint32_t i = 0; i < 64U; i++) {
+        probe_start(&probes[i], 0U, 0U);
+        SoftTimer_Stop(&probes[i].timer);
+    }
+    uint32_t total = 0;
+
+    for (uint32_t round = 0; round < 2000U; round++) {
+        seed = seed * 1103515245U + 12345U;
+        probe_t *probe = &probes[(seed >> 8) & 63U];
+        /* 1 ms up: a timer started with no delay runs on the next tick processed */
+        uint32_t delay = ((seed >> 12) & ((1U << (((seed >> 4) & 15U) + 6U)) - 1U)) + 1U;
+        uint32_t fired = probe->fired;
+        uint32_t late = probe->late;
+
+        if (((seed >> 16) & 7U) == 0U) {
+            SoftTimer_Stop(&probe->timer);
+        } else {
+            probe_start(probe, delay, ((seed >> 19) & 1U) ? delay : 0U);
+        }
+        probe->fired += fired;
+        probe->late += late;
+        run_until(test_ms + ((seed >> 20) & 0x3FFU));
+    }
+    for (uint32_t i = 0; i < 64U; i++) {
+        CHECK(probes[i].late == 0U, "timer %u: %u late expiries", i, probes[i].late);
+        SoftTimer_Stop(&probes[i].timer);
+        total += probes[i].fired;
+    }
+    CHECK(total > 2000U, "only %u expiries", total);
+}
+
+int main(void) {
+    test_wraparound();
+    test_cascade(0U);
+    test_cascade(0xFFFFFFFFU - 300000U);    /* Wraps during the level 2 cascades */
+    test_cascade(0x80000000U - 5U);         /* The signed comparisons flip on the way */
+    test_random();
+    return Test_Done("test_soft_timer");
+}
@@ -0,0 +1,225 @@
+#include "test.h"
+#include "task.h"
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Cooperative tasks: resume order of TASK_YIELD, blocking event
+ * waits and their timeouts, sleeps on the timer wheel; then the cost of a
+ * switch on the host: a yield resumed by Task_RunAll(), an event posted and
+ * the waiting task resumed, a blocked task skipped, against a plain call
+ * through a function pointer. The times are for the host CPU (same -O2
+ * build as the simulator), useful to compare, not Cortex-M4 cycles.
+ */
+
+TEST_COUNTERS;
+
+/* Millisecond clock of the test, in place of the SysTick count of Delay/ */
+static uint32_t test_ms;
+
+uint32_t Get_Ms_Ticks(void) {
+    return test_ms;
+}
+
+static void advance_ms(uint32_t ms) {
+    test_ms += ms;
+    SoftTimer_AdvanceTo(test_ms);
+}
+
+/*---------- Behaviour ----------*/
+
+static char order[16];
+static uint32_t order_len;
+
+static void order_task(Task_t *t) {
+    static uint8_t rounds[3];
+    uint8_t *round = &rounds[t->name[0] - 'A'];
+
+    TASK_BEGIN(t);
+    for (*round = 0; *round < 3U; (*round)++) {
+        order[order_len++] = t->name[0];
+        TASK_YIELD(t);
+    }
+    TASK_END(t);
+}
+
+static uint32_t waiter_runs;
+static uint32_t waiter_got;
+static bool waiter_timed_out;
+
+static void waiter_task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        waiter_runs++;
+        TASK_AWAIT_EVENT(t, 0x3U, 10U);
+        waiter_timed_out = Task_TimedOut(t);
+        waiter_got++;
+    }
+    TASK_END(t);
+}
+
+static uint32_t sleeper_woke;
+
+static void sleeper_task(Task_t *t) {
+    TASK_BEGIN(t);
+    TASK_SLEEP(t, 5U);
+    sleeper_woke = test_ms;
+    TASK_END(t);
+}
+
+static void test_behaviour(void) {
+    static Task_t a, b, c, waiter, sleeper;
+
+    Task_Start(&a, order_task, "A");
+    Task_Start(&b, order_task, "B");
+    Task_Start(&c, order_task, "C");
+    for (uint32_t pass = 0; pass < 5U; pass++) {
+        Task_RunAll();
+    }
+    order[order_len] = '\0';
+    CHECK(strcmp(order, "ABCABCABC") == 0, "resume order %s", order);
+    CHECK((a.flags & b.flags & c.flags & TASK_FLAG_DONE) != 0U, "tasks not done");
+
+    /* Blocked: not run again until an awaited event is posted */
+    Task_Start(&waiter, waiter_task, "waiter");
+    Task_RunAll();
+    Task_RunAll();
+    CHECK(waiter_runs == 1U && (waiter.flags & TASK_FLAG_WAITING), "waiter ran %u times", waiter_runs);
+    CHECK(Task_AllIdle(), "blocked task counted as ready");
+    Task_Post(&waiter, 0x4U);      /* Not awaited */
+    CHECK(waiter.flags & TASK_FLAG_WAITING, "woken by an event it does not wait for");
+    Task_Post(&waiter, 0x2U);
+    CHECK(!Task_AllIdle(), "posted task still idle");
+    Task_RunAll();
+    CHECK(waiter_got == 1U && !waiter_timed_out, "event: got %u, timed out %d", waiter_got, waiter_timed_out);
+    CHECK(waiter.events == 0x4U, "events left %#x", (unsigned)waiter.events);
+
+    /* Timeout: 10 ms without an event */
+    advance_ms(9U);
+    Task_RunAll();
+    CHECK(waiter_got == 1U, "woken before the timeout");
+    advance_ms(1U);
+    Task_RunAll();
+    CHECK(waiter_got == 2U && waiter_timed_out, "timeout: got %u, timed out %d", waiter_got, waiter_timed_out);
+
+    /* Sleep: skipped until the wheel timer ends it */
+    Task_Start(&sleeper, sleeper_task, "sleeper");
+    uint32_t start = test_ms;
+    Task_RunAll();
+    for (uint32_t ms = 0; ms < 8U; ms++) {
+        advance_ms(1U);
+        Task_RunAll();
+    }
+    CHECK(sleeper_woke == start + 5U, "slept %u ms", sleeper_woke - start);
+    CHECK(sleeper.flags & TASK_FLAG_DONE, "sleeper not done");
+
+    /* Leave the waiter blocked with no timeout for the benchmarks */
+    Task_Post(&waiter, 0x1U);
+    Task_RunAll();
+    Task_Post(&waiter, 0x1U);
+    Task_RunAll();
+}
+
+/*---------- Cost of a switch ----------*/
+
+#define BENCH_TASKS     8U
+#define BENCH_PASSES    2000000U
+
+static volatile uint32_t bench_count;
+static bool bench_stop;
+
+static void yield_task(Task_t *t) {
+    TASK_BEGIN(t);
+    while (!bench_stop) {
+        bench_count++;
+        TASK_YIELD(t);
+    }
+    TASK_END(t);
+}
+
+static void event_task(Task_t *t) {
+    TASK_BEGIN(t);
+    for (;;) {
+        TASK_AWAIT_EVENT(t, 0x1U, TASK_FOREVER);
+        bench_count++;
+    }
+    TASK_END(t);
+}
+
+static void plain_call(Task_t *t) {
+    (void)t;
+    bench_count++;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void test_bench(void) {
+    static Task_t yielders[BENCH_TASKS], events;
+    Task_Fn_t volatile call = plain_call;
+    Task_t dummy;
+    double t0, yield_ns, call_ns, event_ns, skip_ns, primask_ns;
+
+    /* Resumed after TASK_YIELD: BENCH_TASKS per pass */
+    for (uint32_t i = 0; i < BENCH_TASKS; i++) {
+        Task_Start(&yielders[i], yield_task, "yield");
+    }
+    Task_RunAll();
+    bench_count = 0;
+    t0 = now_ns();
+    for (uint32_t pass = 0; pass < BENCH_PASSES; pass++) {
+        Task_RunAll();
+    }
+    yield_ns = (now_ns() - t0) / ((double)BENCH_PASSES * BENCH_TASKS);
+    CHECK(bench_count == BENCH_PASSES * BENCH_TASKS, "%u resumes", bench_count);
+    bench_stop = true;
+    Task_RunAll();
+
+    /* The same number of plain indirect calls */
+    t0 = now_ns();
+    for (uint32_t i = 0; i < BENCH_PASSES * BENCH_TASKS; i++) {
+        call(&dummy);
+    }
+    call_ns = (now_ns() - t0) / ((double)BENCH_PASSES * BENCH_TASKS);
+
+    /* Every task done or blocked: a pass only skips them (5 from the behaviour tests) */
+    t0 = now_ns();
+    for (uint32_t pass = 0; pass < BENCH_PASSES; pass++) {
+        Task_RunAll();
+    }
+    skip_ns = (now_ns() - t0) / ((double)BENCH_PASSES * (BENCH_TASKS + 5U));
+
+    /* Event posted, waiting task resumed and blocked again */
+    Task_Start(&events, event_task, "event");
+    Task_RunAll();
+    bench_count = 0;
+    t0 = now_ns();
+    for (uint32_t pass = 0; pass < BENCH_PASSES; pass++) {
+        Task_Post(&events, 0x1U);
+        Task_RunAll();
+    }
+    event_ns = (now_ns() - t0) / (double)BENCH_PASSES;
+    CHECK(bench_count == BENCH_PASSES, "%u event resumes", bench_count);
+
+    /* The event path saves and restores PRIMASK five times (simulated here) */
+    t0 = now_ns();
+    for (uint32_t i = 0; i < BENCH_PASSES; i++) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        __set_PRIMASK(primask);
+    }
+    primask_ns = (now_ns() - t0) / (double)BENCH_PASSES * 5.0;
+
+    printf("task switch (host ns): yield %.1f, plain call %.1f, blocked skip %.1f, "
+            "event post+resume %.1f (of which simulated PRIMASK %.1f)\n",
+            yield_ns, call_ns, skip_ns, event_ns, primask_ns);
+}
+
+int main(void) {
+    test_behaviour();
+    test_bench();
+    return Test_Done("test_task");
+}
@@ -0,0 +1,70 @@
+#include "sim_devices.h"
+#include "board.h"
+#include "delay.h"
+#include "profiler.h"
+#include "74hc595.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief 74HC595 flush benchmark: times HC595_Bench() (the code of the
+ * "hc595 bench" console command) for chains of 3, 8 and HC595_BENCH_MAX
+ * registers in the transport of the build, and prints one line of JSON:
+ * cycles until the CPU is free and until the frame is latched. Needs
+ * PROFILE_ENABLE (the profile and profile_wired boards).
+ *
+ * The cycles are virtual: the simulator charges SIM_ACCESS_CYCLES per
+ * register access and nothing for the instructions in between, so the
+ * bit-banged figures leave out the delay loops of the clock and latch
+ * pulses and are lower bounds. On the board, "hc595 bench" measures them.
+ *
+ * Usage: hc595
+ * Exit status: 0, or 1 if the counter lost its digits to the padding.
+ */
+
+#if !PROFILE_ENABLE || HC595_MUX_DIGITS
+#error "hc595 bench needs PROFILE_ENABLE and the static chain"
+#endif
+
+static const HC595_Display_t counter = { .first = 0, .count = SIM_HC595_DIGITS, .type = COMMON_ANODE };
+
+int main(void) {
+    static const uint8_t lengths[] = { 3, 8, HC595_BENCH_MAX };
+    const char *sep = "";
+    int status = 0;
+
+    Sim_Reset();
+    SimHc595_Init();
+    SystemCoreClock = (uint32_t)SIM_CORE_HZ;
+    Delay_Init();
+    Board_PinsInit();
+    Prof_Init();
+    HC595_Init();
+    HC595_AddDisplay(&counter);
+    HC595_PutNumber(&counter, 123);
+    HC595_Flush();
+
+    printf("{\"bench\": \"hc595\", \"transport\": \"%s\", \"cycle_model\": "
+            "\"%u per register access, delay loops free\", \"flushes\": [",
+            HC595_USE_SPI ? "spi_dma" : "bitbang", SIM_ACCESS_CYCLES);
+    for (uint32_t k = 0; k < sizeof(lengths); k++) {
+        uint32_t cpu, total;
+        char text[SIM_HC595_DIGITS + 1U];
+
+        if (!HC595_Bench(lengths[k], &cpu, &total)) {
+            continue;
+        }
+        delay_us(100);
+        SimHc595_Text(text);
+        if (strcmp(text, "123") != 0) {
+            fprintf(stderr, "hc595: counter shows \"%s\" after a %u-register flush\n", text,
+                    (unsigned)lengths[k]);
+            status = 1;
+        }
+        printf("%s{\"registers\": %u, \"cpu_cycles\": %u, \"total_cycles\": %u}",
+                sep, (unsigned)lengths[k], (unsigned)cpu, (unsigned)total);
+        sep = ", ";
+    }
+    printf("]}\n");
+    return status;
+}
@@ -0,0 +1,125 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+/**
+ * @brief Host simulator of the gate controller: core, virtual time and
+ * peripheral models.
+ *
+ * The firmware runs unmodified on the host, linked against Sim/Include
+ * instead of CMSIS. Time is virtual: it is counted in core clock cycles and
+ * only moves when the firmware touches a peripheral (a few cycles per
+ * access), waits in a polling loop the models can see through (SPI, USART)
+ * or sleeps in WFI, where it jumps straight to the next scheduled event.
+ * A day of gate operation therefore runs in seconds and every run is
+ * exactly reproducible.
+ *
+ * Interrupts are taken between two peripheral accesses, by priority, when
+ * PRIMASK allows it; the handlers are the firmware's own.
+ */
+
+#include "stm32f4xx.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Core clock the firmware configures (SystemClock_Config), unit of virtual time */
+#define SIM_CORE_HZ         84000000ULL
+/* Cycles charged for one peripheral register access */
+#define SIM_ACCESS_CYCLES   4U
+
+typedef uint64_t Sim_Time_t;    /* Core clock cycles since reset */
+
+#define SIM_US(us)  ((Sim_Time_t)(us) * (SIM_CORE_HZ / 1000000ULL))
+#define SIM_MS(ms)  ((Sim_Time_t)(ms) * (SIM_CORE_HZ / 1000ULL))
+#define SIM_S(s)    ((Sim_Time_t)(s) * SIM_CORE_HZ)
+
+/* Something that happens at a point of virtual time (owned by the caller) */
+typedef struct Sim_Event {
+    Sim_Time_t when;
+    void (*fire)(void *arg);
+    void *arg;
+    struct Sim_Event *next;
+    bool queued;
+} Sim_Event_t;
+
+/* Current virtual time */
+extern Sim_Time_t sim_now;
+
+/* @brief Sets the callback of an event. */
+void Sim_EventInit(Sim_Event_t *event, void (*fire)(void *arg), void *arg);
+
+/* @brief Schedules an event (moves it if already queued). */
+void Sim_Schedule(Sim_Event_t *event, Sim_Time_t when);
+
+/* @brief Removes an event from the queue (no effect if not queued). */
+void Sim_Cancel(Sim_Event_t *event);
+
+/* @brief Lets time pass up to when, as a polling loop would: events and interrupts run. */
+void Sim_AdvanceTo(Sim_Time_t when);
+
+/* @brief Cycles the core has spent sleeping in WFI. */
+Sim_Time_t Sim_SleepCycles(void);
+
+/* @brief Cycles the core has been running (not sleeping in WFI). */
+Sim_Time_t Sim_ActiveCycles(void);
+
+/* @brief Marks the interrupt request levels as changed (re-evaluated at the next access). */
+void Sim_IrqChanged(void);
+
+/* @brief Reports an unrecoverable simulation error and exits. */
+void Sim_Fatal(const char *format, ...) __attribute__((format(printf, 1, 2), noreturn));
+
+/* @brief Resets the core and the peripherals to their power-on state. */
+void Sim_Reset(void);
+
+/*---------- Peripheral models (sim_periph.c) ----------*/
+
+/* GPIO port index of a port (0 = GPIOA) */
+#define SIM_PORT_INDEX(port)    ((uint32_t)(((uintptr_t)(port) - (uintptr_t)&sim_gpio[0]) / sizeof(Sim_GpioSlot_t)))
+
+/* Callback of a device watching the pins: levels of a port before and after */
+typedef void (*SimGpio_Watcher_t)(uint32_t port, uint32_t before, uint32_t after);
+
+/* @brief Registers a device that sees every change of pin levels. */
+void SimGpio_Watch(SimGpio_Watcher_t watcher);
+
+/* @brief Drives a pin from outside the MCU (level 0/1), or releases it (level < 0). */
+void SimGpio_Drive(uint32_t port, uint32_t pin, int level);
+
+/* @brief Returns the level of a pin (output, device drive or pull). */
+bool SimGpio_Level(uint32_t port, uint32_t pin);
+
+/* @brief Returns the number of BSRR writes since reset that set or reset a pin. */
+uint32_t SimGpio_Writes(uint32_t port, uint32_t pin);
+
+/* @brief Connects a device to an SPI: exchange() gets each byte sent and returns the byte received. */
+void SimSpi_Attach(uint32_t index, uint8_t (*exchange)(uint8_t out));
+
+/* @brief Connects a device to an I2C bus at a 7-bit address: write() gets each data byte. */
+void SimI2c_Attach(uint32_t index, uint8_t address, void (*write)(uint8_t byte));
+
+/* @brief Connects a receiver to the transmit line of the service USART. */
+void SimUart_Attach(void (*receive)(char c));
+
+/* @brief Queues characters on the receive line of the service USART (one per frame time). */
+void SimUart_Inject(const char *text);
+
+/* Callback of a compare register change: timer (SIM_TIMx), channel 1..4, new value */
+typedef void (*SimTim_Watcher_t)(uint32_t timer, uint32_t channel, uint32_t ccr);
+
+/* @brief Registers a device that sees the compare register writes (PWM outputs). */
+void SimTim_Watch(SimTim_Watcher_t watcher);
+
+/* @brief Returns 1 while TIM1 plays frames from DMA, bringing CCR1-CCR3 up to date. */
+bool SimRgb_Animating(void);
+
+/* Internal: used by the core */
+void SimPeriph_Reset(void);
+void SimPeriph_Reconcile(void *regs);
+void SimPeriph_ReconcilePlain(void);
+void SimPeriph_Present(void *regs);
+bool SimPeriph_IrqLevel(int32_t irq);
+void SimPeriph_IrqTaken(int32_t irq);
+bool SimPeriph_SysTickPending(void);
+void SimPeriph_SysTickTaken(void);
+
+#endif /* SIM_H_ */
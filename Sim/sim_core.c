@@ -0,0 +1,449 @@
+#include "sim.h"
+#include "stm32f4xx_hal.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Interrupts taken at one point of virtual time before it counts as a storm */
+#define SIM_IRQ_STORM_LIMIT     100000U
+/* Priority level of thread mode (below every exception) */
+#define SIM_THREAD_PRIORITY     0x100U
+/* Exception number of an IRQn (SysTick = 15) */
+#define SIM_EXCEPTION(irq)      ((irq) + 16)
+
+Sim_Time_t sim_now;
+volatile uint32_t sim_primask;
+
+static Sim_Time_t sim_sleep;
+static Sim_Event_t *sim_queue;
+
+/* NVIC: enable and priority of every exception from SysTick on */
+static bool sim_nvic_enabled[SIM_IRQ_COUNT + 1];
+static uint8_t sim_nvic_priority[SIM_IRQ_COUNT + 1];
+/* Enabled interrupts, SysTick first (always enabled) */
+static int32_t sim_enabled[SIM_IRQ_COUNT + 1];
+static uint32_t sim_enabled_count;
+
+/* Priority of the running handler (SIM_THREAD_PRIORITY in thread mode) */
+static uint32_t sim_active_priority = SIM_THREAD_PRIORITY;
+static bool sim_irq_dirty = true;
+static int32_t sim_current_irq;
+static Sim_Time_t sim_storm_time;
+static uint32_t sim_storm_count;
+
+/* Register block accessed last: a write to it is seen at the next access */
+static void *sim_last_regs;
+
+/*---------- Clock tree and HAL ----------*/
+
+uint32_t SystemCoreClock = 16000000U;   /* HSI until SystemClock_Config() */
+const uint8_t AHBPrescTable[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9 };
+const uint8_t APBPrescTable[8] = { 0, 0, 0, 0, 1, 2, 3, 4 };
+
+static uint32_t sim_pll_hz;
+
+HAL_StatusTypeDef HAL_Init(void) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *init) {
+    if (init->PLL.PLLState != RCC_PLL_ON || init->PLL.PLLM == 0 || init->PLL.PLLP == 0) {
+        return HAL_ERROR;
+    }
+    sim_pll_hz = (uint32_t)((uint64_t)HSE_VALUE / init->PLL.PLLM * init->PLL.PLLN / init->PLL.PLLP);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *init, uint32_t latency) {
+    (void)latency;
+    if (init->SYSCLKSource != RCC_SYSCLKSOURCE_PLLCLK || sim_pll_hz != SIM_CORE_HZ) {
+        /* Virtual time is counted in cycles of the 84 MHz clock the board runs at */
+        Sim_Fatal("clock configuration: core clock %lu Hz, the simulator runs at %llu Hz",
+                (unsigned long)sim_pll_hz, (unsigned long long)SIM_CORE_HZ);
+    }
+    SystemCoreClock = sim_pll_hz >> AHBPrescTable[(init->AHBCLKDivider >> RCC_CFGR_HPRE_Pos) & 0xFU];
+    RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2))
+            | init->AHBCLKDivider | init->APB1CLKDivider | (init->APB2CLKDivider << 3);
+    return HAL_OK;
+}
+
+/*---------- Events ----------*/
+
+/**
+ * @brief Sets the callback of an event.
+ */
+void Sim_EventInit(Sim_Event_t *event, void (*fire)(void *arg), void *arg) {
+    event->fire = fire;
+    event->arg = arg;
+    event->next = NULL;
+    event->queued = false;
+}
+
+/**
+ * @brief Removes an event from the queue (no effect if not queued).
+ */
+void Sim_Cancel(Sim_Event_t *event) {
+    if (!event->queued) {
+        return;
+    }
+    for (Sim_Event_t **p = &sim_queue; *p; p = &(*p)->next) {
+        if (*p == event) {
+            *p = event->next;
+            break;
+        }
+    }
+    event->queued = false;
+}
+
+/**
+ * @brief Schedules an event (moves it if already queued). Events due at the
+ * same time fire in the order they were scheduled.
+ */
+void Sim_Schedule(Sim_Event_t *event, Sim_Time_t when) {
+    Sim_Cancel(event);
+    if (when < sim_now) {
+        when = sim_now;
+    }
+    event->when = when;
+    Sim_Event_t **p = &sim_queue;
+    while (*p && (*p)->when <= when) {
+        p = &(*p)->next;
+    }
+    event->next = *p;
+    *p = event;
+    event->queued = true;
+}
+
+/**
+ * @brief Fires every event due at the current time.
+ */
+static void sim_fireDue(void) {
+    while (sim_queue && sim_queue->when <= sim_now) {
+        Sim_Event_t *event = sim_queue;
+        sim_queue = event->next;
+        event->queued = false;
+        event->fire(event->arg);
+    }
+}
+
+/*---------- Interrupts ----------*/
+
+/**
+ * @brief Marks the interrupt request levels as changed.
+ */
+void Sim_IrqChanged(void) {
+    sim_irq_dirty = true;
+}
+
+void Sim_NvicEnable(IRQn_Type irq, int enable) {
+    if (irq < 0 || irq >= SIM_IRQ_COUNT) {
+        return;
+    }
+    sim_nvic_enabled[SIM_EXCEPTION(irq) - 15] = enable != 0;
+
+    /* Rebuild the list of enabled interrupts, SysTick first */
+    sim_enabled_count = 0;
+    sim_enabled[sim_enabled_count++] = SysTick_IRQn;
+    for (int32_t i = 0; i < SIM_IRQ_COUNT; i++) {
+        if (sim_nvic_enabled[i + 1]) {
+            sim_enabled[sim_enabled_count++] = i;
+        }
+    }
+    sim_irq_dirty = true;
+}
+
+void Sim_NvicSetPriority(IRQn_Type irq, uint32_t priority) {
+    if (irq >= SysTick_IRQn && irq < SIM_IRQ_COUNT) {
+        sim_nvic_priority[irq + 1] = (uint8_t)(priority & ((1U << __NVIC_PRIO_BITS) - 1U));
+    }
+}
+
+/**
+ * @brief Returns 1 if an interrupt requests service (enabled and asserted).
+ */
+static bool sim_irqAsserted(int32_t irq) {
+    return (irq == SysTick_IRQn) ? SimPeriph_SysTickPending() : SimPeriph_IrqLevel(irq);
+}
+
+/**
+ * @brief Returns the pending interrupt that would preempt the running code,
+ * or a negative value below SysTick_IRQn if there is none.
+ * @param any Set to 1 if any interrupt is pending at all.
+ */
+static int32_t sim_irqSelect(bool *any) {
+    int32_t best = SysTick_IRQn - 1;
+    uint32_t best_priority = sim_active_priority;
+
+    *any = false;
+    for (uint32_t i = 0; i < sim_enabled_count; i++) {
+        int32_t irq = sim_enabled[i];
+        if (!sim_irqAsserted(irq)) {
+            continue;
+        }
+        *any = true;
+        /* Lower value first; on a tie the lower exception number (list order) */
+        if (sim_nvic_priority[irq + 1] < best_priority) {
+            best_priority = sim_nvic_priority[irq + 1];
+            best = irq;
+        }
+    }
+    return best;
+}
+
+/* Default handler: an interrupt was enabled that the firmware does not handle */
+static void sim_defaultHandler(void) {
+    Sim_Fatal("interrupt %ld enabled without a handler", (long)sim_current_irq);
+}
+
+#define SIM_WEAK_HANDLER(name) void name(void) __attribute__((weak, alias("sim_defaultHandler")))
+SIM_WEAK_HANDLER(SysTick_Handler);
+SIM_WEAK_HANDLER(EXTI0_IRQHandler);
+SIM_WEAK_HANDLER(EXTI1_IRQHandler);
+SIM_WEAK_HANDLER(EXTI2_IRQHandler);
+SIM_WEAK_HANDLER(EXTI3_IRQHandler);
+SIM_WEAK_HANDLER(EXTI4_IRQHandler);
+SIM_WEAK_HANDLER(EXTI9_5_IRQHandler);
+SIM_WEAK_HANDLER(EXTI15_10_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream0_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream1_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream2_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream3_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream4_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream5_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream6_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream7_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream0_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream1_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream2_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream3_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream4_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream5_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream6_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream7_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_BRK_TIM9_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_UP_TIM10_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_TRG_COM_TIM11_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_CC_IRQHandler);
+SIM_WEAK_HANDLER(TIM2_IRQHandler);
+SIM_WEAK_HANDLER(TIM3_IRQHandler);
+SIM_WEAK_HANDLER(TIM4_IRQHandler);
+SIM_WEAK_HANDLER(TIM5_IRQHandler);
+SIM_WEAK_HANDLER(I2C1_EV_IRQHandler);
+SIM_WEAK_HANDLER(I2C1_ER_IRQHandler);
+SIM_WEAK_HANDLER(I2C2_EV_IRQHandler);
+SIM_WEAK_HANDLER(I2C2_ER_IRQHandler);
+SIM_WEAK_HANDLER(SPI1_IRQHandler);
+SIM_WEAK_HANDLER(SPI2_IRQHandler);
+SIM_WEAK_HANDLER(USART1_IRQHandler);
+SIM_WEAK_HANDLER(USART2_IRQHandler);
+SIM_WEAK_HANDLER(USART6_IRQHandler);
+
+/* Vector table from SysTick on (index = IRQn + 1) */
+static void (*const sim_vectors[SIM_IRQ_COUNT + 1])(void) = {
+    [SysTick_IRQn + 1]            = SysTick_Handler,
+    [EXTI0_IRQn + 1]              = EXTI0_IRQHandler,
+    [EXTI1_IRQn + 1]              = EXTI1_IRQHandler,
+    [EXTI2_IRQn + 1]              = EXTI2_IRQHandler,
+    [EXTI3_IRQn + 1]              = EXTI3_IRQHandler,
+    [EXTI4_IRQn + 1]              = EXTI4_IRQHandler,
+    [DMA1_Stream0_IRQn + 1]       = DMA1_Stream0_IRQHandler,
+    [DMA1_Stream1_IRQn + 1]       = DMA1_Stream1_IRQHandler,
+    [DMA1_Stream2_IRQn + 1]       = DMA1_Stream2_IRQHandler,
+    [DMA1_Stream3_IRQn + 1]       = DMA1_Stream3_IRQHandler,
+    [DMA1_Stream4_IRQn + 1]       = DMA1_Stream4_IRQHandler,
+    [DMA1_Stream5_IRQn + 1]       = DMA1_Stream5_IRQHandler,
+    [DMA1_Stream6_IRQn + 1]       = DMA1_Stream6_IRQHandler,
+    [EXTI9_5_IRQn + 1]            = EXTI9_5_IRQHandler,
+    [TIM1_BRK_TIM9_IRQn + 1]      = TIM1_BRK_TIM9_IRQHandler,
+    [TIM1_UP_TIM10_IRQn + 1]      = TIM1_UP_TIM10_IRQHandler,
+    [TIM1_TRG_COM_TIM11_IRQn + 1] = TIM1_TRG_COM_TIM11_IRQHandler,
+    [TIM1_CC_IRQn + 1]            = TIM1_CC_IRQHandler,
+    [TIM2_IRQn + 1]               = TIM2_IRQHandler,
+    [TIM3_IRQn + 1]               = TIM3_IRQHandler,
+    [TIM4_IRQn + 1]               = TIM4_IRQHandler,
+    [I2C1_EV_IRQn + 1]            = I2C1_EV_IRQHandler,
+    [I2C1_ER_IRQn + 1]            = I2C1_ER_IRQHandler,
+    [I2C2_EV_IRQn + 1]            = I2C2_EV_IRQHandler,
+    [I2C2_ER_IRQn + 1]            = I2C2_ER_IRQHandler,
+    [SPI1_IRQn + 1]               = SPI1_IRQHandler,
+    [SPI2_IRQn + 1]               = SPI2_IRQHandler,
+    [USART1_IRQn + 1]             = USART1_IRQHandler,
+    [USART2_IRQn + 1]             = USART2_IRQHandler,
+    [EXTI15_10_IRQn + 1]          = EXTI15_10_IRQHandler,
+    [DMA1_Stream7_IRQn + 1]       = DMA1_Stream7_IRQHandler,
+    [TIM5_IRQn + 1]               = TIM5_IRQHandler,
+    [DMA2_Stream0_IRQn + 1]       = DMA2_Stream0_IRQHandler,
+    [DMA2_Stream1_IRQn + 1]       = DMA2_Stream1_IRQHandler,
+    [DMA2_Stream2_IRQn + 1]       = DMA2_Stream2_IRQHandler,
+    [DMA2_Stream3_IRQn + 1]       = DMA2_Stream3_IRQHandler,
+    [DMA2_Stream4_IRQn + 1]       = DMA2_Stream4_IRQHandler,
+    [DMA2_Stream5_IRQn + 1]       = DMA2_Stream5_IRQHandler,
+    [DMA2_Stream6_IRQn + 1]       = DMA2_Stream6_IRQHandler,
+    [DMA2_Stream7_IRQn + 1]       = DMA2_Stream7_IRQHandler,
+    [USART6_IRQn + 1]             = USART6_IRQHandler,
+};
+
+/**
+ * @brief Picks up what the firmware wrote since the last access.
+ */
+static void sim_reconcile(void) {
+    if (sim_last_regs) {
+        void *regs = sim_last_regs;
+        sim_last_regs = NULL;
+        SimPeriph_Reconcile(regs);
+    }
+    SimPeriph_ReconcilePlain();
+}
+
+/**
+ * @brief Takes the pending interrupts that can preempt the running code,
+ * highest priority first; a handler can itself be preempted.
+ */
+static void sim_dispatch(void) {
+    while (sim_irq_dirty && !sim_primask) {
+        bool any;
+        int32_t irq = sim_irqSelect(&any);
+        if (irq < SysTick_IRQn) {
+            /* Nothing to take now; keep looking while something is masked */
+            sim_irq_dirty = any;
+            return;
+        }
+
+        if (sim_storm_time != sim_now) {
+            sim_storm_time = sim_now;
+            sim_storm_count = 0;
+        }
+        if (++sim_storm_count > SIM_IRQ_STORM_LIMIT) {
+            Sim_Fatal("interrupt %ld keeps firing (request not cleared by its handler)", (long)irq);
+        }
+
+        uint32_t preempted = sim_active_priority;
+        sim_active_priority = sim_nvic_priority[irq + 1];
+        sim_current_irq = irq;
+        if (irq == SysTick_IRQn) {
+            SimPeriph_SysTickTaken();
+        }
+        sim_vectors[irq + 1]();
+        sim_reconcile();
+        SimPeriph_IrqTaken(irq);
+        sim_active_priority = preempted;
+        sim_irq_dirty = true;
+    }
+}
+
+/**
+ * @brief Advances the clock by the cost of an access: firmware writes are
+ * applied, due events fire and pending interrupts are taken.
+ */
+static void sim_step(Sim_Time_t cycles) {
+    sim_reconcile();
+    sim_now += cycles;
+    sim_fireDue();
+    sim_dispatch();
+}
+
+/**
+ * @brief Synchronisation point of a peripheral access; returns the register block.
+ */
+void *Sim_Sync(void *regs) {
+    sim_step(SIM_ACCESS_CYCLES);
+    SimPeriph_Present(regs);
+    sim_last_regs = regs;
+    return regs;
+}
+
+/**
+ * @brief Lets time pass up to when, as a polling loop would: events and interrupts run.
+ */
+void Sim_AdvanceTo(Sim_Time_t when) {
+    sim_reconcile();
+    while (sim_now < when) {
+        Sim_Time_t next = (sim_queue && sim_queue->when < when) ? sim_queue->when : when;
+        if (next > sim_now) {
+            sim_now = next;
+        }
+        sim_fireDue();
+        sim_dispatch();
+    }
+}
+
+/**
+ * @brief Returns 1 if an interrupt would wake the core from WFI.
+ */
+static bool sim_wakeup(void) {
+    bool any;
+    int32_t irq = sim_irqSelect(&any);
+    /* With PRIMASK set, a pending interrupt wakes the core but is not taken */
+    return irq >= SysTick_IRQn;
+}
+
+void Sim_Wfi(void) {
+    sim_step(SIM_ACCESS_CYCLES);
+    while (!sim_wakeup()) {
+        if (!sim_queue) {
+            Sim_Fatal("WFI with no interrupt that can ever wake the core");
+        }
+        if (sim_queue->when > sim_now) {
+            sim_sleep += sim_queue->when - sim_now;
+            sim_now = sim_queue->when;
+        }
+        sim_fireDue();
+        sim_reconcile();
+    }
+    sim_irq_dirty = true;
+    sim_dispatch();
+}
+
+void Sim_EnableIrq(void) {
+    sim_primask = 0;
+    sim_irq_dirty = true;
+    sim_step(0);
+}
+
+void Sim_ItmPut(uint32_t c) {
+    (void)c;    /* SWO output is not captured */
+}
+
+/**
+ * @brief Cycles the core has spent sleeping in WFI.
+ */
+Sim_Time_t Sim_SleepCycles(void) {
+    return sim_sleep;
+}
+
+/**
+ * @brief Cycles the core has been running (not sleeping in WFI).
+ */
+Sim_Time_t Sim_ActiveCycles(void) {
+    return sim_now - sim_sleep;
+}
+
+/**
+ * @brief Reports an unrecoverable simulation error and exits.
+ */
+void Sim_Fatal(const char *format, ...) {
+    va_list args;
+    fprintf(stderr, "sim: fatal at %.6f s: ", (double)sim_now / (double)SIM_CORE_HZ);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(2);
+}
+
+/**
+ * @brief Resets the core and the peripherals to their power-on state.
+ */
+void Sim_Reset(void) {
+    sim_now = 0;
+    sim_sleep = 0;
+    sim_queue = NULL;
+    sim_primask = 0;
+    sim_active_priority = SIM_THREAD_PRIORITY;
+    sim_last_regs = NULL;
+    SystemCoreClock = 16000000U;
+    sim_enabled_count = 1;
+    sim_enabled[0] = SysTick_IRQn;
+    SimPeriph_Reset();
+    sim_irq_dirty = true;
+}
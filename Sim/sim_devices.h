@@ -0,0 +1,169 @@
+#ifndef SIM_DEVICES_H_
+#define SIM_DEVICES_H_
+
+/**
+ * @brief Models of the devices on the gate controller board, wired to the
+ * simulated pins and peripherals as on the real board (Board/board.h and the
+ * driver headers): RC522 reader with virtual cards, HD44780 LCD, 74HC595
+ * counter chain, barrier servo, RGB status light, IR beams and the vehicles
+ * that block them.
+ */
+
+#include "sim.h"
+#include "lcd_config.h"
+
+/* GPIO port indexes */
+#define SIM_PORT_A  0U
+#define SIM_PORT_B  1U
+#define SIM_PORT_C  2U
+
+/*---------- RC522 reader (sim_rc522.c) ----------*/
+
+/* @brief Wires the reader to SPI2 and its CS, RST and IRQ pins. */
+void SimRc522_Init(void);
+
+/* @brief Brings a card with a 4-byte UID into the field (replaces any card there). */
+void SimRc522_CardEnter(const uint8_t uid[4]);
+
+/* @brief Takes the card out of the field. */
+void SimRc522_CardLeave(void);
+
+/* @brief Returns 1 if the card in the field has given its UID since it entered. */
+bool SimRc522_CardRead(void);
+
+/* @brief Returns the number of UIDs the reader has read from cards since reset. */
+uint32_t SimRc522_Reads(void);
+
+/*---------- HD44780 LCD (sim_lcd.c) ----------*/
+
+/* Characters per row and rows of the simulated module: those of the build */
+#define SIM_LCD_COLS    ((uint32_t)LCD_COLS)
+#define SIM_LCD_ROWS    ((uint32_t)LCD_ROWS)
+
+/* @brief Wires the LCD to its bus (E, RS, RW, D4-D7 and with LCD8Bit D0-D3),
+ * or with LCD_BUS_I2C to the PCF8574 at LCD_I2C_ADDRESS on I2C2. */
+void SimLcd_Init(void);
+
+/* @brief Copies the text a row shows, SIM_LCD_COLS characters plus NUL
+ * (custom characters: ' ' if blank, '#' otherwise). */
+void SimLcd_Row(uint32_t row, char *text);
+
+/* @brief Returns the number of bus writes made while the controller was busy
+ * (with LCD_BUS_I2C, also those that change RS or data together with E). */
+uint32_t SimLcd_Violations(void);
+
+/* @brief Returns the number of instructions and data bytes the controller executed. */
+uint32_t SimLcd_Writes(void);
+
+/*---------- 74HC595 chain (sim_hc595.c) ----------*/
+
+/* Registers in the chain and the digits of the vehicle counter */
+#define SIM_HC595_CHAIN     3U
+#define SIM_HC595_DIGITS    3U
+
+/* @brief Wires the chain to SPI1 (DMA) and the latch pin. */
+void SimHc595_Init(void);
+
+/* @brief Copies the text of the counter digits (SIM_HC595_DIGITS characters plus NUL). */
+void SimHc595_Text(char *text);
+
+/* @brief Returns the brightness of the digits from the OE PWM, 0..255. */
+uint32_t SimHc595_Brightness(void);
+
+/*---------- Barrier servo and RGB light (sim_servo.c) ----------*/
+
+/* Arm angles of the barrier */
+#define SIM_ARM_OPEN_DEG    70.0    /* Wide enough for a car to pass */
+#define SIM_ARM_CLOSED_DEG  5.0
+#define SIM_ARM_HIT_DEG     60.0    /* Lower than this touches a car under it */
+
+/* @brief Wires the servo to TIM2 channel 1. */
+void SimServo_Init(void);
+
+/* @brief Returns the angle of the arm in degrees (the servo follows its pulse width at its slew rate). */
+double SimServo_Angle(void);
+
+/* @brief Returns the color the RGB light shows: "off", "red", "green", "blue" or "mixed". */
+const char *SimRgb_Color(void);
+
+/*---------- IR beams and vehicles (sim_vehicle.c) ----------*/
+
+typedef enum {
+    SIM_BEAM_ENTRY = 0,     /* PA1 */
+    SIM_BEAM_EXIT,          /* PA2 */
+    SIM_BEAMS
+} SimBeam_t;
+
+typedef enum {
+    SIM_CAR_IN = 0,         /* Enters: blocks the entry beam first */
+    SIM_CAR_OUT             /* Leaves: blocks the exit beam first */
+} SimCar_Direction_t;
+
+typedef enum {
+    SIM_CAR_QUEUED = 0,     /* In the lane behind other cars */
+    SIM_CAR_AT_READER,      /* Pulling up and holding the card to the reader */
+    SIM_CAR_APPROACHING,    /* Card read, driving up to the barrier */
+    SIM_CAR_WAITING,        /* In front of the barrier, waiting for it to open */
+    SIM_CAR_PASSING,        /* Under the arm */
+    SIM_CAR_PASSED,
+    SIM_CAR_GAVE_UP         /* The barrier never opened (refused, or not read) */
+} SimCar_State_t;
+
+/* Behaviour of a driver, in milliseconds */
+typedef struct {
+    uint32_t reach_ms;      /*!< From the head of the lane to the card in the field. */
+    uint32_t hold_ms;       /*!< Card kept in the field after it was read. */
+    uint32_t approach_ms;   /*!< From the card read to the beam in front of the barrier. */
+    uint32_t pass_ms;       /*!< From the arm open to both beams clear. */
+    uint32_t patience_ms;   /*!< Longest wait for a read, then for the arm. */
+} SimCar_Timing_t;
+
+typedef struct SimCar {
+    uint8_t uid[4];
+    SimCar_Direction_t direction;
+    SimCar_Timing_t timing;
+    SimCar_State_t state;
+    bool hit;               /*!< The arm came down on the car. */
+    Sim_Time_t arrived;     /*!< Joined the lane. */
+    Sim_Time_t at_reader;   /*!< Became the head of the lane. */
+    Sim_Time_t read;        /*!< Card read (0 if never). */
+    Sim_Time_t opened;      /*!< Arm open in front of it (0 if never). */
+    Sim_Time_t done;        /*!< Passed or gave up. */
+    void (*on_done)(struct SimCar *car);
+    /* Private to the lane */
+    struct SimCar *next;
+    Sim_Event_t step;
+    Sim_Time_t deadline;
+    bool card_in;
+    uint8_t beams;          /* Beams it blocks (bit per SimBeam_t) */
+} SimCar_t;
+
+/* Totals of the cars since reset */
+typedef struct {
+    uint32_t arrived;
+    uint32_t passed;
+    uint32_t gave_up;
+    uint32_t hits;
+    uint32_t queued;        /*!< Cars in the lane now, the head included. */
+    uint32_t max_queued;
+} SimCar_Stats_t;
+
+/* Default driver (SimCar_Timing_t) */
+extern SimCar_Timing_t simcar_default_timing;
+
+/* @brief Wires the beams to their pins (released: the pull-ups read clear). */
+void SimVehicle_Init(void);
+
+/* @brief Blocks or clears a beam by hand (on top of the cars). */
+void SimBeam_Set(SimBeam_t beam, bool blocked);
+
+/* @brief Returns 1 if a beam is blocked (by hand or by a car). */
+bool SimBeam_Blocked(SimBeam_t beam);
+
+/* @brief Puts a car at the end of the lane (owned by the caller until on_done). */
+void SimCar_Arrive(SimCar_t *car);
+
+/* @brief Returns the totals of the cars. */
+const SimCar_Stats_t *SimCar_Stats(void);
+
+#endif /* SIM_DEVICES_H_ */
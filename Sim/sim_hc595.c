@@ -0,0 +1,145 @@
+#include "sim_devices.h"
+#include "74hc595.h"
+#include <string.h>
+
+/*
+ * 74HC595 chain of Led_Segment/74hc595.h: fed by SPI1 (or by the bit-banged
+ * SDI/SCLK pins), latched on the rising edge of LOAD, with the brightness
+ * PWM of TIM3 on OE (or OE tied low: always full brightness). The counter digits are common anode, so a low output
+ * lights a segment; they are decoded back to characters with the
+ * firmware's own font.
+ * With HC595_MUX_DIGITS the chain is two registers, the segments and the
+ * digit select lines, and each latch lights the selected digits only: a
+ * digit shows the segments of its last selection, and goes dark when the
+ * scan has not selected it for two refresh frames.
+ */
+
+#define HC595_SIM_SPI   0U      /* SPI1 */
+
+#if HC595_MUX_DIGITS
+#define HC_REGS         2U      /* Segments, then the select lines */
+/* A digit not selected for this long looks dark */
+#define HC_MUX_PERSIST  SIM_US(2U * 1000000U / HC595_MUX_REFRESH_HZ)
+#else
+#define HC_REGS         SIM_HC595_CHAIN
+#endif
+
+static struct {
+    uint8_t shift[HC_REGS];
+    uint8_t out[HC_REGS];
+    uint32_t latches;
+#if HC595_MUX_DIGITS
+    uint8_t digit[SIM_HC595_DIGITS];        /* Outputs of the segments at the last selection */
+    Sim_Time_t selected[SIM_HC595_DIGITS];
+#endif
+} hc;
+
+#if HC595_USE_SPI
+/* One byte into register 0, MSB first: the chain moves one register down */
+static uint8_t hc_shiftByte(uint8_t byte) {
+    uint8_t last = hc.shift[HC_REGS - 1U];
+    memmove(&hc.shift[1], &hc.shift[0], HC_REGS - 1U);
+    hc.shift[0] = byte;
+    return last;    /* Q7' of the last register (not wired back) */
+}
+#else
+static void hc_shiftBit(bool bit) {
+    uint8_t carry = bit ? 1U : 0U;
+    for (uint32_t i = 0; i < HC_REGS; i++) {
+        uint8_t next = hc.shift[i] >> 7;
+        hc.shift[i] = (uint8_t)((hc.shift[i] << 1) | carry);
+        carry = next;
+    }
+}
+#endif
+
+#if HC595_MUX_DIGITS
+/* A latch lights the digits on the select lines with the segments */
+static void hc_muxLatch(void) {
+    uint8_t select = HC595_MUX_SELECT_ACTIVE_LOW ? (uint8_t)~hc.out[1] : hc.out[1];
+
+    for (uint32_t d = 0; d < SIM_HC595_DIGITS; d++) {
+        if (select & (1U << d)) {
+            hc.digit[d] = hc.out[0];
+            hc.selected[d] = sim_now;
+        }
+    }
+}
+#endif
+
+static void hc_pins(uint32_t port, uint32_t before, uint32_t after) {
+    uint32_t rising = ~before & after;
+
+    if (port != SIM_PORT_B) {
+        return;
+    }
+#if !HC595_USE_SPI
+    if (rising & (1UL << SCLK_PIN)) {
+        hc_shiftBit((after >> SDI_PIN) & 1U);
+    }
+#endif
+    if (rising & (1UL << LOAD_PIN)) {
+        memcpy(hc.out, hc.shift, sizeof(hc.out));
+        hc.latches++;
+#if HC595_MUX_DIGITS
+        hc_muxLatch();
+#endif
+    }
+}
+
+/**
+ * @brief Wires the chain to SPI1 (DMA) and the latch pin.
+ */
+void SimHc595_Init(void) {
+    memset(&hc, 0, sizeof(hc));
+    memset(hc.out, 0xFF, sizeof(hc.out));   /* Common anode: blank */
+#if HC595_MUX_DIGITS
+    memset(hc.digit, 0xFF, sizeof(hc.digit));
+#endif
+#if HC595_USE_SPI
+    SimSpi_Attach(HC595_SIM_SPI, hc_shiftByte);
+#endif
+    SimGpio_Watch(hc_pins);
+}
+
+/**
+ * @brief Copies the text of the counter digits (SIM_HC595_DIGITS characters plus NUL).
+ */
+void SimHc595_Text(char *text) {
+    static const char charset[] = " 0123456789-ABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+
+    for (uint32_t digit = 0; digit < SIM_HC595_DIGITS; digit++) {
+#if HC595_MUX_DIGITS
+        bool lit = hc.latches && sim_now - hc.selected[digit] <= HC_MUX_PERSIST;
+        uint8_t segments = lit ? ((uint8_t)~hc.digit[digit] & (uint8_t)~HC595_SEG_DP) : 0U;
+#else
+        uint8_t segments = (uint8_t)~hc.out[digit] & (uint8_t)~HC595_SEG_DP;
+#endif
+        text[digit] = '?';
+        for (const char *c = charset; *c; c++) {
+            if (HC595_Font(*c) == segments) {
+                text[digit] = *c;
+                break;
+            }
+        }
+    }
+    text[SIM_HC595_DIGITS] = '\0';
+}
+
+/**
+ * @brief Returns the brightness of the digits from the OE PWM, 0..255.
+ */
+uint32_t SimHc595_Brightness(void) {
+#if HC595_USE_OE_PWM
+    const TIM_TypeDef *oe = &sim_tim[SIM_TIM3];
+    uint64_t level;
+
+    if (!(oe->CR1 & TIM_CR1_CEN) || !(oe->CCER & TIM_CCER_CC1E)) {
+        return 0;   /* OE pulled up: outputs off */
+    }
+    level = (uint64_t)oe->CCR1 * 255U / ((uint64_t)oe->ARR + 1U);
+    return (level > 255U) ? 255U : (uint32_t)level;
+#else
+    return 255U;
+#endif
+}
@@ -0,0 +1,313 @@
+#include "sim_devices.h"
+#include "lcd_config.h"
+#include <string.h>
+
+/*
+ * HD44780 on the bus of LCD/lcd_config.h: D4-D7 on DATA5-DATA8, E, RS and RW
+ * on port B, and with LCD8Bit D0-D3 on DATA1-DATA4 (otherwise not wired,
+ * read as 0). Writes are latched on the falling edge of E; reads put the
+ * busy flag and address counter (or data) on the pins while E is high.
+ * Starts in 8-bit mode like the real controller, so a 4-bit init sequence
+ * must switch it to 4 bits. Execution times are those of the datasheet at
+ * 270 kHz; anything written while the controller is still busy is counted
+ * as a violation. The rows are laid out in DDRAM as the driver expects
+ * (LCD_COLS x LCD_ROWS, rows 2 and 3 continuing rows 0 and 1).
+ * With LCD_BUS_I2C the bus is driven by a PCF8574 backpack on I2C2 instead
+ * (P0 RS, P1 RW, P2 E, P3 backlight, P4-P7 D4-D7): each byte written to the
+ * expander sets all its outputs at once, so RS must be set in a write
+ * before the one that raises E, and E must fall in a write of its own;
+ * anything else counts as a violation.
+ */
+
+/* Execution times: clear and home, the other instructions, data */
+#define LCD_EXEC_LONG   SIM_US(1520)
+#define LCD_EXEC_SHORT  SIM_US(37)
+#define LCD_EXEC_DATA   SIM_US(41)
+
+#define LCD_PORT(is_b)  ((is_b) ? SIM_PORT_B : SIM_PORT_A)
+
+static struct {
+    bool e;
+    bool four_bit;
+    bool low_nibble;        /* Next 4-bit transfer is the low nibble */
+    uint8_t high;
+    uint8_t read;           /* Byte being read, nibble by nibble */
+    bool cgram;             /* Address counter points into CGRAM */
+    bool increment;
+    bool two_line;
+    uint8_t ac;
+    uint8_t ddram[128];
+    uint8_t cgram_data[64];
+    Sim_Time_t busy_until;
+    uint32_t violations;
+    uint32_t writes;        /* Instructions and data executed */
+    uint8_t pcf;            /* PCF8574 outputs (all high at power-on) */
+    bool pcf_written;
+} lcd;
+
+/* D0-D7 pins (D0-D3 only wired with LCD8Bit) */
+#ifdef LCD8Bit
+#define LCD_FIRST_LINE  0U
+#else
+#define LCD_FIRST_LINE  4U
+#endif
+#if LCD_BUS == LCD_BUS_PARALLEL
+static const struct {
+    uint32_t port;
+    uint32_t pin;
+} lcd_data[8] = {
+    { LCD_PORT(DATA1_PortB), DATA1_Pin },
+    { LCD_PORT(DATA2_PortB), DATA2_Pin },
+    { LCD_PORT(DATA3_PortB), DATA3_Pin },
+    { LCD_PORT(DATA4_PortB), DATA4_Pin },
+    { LCD_PORT(DATA5_PortB), DATA5_Pin },
+    { LCD_PORT(DATA6_PortB), DATA6_Pin },
+    { LCD_PORT(DATA7_PortB), DATA7_Pin },
+    { LCD_PORT(DATA8_PortB), DATA8_Pin },
+};
+#endif
+
+/* DDRAM address of the first character of each row */
+static const uint8_t lcd_row_base[4] = { 0x00, 0x40, LCD_COLS, 0x40 + LCD_COLS };
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+/* Byte on D0-D7 (the lines that are not wired read 0) */
+static uint8_t lcd_readBus(void) {
+    uint8_t byte = 0;
+    for (uint32_t i = LCD_FIRST_LINE; i < 8U; i++) {
+        if (SimGpio_Level(lcd_data[i].port, lcd_data[i].pin)) {
+            byte |= (uint8_t)(1U << i);
+        }
+    }
+    return byte;
+}
+
+/* Drives D0-D7 with byte (the wired lines only), or releases them (-1) */
+static void lcd_driveBus(int byte) {
+    for (uint32_t i = LCD_FIRST_LINE; i < 8U; i++) {
+        SimGpio_Drive(lcd_data[i].port, lcd_data[i].pin, (byte < 0) ? -1 : ((byte >> i) & 1));
+    }
+}
+#endif
+
+/* Moves the address counter one step, wrapping as the display lines do */
+static void lcd_step(void) {
+    if (lcd.cgram) {
+        lcd.ac = (uint8_t)((lcd.ac + (lcd.increment ? 1U : 63U)) & 0x3FU);
+    } else if (lcd.two_line) {
+        /* Two lines of 40: 0x00-0x27 and 0x40-0x67 */
+        if (lcd.increment) {
+            lcd.ac = (lcd.ac == 0x27U) ? 0x40U : (lcd.ac == 0x67U) ? 0x00U : (uint8_t)(lcd.ac + 1U);
+        } else {
+            lcd.ac = (lcd.ac == 0x40U) ? 0x27U : (lcd.ac == 0x00U) ? 0x67U : (uint8_t)(lcd.ac - 1U);
+        }
+    } else if (lcd.increment) {
+        lcd.ac = (lcd.ac == 0x4FU) ? 0x00U : (uint8_t)(lcd.ac + 1U);
+    } else {
+        lcd.ac = (lcd.ac == 0x00U) ? 0x4FU : (uint8_t)(lcd.ac - 1U);
+    }
+}
+
+static void lcd_execute(bool rs, uint8_t byte) {
+    Sim_Time_t exec = LCD_EXEC_SHORT;
+
+    if (sim_now < lcd.busy_until) {
+        lcd.violations++;
+    }
+    lcd.writes++;
+    if (rs) {
+        if (lcd.cgram) {
+            lcd.cgram_data[lcd.ac & 0x3FU] = byte & 0x1FU;
+        } else {
+            lcd.ddram[lcd.ac & 0x7FU] = byte;
+        }
+        lcd_step();
+        exec = LCD_EXEC_DATA;
+    } else if (byte & 0x80U) {
+        lcd.ac = byte & 0x7FU;
+        lcd.cgram = false;
+    } else if (byte & 0x40U) {
+        lcd.ac = byte & 0x3FU;
+        lcd.cgram = true;
+    } else if (byte & 0x20U) {
+        lcd.four_bit = !(byte & 0x10U);
+        lcd.two_line = (byte & 0x08U) != 0;
+        lcd.low_nibble = false;
+    } else if (byte & 0x10U) {
+        if (!(byte & 0x08U)) {
+            bool increment = lcd.increment;
+            lcd.increment = (byte & 0x04U) != 0;
+            lcd_step();     /* Cursor move */
+            lcd.increment = increment;
+        }
+    } else if (byte & 0x04U) {
+        lcd.increment = (byte & 0x02U) != 0;
+    } else if (byte & 0x02U) {
+        lcd.ac = 0;
+        lcd.cgram = false;
+        exec = LCD_EXEC_LONG;
+    } else if (byte & 0x01U) {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.ac = 0;
+        lcd.cgram = false;
+        lcd.increment = true;
+        exec = LCD_EXEC_LONG;
+    }
+    lcd.busy_until = sim_now + exec;
+}
+
+/* Byte read by the MCU: busy flag and address counter, or data */
+static uint8_t lcd_readByte(bool rs) {
+    if (!rs) {
+        return (uint8_t)((sim_now < lcd.busy_until ? 0x80U : 0U) | (lcd.ac & 0x7FU));
+    }
+    uint8_t byte = lcd.cgram ? lcd.cgram_data[lcd.ac & 0x3FU] : lcd.ddram[lcd.ac & 0x7FU];
+    lcd_step();
+    return byte;
+}
+
+/* A write latched on the falling edge of E, byte as on D0-D7 */
+static void lcd_latch(bool rs, uint8_t byte) {
+    if (!lcd.four_bit) {
+        lcd_execute(rs, byte);
+    } else if (!lcd.low_nibble) {
+        lcd.high = byte >> 4;
+        lcd.low_nibble = true;
+    } else {
+        lcd.low_nibble = false;
+        lcd_execute(rs, (uint8_t)((lcd.high << 4) | (byte >> 4)));
+    }
+}
+
+#if LCD_BUS == LCD_BUS_PARALLEL
+static void lcd_pins(uint32_t port, uint32_t before, uint32_t after) {
+    (void)before;
+    if (port != SIM_PORT_B) {
+        return;
+    }
+    bool e = (after >> E_Pin) & 1U;
+    if (e == lcd.e) {
+        return;
+    }
+    lcd.e = e;
+    bool rs = (after >> RS_Pin) & 1U;
+    bool rw = (after >> RW_Pin) & 1U;
+
+    if (e && rw) {
+        /* Read: the controller drives the data pins while E is high */
+        if (!lcd.four_bit || !lcd.low_nibble) {
+            lcd.read = lcd_readByte(rs);
+        }
+        /* In 4-bit mode each nibble comes out on D4-D7 */
+        lcd_driveBus((lcd.four_bit && lcd.low_nibble) ? (lcd.read << 4) : lcd.read);
+        return;
+    }
+    if (e) {
+        return;
+    }
+    if (rw) {
+        lcd_driveBus(-1);
+        if (lcd.four_bit) {
+            lcd.low_nibble = !lcd.low_nibble;
+        }
+        return;
+    }
+    lcd_latch(rs, lcd_readBus());
+}
+#endif
+
+#if LCD_BUS == LCD_BUS_I2C
+/* PCF8574 outputs */
+#define PCF_RS      0x01U
+#define PCF_RW      0x02U
+#define PCF_E       0x04U
+#define PCF_DATA    0xF0U
+
+/* A byte written to the expander: its outputs change together */
+static void lcd_expander(uint8_t out) {
+    uint8_t before = lcd.pcf;
+    uint8_t changed = out ^ before;
+    bool checked = lcd.pcf_written;
+
+    lcd.pcf = out;
+    lcd.pcf_written = true;
+    if (out & PCF_RW) {
+        Sim_Fatal("LCD: R/W raised through the PCF8574 (reads are not modelled)");
+    }
+    if (!(changed & PCF_E)) {
+        if (checked && (out & PCF_E) && (changed & (PCF_DATA | PCF_RS))) {
+            lcd.violations++;   /* Data or RS changed while E is high */
+        }
+        return;
+    }
+    if (out & PCF_E) {
+        if (checked && (changed & PCF_RS)) {
+            lcd.violations++;   /* No setup time for RS before E rises */
+        }
+        return;
+    }
+    /* The outputs come up high: the first write only gives them a known level */
+    if (checked && (changed & (PCF_DATA | PCF_RS))) {
+        lcd.violations++;       /* No hold time after E falls */
+    }
+    lcd_latch((before & PCF_RS) != 0, before & PCF_DATA);
+}
+#endif
+
+/**
+ * @brief Wires the LCD to its bus (E, RS, RW, D4-D7 and with LCD8Bit D0-D3),
+ * or with LCD_BUS_I2C to the PCF8574 at LCD_I2C_ADDRESS on I2C2.
+ */
+void SimLcd_Init(void) {
+    memset(&lcd, 0, sizeof(lcd));
+    memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+    lcd.increment = true;
+    lcd.pcf = 0xFFU;
+#if LCD_BUS == LCD_BUS_I2C
+    SimI2c_Attach(1, LCD_I2C_ADDRESS, lcd_expander);
+#else
+    SimGpio_Watch(lcd_pins);
+#endif
+#if LCD_BUS == LCD_BUS_PARALLEL && !LCD_USE_RW
+    /* R/W tied to GND: write only */
+    SimGpio_Drive(SIM_PORT_B, RW_Pin, 0);
+#endif
+}
+
+/**
+ * @brief Copies the text a row shows, SIM_LCD_COLS characters plus NUL
+ * (custom characters: ' ' if blank, '#' otherwise).
+ */
+void SimLcd_Row(uint32_t row, char *text) {
+    uint8_t base = lcd_row_base[row & 3U];
+
+    for (uint32_t col = 0; col < SIM_LCD_COLS; col++) {
+        uint8_t code = lcd.ddram[base + col];
+        if (code < 0x10U) {
+            const uint8_t *glyph = &lcd.cgram_data[(code & 7U) * 8U];
+            bool blank = true;
+            for (uint32_t i = 0; i < 8U; i++) {
+                blank = blank && !glyph[i];
+            }
+            text[col] = blank ? ' ' : '#';
+        } else {
+            text[col] = (code >= 0x20U && code < 0x7FU) ? (char)code : '?';
+        }
+    }
+    text[SIM_LCD_COLS] = '\0';
+}
+
+/**
+ * @brief Returns the number of bus writes made while the controller was busy
+ * (with LCD_BUS_I2C, also those that change RS or data together with E).
+ */
+uint32_t SimLcd_Violations(void) {
+    return lcd.violations;
+}
+
+/**
+ * @brief Returns the number of instructions and data bytes the controller executed.
+ */
+uint32_t SimLcd_Writes(void) {
+    return lcd.writes;
+}
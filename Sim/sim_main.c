@@ -0,0 +1,51 @@
+#include "sim_devices.h"
+#include "sim_script.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Host simulator of the gate controller: runs the firmware (Core/main.c
+ * and every driver, built with main renamed to firmware_main) against the
+ * device models, driven by a scenario script.
+ *
+ * Usage: sim [-v] scenario.scn
+ *   -v  echo the script lines as they run and the console output
+ * Exit status: 0 if every check passed, 1 if one failed, 2 on a simulation
+ * error (firmware doing something the models do not support).
+ */
+
+int firmware_main(void);
+
+int main(int argc, char **argv) {
+    bool verbose = false;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = true;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [-v] scenario.scn\n", argv[0]);
+        return 2;
+    }
+
+    Sim_Reset();
+    SimRc522_Init();
+    SimLcd_Init();
+    SimHc595_Init();
+    SimServo_Init();
+    SimVehicle_Init();
+    if (!SimScript_Load(path)) {
+        return 2;
+    }
+    SimScript_Start(verbose);
+
+    firmware_main();   /* Never returns: the script ends the run */
+    Sim_Fatal("firmware main() returned");
+}
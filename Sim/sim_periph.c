@@ -0,0 +1,1359 @@
+#include "sim.h"
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * Register-level models of the MCU peripherals the drivers use.
+ *
+ * Each register block exists twice: the live copy the firmware reads and
+ * writes, and a shadow holding what the firmware was last shown. A write
+ * is a difference between the two, found at the next synchronisation
+ * point. Registers whose writes cannot be told apart from the value shown
+ * are presented with a marker bit the hardware never returns (SPI/USART/I2C
+ * DR, EXTI PR, timer CNT), or as 0 when write-only (DMA IFCR, timer EGR).
+ */
+
+/* Marker of a register value presented by the model (a write replaces it) */
+#define SIM_MARK            0x80000000U
+/* Timer CNT as presented: the firmware only ever writes it */
+#define SIM_TIM_CNT_SHOWN   0xFFFFFFFFU
+
+/* Live register blocks */
+Sim_GpioSlot_t      sim_gpio[SIM_GPIO_PORTS];
+Sim_TimerPage_t     sim_timer_page;
+RCC_TypeDef         sim_rcc;
+SYSCFG_TypeDef      sim_syscfg;
+PWR_TypeDef         sim_pwr;
+CoreDebug_Type      sim_coredebug;
+ITM_Type            sim_itm;
+SPI_TypeDef         sim_spi[3];
+USART_TypeDef       sim_usart[3];
+I2C_TypeDef         sim_i2c[3];
+DMA_TypeDef         sim_dma[2];
+DMA_Stream_TypeDef  sim_dma_stream[16];
+EXTI_TypeDef        sim_exti;
+SCB_Type            sim_scb;
+DWT_Type            sim_dwt;
+static SysTick_Type sim_systick;
+
+/*---------- SysTick ----------*/
+
+static struct {
+    uint32_t ctrl;          /* ENABLE, TICKINT, CLKSOURCE */
+    uint32_t load;
+    uint32_t val;           /* Counter at anchor (frozen value when stopped) */
+    Sim_Time_t anchor;
+    uint32_t shown_val;
+    bool countflag;
+    bool pending;           /* PENDSTSET */
+    Sim_Event_t zero;
+} st;
+
+/* Counter value now: down from val at anchor, reloaded from LOAD the cycle after 0 */
+static uint32_t st_value(void) {
+    if (!(st.ctrl & SysTick_CTRL_ENABLE_Msk)) {
+        return st.val;
+    }
+    Sim_Time_t elapsed = sim_now - st.anchor;
+    if (elapsed <= st.val) {
+        return st.val - (uint32_t)elapsed;
+    }
+    elapsed -= (Sim_Time_t)st.val + 1U;
+    return st.load - (uint32_t)(elapsed % ((Sim_Time_t)st.load + 1U));
+}
+
+/* Next time the counter reaches 0, strictly after now */
+static Sim_Time_t st_nextZero(void) {
+    Sim_Time_t elapsed = sim_now - st.anchor;
+    if (st.val > 0 && elapsed < st.val) {
+        return st.anchor + st.val;
+    }
+    Sim_Time_t period = (Sim_Time_t)st.load + 1U;
+    return st.anchor + st.val + ((elapsed - st.val) / period + 1U) * period;
+}
+
+static void st_rebase(void) {
+    st.val = st_value();
+    st.anchor = sim_now;
+}
+
+static void st_schedule(void) {
+    if (st.ctrl & SysTick_CTRL_ENABLE_Msk) {
+        Sim_Schedule(&st.zero, st_nextZero());
+    } else {
+        Sim_Cancel(&st.zero);
+    }
+}
+
+static void st_zero(void *arg) {
+    (void)arg;
+    st.countflag = true;
+    if (st.ctrl & SysTick_CTRL_TICKINT_Msk) {
+        st.pending = true;
+        Sim_IrqChanged();
+    }
+    st_schedule();
+}
+
+static void st_reconcile(void) {
+    bool changed = false;
+
+    if ((sim_systick.LOAD & SysTick_LOAD_RELOAD_Msk) != st.load) {
+        st_rebase();    /* The new value is used at the next reload */
+        st.load = sim_systick.LOAD & SysTick_LOAD_RELOAD_Msk;
+        changed = true;
+    }
+    if (sim_systick.VAL != st.shown_val) {
+        /* Any write clears the counter and COUNTFLAG */
+        st.val = 0;
+        st.anchor = sim_now;
+        st.countflag = false;
+        changed = true;
+    }
+    uint32_t ctrl = sim_systick.CTRL & 0x7U;
+    if (ctrl != st.ctrl) {
+        if ((ctrl ^ st.ctrl) & SysTick_CTRL_ENABLE_Msk) {
+            st_rebase();    /* Freezes or restarts the counter */
+        }
+        st.ctrl = ctrl;
+        changed = true;
+    }
+    if (changed) {
+        st_schedule();
+    }
+}
+
+static void st_present(void) {
+    st.shown_val = st_value();
+    if (st.shown_val == 0) {
+        st.shown_val = 1;   /* A written 0 must differ from what was shown */
+    }
+    sim_systick.CTRL = st.ctrl | (st.countflag ? SysTick_CTRL_COUNTFLAG_Msk : 0U);
+    sim_systick.LOAD = st.load;
+    sim_systick.VAL = st.shown_val;
+    sim_systick.CALIB = 0;
+    st.countflag = false;   /* Cleared by the read */
+}
+
+bool SimPeriph_SysTickPending(void) {
+    return st.pending;
+}
+
+void SimPeriph_SysTickTaken(void) {
+    st.pending = false;
+}
+
+SysTick_Type *Sim_SysTickAccess(void) {
+    return (SysTick_Type *)Sim_Sync(&sim_systick);
+}
+
+/*---------- SCB and DWT ----------*/
+
+static void scb_reconcile(void) {
+    if (sim_scb.ICSR & SCB_ICSR_PENDSTCLR_Msk) {
+        st.pending = false;
+    } else if ((sim_scb.ICSR & SCB_ICSR_PENDSTSET_Msk) && !st.pending) {
+        st.pending = true;
+        Sim_IrqChanged();
+    }
+}
+
+static void scb_present(void) {
+    sim_scb.ICSR = st.pending ? SCB_ICSR_PENDSTSET_Msk : 0U;
+}
+
+static struct {
+    uint32_t ctrl;
+    uint32_t frozen;        /* CYCCNT while stopped */
+    Sim_Time_t base;        /* Active cycles at CYCCNT = 0 while running */
+    uint32_t shown;
+} dwt;
+
+static uint32_t dwt_count(void) {
+    return (dwt.ctrl & DWT_CTRL_CYCCNTENA_Msk) ? (uint32_t)(Sim_ActiveCycles() - dwt.base) : dwt.frozen;
+}
+
+static void dwt_reconcile(void) {
+    if (sim_dwt.CYCCNT != dwt.shown) {
+        dwt.frozen = sim_dwt.CYCCNT;
+        dwt.base = Sim_ActiveCycles() - sim_dwt.CYCCNT;
+    }
+    if ((sim_dwt.CTRL ^ dwt.ctrl) & DWT_CTRL_CYCCNTENA_Msk) {
+        if (sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+            dwt.base = Sim_ActiveCycles() - dwt.frozen;
+        } else {
+            dwt.frozen = dwt_count();
+        }
+    }
+    dwt.ctrl = sim_dwt.CTRL;
+}
+
+static void dwt_present(void) {
+    dwt.shown = dwt_count();
+    sim_dwt.CTRL = dwt.ctrl;
+    sim_dwt.CYCCNT = dwt.shown;
+}
+
+/*---------- EXTI ----------*/
+
+static EXTI_TypeDef exti;
+
+static void exti_reconcile(void) {
+    exti.IMR = sim_exti.IMR;
+    exti.EMR = sim_exti.EMR;
+    exti.RTSR = sim_exti.RTSR;
+    exti.FTSR = sim_exti.FTSR;
+    if (sim_exti.SWIER) {
+        exti.PR |= sim_exti.SWIER & exti.IMR;
+        Sim_IrqChanged();
+    }
+    if (!(sim_exti.PR & SIM_MARK)) {
+        exti.PR &= ~sim_exti.PR;    /* Write 1 to clear */
+        Sim_IrqChanged();
+    }
+}
+
+static void exti_present(void) {
+    sim_exti = exti;
+    sim_exti.SWIER = 0;
+    sim_exti.PR = exti.PR | SIM_MARK;
+}
+
+/* Edge on a pin: sets the pending bit of its line if routed and enabled */
+static void exti_edge(uint32_t port, uint32_t pin, bool rising) {
+    uint32_t source = (sim_syscfg.EXTICR[pin / 4U] >> ((pin % 4U) * 4U)) & 0xFU;
+    uint32_t line = 1UL << pin;
+
+    if (source != port || !(exti.IMR & line)) {
+        return;
+    }
+    if ((rising && (exti.RTSR & line)) || (!rising && (exti.FTSR & line))) {
+        exti.PR |= line;
+        Sim_IrqChanged();
+    }
+}
+
+/*---------- GPIO ----------*/
+
+#define SIM_GPIO_WATCHERS   8
+
+static struct {
+    uint32_t drive_mask;    /* Pins driven from outside */
+    uint32_t drive_level;
+    uint32_t idr;
+    uint32_t writes[16];    /* BSRR writes that set or reset each pin */
+} gpio[SIM_GPIO_PORTS];
+
+/* Configuration and output registers as last applied (MODER..ODR) */
+static GPIO_TypeDef gpio_shadow[SIM_GPIO_PORTS];
+#define SIM_GPIO_CONFIG_SIZE    offsetof(GPIO_TypeDef, BSRR)
+
+static SimGpio_Watcher_t gpio_watchers[SIM_GPIO_WATCHERS];
+static uint32_t gpio_watcher_count;
+static uint32_t gpio_dirty;
+static bool gpio_updating;
+
+/* Pin levels of a port from its mode, output, pulls and what drives it */
+static uint32_t gpio_levels(uint32_t p) {
+    const GPIO_TypeDef *g = &sim_gpio[p].regs;
+    uint32_t levels = 0;
+
+    for (uint32_t pin = 0; pin < 16U; pin++) {
+        uint32_t bit = 1UL << pin;
+        uint32_t mode = (g->MODER >> (pin * 2U)) & 3U;
+        uint32_t pull = (g->PUPDR >> (pin * 2U)) & 3U;
+        bool level;
+
+        if (mode == 1U) {
+            level = (g->ODR & bit) != 0;
+            if ((g->OTYPER & bit) && (gpio[p].drive_mask & bit)) {
+                level = level && (gpio[p].drive_level & bit); /* Open drain: wired AND */
+            }
+        } else if (mode == 3U) {
+            level = false;      /* Analog: the input buffer reads 0 */
+        } else if (gpio[p].drive_mask & bit) {
+            level = (gpio[p].drive_level & bit) != 0;
+        } else {
+            level = pull != 2U; /* Pull-up, or floating (reads high) */
+        }
+        if (level) {
+            levels |= bit;
+        }
+    }
+    return levels;
+}
+
+/* Recomputes the levels of a port; devices and EXTI see every change */
+static void gpio_update(uint32_t port) {
+    gpio_dirty |= 1UL << port;
+    if (gpio_updating) {
+        return;     /* A device reacted to a change: the loop below picks it up */
+    }
+    gpio_updating = true;
+    while (gpio_dirty) {
+        uint32_t p = (uint32_t)__builtin_ctz(gpio_dirty);
+        gpio_dirty &= ~(1UL << p);
+
+        uint32_t before = gpio[p].idr;
+        uint32_t after = gpio_levels(p);
+        if (after == before) {
+            continue;
+        }
+        gpio[p].idr = after;
+        sim_gpio[p].regs.IDR = after;
+        gpio_shadow[p].IDR = after;
+
+        for (uint32_t changed = before ^ after; changed; changed &= changed - 1U) {
+            uint32_t pin = (uint32_t)__builtin_ctz(changed);
+            exti_edge(p, pin, (after >> pin) & 1U);
+        }
+        for (uint32_t i = 0; i < gpio_watcher_count; i++) {
+            gpio_watchers[i](p, before, after);
+        }
+    }
+    gpio_updating = false;
+}
+
+/**
+ * @brief Host side of a BSRR write (GPIO/pin.h with PIN_MOCK=1).
+ */
+void Pin_MockBsrr(GPIO_TypeDef *port, uint32_t bsrr) {
+    Sim_Sync(NULL);
+    uint32_t p = SIM_PORT_INDEX(port);
+    uint32_t odr = (port->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFFU); /* Set wins */
+    for (uint32_t pins = (bsrr | (bsrr >> 16)) & 0xFFFFU; pins; pins &= pins - 1U) {
+        gpio[p].writes[__builtin_ctz(pins)]++;
+    }
+    port->ODR = odr;
+    gpio_shadow[p].ODR = odr;
+    gpio_update(p);
+}
+
+/**
+ * @brief Registers a device that sees every change of pin levels.
+ */
+void SimGpio_Watch(SimGpio_Watcher_t watcher) {
+    if (gpio_watcher_count >= SIM_GPIO_WATCHERS) {
+        Sim_Fatal("too many GPIO watchers");
+    }
+    gpio_watchers[gpio_watcher_count++] = watcher;
+}
+
+/**
+ * @brief Drives a pin from outside the MCU (level 0/1), or releases it (level < 0).
+ */
+void SimGpio_Drive(uint32_t port, uint32_t pin, int level) {
+    uint32_t bit = 1UL << pin;
+    uint32_t mask = gpio[port].drive_mask;
+    uint32_t value = gpio[port].drive_level;
+
+    if (level < 0) {
+        mask &= ~bit;
+    } else {
+        mask |= bit;
+        value = level ? (value | bit) : (value & ~bit);
+    }
+    if (mask != gpio[port].drive_mask || value != gpio[port].drive_level) {
+        gpio[port].drive_mask = mask;
+        gpio[port].drive_level = value;
+        gpio_update(port);
+    }
+}
+
+/**
+ * @brief Returns the level of a pin (output, device drive or pull).
+ */
+bool SimGpio_Level(uint32_t port, uint32_t pin) {
+    return (gpio[port].idr >> pin) & 1U;
+}
+
+/**
+ * @brief Returns the number of BSRR writes since reset that set or reset a pin.
+ */
+uint32_t SimGpio_Writes(uint32_t port, uint32_t pin) {
+    return gpio[port].writes[pin];
+}
+
+/*---------- Timers ----------*/
+
+#define SIM_TIM_WATCHERS    4
+
+typedef struct {
+    bool running;
+    uint32_t psc;
+    uint32_t arr;
+    uint32_t cnt;           /* Counter at anchor (frozen value when stopped) */
+    Sim_Time_t anchor;
+    Sim_Time_t last_update;
+    Sim_Time_t uif_cleared;
+    Sim_Event_t update;
+} sim_timer_t;
+
+static sim_timer_t timers[SIM_TIMERS];
+static TIM_TypeDef tim_shadow[SIM_TIMERS];
+static SimTim_Watcher_t tim_watchers[SIM_TIM_WATCHERS];
+static uint32_t tim_watcher_count;
+static volatile bool tim_writable = true;
+/* Reconciles in a row without a timer write: the page is protected again
+   after SIM_TIM_LOCK_AFTER of them, so a timer written at every interrupt
+   (a display refresh) costs a compare per sync rather than a fault */
+#define SIM_TIM_LOCK_AFTER  256U
+static uint32_t tim_unwritten;
+
+/* Makes the timers writable until the next reconcile (model writes, or a fault) */
+static void tim_unlock(void) {
+    if (!tim_writable) {
+        mprotect(&sim_timer_page, sizeof(sim_timer_page), PROT_READ | PROT_WRITE);
+        tim_writable = true;
+    }
+}
+
+static void tim_lock(void) {
+    mprotect(&sim_timer_page, sizeof(sim_timer_page), PROT_READ);
+    tim_writable = false;
+    tim_unwritten = 0;
+}
+
+/* First firmware write to a timer since the last reconcile: retried once writable */
+static void tim_fault(int sig, siginfo_t *info, void *context) {
+    uintptr_t offset = (uintptr_t)info->si_addr - (uintptr_t)&sim_timer_page;
+    (void)context;
+    if (offset < sizeof(sim_timer_page) && !tim_writable) {
+        tim_unlock();
+        return;
+    }
+    signal(sig, SIG_DFL);   /* A real crash: fault again without the handler */
+}
+
+/* Timers on APB2 (the others are on APB1) */
+#define SIM_TIM_APB2(i)     ((i) == SIM_TIM1 || (i) >= SIM_TIM9)
+
+/* Core cycles per count: the timer clock is twice the bus clock when the bus is divided */
+static Sim_Time_t tim_cyclesPerCount(uint32_t i) {
+    uint32_t ppre = SIM_TIM_APB2(i)
+            ? (sim_rcc.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos
+            : (sim_rcc.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+    uint32_t shift = APBPrescTable[ppre];
+    uint64_t clock = (uint64_t)(SystemCoreClock >> shift) * (shift ? 2U : 1U);
+    Sim_Time_t cycles = (Sim_Time_t)(timers[i].psc + 1U) * SIM_CORE_HZ / clock;
+    return cycles ? cycles : 1U;
+}
+
+/* Moves the anchor to the last count boundary, noting the last overflow */
+static void tim_rebase(uint32_t i) {
+    sim_timer_t *t = &timers[i];
+    if (!t->running) {
+        return;
+    }
+    Sim_Time_t cpt = tim_cyclesPerCount(i);
+    uint64_t counts = (sim_now - t->anchor) / cpt;
+    uint64_t period = (uint64_t)t->arr + 1U;
+    uint64_t total = t->cnt + counts;
+    if (total >= period) {
+        t->last_update = t->anchor + ((total / period) * period - t->cnt) * cpt;
+    }
+    t->cnt = (uint32_t)(total % period);
+    t->anchor += counts * cpt;
+}
+
+/* Update events are only simulated when something listens to them */
+static void tim_schedule(uint32_t i) {
+    sim_timer_t *t = &timers[i];
+    uint32_t dier = sim_tim[i].DIER;
+    if (t->running && ((dier & TIM_DIER_UIE) || (sim_tim[i].CR1 & TIM_CR1_OPM))) {
+        uint64_t period = (uint64_t)t->arr + 1U;
+        uint64_t counts = period - (t->cnt % period);
+        Sim_Schedule(&t->update, t->anchor + counts * tim_cyclesPerCount(i));
+    } else {
+        Sim_Cancel(&t->update);
+    }
+}
+
+/* Sets flags in SR without it counting as a firmware write */
+static void tim_setFlags(uint32_t i, uint32_t flags) {
+    tim_unlock();
+    sim_tim[i].SR |= flags;
+    tim_shadow[i].SR = sim_tim[i].SR;
+    Sim_IrqChanged();
+}
+
+static void tim_update(void *arg) {
+    uint32_t i = (uint32_t)(uintptr_t)arg;
+    sim_timer_t *t = &timers[i];
+
+    t->cnt = 0;
+    t->anchor = sim_now;
+    t->last_update = sim_now;
+    if (!(sim_tim[i].CR1 & TIM_CR1_UDIS)) {
+        tim_setFlags(i, TIM_SR_UIF);
+    }
+    if (sim_tim[i].CR1 & TIM_CR1_OPM) {
+        /* One-pulse mode: the counter stops at the update event */
+        tim_unlock();
+        sim_tim[i].CR1 &= ~TIM_CR1_CEN;
+        tim_shadow[i].CR1 = sim_tim[i].CR1;
+        t->running = false;
+    }
+    tim_schedule(i);
+}
+
+/* Applies what the firmware wrote to a timer */
+static void tim_apply(uint32_t i) {
+    TIM_TypeDef *live = &sim_tim[i];
+    TIM_TypeDef *old = &tim_shadow[i];
+    sim_timer_t *t = &timers[i];
+    bool reschedule = false;
+
+    if (live->SR != old->SR) {
+        uint32_t sr = old->SR & live->SR;   /* rc_w0: written zeros clear */
+        if ((old->SR & TIM_SR_UIF) && !(sr & TIM_SR_UIF)) {
+            t->uif_cleared = sim_now;
+        }
+        live->SR = sr;
+        Sim_IrqChanged();
+    }
+    if (live->PSC != old->PSC || live->ARR != old->ARR) {
+        tim_rebase(i);
+        t->psc = live->PSC & 0xFFFFU;
+        t->arr = live->ARR;
+        if (t->cnt > t->arr) {
+            t->cnt = 0;
+        }
+        reschedule = true;
+    }
+    if (live->CNT != SIM_TIM_CNT_SHOWN) {
+        t->cnt = (live->CNT <= t->arr) ? live->CNT : 0U;
+        t->anchor = sim_now;
+        live->CNT = SIM_TIM_CNT_SHOWN;
+        reschedule = true;
+    }
+    if (live->EGR & TIM_EGR_UG) {
+        /* Re-initializes the counter; an update event unless URS */
+        t->cnt = 0;
+        t->anchor = sim_now;
+        if (!(live->CR1 & TIM_CR1_URS)) {
+            live->SR |= TIM_SR_UIF;
+            t->last_update = sim_now;
+            Sim_IrqChanged();
+        }
+        reschedule = true;
+    }
+    live->EGR = 0;
+    if ((live->CR1 ^ old->CR1) & TIM_CR1_CEN) {
+        if (live->CR1 & TIM_CR1_CEN) {
+            t->running = true;
+            t->anchor = sim_now;
+        } else {
+            tim_rebase(i);
+            t->running = false;
+        }
+        reschedule = true;
+    }
+    if ((live->CR1 ^ old->CR1) & TIM_CR1_OPM) {
+        reschedule = true;
+    }
+    if (live->DIER != old->DIER) {
+        if ((live->DIER & ~old->DIER) & TIM_DIER_UIE) {
+            /* Updates flagged while the interrupt was off are still pending */
+            tim_rebase(i);
+            if (t->last_update > t->uif_cleared) {
+                live->SR |= TIM_SR_UIF;
+            }
+        }
+        reschedule = true;
+        Sim_IrqChanged();
+    }
+    for (uint32_t ch = 0; ch < 4U; ch++) {
+        uint32_t ccr = (&live->CCR1)[ch];
+        if (ccr != (&old->CCR1)[ch]) {
+            for (uint32_t w = 0; w < tim_watcher_count; w++) {
+                tim_watchers[w](i, ch + 1U, ccr);
+            }
+        }
+    }
+    *old = *live;
+    if (reschedule) {
+        tim_schedule(i);
+    }
+}
+
+/**
+ * @brief Registers a device that sees the compare register writes (PWM outputs).
+ */
+void SimTim_Watch(SimTim_Watcher_t watcher) {
+    if (tim_watcher_count >= SIM_TIM_WATCHERS) {
+        Sim_Fatal("too many timer watchers");
+    }
+    tim_watchers[tim_watcher_count++] = watcher;
+}
+
+static bool tim_irq(uint32_t i) {
+    return (sim_tim[i].SR & sim_tim[i].DIER & 0x1FU) != 0;
+}
+
+/*---------- DMA ----------*/
+
+/* Streams of DMA2 used for SPI1_TX and TIM1_UP */
+#define SIM_DMA_STREAM(ctrl, n)     ((ctrl) * 8U + (n))
+
+static DMA_Stream_TypeDef dma_shadow[16];
+static uint32_t dma_isr[2][2];      /* LISR, HISR of each controller */
+static Sim_Event_t dma_done[16];
+static uint8_t dma_bytes[16][64];
+
+/* TIM1 update DMA playing RGB frames, evaluated when looked at */
+static struct {
+    bool active;
+    uint32_t stream;
+    Sim_Time_t start;
+    Sim_Time_t frame_cycles;
+    uint32_t frames;
+    bool circular;
+    const uint16_t *table;
+} rgb;
+
+static void dma_setFlags(uint32_t stream, uint32_t flags) {
+    uint32_t n = stream % 8U;
+    dma_isr[stream / 8U][n / 4U] |= flags << SIM_DMA_FLAG_SHIFT(n % 4U);
+    Sim_IrqChanged();
+}
+
+static bool dma_irq(uint32_t stream) {
+    uint32_t n = stream % 8U;
+    uint32_t flags = dma_isr[stream / 8U][n / 4U] >> SIM_DMA_FLAG_SHIFT(n % 4U);
+    uint32_t cr = dma_shadow[stream].CR;
+    return ((flags & (1U << 5)) && (cr & DMA_SxCR_TCIE))
+            || ((flags & (1U << 4)) && (cr & DMA_SxCR_HTIE))
+            || ((flags & (1U << 3)) && (cr & DMA_SxCR_TEIE));
+}
+
+/* Brings the RGB frame DMA up to now: CCR1-CCR3, NDTR, end of a one-shot table */
+static void rgb_update(void) {
+    if (!rgb.active) {
+        return;
+    }
+    uint64_t frame = (sim_now - rgb.start) / rgb.frame_cycles;
+    DMA_Stream_TypeDef *s = &dma_shadow[rgb.stream];
+
+    if (!rgb.circular && frame >= rgb.frames) {
+        frame = rgb.frames - 1U;
+        rgb.active = false;
+        s->CR &= ~DMA_SxCR_EN;
+        s->NDTR = 0;
+        dma_setFlags(rgb.stream, 1U << 5);
+    } else {
+        frame %= rgb.frames;
+        s->NDTR = (uint32_t)(rgb.frames - frame) * 3U;
+    }
+    const uint16_t *values = &rgb.table[frame * 3U];
+    tim_unlock();
+    sim_tim[SIM_TIM1].CCR1 = tim_shadow[SIM_TIM1].CCR1 = values[0];
+    sim_tim[SIM_TIM1].CCR2 = tim_shadow[SIM_TIM1].CCR2 = values[1];
+    sim_tim[SIM_TIM1].CCR3 = tim_shadow[SIM_TIM1].CCR3 = values[2];
+}
+
+/**
+ * @brief Returns 1 while TIM1 plays frames from DMA, bringing CCR1-CCR3 up to date.
+ */
+bool SimRgb_Animating(void) {
+    rgb_update();
+    return rgb.active;
+}
+
+/*---------- SPI ----------*/
+
+static struct {
+    uint8_t (*exchange)(uint8_t out);
+    Sim_Time_t busy_until;
+    Sim_Time_t rx_at;
+    bool rx_pending;
+    uint8_t rx;
+    uint32_t cr1;
+} spi[3];
+
+/* Core cycles per byte: fPCLK / 2^(BR+1), SPI1 on APB2, SPI2/3 on APB1 */
+static Sim_Time_t spi_byteCycles(uint32_t i) {
+    uint32_t ppre = (i == 0)
+            ? (sim_rcc.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos
+            : (sim_rcc.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+    uint32_t br = (spi[i].cr1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+    return 8U * ((Sim_Time_t)2U << br) << APBPrescTable[ppre];
+}
+
+/* Starts a byte on the bus after the one in progress */
+static void spi_send(uint32_t i, uint8_t out) {
+    Sim_Time_t start = (spi[i].busy_until > sim_now) ? spi[i].busy_until : sim_now;
+    spi[i].busy_until = start + spi_byteCycles(i);
+    spi[i].rx = spi[i].exchange ? spi[i].exchange(out) : 0xFFU;
+    spi[i].rx_at = spi[i].busy_until;
+    spi[i].rx_pending = true;
+}
+
+static void spi_reconcile(uint32_t i) {
+    spi[i].cr1 = sim_spi[i].CR1;
+    if (!(sim_spi[i].DR & SIM_MARK)) {
+        spi_send(i, (uint8_t)sim_spi[i].DR);
+    }
+}
+
+static void spi_present(uint32_t i) {
+    bool busy = sim_now < spi[i].busy_until;
+    bool rxne = spi[i].rx_pending && sim_now >= spi[i].rx_at;
+    sim_spi[i].SR = SPI_SR_TXE | (busy ? SPI_SR_BSY : 0U) | (rxne ? SPI_SR_RXNE : 0U);
+    sim_spi[i].DR = spi[i].rx | SIM_MARK;
+}
+
+/**
+ * @brief Connects a device to an SPI: exchange() gets each byte sent and returns the byte received.
+ */
+void SimSpi_Attach(uint32_t index, uint8_t (*exchange)(uint8_t out)) {
+    spi[index].exchange = exchange;
+}
+
+SPI_TypeDef *Sim_SpiAccess(uint32_t index) {
+    /* A polling loop on a byte in progress: skip to its end */
+    if (sim_now < spi[index].busy_until) {
+        Sim_AdvanceTo(spi[index].busy_until);
+    }
+    return (SPI_TypeDef *)Sim_Sync(&sim_spi[index]);
+}
+
+/*---------- I2C (master transmitter, DMA) ----------*/
+
+/* Bus phases of a master transmission */
+typedef enum {
+    I2C_IDLE = 0,
+    I2C_START,          /* START (or repeated START) requested, SB once it is on the bus */
+    I2C_ADDRESS,        /* SB set, then the address byte shifting out */
+    I2C_ADDRESSED,      /* ADDR set, cleared by reading SR1 then SR2 */
+    I2C_DATA,           /* Bytes from DMA, BTF after the last one */
+    I2C_NACK,           /* Address not acknowledged (AF), SCL held until START or STOP */
+    I2C_STOP            /* STOP requested, the bus is free one SCL period later */
+} i2c_phase_t;
+
+#define SIM_I2C_ERRORS  (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR)
+#define SIM_NO_STREAM   16U
+
+static struct {
+    void (*write)(uint8_t byte);
+    uint8_t address;        /* 7-bit address of the device */
+    i2c_phase_t phase;
+    uint32_t sr1;
+    uint32_t held;          /* START and STOP requests the hardware has not cleared yet */
+    uint32_t cr1_shown;     /* CR1 and SR1 as last shown (a difference is a write) */
+    uint32_t sr1_shown;
+    uint8_t target;         /* Address byte sent */
+    Sim_Event_t next;       /* End of the bus step in progress */
+    uint32_t stream;        /* DMA stream writing DR, SIM_NO_STREAM if none is enabled */
+    uint8_t bytes[256];
+    uint32_t count;
+    uint32_t sent;
+} i2c[3];
+
+/* Core cycles per SCL period in standard mode: 2 x CCR cycles of PCLK1 */
+static Sim_Time_t i2c_sclCycles(uint32_t i) {
+    uint32_t ppre = (sim_rcc.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+    uint32_t ccr = sim_i2c[i].CCR & 0xFFFU;
+    return ((Sim_Time_t)2U * (ccr ? ccr : 1U)) << APBPrescTable[ppre];
+}
+
+/* Starts the bytes from DMA once the address is acknowledged and the stream enabled */
+static void i2c_dataStart(uint32_t i) {
+    if (i2c[i].phase != I2C_DATA || i2c[i].stream == SIM_NO_STREAM || i2c[i].count) {
+        return;
+    }
+    DMA_Stream_TypeDef *s = &dma_shadow[i2c[i].stream];
+    uint32_t n = s->NDTR;
+    if (n == 0 || n > sizeof(i2c[i].bytes)) {
+        Sim_Fatal("DMA stream %lu: %lu bytes to I2C%lu", (unsigned long)i2c[i].stream,
+                (unsigned long)n, (unsigned long)i + 1U);
+    }
+    memcpy(i2c[i].bytes, (const void *)(uintptr_t)s->M0AR, n);
+    i2c[i].count = n;
+    i2c[i].sent = 0;
+    Sim_Schedule(&i2c[i].next, sim_now + 9U * i2c_sclCycles(i));
+}
+
+/* DMA moves the next byte into DR as soon as the previous one starts shifting */
+static void i2c_dmaProgress(uint32_t i) {
+    uint32_t stream = i2c[i].stream;
+    uint32_t moved = (i2c[i].sent + 2U < i2c[i].count) ? i2c[i].sent + 2U : i2c[i].count;
+
+    if (stream == SIM_NO_STREAM) {
+        return;     /* Everything moved already: only the shift register is busy */
+    }
+    dma_shadow[stream].NDTR = i2c[i].count - moved;
+    if (moved == i2c[i].count && (dma_shadow[stream].CR & DMA_SxCR_EN)) {
+        dma_shadow[stream].CR &= ~DMA_SxCR_EN;
+        dma_setFlags(stream, 1U << 5);
+        i2c[i].stream = SIM_NO_STREAM;
+    }
+}
+
+/* End of the bus step in progress */
+static void i2c_step(void *arg) {
+    uint32_t i = (uint32_t)(uintptr_t)arg;
+
+    switch (i2c[i].phase) {
+    case I2C_START:
+        i2c[i].held &= ~I2C_CR1_START;
+        i2c[i].sr1 |= I2C_SR1_SB;
+        i2c[i].phase = I2C_ADDRESS;
+        break;
+    case I2C_ADDRESS:
+        /* The address byte is out: acknowledged by a device at that address */
+        if (i2c[i].write && i2c[i].target == (uint8_t)(i2c[i].address << 1)) {
+            i2c[i].sr1 |= I2C_SR1_ADDR | I2C_SR1_TXE;
+            i2c[i].phase = I2C_ADDRESSED;
+        } else {
+            i2c[i].sr1 |= I2C_SR1_AF;
+            i2c[i].phase = I2C_NACK;
+        }
+        break;
+    case I2C_DATA:
+        i2c[i].write(i2c[i].bytes[i2c[i].sent++]);
+        if (i2c[i].sent < i2c[i].count) {
+            i2c_dmaProgress(i);
+            Sim_Schedule(&i2c[i].next, sim_now + 9U * i2c_sclCycles(i));
+        } else {
+            i2c[i].sr1 |= I2C_SR1_BTF | I2C_SR1_TXE;
+        }
+        break;
+    case I2C_STOP:
+        i2c[i].held &= ~I2C_CR1_STOP;
+        i2c[i].phase = I2C_IDLE;
+        break;
+    default:
+        break;
+    }
+    Sim_IrqChanged();
+}
+
+static void i2c_reconcile(uint32_t i) {
+    I2C_TypeDef *live = &sim_i2c[i];
+    uint32_t requests = 0;
+
+    if (live->CR1 & I2C_CR1_SWRST) {
+        Sim_Cancel(&i2c[i].next);
+        i2c[i].phase = I2C_IDLE;
+        i2c[i].sr1 = 0;
+        i2c[i].held = 0;
+        i2c[i].cr1_shown = live->CR1;
+        return;
+    }
+    if (live->CR1 != i2c[i].cr1_shown) {
+        if (i2c[i].held & I2C_CR1_STOP) {
+            /* RM0368: a write before the hardware clears STOP may request a second one */
+            Sim_Fatal("I2C%lu: CR1 written while the STOP condition is generated", (unsigned long)i + 1U);
+        }
+        requests = live->CR1 & ~i2c[i].cr1_shown & (I2C_CR1_START | I2C_CR1_STOP);
+        i2c[i].cr1_shown = live->CR1;
+    }
+    /* Error flags are cleared by writing 0 */
+    i2c[i].sr1 &= ~(i2c[i].sr1_shown & ~live->SR1 & SIM_I2C_ERRORS);
+    i2c[i].sr1_shown = live->SR1;
+
+    if (!(live->DR & SIM_MARK)) {
+        if (i2c[i].phase != I2C_ADDRESS || !(i2c[i].sr1 & I2C_SR1_SB)) {
+            Sim_Fatal("I2C%lu: DR written outside the address phase (data goes by DMA)",
+                    (unsigned long)i + 1U);
+        }
+        i2c[i].target = (uint8_t)live->DR;
+        i2c[i].sr1 &= ~I2C_SR1_SB;
+        Sim_Schedule(&i2c[i].next, sim_now + 9U * i2c_sclCycles(i));
+    }
+    if (requests & I2C_CR1_START) {
+        if (i2c[i].phase != I2C_IDLE && i2c[i].phase != I2C_NACK && !(i2c[i].sr1 & I2C_SR1_BTF)) {
+            Sim_Fatal("I2C%lu: START in the middle of a transfer", (unsigned long)i + 1U);
+        }
+        /* START, or a repeated START after the last byte or a NACK */
+        i2c[i].held |= I2C_CR1_START;
+        i2c[i].sr1 &= ~(I2C_SR1_BTF | I2C_SR1_TXE);
+        i2c[i].count = 0;
+        i2c[i].phase = I2C_START;
+        Sim_Schedule(&i2c[i].next, sim_now + i2c_sclCycles(i));
+    } else if (requests & I2C_CR1_STOP) {
+        i2c[i].held |= I2C_CR1_STOP;
+        i2c[i].sr1 &= ~(I2C_SR1_BTF | I2C_SR1_TXE);
+        i2c[i].count = 0;
+        i2c[i].phase = I2C_STOP;
+        Sim_Schedule(&i2c[i].next, sim_now + i2c_sclCycles(i));
+    }
+    Sim_IrqChanged();
+}
+
+static void i2c_present(uint32_t i) {
+    i2c[i].cr1_shown = (sim_i2c[i].CR1 & ~(I2C_CR1_START | I2C_CR1_STOP)) | i2c[i].held;
+    i2c[i].sr1_shown = i2c[i].sr1;
+    sim_i2c[i].CR1 = i2c[i].cr1_shown;
+    sim_i2c[i].SR1 = i2c[i].sr1;
+    sim_i2c[i].SR2 = (i2c[i].phase != I2C_IDLE) ? (I2C_SR2_BUSY | I2C_SR2_MSL) : 0U;
+    sim_i2c[i].DR = SIM_MARK;
+}
+
+static bool i2c_irq(uint32_t i, bool error) {
+    uint32_t cr2 = sim_i2c[i].CR2;
+    if (error) {
+        return (cr2 & I2C_CR2_ITERREN) && (i2c[i].sr1 & SIM_I2C_ERRORS);
+    }
+    return (cr2 & I2C_CR2_ITEVTEN) && (i2c[i].sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF));
+}
+
+/* The event handler read SR1 then SR2 (reads the model cannot see): ADDR is cleared */
+static void i2c_eventTaken(uint32_t i) {
+    if (i2c[i].sr1 & I2C_SR1_ADDR) {
+        i2c[i].sr1 &= ~(I2C_SR1_ADDR | I2C_SR1_TXE);
+        i2c[i].phase = I2C_DATA;
+        i2c_dataStart(i);
+    }
+}
+
+/**
+ * @brief Connects a device to an I2C bus at a 7-bit address: write() gets each data byte.
+ */
+void SimI2c_Attach(uint32_t index, uint8_t address, void (*write)(uint8_t byte)) {
+    i2c[index].address = address;
+    i2c[index].write = write;
+}
+
+/*---------- DMA to the peripherals ----------*/
+
+/* End of an SPI TX DMA transfer: the bytes are on the bus, the last one still shifting */
+static void dma_spiDone(void *arg) {
+    uint32_t stream = (uint32_t)(uintptr_t)arg;
+    DMA_Stream_TypeDef *s = &dma_shadow[stream];
+    uint32_t i = (uint32_t)((s->PAR - (uint32_t)(uintptr_t)&sim_spi[0].DR) / sizeof(SPI_TypeDef));
+
+    for (uint32_t n = 0; n < s->NDTR; n++) {
+        if (spi[i].exchange) {
+            spi[i].exchange(dma_bytes[stream][n]);
+        }
+    }
+    s->NDTR = 0;
+    s->CR &= ~DMA_SxCR_EN;
+    dma_setFlags(stream, 1U << 5);
+}
+
+/* EN set by the firmware: starts the transfer to the peripheral at PAR */
+static void dma_start(uint32_t stream) {
+    DMA_Stream_TypeDef *s = &dma_shadow[stream];
+
+    for (uint32_t i = 0; i < 3U; i++) {
+        if (s->PAR == (uint32_t)(uintptr_t)&sim_spi[i].DR) {
+            uint32_t n = s->NDTR;
+            if (n == 0 || n > sizeof(dma_bytes[0])) {
+                Sim_Fatal("DMA stream %lu: %lu bytes to SPI%lu", (unsigned long)stream,
+                        (unsigned long)n, (unsigned long)i + 1U);
+            }
+            memcpy(dma_bytes[stream], (const void *)(uintptr_t)s->M0AR, n);
+            Sim_Time_t start = (spi[i].busy_until > sim_now) ? spi[i].busy_until : sim_now;
+            Sim_Time_t byte = spi_byteCycles(i);
+            spi[i].busy_until = start + n * byte;
+            /* Transfer complete when the last byte moves into the transmit buffer */
+            Sim_Schedule(&dma_done[stream], start + (n - 1U) * byte + SIM_ACCESS_CYCLES);
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < 3U; i++) {
+        if (s->PAR == (uint32_t)(uintptr_t)&sim_i2c[i].DR) {
+            /* Bytes move once the address is acknowledged and ADDR cleared */
+            i2c[i].stream = stream;
+            i2c_dataStart(i);
+            return;
+        }
+    }
+    if (s->PAR == (uint32_t)(uintptr_t)&sim_tim[SIM_TIM1].DMAR) {
+        sim_timer_t *t = &timers[SIM_TIM1];
+        rgb.active = true;
+        rgb.stream = stream;
+        rgb.start = sim_now;
+        rgb.frames = s->NDTR / 3U;
+        rgb.circular = (s->CR & DMA_SxCR_CIRC) != 0;
+        rgb.table = (const uint16_t *)(uintptr_t)s->M0AR;
+        rgb.frame_cycles = ((Sim_Time_t)t->arr + 1U) * tim_cyclesPerCount(SIM_TIM1)
+                * ((sim_tim[SIM_TIM1].RCR & 0xFFU) + 1U);
+        if (rgb.frames == 0 || rgb.frame_cycles == 0) {
+            Sim_Fatal("DMA stream %lu: empty RGB frame table", (unsigned long)stream);
+        }
+        return;
+    }
+    Sim_Fatal("DMA stream %lu: transfers to 0x%08lx are not modelled", (unsigned long)stream,
+            (unsigned long)s->PAR);
+}
+
+static void dma_streamReconcile(uint32_t stream) {
+    DMA_Stream_TypeDef *live = &sim_dma_stream[stream];
+    DMA_Stream_TypeDef *s = &dma_shadow[stream];
+    uint32_t rising = live->CR & ~s->CR & DMA_SxCR_EN;
+    uint32_t falling = ~live->CR & s->CR & DMA_SxCR_EN;
+
+    if (falling && rgb.active && rgb.stream == stream) {
+        rgb_update();
+        rgb.active = false;
+    }
+    if (falling) {
+        Sim_Cancel(&dma_done[stream]);
+        for (uint32_t i = 0; i < 3U; i++) {
+            if (i2c[i].stream == stream) {
+                i2c[i].stream = SIM_NO_STREAM;
+            }
+        }
+    }
+    *s = *live;
+    if (rising) {
+        dma_start(stream);
+    }
+    Sim_IrqChanged();
+}
+
+static void dma_streamPresent(uint32_t stream) {
+    if (rgb.active && rgb.stream == stream) {
+        rgb_update();
+    }
+    sim_dma_stream[stream] = dma_shadow[stream];
+}
+
+static void dma_reconcile(uint32_t ctrl) {
+    if (sim_dma[ctrl].LIFCR || sim_dma[ctrl].HIFCR) {
+        dma_isr[ctrl][0] &= ~sim_dma[ctrl].LIFCR;
+        dma_isr[ctrl][1] &= ~sim_dma[ctrl].HIFCR;
+        Sim_IrqChanged();
+    }
+}
+
+static void dma_present(uint32_t ctrl) {
+    if (rgb.active && rgb.stream / 8U == ctrl) {
+        rgb_update();
+    }
+    sim_dma[ctrl].LISR = dma_isr[ctrl][0];
+    sim_dma[ctrl].HISR = dma_isr[ctrl][1];
+    sim_dma[ctrl].LIFCR = 0;
+    sim_dma[ctrl].HIFCR = 0;
+}
+
+/*---------- USART6 (service console) ----------*/
+
+#define SIM_UART            2U      /* USART6 in sim_usart[] */
+#define SIM_UART_RX_SIZE    1024U
+
+static struct {
+    void (*receive)(char c);
+    Sim_Time_t tx_until;
+    bool rxne;
+    uint8_t rx;
+    char queue[SIM_UART_RX_SIZE];
+    uint32_t head, tail;
+    uint32_t overruns;
+    Sim_Event_t rx_next;
+} uart;
+
+/* Core cycles per 8N1 frame from BRR (16x oversampling, USART6 on APB2) */
+static Sim_Time_t uart_frameCycles(void) {
+    uint32_t ppre = (sim_rcc.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos;
+    uint32_t brr = sim_usart[SIM_UART].BRR ? sim_usart[SIM_UART].BRR : 1U;
+    return ((Sim_Time_t)10U * brr) << APBPrescTable[ppre];
+}
+
+static void uart_reconcile(uint32_t i) {
+    if (i != SIM_UART || (sim_usart[i].DR & SIM_MARK)) {
+        return;
+    }
+    Sim_Time_t start = (uart.tx_until > sim_now) ? uart.tx_until : sim_now;
+    uart.tx_until = start + uart_frameCycles();
+    if (uart.receive) {
+        uart.receive((char)sim_usart[i].DR);
+    }
+}
+
+static void uart_present(uint32_t i) {
+    if (i != SIM_UART) {
+        sim_usart[i].SR = USART_SR_TXE | USART_SR_TC;
+        sim_usart[i].DR = SIM_MARK;
+        return;
+    }
+    bool busy = sim_now < uart.tx_until;
+    sim_usart[i].SR = (busy ? 0U : USART_SR_TXE | USART_SR_TC) | (uart.rxne ? USART_SR_RXNE : 0U);
+    sim_usart[i].DR = uart.rx | SIM_MARK;
+}
+
+static void uart_rxNext(void *arg) {
+    (void)arg;
+    if (uart.tail == uart.head) {
+        return;
+    }
+    if (uart.rxne) {
+        uart.overruns++;    /* The previous character was never read */
+    }
+    uart.rx = (uint8_t)uart.queue[uart.tail];
+    uart.tail = (uart.tail + 1U) % SIM_UART_RX_SIZE;
+    uart.rxne = true;
+    Sim_IrqChanged();
+    if (uart.tail != uart.head) {
+        Sim_Schedule(&uart.rx_next, sim_now + uart_frameCycles());
+    }
+}
+
+/**
+ * @brief Connects a receiver to the transmit line of the service USART.
+ */
+void SimUart_Attach(void (*receive)(char c)) {
+    uart.receive = receive;
+}
+
+/**
+ * @brief Queues characters on the receive line of the service USART (one per frame time).
+ */
+void SimUart_Inject(const char *text) {
+    for (; *text; text++) {
+        uint32_t next = (uart.head + 1U) % SIM_UART_RX_SIZE;
+        if (next == uart.tail) {
+            Sim_Fatal("console input queue full");
+        }
+        uart.queue[uart.head] = *text;
+        uart.head = next;
+    }
+    if (!uart.rx_next.queued) {
+        Sim_Schedule(&uart.rx_next, sim_now + uart_frameCycles());
+    }
+}
+
+USART_TypeDef *Sim_UsartAccess(uint32_t index) {
+    /* Waiting for TXE while a frame goes out: skip to its end */
+    if (index == SIM_UART && sim_now < uart.tx_until) {
+        Sim_AdvanceTo(uart.tx_until);
+    }
+    return (USART_TypeDef *)Sim_Sync(&sim_usart[index]);
+}
+
+/*---------- Dispatch by register block ----------*/
+
+#define SIM_IN(block, array) \
+    ((uintptr_t)(block) >= (uintptr_t)&(array)[0] \
+    && (uintptr_t)(block) < (uintptr_t)&(array)[sizeof(array) / sizeof((array)[0])])
+#define SIM_INDEX(block, array) \
+    ((uint32_t)(((uintptr_t)(block) - (uintptr_t)&(array)[0]) / sizeof((array)[0])))
+
+/**
+ * @brief Applies what the firmware wrote to a hooked register block.
+ */
+void SimPeriph_Reconcile(void *regs) {
+    if (regs == NULL) {
+        return;
+    }
+    if (regs == &sim_systick) {
+        st_reconcile();
+    } else if (SIM_IN(regs, sim_spi)) {
+        spi_reconcile(SIM_INDEX(regs, sim_spi));
+    } else if (SIM_IN(regs, sim_dma_stream)) {
+        dma_streamReconcile(SIM_INDEX(regs, sim_dma_stream));
+    } else if (SIM_IN(regs, sim_dma)) {
+        dma_reconcile(SIM_INDEX(regs, sim_dma));
+    } else if (regs == &sim_exti) {
+        exti_reconcile();
+    } else if (regs == &sim_scb) {
+        scb_reconcile();
+    } else if (regs == &sim_dwt) {
+        dwt_reconcile();
+    } else if (SIM_IN(regs, sim_usart)) {
+        uart_reconcile(SIM_INDEX(regs, sim_usart));
+    } else if (SIM_IN(regs, sim_i2c)) {
+        i2c_reconcile(SIM_INDEX(regs, sim_i2c));
+    }
+}
+
+/**
+ * @brief Shows the current state of a hooked register block to the firmware.
+ */
+void SimPeriph_Present(void *regs) {
+    if (regs == NULL) {
+        return;
+    }
+    if (regs == &sim_systick) {
+        st_present();
+    } else if (SIM_IN(regs, sim_spi)) {
+        spi_present(SIM_INDEX(regs, sim_spi));
+    } else if (SIM_IN(regs, sim_dma_stream)) {
+        dma_streamPresent(SIM_INDEX(regs, sim_dma_stream));
+    } else if (SIM_IN(regs, sim_dma)) {
+        dma_present(SIM_INDEX(regs, sim_dma));
+    } else if (regs == &sim_exti) {
+        exti_present();
+    } else if (regs == &sim_scb) {
+        scb_present();
+    } else if (regs == &sim_dwt) {
+        dwt_present();
+    } else if (SIM_IN(regs, sim_usart)) {
+        uart_present(SIM_INDEX(regs, sim_usart));
+    } else if (SIM_IN(regs, sim_i2c)) {
+        i2c_present(SIM_INDEX(regs, sim_i2c));
+    }
+}
+
+/**
+ * @brief Applies the writes to the plain register blocks (timers, GPIO
+ * configuration and outputs). RCC and SYSCFG are read where they are used.
+ */
+void SimPeriph_ReconcilePlain(void) {
+    if (tim_writable) {
+        bool written = false;
+        for (uint32_t i = 0; i < SIM_TIMERS; i++) {
+            if (memcmp(&sim_tim[i], &tim_shadow[i], sizeof(TIM_TypeDef)) != 0) {
+                tim_apply(i);
+                written = true;
+            }
+        }
+        tim_unwritten = written ? 0U : tim_unwritten + 1U;
+        if (tim_unwritten >= SIM_TIM_LOCK_AFTER) {
+            tim_lock();
+        }
+    }
+    for (uint32_t p = 0; p < SIM_GPIO_PORTS; p++) {
+        if (memcmp(&sim_gpio[p].regs, &gpio_shadow[p], SIM_GPIO_CONFIG_SIZE) != 0) {
+            sim_gpio[p].regs.IDR = gpio[p].idr;
+            memcpy(&gpio_shadow[p], &sim_gpio[p].regs, SIM_GPIO_CONFIG_SIZE);
+            gpio_update(p);
+        }
+    }
+}
+
+/**
+ * @brief Returns the request level of an interrupt (source flags and enables).
+ */
+bool SimPeriph_IrqLevel(int32_t irq) {
+    switch (irq) {
+    case EXTI0_IRQn:
+    case EXTI1_IRQn:
+    case EXTI2_IRQn:
+    case EXTI3_IRQn:
+    case EXTI4_IRQn:
+        return (exti.PR >> (irq - EXTI0_IRQn)) & 1U;
+    case EXTI9_5_IRQn:
+        return (exti.PR & 0x03E0U) != 0;
+    case EXTI15_10_IRQn:
+        return (exti.PR & 0xFC00U) != 0;
+    case TIM1_BRK_TIM9_IRQn:
+        return tim_irq(SIM_TIM9);
+    case TIM1_UP_TIM10_IRQn:
+        return tim_irq(SIM_TIM1) || tim_irq(SIM_TIM10);
+    case TIM1_TRG_COM_TIM11_IRQn:
+        return tim_irq(SIM_TIM11);
+    case TIM2_IRQn:
+        return tim_irq(SIM_TIM2);
+    case TIM3_IRQn:
+        return tim_irq(SIM_TIM3);
+    case TIM4_IRQn:
+        return tim_irq(SIM_TIM4);
+    case TIM5_IRQn:
+        return tim_irq(SIM_TIM5);
+    case USART6_IRQn:
+        return uart.rxne && (sim_usart[SIM_UART].CR1 & USART_CR1_RXNEIE);
+    case I2C1_EV_IRQn:
+    case I2C2_EV_IRQn:
+        return i2c_irq((irq == I2C1_EV_IRQn) ? 0U : 1U, false);
+    case I2C1_ER_IRQn:
+    case I2C2_ER_IRQn:
+        return i2c_irq((irq == I2C1_ER_IRQn) ? 0U : 1U, true);
+    default:
+        break;
+    }
+    if (irq >= DMA1_Stream0_IRQn && irq <= DMA1_Stream6_IRQn) {
+        return dma_irq(SIM_DMA_STREAM(0U, (uint32_t)(irq - DMA1_Stream0_IRQn)));
+    }
+    if (irq == DMA1_Stream7_IRQn) {
+        return dma_irq(SIM_DMA_STREAM(0U, 7U));
+    }
+    if (irq >= DMA2_Stream0_IRQn && irq <= DMA2_Stream4_IRQn) {
+        return dma_irq(SIM_DMA_STREAM(1U, (uint32_t)(irq - DMA2_Stream0_IRQn)));
+    }
+    if (irq >= DMA2_Stream5_IRQn && irq <= DMA2_Stream7_IRQn) {
+        return dma_irq(SIM_DMA_STREAM(1U, (uint32_t)(irq - DMA2_Stream5_IRQn) + 5U));
+    }
+    return false;
+}
+
+/**
+ * @brief Side effects of a handler the model cannot see: the USART handler
+ * read DR, the I2C event handler read SR1 and SR2.
+ */
+void SimPeriph_IrqTaken(int32_t irq) {
+    if (irq == USART6_IRQn) {
+        uart.rxne = false;
+    } else if (irq == I2C1_EV_IRQn || irq == I2C2_EV_IRQn) {
+        i2c_eventTaken((irq == I2C1_EV_IRQn) ? 0U : 1U);
+    }
+}
+
+/**
+ * @brief Resets the peripherals to their power-on state (RM0368 reset values).
+ */
+void SimPeriph_Reset(void) {
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+    memset(gpio, 0, sizeof(gpio));
+    sim_gpio[0].regs.MODER = 0xA8000000U;     /* PA13-PA15: debug port */
+    sim_gpio[0].regs.OSPEEDR = 0x0C000000U;
+    sim_gpio[0].regs.PUPDR = 0x64000000U;
+    sim_gpio[1].regs.MODER = 0x00000280U;     /* PB3, PB4: debug port */
+    sim_gpio[1].regs.OSPEEDR = 0x000000C0U;
+    sim_gpio[1].regs.PUPDR = 0x00000100U;
+    for (uint32_t p = 0; p < SIM_GPIO_PORTS; p++) {
+        gpio[p].idr = gpio_levels(p);
+        sim_gpio[p].regs.IDR = gpio[p].idr;
+        memcpy(&gpio_shadow[p], &sim_gpio[p].regs, SIM_GPIO_CONFIG_SIZE);
+    }
+
+    static bool fault_handler;
+    if (!fault_handler) {
+        struct sigaction action = { .sa_sigaction = tim_fault, .sa_flags = SA_SIGINFO };
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, NULL);
+        fault_handler = true;
+    }
+    tim_unlock();
+    memset(sim_tim, 0, sizeof(sim_tim));
+    memset(timers, 0, sizeof(timers));
+    for (uint32_t i = 0; i < SIM_TIMERS; i++) {
+        sim_tim[i].ARR = (i == SIM_TIM2 || i == SIM_TIM5) ? 0xFFFFFFFFU : 0xFFFFU;
+        sim_tim[i].CNT = SIM_TIM_CNT_SHOWN;
+        timers[i].arr = sim_tim[i].ARR;
+        Sim_EventInit(&timers[i].update, tim_update, (void *)(uintptr_t)i);
+    }
+    memcpy(tim_shadow, sim_tim, sizeof(sim_tim));
+
+    memset(&st, 0, sizeof(st));
+    Sim_EventInit(&st.zero, st_zero, NULL);
+    memset(&dwt, 0, sizeof(dwt));
+    memset(&exti, 0, sizeof(exti));
+    memset(dma_shadow, 0, sizeof(dma_shadow));
+    memset(dma_isr, 0, sizeof(dma_isr));
+    memset(&rgb, 0, sizeof(rgb));
+    for (uint32_t s = 0; s < 16U; s++) {
+        Sim_EventInit(&dma_done[s], dma_spiDone, (void *)(uintptr_t)s);
+    }
+    for (uint32_t i = 0; i < 3U; i++) {
+        spi[i].busy_until = 0;
+        spi[i].rx_pending = false;
+        spi[i].cr1 = 0;
+        sim_spi[i].DR = SIM_MARK;
+        sim_usart[i].DR = SIM_MARK;
+        memset(&sim_i2c[i], 0, sizeof(sim_i2c[i]));
+        sim_i2c[i].DR = SIM_MARK;
+        i2c[i].phase = I2C_IDLE;
+        i2c[i].sr1 = 0;
+        i2c[i].held = 0;
+        i2c[i].cr1_shown = 0;
+        i2c[i].sr1_shown = 0;
+        i2c[i].stream = SIM_NO_STREAM;
+        i2c[i].count = 0;
+        Sim_EventInit(&i2c[i].next, i2c_step, (void *)(uintptr_t)i);
+    }
+    uart.tx_until = 0;
+    uart.rxne = false;
+    uart.head = uart.tail = 0;
+    Sim_EventInit(&uart.rx_next, uart_rxNext, NULL);
+    memset(&sim_rcc, 0, sizeof(sim_rcc));
+    memset(&sim_syscfg, 0, sizeof(sim_syscfg));
+    exti_present();
+    st_present();
+    dwt_present();
+}
@@ -0,0 +1,384 @@
+#include "sim_devices.h"
+#include <rc522.h>
+#include <string.h>
+
+/*
+ * MFRC522 behind SPI2, with one ISO 14443-A card (MIFARE Classic, 4-byte
+ * UID) that can be put in its field. Modelled: the register file, the FIFO,
+ * the Idle/Transceive/CalcCRC/SoftReset commands, the timer (TAuto), the
+ * IRQ pin and the air time of frames at 106 kbit/s. The card answers REQA,
+ * WUPA, anticollision, SELECT and HLTA; after answering REQA it is READY,
+ * and like a real card it drops back to IDLE on any other command (so an
+ * unselected card answers every second REQA).
+ */
+
+#define RC522_SPI           1U      /* SPI2 */
+#define RC522_REGS          64U
+#define RC522_FIFO_SIZE     64U
+
+/* Air timings: one bit at 106 kbit/s, card response delay (FDT) */
+#define RC522_BIT_CYCLES    (SIM_CORE_HZ / 106000U)
+#define RC522_FDT_CYCLES    SIM_US(86)
+/* Internal timer input clock */
+#define RC522_TIMER_HZ      13560000U
+
+typedef enum {
+    PICC_STATE_IDLE = 0,
+    PICC_STATE_READY,
+    PICC_STATE_ACTIVE,
+    PICC_STATE_HALT
+} Picc_State_t;
+
+static struct {
+    uint8_t regs[RC522_REGS];
+    uint8_t fifo[RC522_FIFO_SIZE];
+    uint32_t fifo_count;
+    uint32_t fifo_read;
+    bool powered;
+    bool selected;
+    bool have_addr;
+    bool reading;
+    uint8_t addr;
+    uint8_t command;
+
+    bool card;
+    uint8_t uid[4];
+    Picc_State_t picc;
+    bool card_read;
+    uint32_t reads;
+
+    uint8_t reply[RC522_FIFO_SIZE];
+    uint32_t reply_len;
+    Sim_Event_t done;
+    Sim_Event_t timeout;
+} rc;
+
+/* Register values after power-on or SoftReset (datasheet section 9) */
+static void rc_resetRegs(void) {
+    memset(rc.regs, 0, sizeof(rc.regs));
+    rc.regs[CommandReg] = 0x20;
+    rc.regs[CommIEnReg] = 0x80;
+    rc.regs[CommIrqReg] = 0x14;
+    rc.regs[Status1Reg] = 0x21;
+    rc.regs[WaterLevelReg] = 0x08;
+    rc.regs[ControlReg] = 0x10;
+    rc.regs[ModeReg] = 0x3F;
+    rc.regs[TxControlReg] = 0x80;
+    rc.regs[TxSelReg] = 0x10;
+    rc.regs[RxSelReg] = 0x84;
+    rc.regs[RxThresholdReg] = 0x84;
+    rc.regs[DemodReg] = 0x4D;
+    rc.regs[CRCResultRegH] = 0xFF;
+    rc.regs[CRCResultRegL] = 0xFF;
+    rc.regs[ModWidthReg] = 0x26;
+    rc.regs[RFCfgReg] = 0x48;
+    rc.regs[GsNReg] = 0x88;
+    rc.regs[CWGsPReg] = 0x20;
+    rc.regs[ModGsPReg] = 0x20;
+    rc.regs[VersionReg] = 0x92;
+    rc.fifo_count = 0;
+    rc.fifo_read = 0;
+    rc.command = PCD_IDLE;
+    Sim_Cancel(&rc.done);
+    Sim_Cancel(&rc.timeout);
+}
+
+/* IRQ pin: open drain and inverted (IRqInv) as the driver configures it */
+static void rc_updateIrq(void) {
+    bool active = (rc.regs[CommIrqReg] & rc.regs[CommIEnReg] & 0x7FU)
+            || (rc.regs[DivIrqReg] & rc.regs[DivlEnReg] & 0x14U);
+    bool level = (rc.regs[CommIEnReg] & 0x80U) ? !active : active;
+
+    if (!rc.powered) {
+        SimGpio_Drive(SIM_PORT_C, MFRC522_IRQ_PIN, -1);
+    } else if (rc.regs[DivlEnReg] & 0x80U) {
+        SimGpio_Drive(SIM_PORT_C, MFRC522_IRQ_PIN, level);      /* IRQPushPull */
+    } else {
+        SimGpio_Drive(SIM_PORT_C, MFRC522_IRQ_PIN, level ? -1 : 0);
+    }
+}
+
+static void rc_setIrq(uint8_t comm, uint8_t div) {
+    rc.regs[CommIrqReg] |= comm;
+    rc.regs[DivIrqReg] |= div;
+    rc_updateIrq();
+}
+
+/* CRC_A of ISO 14443-3 (preset 0x6363, ModeReg = 0x3D) */
+static uint16_t rc_crcA(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0x6363U;
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t ch = (uint8_t)(data[i] ^ (uint8_t)crc);
+        ch = (uint8_t)(ch ^ (ch << 4));
+        crc = (crc >> 8) ^ ((uint32_t)ch << 8) ^ ((uint32_t)ch << 3) ^ ((uint32_t)ch >> 4);
+    }
+    return (uint16_t)crc;
+}
+
+/* Reply of the card to a frame (length 0: silent) */
+static uint32_t rc_cardReply(const uint8_t *frame, uint32_t len, uint32_t bits, uint8_t *reply) {
+    if (!rc.card || !(rc.regs[TxControlReg] & 0x03U)) {
+        return 0;   /* No card, or the antenna is off */
+    }
+    if (bits == 7U && (frame[0] == PICC_REQIDL || frame[0] == PICC_REQALL)) {
+        bool wakes = (rc.picc == PICC_STATE_IDLE)
+                || (frame[0] == PICC_REQALL && rc.picc == PICC_STATE_HALT);
+        if (!wakes) {
+            if (rc.picc != PICC_STATE_HALT) {
+                rc.picc = PICC_STATE_IDLE;
+            }
+            return 0;
+        }
+        rc.picc = PICC_STATE_READY;
+        reply[0] = 0x04;    /* ATQA: MIFARE Classic 1K */
+        reply[1] = 0x00;
+        return 2;
+    }
+    if (rc.picc == PICC_STATE_READY && len == 2U && frame[0] == PICC_ANTICOLL && frame[1] == 0x20U) {
+        memcpy(reply, rc.uid, 4);
+        reply[4] = rc.uid[0] ^ rc.uid[1] ^ rc.uid[2] ^ rc.uid[3];
+        rc.card_read = true;
+        rc.reads++;
+        return 5;
+    }
+    if (rc.picc == PICC_STATE_READY && len == 9U && frame[0] == PICC_SElECTTAG && frame[1] == 0x70U
+            && memcmp(&frame[2], rc.uid, 4) == 0) {
+        uint16_t crc;
+        rc.picc = PICC_STATE_ACTIVE;
+        reply[0] = 0x08;    /* SAK */
+        crc = rc_crcA(reply, 1);
+        reply[1] = (uint8_t)crc;
+        reply[2] = (uint8_t)(crc >> 8);
+        return 3;
+    }
+    if (len == 4U && frame[0] == PICC_HALT && frame[1] == 0x00U) {
+        rc.picc = PICC_STATE_HALT;
+        return 0;
+    }
+    if (rc.picc != PICC_STATE_HALT) {
+        rc.picc = PICC_STATE_IDLE;  /* Not expected in this state */
+    }
+    return 0;
+}
+
+/* The card reply has been received into the FIFO */
+static void rc_received(void *arg) {
+    (void)arg;
+    memcpy(rc.fifo, rc.reply, rc.reply_len);
+    rc.fifo_count = rc.reply_len;
+    rc.fifo_read = 0;
+    rc.regs[ControlReg] &= ~0x07U;  /* Whole bytes */
+    Sim_Cancel(&rc.timeout);
+    rc_setIrq(0x20U, 0);            /* RxIRq */
+}
+
+/* No reply before the timer ran out */
+static void rc_timedOut(void *arg) {
+    (void)arg;
+    rc_setIrq(0x01U, 0);            /* TimerIRq */
+}
+
+/* StartSend in Transceive: sends the FIFO, then receives or times out */
+static void rc_transceive(void) {
+    uint8_t frame[RC522_FIFO_SIZE];
+    uint32_t len = rc.fifo_count - rc.fifo_read;
+    uint32_t last = rc.regs[BitFramingReg] & 0x07U;
+    uint32_t bits;
+
+    if (len == 0) {
+        return;
+    }
+    memcpy(frame, &rc.fifo[rc.fifo_read], len);
+    rc.fifo_count = 0;
+    rc.fifo_read = 0;
+    bits = (len - 1U) * 8U + (last ? last : 8U);
+
+    /* Every byte carries a parity bit, plus start and end of frame */
+    Sim_Time_t tx_end = sim_now + (bits + bits / 8U + 2U) * RC522_BIT_CYCLES;
+    rc.reply_len = rc_cardReply(frame, len, bits, rc.reply);
+    rc_setIrq(0x40U, 0);            /* TxIRq (as the frame is queued) */
+
+    if (rc.reply_len) {
+        Sim_Time_t rx = (rc.reply_len * 9U + 2U) * RC522_BIT_CYCLES;
+        Sim_Schedule(&rc.done, tx_end + RC522_FDT_CYCLES + rx);
+    }
+    if (rc.regs[TModeReg] & 0x80U) {
+        /* TAuto: the timer starts at the end of the transmission */
+        uint32_t prescaler = ((rc.regs[TModeReg] & 0x0FU) << 8) | rc.regs[TPrescalerReg];
+        uint32_t reload = ((uint32_t)rc.regs[TReloadRegH] << 8) | rc.regs[TReloadRegL];
+        Sim_Time_t period = ((Sim_Time_t)reload + 1U) * (2U * prescaler + 1U) * SIM_CORE_HZ
+                / RC522_TIMER_HZ;
+        if (!rc.reply_len) {
+            Sim_Schedule(&rc.timeout, tx_end + period);
+        }
+    }
+}
+
+static void rc_command(uint8_t command) {
+    rc.regs[CommandReg] = (rc.regs[CommandReg] & 0xF0U) | command;
+    switch (command) {
+    case PCD_IDLE:
+        Sim_Cancel(&rc.done);
+        Sim_Cancel(&rc.timeout);
+        rc.command = PCD_IDLE;
+        break;
+    case PCD_RESETPHASE:
+        rc_resetRegs();
+        rc_updateIrq();
+        break;
+    case PCD_CALCCRC: {
+        uint16_t crc = rc_crcA(&rc.fifo[rc.fifo_read], rc.fifo_count - rc.fifo_read);
+        rc.regs[CRCResultRegL] = (uint8_t)crc;
+        rc.regs[CRCResultRegH] = (uint8_t)(crc >> 8);
+        rc.fifo_count = 0;
+        rc.fifo_read = 0;
+        rc.command = PCD_IDLE;
+        rc_setIrq(0, 0x04U);        /* CRCIRq */
+        break;
+    }
+    case PCD_TRANSCEIVE:
+        rc.command = PCD_TRANSCEIVE;
+        if (rc.regs[BitFramingReg] & 0x80U) {
+            rc_transceive();
+        }
+        break;
+    default:
+        Sim_Fatal("RC522: command 0x%02x is not modelled", command);
+    }
+}
+
+static uint8_t rc_read(uint8_t addr) {
+    switch (addr) {
+    case FIFODataReg:
+        return (rc.fifo_read < rc.fifo_count) ? rc.fifo[rc.fifo_read++] : 0U;
+    case FIFOLevelReg:
+        return (uint8_t)(rc.fifo_count - rc.fifo_read);
+    default:
+        return rc.regs[addr];
+    }
+}
+
+static void rc_write(uint8_t addr, uint8_t value) {
+    switch (addr) {
+    case CommandReg:
+        rc_command(value & 0x0FU);
+        break;
+    case CommIrqReg:
+    case DivIrqReg:
+        /* Set1: the marked bits are set, otherwise cleared */
+        if (value & 0x80U) {
+            rc.regs[addr] |= value & 0x7FU;
+        } else {
+            rc.regs[addr] &= ~value;
+        }
+        rc_updateIrq();
+        break;
+    case CommIEnReg:
+    case DivlEnReg:
+        rc.regs[addr] = value;
+        rc_updateIrq();
+        break;
+    case FIFODataReg:
+        if (rc.fifo_count < RC522_FIFO_SIZE) {
+            rc.fifo[rc.fifo_count++] = value;
+        }
+        break;
+    case FIFOLevelReg:
+        if (value & 0x80U) {
+            rc.fifo_count = 0;      /* FlushBuffer */
+            rc.fifo_read = 0;
+        }
+        break;
+    case BitFramingReg:
+        rc.regs[addr] = value;
+        if ((value & 0x80U) && rc.command == PCD_TRANSCEIVE) {
+            rc_transceive();
+        }
+        break;
+    default:
+        rc.regs[addr] = value;
+        break;
+    }
+}
+
+/* SPI: address byte (bit 7 = read), then one data byte per access */
+static uint8_t rc_exchange(uint8_t out) {
+    uint8_t in = 0;
+
+    if (!rc.selected || !rc.powered) {
+        return 0xFFU;
+    }
+    if (!rc.have_addr) {
+        rc.addr = (out >> 1) & 0x3FU;
+        rc.reading = (out & 0x80U) != 0;
+        rc.have_addr = true;
+    } else if (rc.reading) {
+        in = rc_read(rc.addr);
+        rc.addr = (out >> 1) & 0x3FU;   /* Next address of a burst read */
+    } else {
+        rc_write(rc.addr, out);
+    }
+    return in;
+}
+
+static void rc_pins(uint32_t port, uint32_t before, uint32_t after) {
+    uint32_t changed = before ^ after;
+
+    if (port != SIM_PORT_B) {
+        return;
+    }
+    if (changed & (1UL << MFRC522_RST_PIN)) {
+        rc.powered = (after >> MFRC522_RST_PIN) & 1U;
+        rc_resetRegs();
+        rc_updateIrq();
+    }
+    if (changed & (1UL << MFRC522_CS_PIN)) {
+        rc.selected = !((after >> MFRC522_CS_PIN) & 1U);
+        rc.have_addr = false;
+    }
+}
+
+/**
+ * @brief Wires the reader to SPI2 and its CS, RST and IRQ pins.
+ */
+void SimRc522_Init(void) {
+    memset(&rc, 0, sizeof(rc));
+    Sim_EventInit(&rc.done, rc_received, NULL);
+    Sim_EventInit(&rc.timeout, rc_timedOut, NULL);
+    rc.powered = SimGpio_Level(SIM_PORT_B, MFRC522_RST_PIN);
+    rc_resetRegs();
+    SimSpi_Attach(RC522_SPI, rc_exchange);
+    SimGpio_Watch(rc_pins);
+}
+
+/**
+ * @brief Brings a card with a 4-byte UID into the field (replaces any card there).
+ */
+void SimRc522_CardEnter(const uint8_t uid[4]) {
+    memcpy(rc.uid, uid, 4);
+    rc.card = true;
+    rc.card_read = false;
+    rc.picc = PICC_STATE_IDLE;  /* Powered by the field */
+}
+
+/**
+ * @brief Takes the card out of the field.
+ */
+void SimRc522_CardLeave(void) {
+    rc.card = false;
+    rc.card_read = false;
+}
+
+/**
+ * @brief Returns 1 if the card in the field has given its UID since it entered.
+ */
+bool SimRc522_CardRead(void) {
+    return rc.card && rc.card_read;
+}
+
+/**
+ * @brief Returns the number of UIDs the reader has read from cards since reset.
+ */
+uint32_t SimRc522_Reads(void) {
+    return rc.reads;
+}
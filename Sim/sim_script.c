@@ -0,0 +1,497 @@
+#include "sim_script.h"
+#include "sim_devices.h"
+#include "74hc595.h"
+#include "lcd_config.h"
+#include <rc522.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCRIPT_MAX_LINES    1024U
+#define SCRIPT_MAX_ARGS     12U
+#define SCRIPT_MAX_DEPTH    8U
+#define SCRIPT_TEXT_SIZE    128U
+#define SCRIPT_CONSOLE_SIZE 8192U     /* Holds a full "trace" dump */
+/* How often a pending "expect ... within" is checked again */
+#define SCRIPT_POLL         SIM_MS(1)
+
+typedef struct {
+    char *text;
+    uint32_t number;
+} Script_Line_t;
+
+static struct {
+    const char *path;
+    Script_Line_t lines[SCRIPT_MAX_LINES];
+    uint32_t count;
+    uint32_t pc;
+    struct {
+        uint32_t start;     /* Line after "repeat" */
+        uint32_t left;
+    } loops[SCRIPT_MAX_DEPTH];
+    uint32_t depth;
+    bool verbose;
+    Sim_Time_t expect_until;
+    bool expecting;
+    uint32_t checks;
+    uint32_t failures;
+    char console[SCRIPT_CONSOLE_SIZE];
+    uint32_t console_len;
+    struct timespec started;
+    Sim_Event_t run;
+    Sim_Event_t card_out;
+} script;
+
+/*---------- Parsing ----------*/
+
+/* Splits a line into words; a quoted string is one word */
+static uint32_t script_split(char *line, char **argv) {
+    uint32_t argc = 0;
+    char *p = line;
+
+    while (*p && argc < SCRIPT_MAX_ARGS) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (!*p || *p == '#') {
+            break;
+        }
+        if (*p == '"') {
+            argv[argc++] = ++p;
+            while (*p && *p != '"') {
+                p++;
+            }
+        } else {
+            argv[argc++] = p;
+            while (*p && !isspace((unsigned char)*p)) {
+                p++;
+            }
+        }
+        if (*p) {
+            *p++ = '\0';
+        }
+    }
+    return argc;
+}
+
+/* Duration with a unit: 250us, 20ms, 3s, 5m, 2h, 1d */
+static bool script_duration(const char *text, Sim_Time_t *cycles) {
+    char *unit;
+    double value = strtod(text, &unit);
+    double scale;
+
+    if (unit == text || value < 0.0) {
+        return false;
+    }
+    if (!strcmp(unit, "us")) {
+        scale = 1e-6;
+    } else if (!strcmp(unit, "ms")) {
+        scale = 1e-3;
+    } else if (!strcmp(unit, "s")) {
+        scale = 1.0;
+    } else if (!strcmp(unit, "m")) {
+        scale = 60.0;
+    } else if (!strcmp(unit, "h")) {
+        scale = 3600.0;
+    } else if (!strcmp(unit, "d")) {
+        scale = 86400.0;
+    } else {
+        return false;
+    }
+    *cycles = (Sim_Time_t)(value * scale * (double)SIM_CORE_HZ + 0.5);
+    return true;
+}
+
+/* Card UID as 8 hex digits, first byte first */
+static bool script_uid(const char *text, uint8_t *uid) {
+    if (strlen(text) != 8U) {
+        return false;
+    }
+    for (uint32_t i = 0; i < 4U; i++) {
+        char byte[3] = { text[i * 2U], text[i * 2U + 1U], '\0' };
+        char *end;
+        uid[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*---------- Output ----------*/
+
+static double script_seconds(void) {
+    return (double)sim_now / (double)SIM_CORE_HZ;
+}
+
+static void script_console(char c) {
+    if (script.console_len < SCRIPT_CONSOLE_SIZE - 1U) {
+        script.console[script.console_len++] = c;
+        script.console[script.console_len] = '\0';
+    }
+    if (script.verbose) {
+        putchar(c);
+    }
+}
+
+static const Script_Line_t *script_line(void) {
+    return &script.lines[script.pc];
+}
+
+__attribute__((noreturn))
+static void script_error(const char *message, const char *detail) {
+    Sim_Fatal("%s:%u: %s%s%s", script.path, (unsigned)script_line()->number, message,
+            detail ? ": " : "", detail ? detail : "");
+}
+
+/* Driver options a scenario can require (the board wiring they assume) */
+static const struct {
+    const char *name;
+    bool enabled;
+} script_options[] = {
+    { "MFRC522_USE_IRQ", MFRC522_USE_IRQ },
+    { "LCD_USE_RW", LCD_USE_RW },
+    { "HC595_USE_SPI", HC595_USE_SPI },
+    { "HC595_USE_OE_PWM", HC595_USE_OE_PWM },
+};
+
+/*---------- Probes ----------*/
+
+typedef enum {
+    PROBE_NUMBER,
+    PROBE_TEXT
+} Probe_Type_t;
+
+static void script_trim(char *text) {
+    size_t len = strlen(text);
+    while (len && text[len - 1U] == ' ') {
+        text[--len] = '\0';
+    }
+}
+
+/* Value of a probe: a number, or a text in buf (SCRIPT_CONSOLE_SIZE) */
+static Probe_Type_t script_probe(const char *name, char *buf, double *number) {
+    const SimCar_Stats_t *cars = SimCar_Stats();
+
+    if (!strncmp(name, "lcd", 3) && name[3] >= '0' && name[3] < (char)('0' + SIM_LCD_ROWS)
+            && !name[4]) {
+        SimLcd_Row((uint32_t)(name[3] - '0'), buf);
+        script_trim(buf);
+        return PROBE_TEXT;
+    }
+    if (!strcmp(name, "counter")) {
+        SimHc595_Text(buf);
+        script_trim(buf);
+        while (*buf == ' ') {
+            memmove(buf, buf + 1, strlen(buf));
+        }
+        return PROBE_TEXT;
+    }
+    if (!strcmp(name, "rgb")) {
+        snprintf(buf, SCRIPT_CONSOLE_SIZE, "%s", SimRgb_Color());
+        return PROBE_TEXT;
+    }
+    if (!strcmp(name, "console")) {
+        snprintf(buf, SCRIPT_CONSOLE_SIZE, "%s", script.console);
+        return PROBE_TEXT;
+    }
+    if (!strcmp(name, "servo")) {
+        *number = SimServo_Angle();
+    } else if (!strcmp(name, "brightness")) {
+        *number = SimHc595_Brightness();
+    } else if (!strcmp(name, "reads")) {
+        *number = SimRc522_Reads();
+    } else if (!strcmp(name, "passed")) {
+        *number = cars->passed;
+    } else if (!strcmp(name, "gave_up")) {
+        *number = cars->gave_up;
+    } else if (!strcmp(name, "hits")) {
+        *number = cars->hits;
+    } else if (!strcmp(name, "queued")) {
+        *number = cars->queued;
+    } else if (!strcmp(name, "violations")) {
+        *number = SimLcd_Violations();
+    } else if (!strcmp(name, "time")) {
+        *number = script_seconds();
+    } else {
+        script_error("unknown probe", name);
+    }
+    return PROBE_NUMBER;
+}
+
+static void script_print(const char *name) {
+    static const char *const all[] = {
+        "lcd0", "lcd1",
+#if LCD_ROWS >= 4
+        "lcd2", "lcd3",
+#endif
+        "counter", "rgb", "servo", "brightness", "reads", "passed",
+        "gave_up", "hits", "queued", "violations"
+    };
+    char buf[SCRIPT_CONSOLE_SIZE];
+    double number;
+
+    if (strcmp(name, "state") != 0) {
+        if (script_probe(name, buf, &number) == PROBE_TEXT) {
+            printf("[%12.6f] %s = \"%s\"\n", script_seconds(), name, buf);
+        } else {
+            printf("[%12.6f] %s = %g\n", script_seconds(), name, number);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        script_print(all[i]);
+    }
+}
+
+static bool script_compare(double a, const char *op, double b) {
+    if (!strcmp(op, "==")) return a == b;
+    if (!strcmp(op, "!=")) return a != b;
+    if (!strcmp(op, "<")) return a < b;
+    if (!strcmp(op, "<=")) return a <= b;
+    if (!strcmp(op, ">")) return a > b;
+    if (!strcmp(op, ">=")) return a >= b;
+    script_error("unknown operator", op);
+}
+
+/* Evaluates "expect <probe> <op> <value>"; the actual value goes in got */
+static bool script_check(char **argv, char *got) {
+    char buf[SCRIPT_CONSOLE_SIZE];
+    double number = 0.0;
+
+    if (script_probe(argv[1], buf, &number) == PROBE_TEXT) {
+        snprintf(got, SCRIPT_TEXT_SIZE, "\"%.100s\"", buf);
+        if (!strcmp(argv[2], "contains")) {
+            return strstr(buf, argv[3]) != NULL;
+        }
+        if (!strcmp(argv[2], "==")) {
+            return !strcmp(buf, argv[3]);
+        }
+        if (!strcmp(argv[2], "!=")) {
+            return strcmp(buf, argv[3]) != 0;
+        }
+        script_error("operator not valid on text", argv[2]);
+    }
+    snprintf(got, SCRIPT_TEXT_SIZE, "%g", number);
+    return script_compare(number, argv[2], strtod(argv[3], NULL));
+}
+
+/*---------- Execution ----------*/
+
+static void script_finish(void) {
+    struct timespec now;
+    double wall;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wall = (double)(now.tv_sec - script.started.tv_sec)
+            + (double)(now.tv_nsec - script.started.tv_nsec) * 1e-9;
+    printf("%s: %u checks, %u failed; %.1f s simulated in %.2f s (%.0fx), %.1f%% of it asleep\n",
+            script.path, (unsigned)script.checks, (unsigned)script.failures, script_seconds(),
+            wall, (wall > 0.0) ? script_seconds() / wall : 0.0,
+            sim_now ? 100.0 * (double)Sim_SleepCycles() / (double)sim_now : 0.0);
+    fflush(stdout);
+    exit(script.failures ? 1 : 0);
+}
+
+static void script_cardOut(void *arg) {
+    (void)arg;
+    SimRc522_CardLeave();
+}
+
+static void script_carDone(SimCar_t *car) {
+    free(car);
+}
+
+/* Runs lines until one has to wait, rescheduling the run event for it */
+static void script_run(void *arg) {
+    char *argv[SCRIPT_MAX_ARGS];
+    char line[256];
+    char got[SCRIPT_TEXT_SIZE];
+    (void)arg;
+
+    while (script.pc < script.count) {
+        snprintf(line, sizeof(line), "%s", script_line()->text);
+        uint32_t argc = script_split(line, argv);
+        const char *cmd = argv[0];
+        Sim_Time_t t;
+
+        if (script.verbose && !script.expecting) {
+            printf("[%12.6f] %s\n", script_seconds(), script_line()->text);
+        }
+        if (!strcmp(cmd, "wait") && argc == 2U && script_duration(argv[1], &t)) {
+            script.pc++;
+            Sim_Schedule(&script.run, sim_now + t);
+            return;
+        }
+        if (!strcmp(cmd, "at") && argc == 2U && script_duration(argv[1], &t)) {
+            if (t < sim_now) {
+                script_error("time already passed", argv[1]);
+            }
+            script.pc++;
+            Sim_Schedule(&script.run, t);
+            return;
+        }
+        if (!strcmp(cmd, "card") && (argc == 2U || argc == 4U)) {
+            uint8_t uid[4];
+            if (!strcmp(argv[1], "none")) {
+                SimRc522_CardLeave();
+            } else if (script_uid(argv[1], uid)) {
+                SimRc522_CardEnter(uid);
+            } else {
+                script_error("bad card UID", argv[1]);
+            }
+            if (argc == 4U) {
+                if (strcmp(argv[2], "hold") != 0 || !script_duration(argv[3], &t)) {
+                    script_error("expected hold <duration>", NULL);
+                }
+                Sim_Schedule(&script.card_out, sim_now + t);
+            }
+        } else if (!strcmp(cmd, "beam") && argc == 3U) {
+            SimBeam_t beam = !strcmp(argv[1], "entry") ? SIM_BEAM_ENTRY
+                    : !strcmp(argv[1], "exit") ? SIM_BEAM_EXIT : SIM_BEAMS;
+            if (beam == SIM_BEAMS || (strcmp(argv[2], "block") && strcmp(argv[2], "clear"))) {
+                script_error("expected beam entry|exit block|clear", NULL);
+            }
+            SimBeam_Set(beam, !strcmp(argv[2], "block"));
+        } else if (!strcmp(cmd, "car") && argc == 3U) {
+            SimCar_t *car = calloc(1, sizeof(*car));
+            if (!car || (strcmp(argv[1], "in") && strcmp(argv[1], "out"))
+                    || !script_uid(argv[2], car->uid)) {
+                script_error("expected car in|out <uid>", NULL);
+            }
+            car->direction = !strcmp(argv[1], "in") ? SIM_CAR_IN : SIM_CAR_OUT;
+            car->timing = simcar_default_timing;
+            car->on_done = script_carDone;
+            SimCar_Arrive(car);
+        } else if (!strcmp(cmd, "timing") && argc == 3U && script_duration(argv[2], &t)) {
+            uint32_t ms = (uint32_t)(t / SIM_MS(1));
+            if (!strcmp(argv[1], "reach")) {
+                simcar_default_timing.reach_ms = ms;
+            } else if (!strcmp(argv[1], "hold")) {
+                simcar_default_timing.hold_ms = ms;
+            } else if (!strcmp(argv[1], "approach")) {
+                simcar_default_timing.approach_ms = ms;
+            } else if (!strcmp(argv[1], "pass")) {
+                simcar_default_timing.pass_ms = ms;
+            } else if (!strcmp(argv[1], "patience")) {
+                simcar_default_timing.patience_ms = ms;
+            } else {
+                script_error("unknown timing", argv[1]);
+            }
+        } else if (!strcmp(cmd, "console") && argc == 2U) {
+            script.console_len = 0;
+            script.console[0] = '\0';
+            SimUart_Inject(argv[1]);
+            SimUart_Inject("\r");
+        } else if (!strcmp(cmd, "expect") && (argc == 4U || argc == 6U)) {
+            bool ok = script_check(argv, got);
+            if (!ok && argc == 6U) {
+                if (strcmp(argv[4], "within") != 0 || !script_duration(argv[5], &t)) {
+                    script_error("expected within <duration>", NULL);
+                }
+                if (!script.expecting) {
+                    script.expecting = true;
+                    script.expect_until = sim_now + t;
+                }
+                if (sim_now < script.expect_until) {
+                    Sim_Schedule(&script.run, sim_now + SCRIPT_POLL);
+                    return;
+                }
+            }
+            script.expecting = false;
+            script.checks++;
+            if (!ok) {
+                script.failures++;
+                printf("%s:%u: [%.6f] FAILED: %s (got %s)\n", script.path,
+                        (unsigned)script_line()->number, script_seconds(), script_line()->text, got);
+            }
+        } else if (!strcmp(cmd, "print") && argc == 2U) {
+            script_print(argv[1]);
+        } else if (!strcmp(cmd, "repeat") && argc == 2U) {
+            if (script.depth >= SCRIPT_MAX_DEPTH) {
+                script_error("repeat nested too deep", NULL);
+            }
+            script.loops[script.depth].start = script.pc + 1U;
+            script.loops[script.depth].left = (uint32_t)strtoul(argv[1], NULL, 10);
+            script.depth++;
+        } else if (!strcmp(cmd, "end") && argc == 1U) {
+            if (!script.depth) {
+                script_error("end without repeat", NULL);
+            }
+            if (--script.loops[script.depth - 1U].left) {
+                script.pc = script.loops[script.depth - 1U].start;
+                continue;
+            }
+            script.depth--;
+        } else if (!strcmp(cmd, "require") && argc == 2U) {
+            uint32_t i = 0;
+            while (i < sizeof(script_options) / sizeof(script_options[0])
+                    && strcmp(script_options[i].name, argv[1]) != 0) {
+                i++;
+            }
+            if (i == sizeof(script_options) / sizeof(script_options[0])) {
+                script_error("unknown option", argv[1]);
+            }
+            if (!script_options[i].enabled) {
+                printf("%s: skipped, needs %s\n", script.path, argv[1]);
+                exit(0);
+            }
+        } else if (!strcmp(cmd, "stop") && argc == 1U) {
+            break;
+        } else {
+            script_error("bad command", script_line()->text);
+        }
+        script.pc++;
+    }
+    script_finish();
+}
+
+/**
+ * @brief Loads a scenario file; returns 0 (with a message) if it cannot be read.
+ */
+bool SimScript_Load(const char *path) {
+    char buf[256];
+    uint32_t number = 0;
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    script.path = path;
+    while (fgets(buf, sizeof(buf), file)) {
+        char *argv[SCRIPT_MAX_ARGS];
+        char copy[sizeof(buf)];
+
+        number++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+        snprintf(copy, sizeof(copy), "%s", buf);
+        if (!script_split(copy, argv)) {
+            continue;   /* Blank or comment */
+        }
+        if (script.count >= SCRIPT_MAX_LINES) {
+            fprintf(stderr, "%s: more than %u lines\n", path, SCRIPT_MAX_LINES);
+            fclose(file);
+            return false;
+        }
+        script.lines[script.count].text = strdup(buf);
+        script.lines[script.count].number = number;
+        script.count++;
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Starts the loaded scenario at time 0; the run ends with the script.
+ */
+void SimScript_Start(bool verbose) {
+    script.verbose = verbose;
+    clock_gettime(CLOCK_MONOTONIC, &script.started);
+    Sim_EventInit(&script.run, script_run, NULL);
+    Sim_EventInit(&script.card_out, script_cardOut, NULL);
+    SimUart_Attach(script_console);
+    Sim_Schedule(&script.run, sim_now);
+}
@@ -0,0 +1,40 @@
+#ifndef SIM_SCRIPT_H_
+#define SIM_SCRIPT_H_
+
+/**
+ * @brief Scenario scripts: timed stimuli (cards, beams, cars, console input)
+ * and checks of what the devices show, run in virtual time next to the
+ * firmware. One command per line, '#' starts a comment:
+ *
+ *   wait <duration>                    let time pass (us, ms, s, m, h, d)
+ *   at <duration>                      wait until a time since reset
+ *   card <uid>|none [hold <duration>]  put a card in the field (or remove it)
+ *   beam entry|exit block|clear        block or clear a beam by hand
+ *   car in|out <uid>                   a car joins the lane (Sim/sim_devices.h)
+ *   timing <reach|hold|approach|pass|patience> <duration>
+ *                                      driver behaviour of the next cars
+ *   console "<text>"                   type a command line on the console
+ *   expect <probe> <op> <value> [within <duration>]
+ *                                      check now, or as soon as it holds
+ *   print <probe>                      show a probe (or "state": all of them)
+ *   repeat <count> ... end             run the lines between count times
+ *   require <option>                   skip the scenario unless a driver option
+ *                                      is on (MFRC522_USE_IRQ, LCD_USE_RW,
+ *                                      HC595_USE_SPI, HC595_USE_OE_PWM)
+ *   stop                               end of the scenario
+ *
+ * Probes: lcd0, lcd1 (lcd2, lcd3 on a 20x4 build: row text, trailing blanks
+ * removed), counter, rgb, console (output since the last console command),
+ * servo (degrees), brightness, reads, passed, gave_up, hits, queued, violations, time (s).
+ * Operators: == != < <= > >= contains.
+ */
+
+#include <stdbool.h>
+
+/* @brief Loads a scenario file; returns 0 (with a message) if it cannot be read. */
+bool SimScript_Load(const char *path);
+
+/* @brief Starts the loaded scenario at time 0; the run ends with the script. */
+void SimScript_Start(bool verbose);
+
+#endif /* SIM_SCRIPT_H_ */
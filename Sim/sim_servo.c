@@ -0,0 +1,79 @@
+#include "sim_devices.h"
+#include "servo.h"
+#include <string.h>
+
+/*
+ * Barrier servo on TIM2 channel 1 and the RGB light on TIM1 channels 1-3.
+ * The servo turns towards the angle of its pulse width (Servo/servo.h
+ * range) at the slew rate of a small hobby servo; a pulse width of 0 (no
+ * pulses) leaves the arm where it is.
+ */
+
+#define SERVO_SIM_SLEW_DPS  600.0   /* 0.1 s per 60 degrees */
+
+static struct {
+    double angle;           /* At anchor */
+    double target;
+    Sim_Time_t anchor;
+} arm;
+
+static double arm_angleNow(void) {
+    double travel = (double)(sim_now - arm.anchor) * SERVO_SIM_SLEW_DPS / (double)SIM_CORE_HZ;
+    if (arm.target > arm.angle) {
+        return (arm.angle + travel < arm.target) ? arm.angle + travel : arm.target;
+    }
+    return (arm.angle - travel > arm.target) ? arm.angle - travel : arm.target;
+}
+
+static void servo_pulse(uint32_t timer, uint32_t channel, uint32_t ccr) {
+    if (timer != SIM_TIM2 || channel != 1U) {
+        return;
+    }
+    /* TIM2 counts at 84 MHz / (PSC + 1) */
+    double us = (double)ccr * (sim_tim[SIM_TIM2].PSC + 1U) * 1e6 / (double)SIM_CORE_HZ;
+    arm.angle = arm_angleNow();
+    arm.anchor = sim_now;
+    if (us <= 0.0) {
+        arm.target = arm.angle;
+        return;
+    }
+    double angle = (us - SERVO_MIN_PULSE_WIDTH_US) * 180.0
+            / (SERVO_MAX_PULSE_WIDTH_US - SERVO_MIN_PULSE_WIDTH_US);
+    arm.target = (angle < 0.0) ? 0.0 : (angle > 180.0) ? 180.0 : angle;
+}
+
+/**
+ * @brief Wires the servo to TIM2 channel 1.
+ */
+void SimServo_Init(void) {
+    memset(&arm, 0, sizeof(arm));
+    SimTim_Watch(servo_pulse);
+}
+
+/**
+ * @brief Returns the angle of the arm in degrees (the servo follows its pulse width at its slew rate).
+ */
+double SimServo_Angle(void) {
+    return arm_angleNow();
+}
+
+/**
+ * @brief Returns the color the RGB light shows: "off", "red", "green", "blue" or "mixed".
+ */
+const char *SimRgb_Color(void) {
+    static const char *const names[8] = {
+        "off", "red", "green", "mixed", "blue", "mixed", "mixed", "mixed"
+    };
+    const TIM_TypeDef *tim = &sim_tim[SIM_TIM1];
+    uint64_t half = ((uint64_t)tim->ARR + 1U) / 2U;
+    uint32_t lit = 0;
+
+    SimRgb_Animating();     /* CCR1-CCR3 of the frame playing now */
+    if (!(tim->CR1 & TIM_CR1_CEN)) {
+        return names[0];
+    }
+    lit |= (tim->CCR1 >= half) ? 1U : 0U;
+    lit |= (tim->CCR2 >= half) ? 2U : 0U;
+    lit |= (tim->CCR3 >= half) ? 4U : 0U;
+    return names[lit];
+}
@@ -0,0 +1,390 @@
+#include "sim_traffic.h"
+#include "sim_devices.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Authorized cards of the firmware (Core/main.c) */
+extern const uint8_t VALID_UIDS[][4];
+extern const uint8_t NUM_VALID_UIDS;
+
+#define TRAFFIC_MAX_CARDS   32U
+#define TRAFFIC_MAX_HOURS   168U    /* Length of the per-hour counts (one week) */
+#define TRAFFIC_HOUR        SIM_S(3600)
+/* How often the arm is looked at after a passage, to time the gate cycle */
+#define TRAFFIC_POLL        SIM_MS(10)
+
+/* Rush profile: share of the peak rate outside the peaks, peak hours and width */
+#define TRAFFIC_RUSH_BASE   0.05
+#define TRAFFIC_RUSH_AM     8.0
+#define TRAFFIC_RUSH_PM     17.5
+#define TRAFFIC_RUSH_SIGMA  0.75
+
+typedef enum {
+    CARD_OUTSIDE = 0,
+    CARD_ENTERING,          /* In the lane to come in */
+    CARD_INSIDE,
+    CARD_LEAVING            /* In the lane to go out */
+} Traffic_CardState_t;
+
+typedef struct {
+    const uint8_t *uid;
+    Traffic_CardState_t state;
+    Sim_Event_t leave;      /* End of the dwell time while parked */
+} Traffic_Card_t;
+
+typedef struct {
+    double *values;
+    uint32_t count;
+    uint32_t size;
+} Traffic_Samples_t;
+
+static struct {
+    SimTraffic_Config_t config;
+    FILE *out;
+    uint64_t rng;
+    Traffic_Card_t cards[TRAFFIC_MAX_CARDS];
+    uint32_t card_count;
+    Sim_Event_t arrival;
+    Sim_Event_t close_poll;
+    Sim_Event_t end;
+    Sim_Time_t cycle_start;     /* Card read of the last car that passed */
+    /* Lane length integrated over time */
+    double queue_area;
+    Sim_Time_t queue_since;
+    uint32_t queue_len;
+    uint32_t entered;
+    uint32_t left;
+    uint32_t refused;           /* Foreign cards turned away */
+    uint32_t abandoned;         /* Authorized cars that gave up */
+    uint32_t hourly[TRAFFIC_MAX_HOURS];
+    Traffic_Samples_t wait;
+    Traffic_Samples_t cycle;
+    struct timespec started;
+} traffic;
+
+/*---------- Random numbers (SplitMix64: same sequence on every host) ----------*/
+
+static uint64_t traffic_next(void) {
+    uint64_t z = (traffic.rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1) */
+static double traffic_uniform(void) {
+    return (double)(traffic_next() >> 11) * 0x1.0p-53;
+}
+
+static double traffic_exponential(double mean) {
+    return -mean * log(1.0 - traffic_uniform());
+}
+
+static uint32_t traffic_between(SimTraffic_Range_t range) {
+    return range.min_ms + (uint32_t)(traffic_uniform() * (double)(range.max_ms - range.min_ms + 1U));
+}
+
+static Sim_Time_t traffic_cycles(double seconds) {
+    return (Sim_Time_t)(seconds * (double)SIM_CORE_HZ);
+}
+
+static double traffic_seconds(Sim_Time_t cycles) {
+    return (double)cycles / (double)SIM_CORE_HZ;
+}
+
+/*---------- Measurements ----------*/
+
+static void traffic_sample(Traffic_Samples_t *samples, double value) {
+    if (samples->count == samples->size) {
+        samples->size = samples->size ? samples->size * 2U : 256U;
+        samples->values = realloc(samples->values, samples->size * sizeof(double));
+        if (!samples->values) {
+            Sim_Fatal("out of memory");
+        }
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int traffic_compare(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples (0 if none) */
+static double traffic_percentile(const Traffic_Samples_t *samples, double p) {
+    if (!samples->count) {
+        return 0.0;
+    }
+    uint32_t rank = (uint32_t)ceil(p * (double)samples->count);
+    return samples->values[(rank > 0U) ? rank - 1U : 0U];
+}
+
+/* Brings the lane length integral up to now, then takes the new length */
+static void traffic_queueUpdate(void) {
+    traffic.queue_area += (double)traffic.queue_len * traffic_seconds(sim_now - traffic.queue_since);
+    traffic.queue_since = sim_now;
+    traffic.queue_len = SimCar_Stats()->queued;
+}
+
+/* Waits for the arm to be down again after a passage */
+static void traffic_closePoll(void *arg) {
+    (void)arg;
+    if (SimServo_Angle() < SIM_ARM_CLOSED_DEG) {
+        traffic_sample(&traffic.cycle, traffic_seconds(sim_now - traffic.cycle_start));
+        return;
+    }
+    Sim_Schedule(&traffic.close_poll, sim_now + TRAFFIC_POLL);
+}
+
+/*---------- Cars ----------*/
+
+/* Arrival rate at a time, per hour */
+static double traffic_rate(Sim_Time_t when) {
+    const SimTraffic_Config_t *c = &traffic.config;
+    if (c->profile == SIM_TRAFFIC_POISSON) {
+        return c->rate;
+    }
+    double hour = fmod(traffic_seconds(when) / 3600.0, 24.0);
+    double am = (hour - TRAFFIC_RUSH_AM) / TRAFFIC_RUSH_SIGMA;
+    double pm = (hour - TRAFFIC_RUSH_PM) / TRAFFIC_RUSH_SIGMA;
+    return c->rate * (TRAFFIC_RUSH_BASE
+            + (1.0 - TRAFFIC_RUSH_BASE) * (exp(-0.5 * am * am) + exp(-0.5 * pm * pm)));
+}
+
+/* Next arrival of the (possibly varying) Poisson process, by thinning at the peak rate */
+static void traffic_scheduleArrival(void) {
+    Sim_Time_t when = sim_now;
+
+    if (traffic.config.rate <= 0.0) {
+        return;
+    }
+    do {
+        when += traffic_cycles(traffic_exponential(3600.0 / traffic.config.rate));
+    } while (traffic_uniform() * traffic.config.rate >= traffic_rate(when));
+    Sim_Schedule(&traffic.arrival, when);
+}
+
+static Traffic_Card_t *traffic_findCard(const uint8_t uid[4]) {
+    for (uint32_t i = 0; i < traffic.card_count; i++) {
+        if (!memcmp(traffic.cards[i].uid, uid, 4)) {
+            return &traffic.cards[i];
+        }
+    }
+    return NULL;
+}
+
+/* A random authorized card that is outside, NULL if they are all in use */
+static Traffic_Card_t *traffic_pickOutside(void) {
+    uint32_t outside = 0;
+    for (uint32_t i = 0; i < traffic.card_count; i++) {
+        outside += (traffic.cards[i].state == CARD_OUTSIDE);
+    }
+    if (!outside) {
+        return NULL;
+    }
+    uint32_t pick = (uint32_t)(traffic_uniform() * (double)outside);
+    for (uint32_t i = 0; i < traffic.card_count; i++) {
+        if (traffic.cards[i].state == CARD_OUTSIDE && pick-- == 0U) {
+            return &traffic.cards[i];
+        }
+    }
+    return NULL;
+}
+
+static void traffic_park(Traffic_Card_t *card) {
+    card->state = CARD_INSIDE;
+    Sim_Schedule(&card->leave, sim_now + traffic_cycles(traffic_exponential(traffic.config.dwell_min * 60.0)));
+}
+
+static void traffic_done(SimCar_t *car) {
+    Traffic_Card_t *card = traffic_findCard(car->uid);
+
+    traffic_queueUpdate();
+    if (car->state == SIM_CAR_PASSED) {
+        uint32_t hour = (uint32_t)(sim_now / TRAFFIC_HOUR);
+        if (hour < TRAFFIC_MAX_HOURS) {
+            traffic.hourly[hour]++;
+        }
+        traffic_sample(&traffic.wait, traffic_seconds(car->opened - car->arrived));
+        traffic.cycle_start = car->read;
+        Sim_Schedule(&traffic.close_poll, sim_now);
+        if (card && car->direction == SIM_CAR_IN) {
+            traffic.entered++;
+            traffic_park(card);
+        } else if (card) {
+            traffic.left++;
+            card->state = CARD_OUTSIDE;
+        }
+    } else if (card) {
+        /* Still on its side: a car that could not leave tries again after another dwell */
+        traffic.abandoned++;
+        if (car->direction == SIM_CAR_IN) {
+            card->state = CARD_OUTSIDE;
+        } else {
+            traffic_park(card);
+        }
+    } else {
+        traffic.refused++;
+    }
+    free(car);
+}
+
+/* A car joins the lane with an authorized card, or a foreign one if card is NULL */
+static void traffic_send(Traffic_Card_t *card, SimCar_Direction_t direction) {
+    const SimTraffic_Config_t *c = &traffic.config;
+    SimCar_t *car = calloc(1, sizeof(*car));
+
+    if (!car) {
+        Sim_Fatal("out of memory");
+    }
+    if (card) {
+        memcpy(car->uid, card->uid, 4);
+        card->state = (direction == SIM_CAR_IN) ? CARD_ENTERING : CARD_LEAVING;
+    } else {
+        do {
+            uint64_t bits = traffic_next();
+            memcpy(car->uid, &bits, 4);
+        } while (traffic_findCard(car->uid));
+    }
+    car->direction = direction;
+    car->timing.reach_ms = traffic_between(c->reach);
+    car->timing.hold_ms = traffic_between(c->hold);
+    car->timing.approach_ms = traffic_between(c->approach);
+    car->timing.pass_ms = traffic_between(c->pass);
+    car->timing.patience_ms = c->patience_ms;
+    car->on_done = traffic_done;
+    SimCar_Arrive(car);
+    traffic_queueUpdate();
+}
+
+static void traffic_arrive(void *arg) {
+    (void)arg;
+    Traffic_Card_t *card = (traffic_uniform() < traffic.config.foreign) ? NULL : traffic_pickOutside();
+    traffic_send(card, SIM_CAR_IN);
+    traffic_scheduleArrival();
+}
+
+static void traffic_leave(void *arg) {
+    traffic_send(arg, SIM_CAR_OUT);
+}
+
+/*---------- Report ----------*/
+
+static void traffic_printSamples(const char *name, Traffic_Samples_t *samples) {
+    qsort(samples->values, samples->count, sizeof(double), traffic_compare);
+    fprintf(traffic.out, "\"%s\":{\"count\":%u,\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+            name, (unsigned)samples->count, traffic_percentile(samples, 0.50),
+            traffic_percentile(samples, 0.99), traffic_percentile(samples, 1.0));
+}
+
+/* Prints the results as one line of JSON, and the speed of the run on stderr */
+static void traffic_end(void *arg) {
+    const SimTraffic_Config_t *c = &traffic.config;
+    const SimCar_Stats_t *stats = SimCar_Stats();
+    double seconds = traffic_seconds(sim_now);
+    uint32_t hours = (uint32_t)ceil(c->hours);
+    struct timespec now;
+    double wall;
+    (void)arg;
+
+    traffic_queueUpdate();
+    fprintf(traffic.out, "{\"seed\":%llu,\"profile\":\"%s\",\"rate\":%.2f,\"hours\":%.2f,"
+            "\"dwell_min\":%.1f,\"foreign\":%.3f,\"cards\":%u,",
+            (unsigned long long)c->seed, (c->profile == SIM_TRAFFIC_RUSH) ? "rush" : "poisson",
+            c->rate, c->hours, c->dwell_min, c->foreign, (unsigned)traffic.card_count);
+    fprintf(traffic.out, "\"arrived\":%u,\"passed\":%u,\"entered\":%u,\"left\":%u,"
+            "\"refused\":%u,\"abandoned\":%u,\"hits\":%u,\"lcd_violations\":%u,",
+            (unsigned)stats->arrived, (unsigned)stats->passed, (unsigned)traffic.entered,
+            (unsigned)traffic.left, (unsigned)traffic.refused, (unsigned)traffic.abandoned,
+            (unsigned)stats->hits, (unsigned)SimLcd_Violations());
+    fprintf(traffic.out, "\"vehicles_per_hour\":%.2f,\"queue\":{\"mean\":%.3f,\"max\":%u},",
+            (seconds > 0.0) ? (double)stats->passed * 3600.0 / seconds : 0.0,
+            (seconds > 0.0) ? traffic.queue_area / seconds : 0.0, (unsigned)stats->max_queued);
+    traffic_printSamples("wait_s", &traffic.wait);
+    fputc(',', traffic.out);
+    traffic_printSamples("cycle_s", &traffic.cycle);
+    fprintf(traffic.out, ",\"hourly\":[");
+    for (uint32_t i = 0; i < hours && i < TRAFFIC_MAX_HOURS; i++) {
+        fprintf(traffic.out, "%s%u", i ? "," : "", (unsigned)traffic.hourly[i]);
+    }
+    fprintf(traffic.out, "]}\n");
+    fflush(traffic.out);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wall = (double)(now.tv_sec - traffic.started.tv_sec)
+            + (double)(now.tv_nsec - traffic.started.tv_nsec) * 1e-9;
+    fprintf(stderr, "traffic: %.1f h simulated in %.2f s (%.0fx)\n",
+            seconds / 3600.0, wall, (wall > 0.0) ? seconds / wall : 0.0);
+    exit(0);
+}
+
+/*---------- API ----------*/
+
+/**
+ * @brief Fills a config with the defaults of a profile: a busy office car
+ * park for the rush profile (cars stay the working day), short visits for
+ * the Poisson one.
+ */
+void SimTraffic_Defaults(SimTraffic_Config_t *config, SimTraffic_Profile_t profile) {
+    memset(config, 0, sizeof(*config));
+    config->seed = 1;
+    config->profile = profile;
+    config->rate = (profile == SIM_TRAFFIC_RUSH) ? 30.0 : 20.0;
+    config->hours = (profile == SIM_TRAFFIC_RUSH) ? 24.0 : 4.0;
+    config->dwell_min = (profile == SIM_TRAFFIC_RUSH) ? 540.0 : 30.0;
+    config->foreign = 0.05;
+    config->reach = (SimTraffic_Range_t){ 1000, 4000 };
+    config->hold = (SimTraffic_Range_t){ 200, 1500 };
+    config->approach = (SimTraffic_Range_t){ 1000, 3000 };
+    config->pass = (SimTraffic_Range_t){ 2000, 5000 };
+    config->patience_ms = simcar_default_timing.patience_ms;
+}
+
+/**
+ * @brief Sets a timing range by name (reach, hold, approach, pass).
+ * @return 0 if the name is unknown or the range is empty.
+ */
+bool SimTraffic_SetRange(SimTraffic_Config_t *config, const char *name, SimTraffic_Range_t range) {
+    if (range.min_ms > range.max_ms) {
+        return false;
+    }
+    if (!strcmp(name, "reach")) {
+        config->reach = range;
+    } else if (!strcmp(name, "hold")) {
+        config->hold = range;
+    } else if (!strcmp(name, "approach")) {
+        config->approach = range;
+    } else if (!strcmp(name, "pass")) {
+        config->pass = range;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Starts the traffic at time 0 (midnight). At the end of the run the
+ * report goes to out and the program exits.
+ */
+void SimTraffic_Start(const SimTraffic_Config_t *config, FILE *out) {
+    memset(&traffic, 0, sizeof(traffic));
+    traffic.config = *config;
+    traffic.out = out;
+    traffic.rng = config->seed;
+
+    for (uint32_t i = 0; i < NUM_VALID_UIDS && i < TRAFFIC_MAX_CARDS; i++) {
+        Traffic_Card_t *card = &traffic.cards[traffic.card_count++];
+        card->uid = VALID_UIDS[i];
+        card->state = CARD_OUTSIDE;
+        Sim_EventInit(&card->leave, traffic_leave, card);
+    }
+    Sim_EventInit(&traffic.arrival, traffic_arrive, NULL);
+    Sim_EventInit(&traffic.close_poll, traffic_closePoll, NULL);
+    Sim_EventInit(&traffic.end, traffic_end, NULL);
+    Sim_Schedule(&traffic.end, sim_now + traffic_cycles(config->hours * 3600.0));
+    clock_gettime(CLOCK_MONOTONIC, &traffic.started);
+    traffic_scheduleArrival();
+}
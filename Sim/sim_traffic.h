@@ -0,0 +1,59 @@
+#ifndef SIM_TRAFFIC_H_
+#define SIM_TRAFFIC_H_
+
+/**
+ * @brief Traffic through the gate: cars arrive at random (seeded, so a run
+ * is reproducible), use the lane of Sim/sim_vehicle.c and are measured.
+ *
+ * The card population is the firmware's own list of authorized cards
+ * (VALID_UIDS of Core/main.c) plus foreign cards it refuses. A car arriving
+ * to enter takes an authorized card that is outside, or a foreign one (a
+ * fraction of the arrivals, and every arrival while all the authorized cards
+ * are in use). A car that parked leaves after an exponential dwell time.
+ * Driver timings are drawn uniformly between the bounds of the config.
+ *
+ * Results: vehicles per hour, lane length (time average and maximum), wait
+ * (arrival in the lane to the arm open in front of the car) and gate cycle
+ * (card read to the arm closed again), as p50/p99 over the cars that passed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Arrival profiles */
+typedef enum {
+    SIM_TRAFFIC_POISSON = 0,    /* Constant rate */
+    SIM_TRAFFIC_RUSH            /* Peaks at 08:00 and 17:30 on a low base (rate = peak) */
+} SimTraffic_Profile_t;
+
+/* Uniform range of a driver timing, in milliseconds */
+typedef struct {
+    uint32_t min_ms;
+    uint32_t max_ms;
+} SimTraffic_Range_t;
+
+typedef struct {
+    uint64_t seed;
+    SimTraffic_Profile_t profile;
+    double rate;                /*!< Arrivals per hour (peak rate of the rush profile). */
+    double hours;               /*!< Length of the run, from midnight. */
+    double dwell_min;           /*!< Mean time a car stays parked, minutes. */
+    double foreign;             /*!< Fraction of the arrivals with an unknown card. */
+    SimTraffic_Range_t reach;   /*!< Head of the lane to the card in the field (tap delay). */
+    SimTraffic_Range_t hold;    /*!< Card left in the field after the read. */
+    SimTraffic_Range_t approach;/*!< Card read to the beam in front of the barrier. */
+    SimTraffic_Range_t pass;    /*!< Arm open to both beams clear. */
+    uint32_t patience_ms;       /*!< Longest wait for a read, then for the arm. */
+} SimTraffic_Config_t;
+
+/* @brief Fills a config with the defaults of a profile. */
+void SimTraffic_Defaults(SimTraffic_Config_t *config, SimTraffic_Profile_t profile);
+
+/* @brief Sets a timing range by name (reach, hold, approach, pass); returns 0 if unknown. */
+bool SimTraffic_SetRange(SimTraffic_Config_t *config, const char *name, SimTraffic_Range_t range);
+
+/* @brief Starts the traffic at time 0; at the end of the run the report goes to out and the program exits. */
+void SimTraffic_Start(const SimTraffic_Config_t *config, FILE *out);
+
+#endif /* SIM_TRAFFIC_H_ */
@@ -0,0 +1,211 @@
+#include "sim_devices.h"
+#include "board.h"
+#include <string.h>
+
+/*
+ * IR beams (active low, pulled up: a released pin reads clear) and the cars
+ * that block them. Cars wait in one lane, in order of arrival, and only the
+ * head of the lane deals with the gate: it pulls up to the reader and holds
+ * its card there until it is read, drives up to the beam on its side, waits
+ * for the arm to open, then drives through, blocking the far beam before
+ * clearing its own. A driver gives up after its patience runs out, waiting
+ * either for the read or for the arm.
+ */
+
+/* How often a driver looks at the reader or the arm */
+#define VEHICLE_POLL        SIM_MS(10)
+
+SimCar_Timing_t simcar_default_timing = {
+    .reach_ms = 2000,
+    .hold_ms = 500,
+    .approach_ms = 1500,
+    .pass_ms = 3000,
+    .patience_ms = 15000,
+};
+
+static struct {
+    bool manual[SIM_BEAMS];
+    uint32_t cars[SIM_BEAMS];   /* Cars blocking each beam */
+    SimCar_t *head;
+    SimCar_t *tail;
+    SimCar_Stats_t stats;
+} road;
+
+static void beam_update(SimBeam_t beam) {
+    static const uint32_t pins[SIM_BEAMS] = { ENTRY_IR_PIN, EXIT_IR_PIN };
+    bool blocked = road.manual[beam] || road.cars[beam] > 0U;
+    SimGpio_Drive(SIM_PORT_A, pins[beam], blocked ? 0 : -1);
+}
+
+static void car_block(SimCar_t *car, SimBeam_t beam, bool blocked) {
+    uint8_t bit = (uint8_t)(1U << beam);
+    if (blocked == ((car->beams & bit) != 0)) {
+        return;
+    }
+    car->beams ^= bit;
+    road.cars[beam] = blocked ? road.cars[beam] + 1U : road.cars[beam] - 1U;
+    beam_update(beam);
+}
+
+static SimBeam_t car_nearBeam(const SimCar_t *car) {
+    return (car->direction == SIM_CAR_IN) ? SIM_BEAM_ENTRY : SIM_BEAM_EXIT;
+}
+
+static SimBeam_t car_farBeam(const SimCar_t *car) {
+    return (car->direction == SIM_CAR_IN) ? SIM_BEAM_EXIT : SIM_BEAM_ENTRY;
+}
+
+static void car_start(SimCar_t *car) {
+    car->state = SIM_CAR_AT_READER;
+    car->at_reader = sim_now;
+    car->deadline = sim_now + SIM_MS(car->timing.reach_ms) + SIM_MS(car->timing.patience_ms);
+    Sim_Schedule(&car->step, sim_now + SIM_MS(car->timing.reach_ms));
+}
+
+/* Leaves the lane; the next car pulls up */
+static void car_finish(SimCar_t *car, SimCar_State_t state) {
+    if (car->card_in) {
+        SimRc522_CardLeave();
+        car->card_in = false;
+    }
+    car_block(car, SIM_BEAM_ENTRY, false);
+    car_block(car, SIM_BEAM_EXIT, false);
+    car->state = state;
+    car->done = sim_now;
+    if (state == SIM_CAR_PASSED) {
+        road.stats.passed++;
+    } else {
+        road.stats.gave_up++;
+    }
+    road.stats.queued--;
+    road.head = car->next;
+    if (!road.head) {
+        road.tail = NULL;
+    }
+    if (car->on_done) {
+        car->on_done(car);
+    }
+    if (road.head) {
+        car_start(road.head);
+    }
+}
+
+static void car_step(void *arg) {
+    SimCar_t *car = arg;
+    Sim_Time_t next = sim_now + VEHICLE_POLL;
+
+    switch (car->state) {
+    case SIM_CAR_AT_READER:
+        if (!car->card_in) {
+            SimRc522_CardEnter(car->uid);
+            car->card_in = true;
+        } else if (SimRc522_CardRead()) {
+            car->read = sim_now;
+            car->state = SIM_CAR_APPROACHING;
+            next = sim_now + SIM_MS(car->timing.hold_ms);
+        } else if (sim_now >= car->deadline) {
+            car_finish(car, SIM_CAR_GAVE_UP);
+            return;
+        }
+        break;
+    case SIM_CAR_APPROACHING:
+        if (car->card_in) {
+            SimRc522_CardLeave();
+            car->card_in = false;
+        }
+        if (sim_now < car->read + SIM_MS(car->timing.approach_ms)) {
+            next = car->read + SIM_MS(car->timing.approach_ms);
+            break;
+        }
+        car_block(car, car_nearBeam(car), true);
+        car->state = SIM_CAR_WAITING;
+        car->deadline = sim_now + SIM_MS(car->timing.patience_ms);
+        break;
+    case SIM_CAR_WAITING:
+        if (SimServo_Angle() >= SIM_ARM_OPEN_DEG) {
+            car->opened = sim_now;
+            car->state = SIM_CAR_PASSING;
+        } else if (sim_now >= car->deadline) {
+            car_finish(car, SIM_CAR_GAVE_UP);
+            return;
+        }
+        break;
+    case SIM_CAR_PASSING: {
+        Sim_Time_t elapsed = sim_now - car->opened;
+        Sim_Time_t pass = SIM_MS(car->timing.pass_ms);
+
+        if (!car->hit && SimServo_Angle() < SIM_ARM_HIT_DEG) {
+            car->hit = true;
+            road.stats.hits++;
+        }
+        if (elapsed >= pass) {
+            car_finish(car, SIM_CAR_PASSED);
+            return;
+        }
+        car_block(car, car_farBeam(car), elapsed >= pass / 3U);
+        car_block(car, car_nearBeam(car), elapsed < pass * 2U / 3U);
+        break;
+    }
+    default:
+        return;
+    }
+    Sim_Schedule(&car->step, next);
+}
+
+/**
+ * @brief Wires the beams to their pins (released: the pull-ups read clear).
+ */
+void SimVehicle_Init(void) {
+    memset(&road, 0, sizeof(road));
+    beam_update(SIM_BEAM_ENTRY);
+    beam_update(SIM_BEAM_EXIT);
+}
+
+/**
+ * @brief Blocks or clears a beam by hand (on top of the cars).
+ */
+void SimBeam_Set(SimBeam_t beam, bool blocked) {
+    road.manual[beam] = blocked;
+    beam_update(beam);
+}
+
+/**
+ * @brief Returns 1 if a beam is blocked (by hand or by a car).
+ */
+bool SimBeam_Blocked(SimBeam_t beam) {
+    return road.manual[beam] || road.cars[beam] > 0U;
+}
+
+/**
+ * @brief Puts a car at the end of the lane (owned by the caller until on_done).
+ */
+void SimCar_Arrive(SimCar_t *car) {
+    car->state = SIM_CAR_QUEUED;
+    car->hit = false;
+    car->arrived = sim_now;
+    car->at_reader = car->read = car->opened = car->done = 0;
+    car->card_in = false;
+    car->beams = 0;
+    car->next = NULL;
+    Sim_EventInit(&car->step, car_step, car);
+
+    road.stats.arrived++;
+    road.stats.queued++;
+    if (road.stats.queued > road.stats.max_queued) {
+        road.stats.max_queued = road.stats.queued;
+    }
+    if (road.tail) {
+        road.tail->next = car;
+        road.tail = car;
+    } else {
+        road.head = road.tail = car;
+        car_start(car);
+    }
+}
+
+/**
+ * @brief Returns the totals of the cars.
+ */
+const SimCar_Stats_t *SimCar_Stats(void) {
+    return &road.stats;
+}
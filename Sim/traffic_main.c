@@ -0,0 +1,138 @@
+#include "sim_devices.h"
+#include "sim_traffic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Traffic benchmark: runs the firmware against the device models with
+ * random traffic (Sim/sim_traffic.h) and prints the results as one line of
+ * JSON. The same options and seed give the same results.
+ *
+ * Usage: traffic [options]
+ *   -p poisson|rush    arrival profile (sets the defaults below; first)
+ *   -s seed            random seed (1)
+ *   -r rate            arrivals per hour, peak rate for rush (20, rush 30)
+ *   -H hours           length of the run from midnight (4, rush 24)
+ *   -d minutes         mean time parked (30, rush 540)
+ *   -f fraction        arrivals with an unknown card (0.05)
+ *   -t name=min:max    driver timing range in ms: reach, hold, approach, pass
+ *   -w ms              driver patience (15000)
+ *   -o file            write the JSON there instead of stdout
+ */
+
+#define TRAFFIC_MAX_RUN_HOURS   168.0
+
+int firmware_main(void);
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-p poisson|rush] [-s seed] [-r rate] [-H hours] [-d minutes]\n"
+            "       [-f fraction] [-t reach|hold|approach|pass=min:max] [-w ms] [-o file]\n", name);
+    exit(2);
+}
+
+static bool parse_profile(const char *text, SimTraffic_Profile_t *profile) {
+    if (!strcmp(text, "poisson")) {
+        *profile = SIM_TRAFFIC_POISSON;
+    } else if (!strcmp(text, "rush")) {
+        *profile = SIM_TRAFFIC_RUSH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_range(char *text, SimTraffic_Config_t *config) {
+    char *eq = strchr(text, '=');
+    char *end;
+    SimTraffic_Range_t range;
+
+    if (!eq) {
+        return false;
+    }
+    *eq = '\0';
+    range.min_ms = (uint32_t)strtoul(eq + 1, &end, 10);
+    if (*end != ':') {
+        return false;
+    }
+    range.max_ms = (uint32_t)strtoul(end + 1, &end, 10);
+    return *end == '\0' && SimTraffic_SetRange(config, text, range);
+}
+
+static double parse_number(const char *text, const char *name, double min, double max) {
+    char *end;
+    double value = strtod(text, &end);
+    if (*end != '\0' || value < min || value > max) {
+        fprintf(stderr, "traffic: bad %s \"%s\"\n", name, text);
+        exit(2);
+    }
+    return value;
+}
+
+int main(int argc, char **argv) {
+    SimTraffic_Profile_t profile = SIM_TRAFFIC_POISSON;
+    SimTraffic_Config_t config;
+    FILE *out = stdout;
+    int opt;
+
+    /* The profile first: the other options override its defaults */
+    while ((opt = getopt(argc, argv, "p:s:r:H:d:f:t:w:o:")) != -1) {
+        if (opt == '?' || (opt == 'p' && !parse_profile(optarg, &profile))) {
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+    }
+    SimTraffic_Defaults(&config, profile);
+
+    optind = 1;
+    while ((opt = getopt(argc, argv, "p:s:r:H:d:f:t:w:o:")) != -1) {
+        switch (opt) {
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'r':
+            config.rate = parse_number(optarg, "rate", 0.0, 3600.0);
+            break;
+        case 'H':
+            config.hours = parse_number(optarg, "hours", 0.0, TRAFFIC_MAX_RUN_HOURS);
+            break;
+        case 'd':
+            config.dwell_min = parse_number(optarg, "dwell", 0.0, 1e6);
+            break;
+        case 'f':
+            config.foreign = parse_number(optarg, "fraction", 0.0, 1.0);
+            break;
+        case 't':
+            if (!parse_range(optarg, &config)) {
+                usage(argv[0]);
+            }
+            break;
+        case 'w':
+            config.patience_ms = (uint32_t)parse_number(optarg, "patience", 0.0, 3600000.0);
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (!out) {
+                perror(optarg);
+                return 2;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    Sim_Reset();
+    SimRc522_Init();
+    SimLcd_Init();
+    SimHc595_Init();
+    SimServo_Init();
+    SimVehicle_Init();
+    SimTraffic_Start(&config, out);
+
+    firmware_main();   /* Never returns: the end of the run exits */
+    Sim_Fatal("firmware main() returned");
+}
@@ -0,0 +1,185 @@
+#include "task.h"
+#include "delay.h"
+
+/* Head of the list of registered tasks */
+static Task_t *task_list = 0;
+
+/**
+ * @brief Timer callback ending the sleep or event wait of a task.
+ * @param arg The suspended task.
+ */
+static void task_wake(void *arg) {
+    Task_t *task = (Task_t *)arg;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (task->flags & TASK_FLAG_IN_WAIT) {
+        task->flags |= TASK_FLAG_TIMED_OUT;
+    }
+    task->flags &= ~(TASK_FLAG_SLEEPING | TASK_FLAG_WAITING);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Registers a task with the scheduler.
+ * @param task Statically allocated task control block.
+ * @param fn   Task body.
+ * @param name Name for debugging.
+ */
+void Task_Start(Task_t *task, Task_Fn_t fn, const char *name) {
+    task->fn = fn;
+    task->name = name;
+    task->resume = 0;
+    task->flags = 0;
+    task->events = 0;
+    task->wait_mask = 0;
+    task->next = 0;
+    SoftTimer_Init(&task->timer, task_wake, task);
+
+    /* Append so tasks run in the order they were started */
+    Task_t **tail = &task_list;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = task;
+}
+
+/**
+ * @brief Runs one pass of every task that is not sleeping.
+ * @note  A suspended task returns straight from its resume point, so a pass
+ * over idle tasks costs only a call and a switch jump per task.
+ */
+void Task_RunAll(void) {
+    for (Task_t *task = task_list; task; task = task->next) {
+        if (task->flags & (TASK_FLAG_DONE | TASK_FLAG_SLEEPING | TASK_FLAG_WAITING)) {
+            continue;
+        }
+        task->fn(task);
+    }
+}
+
+/**
+ * @brief Posts event bits to a task. Safe to call from an interrupt.
+ * @param task Destination task.
+ * @param events Event bits to set.
+ */
+void Task_Post(Task_t *task, uint32_t events) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    task->events |= events;
+    if (task->events & task->wait_mask) {
+        task->flags &= ~TASK_FLAG_WAITING;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Consumes the pending events of a task that match mask.
+ * @return The consumed events (0 if none were pending).
+ */
+uint32_t Task_TakeEvents(Task_t *task, uint32_t mask) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t taken = task->events & mask;
+    task->events &= ~taken;
+    __set_PRIMASK(primask);
+    return taken;
+}
+
+/**
+ * @brief Arms the timeout used by TASK_AWAIT_TIMEOUT.
+ * @param task The awaiting task.
+ * @param ms Timeout in milliseconds, or TASK_FOREVER.
+ */
+void Task_SetDeadline(Task_t *task, uint32_t ms) {
+    task->flags &= ~(TASK_FLAG_TIMED_OUT | TASK_FLAG_NO_DEADLINE);
+    if (ms == TASK_FOREVER) {
+        task->flags |= TASK_FLAG_NO_DEADLINE;
+    } else {
+        task->deadline = Get_Ms_Ticks() + ms;
+    }
+}
+
+/**
+ * @brief Evaluates an await.
+ * @param task The awaiting task.
+ * @param cond Current value of the awaited condition.
+ * @return true when the await is over (condition met or timed out).
+ */
+bool Task_Check(Task_t *task, bool cond) {
+    if (cond) {
+        return true;
+    }
+    if (!(task->flags & TASK_FLAG_NO_DEADLINE) && (int32_t)(Get_Ms_Ticks() - task->deadline) >= 0) {
+        task->flags |= TASK_FLAG_TIMED_OUT;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Starts an event wait.
+ * @param task The waiting task.
+ * @param mask Events that wake the task up.
+ * @param ms Timeout in milliseconds, or TASK_FOREVER.
+ */
+void Task_BeginWait(Task_t *task, uint32_t mask, uint32_t ms) {
+    task->flags &= ~TASK_FLAG_TIMED_OUT;
+    task->flags |= TASK_FLAG_IN_WAIT;
+    task->wait_mask = mask;
+    if (ms == TASK_FOREVER) {
+        SoftTimer_Stop(&task->timer);
+    } else {
+        SoftTimer_Start(&task->timer, ms, 0);
+    }
+}
+
+/**
+ * @brief Evaluates an event wait.
+ * @param task The waiting task.
+ * @param cond Current value of the awaited condition.
+ * @return true when the wait is over (condition met or timed out). Otherwise
+ * the task is blocked until one of its events is posted or the timer fires.
+ */
+bool Task_EndWait(Task_t *task, bool cond) {
+    bool done;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    done = cond || (task->flags & TASK_FLAG_TIMED_OUT);
+    if (done) {
+        task->flags &= ~TASK_FLAG_IN_WAIT;
+        task->wait_mask = 0;
+    } else if (!(task->events & task->wait_mask)) {
+        /* Nothing arrived since the condition was evaluated: block */
+        task->flags |= TASK_FLAG_WAITING;
+    }
+    __set_PRIMASK(primask);
+
+    if (done && !Task_TimedOut(task)) {
+        SoftTimer_Stop(&task->timer);
+    }
+    return done;
+}
+
+/**
+ * @brief Checks whether every task is sleeping, blocked or finished.
+ * @return true if the scheduler has nothing to run until the next timer or event.
+ */
+bool Task_AllIdle(void) {
+    for (Task_t *task = task_list; task; task = task->next) {
+        if (!(task->flags & (TASK_FLAG_DONE | TASK_FLAG_SLEEPING | TASK_FLAG_WAITING))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Puts a task to sleep for ms milliseconds.
+ * @note  A sleeping task is skipped by the scheduler instead of being polled;
+ * its wheel timer clears the sleeping flag on expiry.
+ */
+void Task_Sleep(Task_t *task, uint32_t ms) {
+    task->flags |= TASK_FLAG_SLEEPING;
+    SoftTimer_Start(&task->timer, ms, 0);
+}
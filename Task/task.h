@@ -0,0 +1,153 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "stm32f4xx.h"
+#include "soft_timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Stackless cooperative tasks.
+ * A task is a plain function that is re-entered by the scheduler. The
+ * TASK_* macros record the line where the task suspended and jump back to
+ * it on the next call, so a gate sequence can be written top to bottom
+ * instead of as a flattened switch. Tasks have no stack of their own:
+ * anything that must survive a suspension point has to live in a static
+ * (or in the Task_t itself). Do not use `switch` inside a task body.
+ */
+
+/* Wait forever (no timeout) */
+#define TASK_FOREVER        0xFFFFFFFFU
+
+/* Task flags */
+#define TASK_FLAG_SLEEPING     0x01U  /* Suspended until wake_at */
+#define TASK_FLAG_TIMED_OUT    0x02U  /* Last await ended by its timeout */
+#define TASK_FLAG_DONE         0x04U  /* Task body returned through TASK_END */
+#define TASK_FLAG_NO_DEADLINE  0x08U  /* Current await has no timeout */
+#define TASK_FLAG_WAITING      0x10U  /* Blocked until an awaited event or timeout */
+#define TASK_FLAG_IN_WAIT      0x20U  /* An event wait is in progress */
+
+typedef struct Task Task_t;
+
+/* @brief Task body. Called by the scheduler until it reaches TASK_END. */
+typedef void (*Task_Fn_t)(Task_t *task);
+
+/**
+ * @brief Task control block (the statically allocated coroutine frame).
+ */
+struct Task {
+    Task_Fn_t         fn;        /*!< Task body. */
+    const char        *name;     /*!< Name for debugging. */
+    uint16_t          resume;    /*!< Line to resume at (0 = start). */
+    volatile uint8_t  flags;     /*!< TASK_FLAG_* bits. */
+    volatile uint32_t events;    /*!< Pending event bits posted to this task. */
+    uint32_t          wait_mask; /*!< Events that wake the task from the current wait. */
+    uint32_t          deadline;  /*!< Timeout of the current await (ms ticks). */
+    SoftTimer_t       timer;     /*!< Ends a sleep or the timeout of an event wait. */
+    Task_t            *next;     /*!< Next task in the scheduler list. */
+};
+
+/*------------- TASK BODY MACROS -------------*/
+#define TASK_BEGIN(t)       switch ((t)->resume) { case 0:
+
+/* The code before a resume label runs on into it on the first pass */
+#define TASK_LABEL(t)       (t)->resume = __LINE__; __attribute__((fallthrough)); case __LINE__:
+
+/* @brief Give the other tasks a turn, continue on the next pass. */
+#define TASK_YIELD(t) \
+    do { (t)->resume = __LINE__; return; case __LINE__:; } while (0)
+
+/* @brief Suspend until cond is true (re-evaluated on every pass). */
+#define TASK_AWAIT(t, cond) \
+    do { TASK_LABEL(t) if (!(cond)) return; } while (0)
+
+/**
+ * @brief Suspend until cond is true or ms milliseconds elapsed.
+ * Task_TimedOut() tells which one happened.
+ */
+#define TASK_AWAIT_TIMEOUT(t, cond, ms) \
+    do { Task_SetDeadline((t), (ms)); TASK_LABEL(t) \
+        if (!Task_Check((t), (cond))) return; } while (0)
+
+/**
+ * @brief Block until one of the events in mask is posted or ms elapsed.
+ * The task is not polled while blocked. The received events are consumed;
+ * Task_TimedOut() reports a timeout.
+ */
+#define TASK_AWAIT_EVENT(t, mask, ms) \
+    do { Task_BeginWait((t), (mask), (ms)); TASK_LABEL(t) \
+        if (!Task_EndWait((t), Task_TakeEvents((t), (mask)) != 0)) return; } while (0)
+
+/**
+ * @brief Block until cond is true or ms elapsed.
+ * cond is only re-evaluated when one of the events in mask is posted, so
+ * it must depend on state whose changes are signalled by those events.
+ */
+#define TASK_AWAIT_UNTIL(t, cond, mask, ms) \
+    do { Task_BeginWait((t), (mask), (ms)); TASK_LABEL(t) \
+        Task_TakeEvents((t), (mask)); if (!Task_EndWait((t), (cond))) return; } while (0)
+
+/* @brief Suspend for ms milliseconds without being polled. */
+#define TASK_SLEEP(t, ms) \
+    do { Task_Sleep((t), (ms)); (t)->resume = __LINE__; return; case __LINE__:; } while (0)
+
+#define TASK_END(t)         } (t)->resume = 0; (t)->flags |= TASK_FLAG_DONE; return
+
+/*------------- FUNCTION PROTOTYPES -------------*/
+
+/**
+ * @brief Registers a task with the scheduler.
+ * @param task Statically allocated task control block.
+ * @param fn   Task body.
+ * @param name Name for debugging.
+ */
+void Task_Start(Task_t *task, Task_Fn_t fn, const char *name);
+
+/**
+ * @brief Runs one pass of every task that is not sleeping or blocked.
+ * @note  Call SoftTimer_Process() first so that expired sleeps are woken.
+ */
+void Task_RunAll(void);
+
+/**
+ * @brief Posts event bits to a task. Safe to call from an interrupt.
+ * @param task Destination task.
+ * @param events Event bits to set.
+ */
+void Task_Post(Task_t *task, uint32_t events);
+
+/**
+ * @brief Consumes the pending events of a task that match mask.
+ * @return The consumed events (0 if none were pending).
+ */
+uint32_t Task_TakeEvents(Task_t *task, uint32_t mask);
+
+/* @brief Arms the timeout used by TASK_AWAIT_TIMEOUT. */
+void Task_SetDeadline(Task_t *task, uint32_t ms);
+
+/* @brief Evaluates an await: true when done (condition met or timed out). */
+bool Task_Check(Task_t *task, bool cond);
+
+/* @brief Starts an event wait (used by TASK_AWAIT_EVENT/TASK_AWAIT_UNTIL). */
+void Task_BeginWait(Task_t *task, uint32_t mask, uint32_t ms);
+
+/* @brief Evaluates an event wait: true when done, otherwise blocks the task. */
+bool Task_EndWait(Task_t *task, bool cond);
+
+/**
+ * @brief Checks whether every task is sleeping, blocked or finished.
+ * @note  Call with interrupts disabled so that no event can slip in between
+ * this check and entering sleep.
+ * @return true if the scheduler has nothing to run until the next timer or event.
+ */
+bool Task_AllIdle(void);
+
+/* @brief Puts a task to sleep for ms milliseconds. */
+void Task_Sleep(Task_t *task, uint32_t ms);
+
+/* @brief Returns true if the last await of the task ended by timeout. */
+static inline bool Task_TimedOut(const Task_t *task) {
+    return (task->flags & TASK_FLAG_TIMED_OUT) != 0;
+}
+
+#endif /* TASK_H_ */
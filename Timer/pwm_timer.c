@@ -0,0 +1,296 @@
+#include "pwm_timer.h"
+#include "format.h"
+#include "console.h"
+#include "uart.h"
+#include <stddef.h>
+
+/* Fixed properties of a timer */
+typedef struct {
+    TIM_TypeDef       *timer;
+    volatile uint32_t *rcc_reg;     /* Clock enable register */
+    uint32_t          rcc_en;       /* Clock enable bit */
+    uint8_t           apb2;         /* 1 if clocked from APB2, 0 from APB1 */
+    uint8_t           channels;     /* Number of compare channels */
+    uint8_t           af;           /* GPIO alternate function */
+    uint8_t           wide;         /* 1 for a 32-bit counter */
+    const char        *name;
+} pwm_hw_t;
+
+/* Allocation state of a timer */
+typedef struct {
+    uint32_t           freq_hz;     /* Period shared by the open channels */
+    uint32_t           steps;
+    const char         *owners[4];  /* Owner of each channel, NULL if free */
+    const char         *reserved;   /* Owner of the whole timer, NULL if not reserved */
+    PwmTimer_Reclock_t reclock;
+} pwm_state_t;
+
+/* Timers of the STM32F401 */
+static const pwm_hw_t pwm_hw[] = {
+    { TIM1,  &RCC->APB2ENR, RCC_APB2ENR_TIM1EN,  1, 4, 1, 0, "TIM1"  },
+    { TIM2,  &RCC->APB1ENR, RCC_APB1ENR_TIM2EN,  0, 4, 1, 1, "TIM2"  },
+    { TIM3,  &RCC->APB1ENR, RCC_APB1ENR_TIM3EN,  0, 4, 2, 0, "TIM3"  },
+    { TIM4,  &RCC->APB1ENR, RCC_APB1ENR_TIM4EN,  0, 4, 2, 0, "TIM4"  },
+    { TIM5,  &RCC->APB1ENR, RCC_APB1ENR_TIM5EN,  0, 4, 2, 1, "TIM5"  },
+    { TIM9,  &RCC->APB2ENR, RCC_APB2ENR_TIM9EN,  1, 2, 3, 0, "TIM9"  },
+    { TIM10, &RCC->APB2ENR, RCC_APB2ENR_TIM10EN, 1, 1, 3, 0, "TIM10" },
+    { TIM11, &RCC->APB2ENR, RCC_APB2ENR_TIM11EN, 1, 1, 3, 0, "TIM11" },
+};
+
+#define PWM_TIMER_COUNT     (sizeof(pwm_hw) / sizeof(pwm_hw[0]))
+/* Owner names are cut (and padded) to this width in the "pwm" listing */
+#define PWM_OWNER_WIDTH     16U
+
+static pwm_state_t pwm_state[PWM_TIMER_COUNT];
+
+/**
+ * @brief Returns the table index of a timer, -1 if unknown.
+ */
+static int32_t pwm_find(TIM_TypeDef *timer) {
+    for (uint32_t i = 0; i < PWM_TIMER_COUNT; i++) {
+        if (pwm_hw[i].timer == timer) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns 1 if any channel of the timer is open.
+ */
+static uint8_t pwm_channelsOpen(const pwm_state_t *state) {
+    for (uint32_t ch = 0; ch < 4U; ch++) {
+        if (state->owners[ch]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the input clock of a timer for an APB prescaler setting.
+ * @param hclk AHB clock in Hz.
+ * @param ppre PPRE1 or PPRE2 field of RCC->CFGR.
+ * @return Timer clock in Hz: twice the APB clock when the APB is divided.
+ */
+uint32_t PwmTimer_ClockFrom(uint32_t hclk, uint32_t ppre) {
+    /* 0xx: not divided, 100: /2, 101: /4, 110: /8, 111: /16 */
+    uint32_t shift = (ppre & 4U) ? (ppre & 3U) + 1U : 0U;
+    return shift ? (hclk >> shift) * 2U : hclk;
+}
+
+/**
+ * @brief Computes the prescaler for a frequency and a resolution.
+ * The prescaler is rounded to the nearest value; ARR is exactly steps - 1.
+ * @param timer_clk Timer input clock in Hz.
+ * @param freq_hz PWM frequency in Hz.
+ * @param steps Duty steps per period (ARR + 1), at least 2.
+ * @param max_arr Largest ARR of the timer.
+ * @param timing Receives the register values and the resulting frequency.
+ * @return true if reachable with a 16-bit prescaler.
+ */
+bool PwmTimer_Compute(uint32_t timer_clk, uint32_t freq_hz, uint32_t steps,
+        uint32_t max_arr, PwmTimer_Timing_t *timing) {
+    if (freq_hz == 0U || steps < 2U || steps - 1U > max_arr) {
+        return false;
+    }
+    uint64_t ticks = (uint64_t)freq_hz * steps;
+    uint64_t div = ((uint64_t)timer_clk + ticks / 2U) / ticks;
+    if (div == 0U || div > 0x10000U) {
+        return false;
+    }
+    timing->psc = (uint32_t)div - 1U;
+    timing->arr = steps - 1U;
+    timing->freq_hz = (uint32_t)(timer_clk / (div * steps));
+    return true;
+}
+
+/**
+ * @brief Returns the current input clock of a timer, read from RCC.
+ * @param timer Timer.
+ * @return Clock in Hz, 0 if not a timer of this MCU.
+ */
+uint32_t PwmTimer_Clock(TIM_TypeDef *timer) {
+    int32_t i = pwm_find(timer);
+    if (i < 0) {
+        return 0;
+    }
+    uint32_t ppre = pwm_hw[i].apb2 ? (RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos
+                                   : (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+    return PwmTimer_ClockFrom(SystemCoreClock, ppre);
+}
+
+/**
+ * @brief Returns the GPIO alternate function of a timer's channels.
+ * @param timer Timer.
+ * @return AF number, 0xFF if not a timer of this MCU.
+ */
+uint8_t PwmTimer_AF(TIM_TypeDef *timer) {
+    int32_t i = pwm_find(timer);
+    return (i < 0) ? 0xFF : pwm_hw[i].af;
+}
+
+/**
+ * @brief Opens a PWM channel (mode 1, active high, preloaded, duty 0).
+ * @param timer Timer.
+ * @param channel Channel, 1..4.
+ * @param freq_hz PWM frequency.
+ * @param steps Duty steps per period; the compare value runs 0..steps.
+ * @param owner Name shown by the "pwm" console command.
+ * @return PWM_TIMER_OK or the reason for refusing.
+ */
+PwmTimer_Status_t PwmTimer_Open(TIM_TypeDef *timer, uint8_t channel,
+        uint32_t freq_hz, uint32_t steps, const char *owner) {
+    int32_t i = pwm_find(timer);
+    if (i < 0 || channel < 1U || channel > pwm_hw[i].channels) {
+        return PWM_TIMER_ERR_TIMER;
+    }
+    const pwm_hw_t *hw = &pwm_hw[i];
+    pwm_state_t *state = &pwm_state[i];
+
+    if (state->reserved || state->owners[channel - 1U]) {
+        return PWM_TIMER_ERR_BUSY;
+    }
+    if (pwm_channelsOpen(state)) {
+        if (freq_hz != state->freq_hz || steps != state->steps) {
+            return PWM_TIMER_ERR_CONFLICT;
+        }
+    } else {
+        PwmTimer_Timing_t timing;
+        if (!PwmTimer_Compute(PwmTimer_Clock(timer), freq_hz, steps,
+                hw->wide ? 0xFFFFFFFFU : 0xFFFFU, &timing)) {
+            return PWM_TIMER_ERR_RANGE;
+        }
+        *hw->rcc_reg |= hw->rcc_en;
+        timer->CR1 = TIM_CR1_ARPE;
+        timer->PSC = timing.psc;
+        timer->ARR = timing.arr;
+        if (timer == TIM1) {
+            timer->BDTR |= TIM_BDTR_MOE; /* Advanced timer: main output enable */
+        }
+        timer->EGR = TIM_EGR_UG; /* Load PSC and ARR */
+        timer->SR = 0;
+        timer->CR1 |= TIM_CR1_CEN;
+        state->freq_hz = freq_hz;
+        state->steps = steps;
+    }
+
+    /* PWM mode 1 (OCxM = 110) with preload (OCxPE), then active high output */
+    volatile uint32_t *ccmr = (channel <= 2U) ? &timer->CCMR1 : &timer->CCMR2;
+    uint32_t ccmr_shift = ((channel - 1U) & 1U) * 8U;
+    uint32_t ccer_shift = (channel - 1U) * 4U;
+    *ccmr = (*ccmr & ~(0xFFUL << ccmr_shift)) | (0x68UL << ccmr_shift);
+    PwmTimer_Write(timer, channel, 0);
+    timer->CCER = (timer->CCER & ~(0xFUL << ccer_shift)) | (TIM_CCER_CC1E << ccer_shift);
+
+    state->owners[channel - 1U] = owner;
+    return PWM_TIMER_OK;
+}
+
+/**
+ * @brief Closes a channel; the timer stops when its last channel is closed.
+ * @param timer Timer.
+ * @param channel Channel, 1..4.
+ */
+void PwmTimer_Close(TIM_TypeDef *timer, uint8_t channel) {
+    int32_t i = pwm_find(timer);
+    if (i < 0 || channel < 1U || channel > pwm_hw[i].channels || !pwm_state[i].owners[channel - 1U]) {
+        return;
+    }
+    timer->CCER &= ~(0xFUL << ((channel - 1U) * 4U));
+    pwm_state[i].owners[channel - 1U] = NULL;
+    if (!pwm_channelsOpen(&pwm_state[i])) {
+        timer->CR1 &= ~TIM_CR1_CEN;
+        pwm_state[i].freq_hz = 0;
+        pwm_state[i].steps = 0;
+    }
+}
+
+/**
+ * @brief Reserves a whole timer for a non-PWM use and enables its clock.
+ * @param timer Timer.
+ * @param owner Name shown by the "pwm" console command.
+ * @param reclock Called by PwmTimer_ClockChanged() to redo the prescaler (may be NULL).
+ * @return PWM_TIMER_OK, PWM_TIMER_ERR_TIMER or PWM_TIMER_ERR_BUSY.
+ */
+PwmTimer_Status_t PwmTimer_Reserve(TIM_TypeDef *timer, const char *owner,
+        PwmTimer_Reclock_t reclock) {
+    int32_t i = pwm_find(timer);
+    if (i < 0) {
+        return PWM_TIMER_ERR_TIMER;
+    }
+    if (pwm_state[i].reserved || pwm_channelsOpen(&pwm_state[i])) {
+        return PWM_TIMER_ERR_BUSY;
+    }
+    *pwm_hw[i].rcc_reg |= pwm_hw[i].rcc_en;
+    pwm_state[i].reserved = owner;
+    pwm_state[i].reclock = reclock;
+    return PWM_TIMER_OK;
+}
+
+/**
+ * @brief Recomputes the prescalers after a clock change. The new prescaler
+ * is preloaded, so a running period finishes at the old rate.
+ */
+void PwmTimer_ClockChanged(void) {
+    for (uint32_t i = 0; i < PWM_TIMER_COUNT; i++) {
+        pwm_state_t *state = &pwm_state[i];
+        PwmTimer_Timing_t timing;
+
+        if (state->reserved) {
+            if (state->reclock) {
+                state->reclock();
+            }
+        } else if (pwm_channelsOpen(state)
+                && PwmTimer_Compute(PwmTimer_Clock(pwm_hw[i].timer), state->freq_hz, state->steps,
+                        pwm_hw[i].wide ? 0xFFFFFFFFU : 0xFFFFU, &timing)) {
+            pwm_hw[i].timer->PSC = timing.psc;
+        }
+    }
+}
+
+/**
+ * @brief Console command: "pwm" lists the timers in use, their clock and owners.
+ */
+static void pwm_command(const char *args) {
+    /* Longest line: 28 + 2 x 10 digits + 4 channels x (6 + PWM_OWNER_WIDTH) + NUL */
+    char line[144];
+    char *end = line + sizeof line - 1U;
+    char *p;
+
+    for (uint32_t i = 0; i < PWM_TIMER_COUNT; i++) {
+        const pwm_state_t *state = &pwm_state[i];
+        if (!state->reserved && !pwm_channelsOpen(state)) {
+            continue;
+        }
+        p = Format_Str(line, end, pwm_hw[i].name, 6);
+        p = Format_Uint(p, end, PwmTimer_Clock(pwm_hw[i].timer), 9, ' ');
+        p = Format_Str(p, end, " Hz  ", 0);
+        if (state->reserved) {
+            p = Format_Str(p, end, "reserved: ", 0);
+            p = Format_Str(p, end, state->reserved, PWM_OWNER_WIDTH);
+        } else {
+            p = Format_Uint(p, end, state->freq_hz, 0, ' ');
+            p = Format_Str(p, end, " Hz x ", 0);
+            p = Format_Uint(p, end, state->steps, 0, ' ');
+            for (uint32_t ch = 0; ch < 4U; ch++) {
+                if (state->owners[ch]) {
+                    p = Format_Str(p, end, "  ch", 0);
+                    p = Format_Uint(p, end, ch + 1U, 0, ' ');
+                    p = Format_Str(p, end, " ", 0);
+                    p = Format_Str(p, end, state->owners[ch], PWM_OWNER_WIDTH);
+                }
+            }
+        }
+        p = Format_Str(p, end, "\r\n", 0);
+        *p = '\0';
+        UART_Write(line);
+    }
+}
+
+/**
+ * @brief Registers the "pwm" console command.
+ */
+void PwmTimer_Init(void) {
+    Console_Register("pwm", pwm_command);
+}
@@ -0,0 +1,126 @@
+#ifndef PWM_TIMER_H_
+#define PWM_TIMER_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Hardware timer service.
+ * Hands out the general purpose timers of the STM32F401 (TIM1-5, TIM9-11)
+ * to the drivers. A PWM channel is opened with a frequency and a number
+ * of duty steps. The prescaler is computed from the APB timer clock read
+ * from RCC, not from a constant, and the auto-reload is steps - 1, so the
+ * duty values of the caller do not depend on the clock. Channels of one
+ * timer share its period: opening a channel with a different frequency or
+ * resolution than the other channels of the timer is refused, as is any
+ * channel of a timer reserved whole (tick or timeout timers).
+ * After a clock change, PwmTimer_ClockChanged() recomputes every prescaler
+ * (and Delay_ClockChanged() the delay and clock rates).
+ * The console command "pwm" lists the timers in use.
+ */
+
+/* Result of opening a channel */
+typedef enum {
+    PWM_TIMER_OK = 0,
+    PWM_TIMER_ERR_TIMER,    /* Not a timer of this MCU, or no such channel */
+    PWM_TIMER_ERR_BUSY,     /* Channel already open, or timer reserved */
+    PWM_TIMER_ERR_CONFLICT, /* Timer already runs at another frequency or resolution */
+    PWM_TIMER_ERR_RANGE,    /* Frequency and resolution not reachable from the timer clock */
+} PwmTimer_Status_t;
+
+/* Prescaler and period of a PWM timer */
+typedef struct {
+    uint32_t psc;       /*!< PSC register value. */
+    uint32_t arr;       /*!< ARR register value (steps - 1). */
+    uint32_t freq_hz;   /*!< Resulting PWM frequency (rounded down). */
+} PwmTimer_Timing_t;
+
+/* @brief Called after a clock change by the owner of a reserved timer. */
+typedef void (*PwmTimer_Reclock_t)(void);
+
+/* @brief Registers the "pwm" console command. */
+void PwmTimer_Init(void);
+
+/**
+ * @brief Returns the input clock of a timer for an APB prescaler setting.
+ * @param hclk AHB clock in Hz.
+ * @param ppre PPRE1 or PPRE2 field of RCC->CFGR.
+ * @return Timer clock in Hz: twice the APB clock when the APB is divided.
+ */
+uint32_t PwmTimer_ClockFrom(uint32_t hclk, uint32_t ppre);
+
+/**
+ * @brief Computes the prescaler for a frequency and a resolution.
+ * @param timer_clk Timer input clock in Hz.
+ * @param freq_hz PWM frequency in Hz.
+ * @param steps Duty steps per period (ARR + 1), at least 2.
+ * @param max_arr Largest ARR of the timer (0xFFFF, or 0xFFFFFFFF for TIM2/TIM5).
+ * @param timing Receives the register values and the resulting frequency.
+ * @return true if reachable with a 16-bit prescaler.
+ */
+bool PwmTimer_Compute(uint32_t timer_clk, uint32_t freq_hz, uint32_t steps,
+        uint32_t max_arr, PwmTimer_Timing_t *timing);
+
+/**
+ * @brief Returns the current input clock of a timer, read from RCC.
+ * @param timer Timer.
+ * @return Clock in Hz, 0 if not a timer of this MCU.
+ */
+uint32_t PwmTimer_Clock(TIM_TypeDef *timer);
+
+/**
+ * @brief Returns the GPIO alternate function of a timer's channels.
+ * @param timer Timer.
+ * @return AF number, 0xFF if not a timer of this MCU.
+ */
+uint8_t PwmTimer_AF(TIM_TypeDef *timer);
+
+/**
+ * @brief Opens a PWM channel (mode 1, active high, preloaded, duty 0).
+ * The first channel of a timer enables its clock and starts it; the pin
+ * is left to the caller (alternate function PwmTimer_AF()).
+ * @param timer Timer.
+ * @param channel Channel, 1..4.
+ * @param freq_hz PWM frequency.
+ * @param steps Duty steps per period; the compare value runs 0..steps.
+ * @param owner Name shown by the "pwm" console command.
+ * @return PWM_TIMER_OK or the reason for refusing.
+ */
+PwmTimer_Status_t PwmTimer_Open(TIM_TypeDef *timer, uint8_t channel,
+        uint32_t freq_hz, uint32_t steps, const char *owner);
+
+/**
+ * @brief Closes a channel; the timer stops when its last channel is closed.
+ * @param timer Timer.
+ * @param channel Channel, 1..4.
+ */
+void PwmTimer_Close(TIM_TypeDef *timer, uint8_t channel);
+
+/**
+ * @brief Reserves a whole timer for a non-PWM use and enables its clock.
+ * @param timer Timer.
+ * @param owner Name shown by the "pwm" console command.
+ * @param reclock Called by PwmTimer_ClockChanged() to redo the prescaler (may be NULL).
+ * @return PWM_TIMER_OK, or PWM_TIMER_ERR_BUSY if any channel is in use.
+ */
+PwmTimer_Status_t PwmTimer_Reserve(TIM_TypeDef *timer, const char *owner,
+        PwmTimer_Reclock_t reclock);
+
+/**
+ * @brief Recomputes the prescalers after SystemCoreClock or the APB
+ * prescalers changed. Periods and duty values stay the same.
+ */
+void PwmTimer_ClockChanged(void);
+
+/**
+ * @brief Sets the duty of an open channel.
+ * @param timer Timer.
+ * @param channel Channel, 1..4.
+ * @param value Compare value, 0..steps (steps = always on).
+ */
+static inline void PwmTimer_Write(TIM_TypeDef *timer, uint8_t channel, uint32_t value) {
+    (&timer->CCR1)[channel - 1U] = value;
+}
+
+#endif /* PWM_TIMER_H_ */
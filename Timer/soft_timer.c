@@ -0,0 +1,273 @@
+#include "soft_timer.h"
+#include "delay.h"
+
+#define SLOT_MASK       (SOFT_TIMER_SLOTS - 1U)
+#define LEVEL_SHIFT(l)  ((l) * SOFT_TIMER_SLOT_BITS)
+#define WHEEL_SPAN      (1UL << (SOFT_TIMER_LEVELS * SOFT_TIMER_SLOT_BITS))
+
+/* Slot lists of every level */
+static SoftTimer_t *wheel[SOFT_TIMER_LEVELS][SOFT_TIMER_SLOTS];
+/* One bit per non-empty slot, used to skip over empty stretches */
+static uint64_t occupied[SOFT_TIMER_LEVELS];
+/* Next tick to be processed */
+static uint32_t wheel_now = 0;
+/* Number of running timers */
+static uint32_t active_count = 0;
+
+/**
+ * @brief Links a timer into the slot matching its expiry time.
+ * @param timer Timer with expires already set.
+ */
+static void wheel_insert(SoftTimer_t *timer) {
+    uint32_t expires = timer->expires;
+    int32_t delta = (int32_t)(expires - wheel_now);
+    uint32_t level;
+
+    if (delta < 0) {
+        /* Already due: run it on the next processed tick */
+        expires = wheel_now;
+        delta = 0;
+    } else if ((uint32_t)delta >= WHEEL_SPAN) {
+        /* Beyond the wheel: park at the far end, re-filed on cascade */
+        expires = wheel_now + WHEEL_SPAN - 1U;
+        delta = (int32_t)(WHEEL_SPAN - 1U);
+    }
+
+    for (level = 0; level < SOFT_TIMER_LEVELS - 1U; level++) {
+        if ((uint32_t)delta < (1UL << LEVEL_SHIFT(level + 1U))) {
+            break;
+        }
+    }
+
+    uint32_t slot = (expires >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    SoftTimer_t **head = &wheel[level][slot];
+
+    timer->next = *head;
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+    occupied[level] |= (1ULL << slot);
+}
+
+/**
+ * @brief Unlinks a timer from whatever list it is on.
+ * @param timer Running timer.
+ */
+static void wheel_unlink(SoftTimer_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = 0;
+    timer->pprev = 0;
+}
+
+/**
+ * @brief Clears the occupied bit of a slot if it became empty.
+ */
+static inline void slot_update(uint32_t level, uint32_t slot) {
+    if (!wheel[level][slot]) {
+        occupied[level] &= ~(1ULL << slot);
+    }
+}
+
+/**
+ * @brief Moves every timer of a higher-level slot down to where it now belongs.
+ * @param level Level to cascade from (1 and up).
+ * @param slot Slot index in that level.
+ */
+static void wheel_cascade(uint32_t level, uint32_t slot) {
+    SoftTimer_t *list = wheel[level][slot];
+
+    wheel[level][slot] = 0;
+    occupied[level] &= ~(1ULL << slot);
+
+    while (list) {
+        SoftTimer_t *timer = list;
+        list = timer->next;
+        wheel_insert(timer);
+    }
+}
+
+/**
+ * @brief Initializes a timer. Must be called once before the timer is started.
+ * @param timer Timer to initialize.
+ * @param callback Function called on expiry.
+ * @param arg Argument passed to the callback.
+ */
+void SoftTimer_Init(SoftTimer_t *timer, SoftTimer_Callback_t callback, void *arg) {
+    timer->next = 0;
+    timer->pprev = 0;
+    timer->expires = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+/**
+ * @brief Starts (or restarts) a timer.
+ * @param timer Timer to start.
+ * @param delay_ms Delay before the first expiry.
+ * @param period_ms Reload period for a periodic timer, 0 for a one-shot timer.
+ */
+void SoftTimer_Start(SoftTimer_t *timer, uint32_t delay_ms, uint32_t period_ms) {
+    uint32_t now = Get_Ms_Ticks();
+
+    SoftTimer_Stop(timer);
+
+    if (delay_ms > SOFT_TIMER_MAX_DELAY) delay_ms = SOFT_TIMER_MAX_DELAY;
+    if (period_ms > SOFT_TIMER_MAX_DELAY) period_ms = SOFT_TIMER_MAX_DELAY;
+
+    if (active_count == 0) {
+        /* Nothing is filed: resynchronize instead of catching up later */
+        wheel_now = now;
+    }
+    timer->expires = now + delay_ms;
+    timer->period = period_ms;
+    wheel_insert(timer);
+    active_count++;
+}
+
+/**
+ * @brief Stops a timer. Does nothing if the timer is not running.
+ * @param timer Timer to stop.
+ */
+void SoftTimer_Stop(SoftTimer_t *timer) {
+    if (!timer->pprev) {
+        return;
+    }
+    wheel_unlink(timer);
+    active_count--;
+}
+
+/**
+ * @brief Advances the wheel to the current tick and runs expired callbacks.
+ * @note  Call from the main loop. Ticks missed in between are caught up.
+ */
+void SoftTimer_Process(void) {
+    SoftTimer_AdvanceTo(Get_Ms_Ticks());
+}
+
+/**
+ * @brief Advances the wheel to an explicit tick and runs expired callbacks.
+ * @param now Tick to advance to (inclusive).
+ */
+void SoftTimer_AdvanceTo(uint32_t now) {
+    while ((int32_t)(now - wheel_now) >= 0) {
+        uint32_t tick = wheel_now;
+        uint32_t slot = tick & SLOT_MASK;
+
+        if (active_count == 0) {
+            wheel_now = now + 1U;
+            return;
+        }
+
+        /* At the start of each 64-tick block pull down the next higher slots */
+        if (slot == 0) {
+            uint32_t level = 1;
+            while (level < SOFT_TIMER_LEVELS
+                    && ((tick >> LEVEL_SHIFT(level - 1U)) & SLOT_MASK) == 0) {
+                level++;
+            }
+            /* Highest level first so its timers can trickle all the way down */
+            while (--level > 0) {
+                wheel_cascade(level, (tick >> LEVEL_SHIFT(level)) & SLOT_MASK);
+            }
+        }
+
+        /* Skip empty level-0 slots up to the next due timer or block end */
+        uint64_t pending = occupied[0] >> slot;
+        if (!pending) {
+            uint32_t skip = SOFT_TIMER_SLOTS - slot;
+            if ((int32_t)(now - tick) < (int32_t)skip) {
+                wheel_now = now + 1U;
+                return;
+            }
+            wheel_now = tick + skip;
+            continue;
+        }
+        uint32_t skip = (uint32_t)__builtin_ctzll(pending);
+        if (skip) {
+            if ((int32_t)(now - tick) < (int32_t)skip) {
+                wheel_now = now + 1U;
+                return;
+            }
+            wheel_now = tick + skip;
+            continue;
+        }
+
+        /* Detach the due slot; callbacks may freely start/stop timers */
+        SoftTimer_t *list = wheel[0][slot];
+        wheel[0][slot] = 0;
+        if (list) {
+            list->pprev = &list;
+        }
+        slot_update(0, slot);
+        wheel_now = tick + 1U;
+
+        while (list) {
+            SoftTimer_t *timer = list;
+            wheel_unlink(timer);
+            active_count--;
+
+            if (timer->period) {
+                timer->expires += timer->period;
+                wheel_insert(timer);
+                active_count++;
+            }
+            if (timer->callback) {
+                timer->callback(timer->arg);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rotates a slot bitmap right so that bit 0 is the given slot.
+ */
+static inline uint64_t rotate_slots(uint64_t bits, uint32_t slot) {
+    return slot ? ((bits >> slot) | (bits << (SOFT_TIMER_SLOTS - slot))) : bits;
+}
+
+/**
+ * @brief Returns how long the wheel can be left alone.
+ * @return Milliseconds from now until the wheel needs processing
+ * (0 if already due, SOFT_TIMER_MAX_DELAY if no timer is running).
+ */
+uint32_t SoftTimer_NextExpiry(void) {
+    uint32_t now = Get_Ms_Ticks();
+    uint32_t next = wheel_now + SOFT_TIMER_MAX_DELAY;
+
+    if (active_count == 0) {
+        return SOFT_TIMER_MAX_DELAY;
+    }
+
+    /* Level 0: the first occupied slot from the current one is the next expiry */
+    if (occupied[0]) {
+        uint32_t slot = wheel_now & SLOT_MASK;
+        next = wheel_now + (uint32_t)__builtin_ctzll(rotate_slots(occupied[0], slot));
+    }
+
+    /* Higher levels: the next occupied slot is pulled down at its block start */
+    for (uint32_t level = 1; level < SOFT_TIMER_LEVELS; level++) {
+        if (!occupied[level]) {
+            continue;
+        }
+        uint32_t block = wheel_now >> LEVEL_SHIFT(level);
+        /* The current block is still to be cascaded if we stand on its first tick */
+        uint32_t first = (wheel_now & ((1UL << LEVEL_SHIFT(level)) - 1U)) ? 1U : 0U;
+        uint32_t slot = (block + first) & SLOT_MASK;
+        uint32_t distance = first + (uint32_t)__builtin_ctzll(rotate_slots(occupied[level], slot));
+        uint32_t cascade_at = (block + distance) << LEVEL_SHIFT(level);
+        if ((int32_t)(cascade_at - next) < 0) {
+            next = cascade_at;
+        }
+    }
+
+    if ((int32_t)(next - now) <= 0) {
+        return 0;
+    }
+    return next - now;
+}
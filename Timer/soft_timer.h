@@ -0,0 +1,96 @@
+#ifndef SOFT_TIMER_H_
+#define SOFT_TIMER_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Software timers on a hierarchical timing wheel.
+ * The wheel has SOFT_TIMER_LEVELS levels of 64 slots each. Level 0 holds
+ * timers due in the next 64 ms, level 1 those due in the next 4 s, and so
+ * on up to ~4.6 h; longer timers are parked in the top level and re-filed
+ * when they come closer. Start and stop are O(1) list operations, and the
+ * wheel is advanced from the main loop up to the SysTick millisecond count,
+ * so callbacks never run in interrupt context.
+ */
+
+/* Wheel geometry */
+#define SOFT_TIMER_LEVELS       4U
+#define SOFT_TIMER_SLOT_BITS    6U
+#define SOFT_TIMER_SLOTS        (1U << SOFT_TIMER_SLOT_BITS)
+
+/* Longest supported delay or period in ms (timestamps are compared as signed) */
+#define SOFT_TIMER_MAX_DELAY    0x7FFFFFFFU
+
+typedef struct SoftTimer SoftTimer_t;
+
+/* @brief Timer callback, called from SoftTimer_Process(). */
+typedef void (*SoftTimer_Callback_t)(void *arg);
+
+/**
+ * @brief Software timer. Allocated by the user, typically as a static.
+ */
+struct SoftTimer {
+    SoftTimer_t          *next;     /*!< Next timer in the wheel slot. */
+    SoftTimer_t          **pprev;   /*!< Link pointing to this timer (NULL when stopped). */
+    uint32_t             expires;   /*!< Expiry time in ms ticks. */
+    uint32_t             period;    /*!< Reload period in ms (0 = one-shot). */
+    SoftTimer_Callback_t callback;  /*!< Function called on expiry. */
+    void                 *arg;      /*!< Argument passed to the callback. */
+};
+
+/**
+ * @brief Initializes a timer. Must be called once before the timer is started.
+ * @param timer Timer to initialize.
+ * @param callback Function called on expiry.
+ * @param arg Argument passed to the callback.
+ */
+void SoftTimer_Init(SoftTimer_t *timer, SoftTimer_Callback_t callback, void *arg);
+
+/**
+ * @brief Starts (or restarts) a timer.
+ * @param timer Timer to start.
+ * @param delay_ms Delay before the first expiry.
+ * @param period_ms Reload period for a periodic timer, 0 for a one-shot timer.
+ */
+void SoftTimer_Start(SoftTimer_t *timer, uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Stops a timer. Does nothing if the timer is not running.
+ * @param timer Timer to stop.
+ */
+void SoftTimer_Stop(SoftTimer_t *timer);
+
+/**
+ * @brief Checks whether a timer is running.
+ * @param timer Timer to check.
+ * @return true if the timer is armed.
+ */
+static inline bool SoftTimer_IsActive(const SoftTimer_t *timer) {
+    return timer->pprev != 0;
+}
+
+/**
+ * @brief Advances the wheel to the current tick and runs expired callbacks.
+ * @note  Call from the main loop. Ticks missed in between are caught up.
+ */
+void SoftTimer_Process(void);
+
+/**
+ * @brief Advances the wheel to an explicit tick and runs expired callbacks.
+ * @param now Tick to advance to (inclusive).
+ */
+void SoftTimer_AdvanceTo(uint32_t now);
+
+/**
+ * @brief Returns how long the wheel can be left alone.
+ * @note  The value is a lower bound on the time to the next expiry: a slot
+ * that is due for a cascade counts as an expiry. Used to program tickless
+ * idle.
+ * @return Milliseconds from now until the wheel needs processing
+ * (0 if already due, SOFT_TIMER_MAX_DELAY if no timer is running).
+ */
+uint32_t SoftTimer_NextExpiry(void);
+
+#endif /* SOFT_TIMER_H_ */
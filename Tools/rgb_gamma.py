@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Generates the gamma table of the RGB status light (Led_RGB/rgb_gamma.h).
+
+Maps 8-bit perceptual levels to TIM1 compare values: 0..255 becomes
+0..(arr + 1), where arr + 1 is a 100% duty in PWM mode 1. With the
+default exponent, equal steps of the input look like equal steps of
+brightness, so fades and pulses are even.
+
+Usage: rgb_gamma.py [--gamma 2.2] [--arr 1023] > Led_RGB/rgb_gamma.h
+"""
+
+import argparse
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--gamma", type=float, default=2.2)
+    parser.add_argument("--arr", type=int, default=1023, help="TIM1 auto-reload value")
+    args = parser.parse_args()
+
+    top = args.arr + 1
+    table = [round(top * (i / 255) ** args.gamma) for i in range(256)]
+
+    print("/* Generated by Tools/rgb_gamma.py --gamma %g --arr %d; do not edit. */"
+          % (args.gamma, args.arr))
+    print("#ifndef INC_RGB_GAMMA_H_")
+    print("#define INC_RGB_GAMMA_H_")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print("/* Auto-reload value the table was built for */")
+    print("#define RGB_GAMMA_ARR   %dU" % args.arr)
+    print()
+    print("/* Compare value of each 8-bit level (gamma %g) */" % args.gamma)
+    print("static const uint16_t rgb_gamma[256] = {")
+    for row in range(0, 256, 16):
+        print("    " + ", ".join("%4d" % v for v in table[row:row + 16]) + ",")
+    print("};")
+    print()
+    print("#endif /* INC_RGB_GAMMA_H_ */")
+
+
+if __name__ == "__main__":
+    main()
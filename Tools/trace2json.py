@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Convert a firmware trace dump to Chrome trace / Perfetto JSON.
+
+Capture the output of the console command "trace" (UART) or "trace swo"
+(ITM port 0) to a file, then run:
+
+    python3 trace2json.py capture.txt -o trace.json
+
+and open trace.json in chrome://tracing or https://ui.perfetto.dev.
+Event ids and record layout must match Trace/trace.h.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+EVT_STATE = 0x01
+EVT_RC522_BEGIN = 0x02
+EVT_RC522_END = 0x03
+EVT_IR_EDGE = 0x04
+EVT_SERVO = 0x05
+EVT_LCD_FLUSH_BEGIN = 0x06
+EVT_LCD_FLUSH_END = 0x07
+EVT_SERVO_DONE = 0x08
+
+# BarrierState_t in Core/main.c
+STATES = [
+    "CLOSED",
+    "AUTHORIZED_WAITING_VEHICLE",
+    "OPENING",
+    "OPEN_WAITING_PASSAGE",
+    "CLOSING",
+    "WAIT_BEFORE_CLOSING",
+]
+
+PCD_COMMANDS = {0x00: "IDLE", 0x03: "CALCCRC", 0x04: "TRANSMIT",
+                0x08: "RECEIVE", 0x0C: "TRANSCEIVE", 0x0E: "AUTHENT",
+                0x0F: "RESETPHASE"}
+MI_STATUS = {0: "OK", 1: "NOTAGERR", 2: "ERR"}
+IR_SENSORS = {1: "entry", 2: "exit"}
+
+# One track (thread) per subsystem
+TID_GATE, TID_RC522, TID_IR, TID_SERVO, TID_LCD = 1, 2, 3, 4, 5
+TRACKS = {TID_GATE: "gate state", TID_RC522: "rc522", TID_IR: "ir sensors",
+          TID_SERVO: "servo", TID_LCD: "lcd"}
+
+
+def parse_dump(lines):
+    """Returns (clock_hz, [(cycles, id, arg), ...]) of the dumps in lines.
+
+    Each dump drains the firmware buffer, so consecutive dumps hold
+    consecutive events and are joined."""
+    clock_hz, records, current = None, None, None
+    for raw in lines:
+        line = raw.strip()
+        if line.startswith("TRACE "):
+            fields = line.split()
+            clock_hz = int(fields[1], 16)
+            current = []
+        elif line == "END" and current is not None:
+            records, current = (records or []) + current, None
+        elif current is not None and len(line) == 16:
+            time_lo, time_hi, evt, arg = struct.unpack("<IHBB", bytes.fromhex(line))
+            current.append(((time_hi << 32) | time_lo, evt, arg))
+    if clock_hz is None or records is None:
+        raise ValueError("no complete TRACE ... END block found")
+    return clock_hz, records
+
+
+def to_chrome(clock_hz, records):
+    """Builds the Chrome trace event list."""
+    events = [{"ph": "M", "name": "process_name", "pid": 1, "tid": 0,
+               "args": {"name": "parking gate"}}]
+    for tid, name in TRACKS.items():
+        events.append({"ph": "M", "name": "thread_name", "pid": 1, "tid": tid,
+                       "args": {"name": name}})
+
+    if not records:
+        return events
+    origin = records[0][0]
+    state = None
+
+    def us(cycles):
+        return (cycles - origin) * 1e6 / clock_hz
+
+    def emit(ph, tid, name, ts, **extra):
+        event = {"ph": ph, "pid": 1, "tid": tid, "name": name, "ts": ts}
+        event.update(extra)
+        events.append(event)
+
+    for cycles, evt, arg in records:
+        ts = us(cycles)
+        if evt == EVT_STATE:
+            if state is not None:
+                emit("E", TID_GATE, state, ts)
+            state = STATES[arg] if arg < len(STATES) else "STATE_%d" % arg
+            emit("B", TID_GATE, state, ts)
+        elif evt == EVT_RC522_BEGIN:
+            emit("B", TID_RC522, PCD_COMMANDS.get(arg, "0x%02x" % arg), ts)
+        elif evt == EVT_RC522_END:
+            emit("E", TID_RC522, "", ts,
+                 args={"status": MI_STATUS.get(arg & 0x7F, arg & 0x7F),
+                       "timeout": bool(arg & 0x80)})
+        elif evt == EVT_IR_EDGE:
+            sensor = IR_SENSORS.get(arg & 0x7F, "pin %d" % (arg & 0x7F))
+            emit("i", TID_IR, "%s %s" % (sensor, "blocked" if arg & 0x80 else "clear"),
+                 ts, s="t")
+        elif evt == EVT_SERVO:
+            emit("i", TID_SERVO, "angle %d" % arg, ts, s="t")
+            emit("C", TID_SERVO, "servo angle", ts, args={"deg": arg})
+        elif evt == EVT_SERVO_DONE:
+            emit("i", TID_SERVO, "reached %d" % arg, ts, s="t")
+        elif evt == EVT_LCD_FLUSH_BEGIN:
+            emit("B", TID_LCD, "flush", ts)
+        elif evt == EVT_LCD_FLUSH_END:
+            emit("E", TID_LCD, "", ts, args={"transfers": arg})
+        else:
+            emit("i", TID_GATE, "event 0x%02x" % evt, ts, s="t", args={"arg": arg})
+
+    if state is not None:
+        emit("E", TID_GATE, state, us(records[-1][0]))
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="captured console output containing a trace dump")
+    parser.add_argument("-o", "--output", help="output JSON file (default: stdout)")
+    options = parser.parse_args()
+
+    with open(options.dump, "r", errors="replace") as f:
+        clock_hz, records = parse_dump(f)
+
+    trace = {"traceEvents": to_chrome(clock_hz, records), "displayTimeUnit": "ms"}
+    if options.output:
+        with open(options.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+    print("%d events, %.3f s" % (len(records),
+          (records[-1][0] - records[0][0]) / clock_hz if records else 0.0), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
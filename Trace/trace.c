@@ -0,0 +1,134 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include "delay.h"
+#include "console.h"
+#include "uart.h"
+#include <string.h>
+
+static Trace_Event_t trace_ring[TRACE_BUFFER_SIZE];
+/* Total number of events written (the ring index is its low bits) */
+static volatile uint32_t trace_head = 0;
+/* Events before this count are discarded */
+static uint32_t trace_tail = 0;
+/* Set while dumping so that the records being read are not overwritten */
+static volatile uint8_t trace_paused = 0;
+
+/**
+ * @brief Appends an event, overwriting the oldest one when full.
+ * @param id TRACE_EVT_* id.
+ * @param arg Event argument.
+ */
+void Trace_Record(uint8_t id, uint8_t arg) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!trace_paused) {
+        uint64_t now = monotonic_cycles();
+        Trace_Event_t *event = &trace_ring[trace_head & (TRACE_BUFFER_SIZE - 1U)];
+        event->time_lo = (uint32_t)now;
+        event->time_hi = (uint16_t)(now >> 32);
+        event->id = id;
+        event->arg = arg;
+        trace_head++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Discards all recorded events.
+ */
+void Trace_Clear(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    trace_tail = trace_head;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Appends a value as fixed-width hex digits.
+ */
+static char *put_hex(char *p, uint32_t value, uint32_t digits) {
+    static const char hex[] = "0123456789abcdef";
+    while (digits--) {
+        *p++ = hex[(value >> (digits * 4U)) & 0xFU];
+    }
+    return p;
+}
+
+/**
+ * @brief Sends the recorded events as text, oldest first, and removes them
+ * from the buffer: the next dump starts with the events recorded since.
+ * @note  Format: "TRACE <clock Hz> <count>", then one line per record with
+ * the 8 record bytes in hex (memory order), then "END". Events posted while
+ * dumping are dropped.
+ * @param write Output function (e.g. UART_Write).
+ */
+void Trace_Dump(void (*write)(const char *str)) {
+    char line[24];
+    char *p;
+
+    trace_paused = 1;
+
+    uint32_t head = trace_head;
+    uint32_t first = trace_tail;
+    if (head - first > TRACE_BUFFER_SIZE) {
+        first = head - TRACE_BUFFER_SIZE; /* The oldest events were overwritten */
+    }
+
+    write("TRACE ");
+    p = put_hex(line, SystemCoreClock, 8);
+    *p++ = ' ';
+    p = put_hex(p, head - first, 4);
+    *p++ = '\r'; *p++ = '\n'; *p = '\0';
+    write(line);
+
+    for (uint32_t i = first; i != head; i++) {
+        const uint8_t *bytes = (const uint8_t *)&trace_ring[i & (TRACE_BUFFER_SIZE - 1U)];
+        p = line;
+        for (uint32_t b = 0; b < sizeof(Trace_Event_t); b++) {
+            p = put_hex(p, bytes[b], 2);
+        }
+        *p++ = '\r'; *p++ = '\n'; *p = '\0';
+        write(line);
+    }
+    trace_tail = head;  /* Sent: the next dump starts after them */
+    write("END\r\n");
+
+    trace_paused = 0;
+}
+
+/**
+ * @brief Sends a string over ITM stimulus port 0 (SWO).
+ */
+static void trace_write_swo(const char *str) {
+    while (*str) {
+        ITM_SendChar((uint32_t)*str++);
+    }
+}
+
+/**
+ * @brief Console command: "trace" dumps to the UART, "trace swo" to SWO,
+ * "trace clear" empties the buffer.
+ */
+static void trace_command(const char *args) {
+    if (strcmp(args, "clear") == 0) {
+        Trace_Clear();
+        UART_Write("trace: cleared\r\n");
+    } else if (strcmp(args, "swo") == 0) {
+        Trace_Dump(trace_write_swo);
+    } else {
+        Trace_Dump(UART_Write);
+    }
+}
+
+/**
+ * @brief Registers the "trace" console command.
+ */
+void Trace_Init(void) {
+    Console_Register("trace", trace_command);
+}
+
+#endif /* TRACE_ENABLE */
@@ -0,0 +1,82 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/**
+ * @brief Flight recorder for field debugging.
+ * Events are stored as 8-byte records in a RAM ring buffer that always
+ * keeps the newest TRACE_BUFFER_SIZE events. Each record holds a 48-bit
+ * timestamp in CPU cycles (from monotonic_cycles(), so it survives tickless
+ * idle), an event id and an 8-bit argument. Recording is safe from
+ * interrupts and costs a few dozen cycles, so it is enabled by default.
+ *
+ * The console command "trace" drains the buffer as hex text on the service
+ * UART, "trace swo" sends it over ITM stimulus port 0 instead and
+ * "trace clear" empties it. Tools/trace2json.py turns a captured dump into
+ * Chrome trace / Perfetto JSON.
+ */
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE        1
+#endif
+
+/* Number of events kept (power of two) */
+#define TRACE_BUFFER_SIZE   256U
+
+/* Event ids (keep in sync with Tools/trace2json.py) */
+#define TRACE_EVT_STATE           0x01U  /* arg: new BarrierState_t */
+#define TRACE_EVT_RC522_BEGIN     0x02U  /* arg: PCD command */
+#define TRACE_EVT_RC522_END       0x03U  /* arg: status, bit 7 set on timeout */
+#define TRACE_EVT_IR_EDGE         0x04U  /* arg: EXTI pin, bit 7 set when blocked */
+#define TRACE_EVT_SERVO           0x05U  /* arg: commanded angle in degrees */
+#define TRACE_EVT_LCD_FLUSH_BEGIN 0x06U  /* arg: unused */
+#define TRACE_EVT_LCD_FLUSH_END   0x07U  /* arg: bus transfers sent (saturated) */
+#define TRACE_EVT_SERVO_DONE      0x08U  /* arg: angle reached in degrees */
+
+/**
+ * @brief Trace record as stored in RAM and dumped (little endian).
+ */
+typedef struct {
+    uint32_t time_lo;   /*!< Timestamp in cycles, bits 0..31. */
+    uint16_t time_hi;   /*!< Timestamp in cycles, bits 32..47. */
+    uint8_t  id;        /*!< TRACE_EVT_* id. */
+    uint8_t  arg;       /*!< Event argument. */
+} Trace_Event_t;
+
+#if TRACE_ENABLE
+
+/* @brief Registers the "trace" console command. */
+void Trace_Init(void);
+
+/**
+ * @brief Appends an event, overwriting the oldest one when full.
+ * @note  Safe to call from interrupts.
+ * @param id TRACE_EVT_* id.
+ * @param arg Event argument.
+ */
+void Trace_Record(uint8_t id, uint8_t arg);
+
+/* @brief Discards all recorded events. */
+void Trace_Clear(void);
+
+/**
+ * @brief Sends the recorded events as text, oldest first, and removes them
+ * from the buffer (repeated dumps stream the events without duplicates).
+ * @param write Output function (e.g. UART_Write).
+ */
+void Trace_Dump(void (*write)(const char *str));
+
+#define TRACE(id, arg)      Trace_Record((id), (uint8_t)(arg))
+
+#else
+
+#define Trace_Init()        ((void)0)
+#define Trace_Clear()       ((void)0)
+#define Trace_Dump(write)   ((void)(write))
+#define TRACE(id, arg)      ((void)0)
+
+#endif /* TRACE_ENABLE */
+
+#endif /* TRACE_H_ */
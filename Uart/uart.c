@@ -0,0 +1,101 @@
+#include "uart.h"
+
+/* Receive ring buffer filled by the interrupt */
+static volatile uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+/* Line being assembled by UART_ReadLine() */
+static char line_buffer[48];
+static size_t line_length = 0;
+
+/**
+ * @brief Returns the APB2 peripheral clock (USART1/USART6 bus) in Hz.
+ */
+static uint32_t uart_pclk_hz(void) {
+    uint32_t ppre2 = (RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos;
+    return SystemCoreClock >> APBPrescTable[ppre2];
+}
+
+/**
+ * @brief Initializes the service UART (8N1) and its receive interrupt.
+ * @param baud Baud rate, e.g. 115200.
+ */
+void UART_Init(uint32_t baud) {
+    /* Enable the USART6 clock (pins: board pin table) */
+    RCC->APB2ENR |= RCC_APB2ENR_USART6EN;
+
+    /* 16x oversampling: BRR holds USARTDIV * 16, rounded */
+    UART_INSTANCE->CR1 = 0;
+    UART_INSTANCE->BRR = (uart_pclk_hz() + baud / 2U) / baud;
+    UART_INSTANCE->CR1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE | USART_CR1_UE;
+
+    NVIC_EnableIRQ(UART_IRQn);
+}
+
+/**
+ * @brief USART6 interrupt: stores received bytes, drops them when full.
+ */
+void USART6_IRQHandler(void) {
+    if (UART_INSTANCE->SR & USART_SR_RXNE) {
+        uint8_t c = (uint8_t)UART_INSTANCE->DR; /* Reading DR clears RXNE */
+        uint32_t next = (rx_head + 1U) & (UART_RX_BUFFER_SIZE - 1U);
+        if (next != rx_tail) {
+            rx_buffer[rx_head] = c;
+            rx_head = next;
+        }
+    }
+}
+
+/**
+ * @brief Sends raw bytes (blocking until the last byte is in the shift register).
+ * @param data Bytes to send.
+ * @param len Number of bytes.
+ */
+void UART_WriteBytes(const uint8_t *data, size_t len) {
+    while (len--) {
+        while (!(UART_INSTANCE->SR & USART_SR_TXE));
+        UART_INSTANCE->DR = *data++;
+    }
+}
+
+/**
+ * @brief Sends a zero-terminated string.
+ * @param str String to send.
+ */
+void UART_Write(const char *str) {
+    while (*str) {
+        while (!(UART_INSTANCE->SR & USART_SR_TXE));
+        UART_INSTANCE->DR = (uint8_t)*str++;
+    }
+}
+
+/**
+ * @brief Collects received characters into a command line.
+ * @param line Buffer receiving the line (without the terminator).
+ * @param size Size of the buffer.
+ * @return true when a complete line (ended by CR or LF) is in line.
+ */
+bool UART_ReadLine(char *line, size_t size) {
+    while (rx_tail != rx_head) {
+        char c = (char)rx_buffer[rx_tail];
+        rx_tail = (rx_tail + 1U) & (UART_RX_BUFFER_SIZE - 1U);
+
+        if (c == '\r' || c == '\n') {
+            if (line_length == 0) {
+                continue; /* Ignore empty lines and the LF of CRLF */
+            }
+            size_t n = (line_length < size - 1U) ? line_length : size - 1U;
+            for (size_t i = 0; i < n; i++) {
+                line[i] = line_buffer[i];
+            }
+            line[n] = '\0';
+            line_length = 0;
+            return true;
+        }
+        if (line_length < sizeof(line_buffer)) {
+            line_buffer[line_length++] = c;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,38 @@
+#ifndef UART_H_
+#define UART_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*------------- PIN DEFINITIONS -------------*/
+/* Service/debug port: USART6 on PA11 (TX) / PA12 (RX), AF8 (board pin table) */
+#define UART_INSTANCE           USART6
+#define UART_IRQn               USART6_IRQn
+#define UART_GPIO_PORT          GPIOA
+#define UART_TX_PIN             11
+#define UART_RX_PIN             12
+#define UART_GPIO_AF            8
+
+/* Size of the receive ring buffer (power of two) */
+#define UART_RX_BUFFER_SIZE     64U
+
+/* @brief Initializes the service UART (8N1) and its receive interrupt. */
+void UART_Init(uint32_t baud);
+
+/* @brief Sends raw bytes (blocking until the last byte is in the shift register). */
+void UART_WriteBytes(const uint8_t *data, size_t len);
+
+/* @brief Sends a zero-terminated string. */
+void UART_Write(const char *str);
+
+/**
+ * @brief Collects received characters into a command line.
+ * @param line Buffer receiving the line (without the terminator).
+ * @param size Size of the buffer.
+ * @return true when a complete line (ended by CR or LF) is in line.
+ */
+bool UART_ReadLine(char *line, size_t size);
+
+#endif /* UART_H_ */